@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# Home monitoring system
+# Author: Maksymilian Komarnicki
+#
+# Measures requests/s and latency of control server URIs with several concurrent keep-alive clients.
+
+import argparse
+import http.client
+import json
+import threading
+import time
+
+DEFAULT_URIS = [
+    "/get_config_frame",
+    "/get_config_cam",
+    "/get_sources",
+    "/get_stream_clients",
+    "/metrics",
+]
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+class Client(threading.Thread):
+    def __init__(self, host, port, uris, deadline):
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.uris = uris
+        self.deadline = deadline
+        self.latencies_ms = {uri: [] for uri in uris}
+        self.errors = 0
+
+    def run(self):
+        connection = http.client.HTTPConnection(self.host, self.port, timeout=5)
+        i = 0
+        while time.monotonic() < self.deadline:
+            uri = self.uris[i % len(self.uris)]
+            i += 1
+            start = time.perf_counter()
+            try:
+                connection.request("GET", uri)
+                response = connection.getresponse()
+                response.read()
+                if response.status >= 400:
+                    self.errors += 1
+                    continue
+            except (OSError, http.client.HTTPException):
+                self.errors += 1
+                connection.close()
+                connection = http.client.HTTPConnection(self.host, self.port, timeout=5)
+                continue
+            self.latencies_ms[uri].append((time.perf_counter() - start) * 1000)
+        connection.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds")
+    parser.add_argument("--uri", action="append", help="URI to request, may be repeated")
+    parser.add_argument("--json", action="store_true", help="print result as JSON")
+    args = parser.parse_args()
+
+    uris = args.uri or DEFAULT_URIS
+    deadline = time.monotonic() + args.duration
+    clients = [Client(args.host, args.port, uris, deadline) for _ in range(args.clients)]
+    for client in clients:
+        client.start()
+    for client in clients:
+        client.join(args.duration + 10)
+
+    result = {"clients": args.clients, "duration_s": args.duration, "uris": {}}
+    total = 0
+    for uri in uris:
+        latencies = [latency for client in clients for latency in client.latencies_ms[uri]]
+        total += len(latencies)
+        result["uris"][uri] = {
+            "req_s": round(len(latencies) / args.duration, 1),
+            "p50_ms": round(percentile(latencies, 50), 2),
+            "p99_ms": round(percentile(latencies, 99), 2),
+        }
+    result["req_s"] = round(total / args.duration, 1)
+    result["errors"] = sum(client.errors for client in clients)
+
+    if args.json:
+        print(json.dumps(result))
+        return
+
+    for uri, stats in result["uris"].items():
+        print(f"{uri}: {stats['req_s']} req/s, p50 {stats['p50_ms']} ms, p99 {stats['p99_ms']} ms")
+    print(f"total: {result['req_s']} req/s, errors {result['errors']}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+#
+# Home monitoring system
+# Author: Maksymilian Komarnicki
+#
+# Measures frames/s and per-frame latency of /stream with several concurrent viewers. Latency is read from COM
+# segment that mock ESPFSP client of host build puts into every frame, so it is only reported for host build.
+
+import argparse
+import json
+import re
+import socket
+import threading
+import time
+import urllib.request
+
+TIMESTAMP_RE = re.compile(rb"espfsp-mock ts=(\d+) seq=(\d+)")
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def run_command(host, port, uri, timeout=10.0, body=None):
+    """Queues control command and waits until control worker finishes it. Body is POSTed as JSON when given."""
+    request = urllib.request.Request(f"http://{host}:{port}{uri}")
+    if body is not None:
+        request.data = json.dumps(body).encode()
+        request.add_header("Content-Type", "application/json")
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        command_id = json.load(response)["id"]
+    while True:
+        url = f"http://{host}:{port}/get_command?id={command_id}&wait=5000"
+        with urllib.request.urlopen(url, timeout=timeout) as response:
+            status = json.load(response)
+        if status["state"] == "merged":
+            command_id = status["merged_into"]
+        elif status["state"] != "queued" and status["state"] != "running":
+            return status
+
+
+class Viewer(threading.Thread):
+    def __init__(self, host, port, path, deadline):
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.path = path
+        self.deadline = deadline
+        self.frames = 0
+        self.bytes = 0
+        self.latencies_ms = []
+        self.arrivals = []  # (monotonic time, latency ms or None) of every frame
+        self.lost = 0
+        self.first_frame_s = None
+        self.error = None
+
+    def read_part(self, stream):
+        headers = {}
+        line = stream.readline()
+        while line in (b"\r\n", b"\n"):
+            line = stream.readline()
+        if not line:
+            return None
+        while line not in (b"\r\n", b"\n", b""):
+            if b":" in line:
+                key, value = line.split(b":", 1)
+                headers[key.strip().lower()] = value.strip()
+            line = stream.readline()
+        length = int(headers[b"content-length"])
+        return stream.read(length)
+
+    def run(self):
+        start = time.monotonic()
+        last_seq = None
+        try:
+            sock = socket.create_connection((self.host, self.port), timeout=5)
+            sock.sendall(f"GET {self.path} HTTP/1.1\r\nHost: {self.host}\r\n\r\n".encode())
+            stream = sock.makefile("rb")
+            status = stream.readline()
+            if b" 200 " not in status:
+                raise RuntimeError(status.decode(errors="replace").strip())
+            while stream.readline() not in (b"\r\n", b""):
+                pass
+
+            while time.monotonic() < self.deadline:
+                frame = self.read_part(stream)
+                if frame is None:
+                    break
+                now_us = time.time() * 1e6
+                if self.first_frame_s is None:
+                    self.first_frame_s = time.monotonic() - start
+                self.frames += 1
+                self.bytes += len(frame)
+
+                match = TIMESTAMP_RE.search(frame, 0, 256)
+                latency_ms = None
+                if match:
+                    latency_ms = (now_us - int(match.group(1))) / 1000
+                    self.latencies_ms.append(latency_ms)
+                    seq = int(match.group(2))
+                    if last_seq is not None and seq > last_seq + 1:
+                        self.lost += seq - last_seq - 1
+                    last_seq = seq
+                self.arrivals.append((time.monotonic(), latency_ms))
+            sock.close()
+        except Exception as error:  # Reported in summary, other viewers keep running
+            self.error = str(error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080, help="control server port, stream server is next one")
+    parser.add_argument("--viewers", type=int, default=1)
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds")
+    parser.add_argument("--path", default="/stream")
+    parser.add_argument("--no-start", action="store_true", help="do not send /start_stream before measuring")
+    parser.add_argument("--json", action="store_true", help="print result as JSON")
+    args = parser.parse_args()
+
+    if not args.no_start:
+        run_command(args.host, args.port, "/start_stream")
+
+    deadline = time.monotonic() + args.duration
+    viewers = [Viewer(args.host, args.port + 1, args.path, deadline) for _ in range(args.viewers)]
+    for viewer in viewers:
+        viewer.start()
+    for viewer in viewers:
+        viewer.join(args.duration + 10)
+
+    latencies = [latency for viewer in viewers for latency in viewer.latencies_ms]
+    result = {
+        "viewers": args.viewers,
+        "duration_s": args.duration,
+        "fps": [round(viewer.frames / args.duration, 2) for viewer in viewers],
+        "mbit_s": [round(viewer.bytes * 8 / args.duration / 1e6, 3) for viewer in viewers],
+        "lost_frames": [viewer.lost for viewer in viewers],
+        "first_frame_ms": [round((viewer.first_frame_s or 0) * 1000, 1) for viewer in viewers],
+        "latency_ms": {
+            "p50": round(percentile(latencies, 50), 2),
+            "p90": round(percentile(latencies, 90), 2),
+            "p99": round(percentile(latencies, 99), 2),
+            "max": round(max(latencies, default=0), 2),
+        },
+        "errors": [viewer.error for viewer in viewers if viewer.error],
+    }
+
+    if args.json:
+        print(json.dumps(result))
+        return
+
+    for i, viewer in enumerate(viewers):
+        print(f"viewer {i}: {result['fps'][i]} fps, {result['mbit_s'][i]} Mbit/s, "
+              f"lost {viewer.lost}, first frame {result['first_frame_ms'][i]} ms")
+    latency = result["latency_ms"]
+    print(f"latency ms: p50 {latency['p50']} p90 {latency['p90']} p99 {latency['p99']} max {latency['max']}")
+    for error in result["errors"]:
+        print(f"error: {error}")
+
+
+if __name__ == "__main__":
+    main()
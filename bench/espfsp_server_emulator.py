@@ -0,0 +1,317 @@
+#!/usr/bin/env python3
+#
+# Home monitoring system
+# Author: Maksymilian Komarnicki
+#
+# Stand-in for ESPFSP server module, used by host build with ESPFSP_MOCK_NET set. It serves synthetic or recorded
+# camera sources over TCP or UDP data transport through emulated link with delay, jitter, loss and bandwidth cap.
+# Wire format is the one of mock client, described in mock/esp32_udps/mock_net.c, not real ESPFSP protocol.
+#
+# Link impairment can be changed at runtime by sending JSON line to admin port, e.g.
+#   {"delay_ms": 100, "jitter_ms": 20, "loss": 0.01, "bandwidth_kbps": 2000}
+# Fields that are not given are reset to no impairment.
+
+import argparse
+import heapq
+import json
+import os
+import random
+import socket
+import struct
+import threading
+import time
+
+BUILTIN_FRAME = bytes.fromhex(
+    "ffd8ffe000104a46494600010100000100010000ffdb004300100b0c0e0c0a100e0d0e1211101318281a181616183123251d283a"
+    "333d3c3933383740485c4e404457453738506d51575f626768673e4d71797064785c656763ffdb0043011112121815182f1a1a2f"
+    "6342384263636363636363636363636363636363636363636363636363636363636363636363636363636363636363636363"
+    "6363ffc00011080010001003012200021101031101ffc4001500010100000000000000000000000000000506ffc40017100100"
+    "030000000000000000000000000004002131ffc4001501010100000000000000000000000000000002ffc40019110002030100"
+    "0000000000000000000000000403052131ffda000c03010002110311003f009f3872a2670e5448e1ca899c3952a56c57bdcd3f"
+    "ffd9")
+
+UDP_PAYLOAD_LEN = 1400
+UDP_HEADER = struct.Struct(">IHHI")
+TCP_HEADER = struct.Struct(">IQI")
+TCP_RTO_S = 0.2
+COM_MAX_LEN = 65533
+# Frames waiting for congested link longer than this are skipped at source, like camera grabbing latest frame
+MAX_LINK_BACKLOG_S = 1.0
+
+
+def com_segment(payload):
+    return b"\xff\xfe" + struct.pack(">H", len(payload) + 2) + payload
+
+
+def build_frame(jpeg, seq, pad_len):
+    """Puts timestamp COM segment right after SOI and pads frame with COM segments to pad_len."""
+    stamp = b"espfsp-mock ts=%d seq=%d" % (int(time.time() * 1e6), seq)
+    head = jpeg[:2] + com_segment(stamp)
+    padding = pad_len - len(head) - (len(jpeg) - 2)
+    segments = []
+    while padding >= 4:
+        payload_len = min(padding - 4, COM_MAX_LEN)
+        segments.append(com_segment(bytes(payload_len)))
+        padding -= payload_len + 4
+    return head + b"".join(segments) + jpeg[2:]
+
+
+def load_frames(frames_dir):
+    if not frames_dir:
+        return [BUILTIN_FRAME]
+    names = sorted(name for name in os.listdir(frames_dir) if name.lower().endswith((".jpg", ".jpeg")))
+    frames = []
+    for name in names:
+        with open(os.path.join(frames_dir, name), "rb") as file:
+            data = file.read()
+        if data[:2] == b"\xff\xd8":
+            frames.append(data)
+    return frames or [BUILTIN_FRAME]
+
+
+class Impairment:
+    def __init__(self, delay_ms=0.0, jitter_ms=0.0, loss=0.0, bandwidth_kbps=0.0):
+        self.delay_s = delay_ms / 1000
+        self.jitter_s = jitter_ms / 1000
+        self.loss = loss
+        self.bandwidth_bps = bandwidth_kbps * 1000
+
+    def transit_s(self):
+        return max(0.0, self.delay_s + random.uniform(-self.jitter_s, self.jitter_s))
+
+
+class Link:
+    """Bottleneck link: packets are serialized at bandwidth cap, then delayed by propagation delay and jitter.
+
+    TCP keeps order and turns every loss into retransmission timeout, UDP loses datagrams and may reorder them.
+    """
+
+    def __init__(self, send, ordered):
+        self.send = send
+        self.ordered = ordered
+        self.impairment = Impairment()
+        self.queue = []
+        self.counter = 0
+        self.link_free_at = 0.0
+        self.last_arrival = 0.0
+        self.condition = threading.Condition()
+        self.closed = False
+        threading.Thread(target=self.run, daemon=True).start()
+
+    def backlog_s(self):
+        with self.condition:
+            return max(0.0, self.link_free_at - time.monotonic())
+
+    def submit(self, packets):
+        """Packets of one frame. Each is (bytes, loss_units), loss_units says how many segments it stands for."""
+        with self.condition:
+            now = time.monotonic()
+            impairment = self.impairment
+            for data, loss_units in packets:
+                start = max(now, self.link_free_at)
+                if impairment.bandwidth_bps > 0:
+                    start += len(data) * 8 / impairment.bandwidth_bps
+                self.link_free_at = start
+                arrival = start + impairment.transit_s()
+
+                lost = impairment.loss > 0 and random.random() > (1 - impairment.loss) ** loss_units
+                if lost and not self.ordered:
+                    continue
+                if lost:
+                    arrival += TCP_RTO_S
+                if self.ordered:
+                    arrival = max(arrival, self.last_arrival)
+                    self.last_arrival = arrival
+
+                self.counter += 1
+                heapq.heappush(self.queue, (arrival, self.counter, data))
+            self.condition.notify()
+
+    def run(self):
+        while True:
+            with self.condition:
+                while not self.closed and (not self.queue or self.queue[0][0] > time.monotonic()):
+                    timeout = self.queue[0][0] - time.monotonic() if self.queue else None
+                    self.condition.wait(timeout)
+                if self.closed:
+                    return
+                _, _, data = heapq.heappop(self.queue)
+            try:
+                self.send(data)
+            except OSError:
+                self.close()
+                return
+
+    def close(self):
+        with self.condition:
+            self.closed = True
+            self.condition.notify()
+
+
+class Session(threading.Thread):
+    def __init__(self, server, control):
+        super().__init__(daemon=True)
+        self.server = server
+        self.control = control
+        self.reader = control.makefile("rb")
+        self.link = None
+        self.streaming = False
+        self.fps = server.args.fps
+        self.source = server.sources[0]
+
+    def open_data(self, transport, port):
+        peer = self.control.getpeername()[0]
+        if transport == "udp":
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 1024 * 1024)
+            sock.connect((peer, port))
+            self.link = Link(sock.send, ordered=False)
+            self.transport = "udp"
+        else:
+            data, _ = self.server.data_listener.accept()
+            data.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self.link = Link(data.sendall, ordered=True)
+            self.transport = "tcp"
+        self.link.impairment = self.server.impairment
+        self.server.links.append(self.link)
+        threading.Thread(target=self.produce, daemon=True).start()
+
+    def handle(self, request):
+        words = request.split()
+        if not words:
+            return "ERR"
+        command = words[0]
+        if command == "HELLO" and len(words) >= 2:
+            # Reply goes before data connection is accepted, as client connects only after it
+            port = int(words[2]) if len(words) > 2 else 0
+            threading.Thread(target=self.open_data, args=(words[1], port), daemon=True).start()
+            return "OK"
+        if command == "START":
+            self.streaming = True
+            return "OK"
+        if command == "STOP":
+            self.streaming = False
+            return "OK"
+        if command == "SOURCES":
+            return "OK " + " ".join(self.server.sources)
+        if command == "SOURCE" and len(words) == 2 and words[1] in self.server.sources:
+            self.source = words[1]
+            return "OK"
+        if command == "FRAME" and len(words) == 5:
+            self.fps = max(1, int(words[1]))
+            return "OK"
+        if command == "CAM" and len(words) == 4:
+            return "OK"
+        return "ERR"
+
+    def produce(self):
+        frames = self.server.frames
+        seq = 0
+        index = 0
+        next_at = time.monotonic()
+        while not self.link.closed:
+            next_at += 1 / self.fps
+            time.sleep(max(0.0, next_at - time.monotonic()))
+            if not self.streaming:
+                continue
+            if self.link.backlog_s() > MAX_LINK_BACKLOG_S:
+                self.server.stats["skipped"] += 1
+                continue
+
+            seq += 1
+            frame = build_frame(frames[index], seq, self.server.args.frame_len)
+            index = (index + 1) % len(frames)
+            self.server.stats["sent"] += 1
+
+            if self.transport == "udp":
+                fragments = (len(frame) + UDP_PAYLOAD_LEN - 1) // UDP_PAYLOAD_LEN
+                packets = []
+                for i in range(fragments):
+                    payload = frame[i * UDP_PAYLOAD_LEN:(i + 1) * UDP_PAYLOAD_LEN]
+                    packets.append((UDP_HEADER.pack(seq, i, fragments, len(frame)) + payload, 1))
+                self.link.submit(packets)
+            else:
+                segments = (len(frame) + UDP_PAYLOAD_LEN - 1) // UDP_PAYLOAD_LEN
+                header = TCP_HEADER.pack(seq, int(time.time() * 1e6), len(frame))
+                self.link.submit([(header + frame, segments)])
+
+    def run(self):
+        try:
+            for line in self.reader:
+                reply = self.handle(line.decode(errors="replace").strip())
+                self.control.sendall(reply.encode() + b"\n")
+        except OSError:
+            pass
+        self.streaming = False
+        if self.link:
+            self.link.close()
+            self.server.links.remove(self.link)
+        self.control.close()
+
+
+class Server:
+    def __init__(self, args):
+        self.args = args
+        self.frames = load_frames(args.frames_dir)
+        self.sources = ["emu_cam_%d" % i for i in range(args.sources)]
+        self.impairment = Impairment(args.delay_ms, args.jitter_ms, args.loss, args.bandwidth_kbps)
+        self.links = []
+        self.stats = {"sent": 0, "skipped": 0}
+
+        self.control_listener = self.listen(args.control_port)
+        self.data_listener = self.listen(args.data_port)
+
+    def listen(self, port):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind((self.args.host, port))
+        sock.listen()
+        return sock
+
+    def set_impairment(self, impairment):
+        self.impairment = impairment
+        for link in self.links:
+            link.impairment = impairment
+
+    def admin(self):
+        listener = self.listen(self.args.admin_port)
+        while True:
+            conn, _ = listener.accept()
+            with conn, conn.makefile("rwb") as stream:
+                for line in stream:
+                    try:
+                        self.set_impairment(Impairment(**json.loads(line)))
+                        reply = {"status": "ok", **self.stats}
+                    except (ValueError, TypeError) as error:
+                        reply = {"status": "error", "error": str(error)}
+                    stream.write(json.dumps(reply).encode() + b"\n")
+                    stream.flush()
+
+    def serve(self):
+        threading.Thread(target=self.admin, daemon=True).start()
+        print(f"ESPFSP server emulator: control {self.args.control_port}, data {self.args.data_port}, "
+              f"admin {self.args.admin_port}, {len(self.frames)} frames", flush=True)
+        while True:
+            control, _ = self.control_listener.accept()
+            Session(self, control).start()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--control-port", type=int, default=5003)
+    parser.add_argument("--data-port", type=int, default=5004)
+    parser.add_argument("--admin-port", type=int, default=5005)
+    parser.add_argument("--frames-dir", help="directory with *.jpg frames, built-in 16x16 frame if not given")
+    parser.add_argument("--frame-len", type=int, default=0, help="pad frames to this many bytes")
+    parser.add_argument("--fps", type=int, default=15, help="until accessor sets frame configuration")
+    parser.add_argument("--sources", type=int, default=2)
+    parser.add_argument("--delay-ms", type=float, default=0)
+    parser.add_argument("--jitter-ms", type=float, default=0)
+    parser.add_argument("--loss", type=float, default=0, help="probability of losing one 1400 byte segment")
+    parser.add_argument("--bandwidth-kbps", type=float, default=0, help="0 for unlimited")
+    Server(parser.parse_args()).serve()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+#
+# Home monitoring system
+# Author: Maksymilian Komarnicki
+#
+# Runs host build of accessor against ESPFSP server emulator and reports frame rate, stalls and recovery time of
+# /stream under link impairment profiles, for TCP, UDP and auto data transport. Every profile is measured in three
+# phases: clean warmup, impaired link and clean recovery. Recovery time is time from link getting clean until first
+# one second window with at least 90% of warmup frame rate.
+#
+# Used to check tuning of buffered_fbs and fb_in_buffer_before_get, e.g.
+#   bench/impairment_test.py --accessor build/home_monitoring_system_remote_accessor.elf --buffered-fbs 4
+#   bench/impairment_test.py --accessor build/home_monitoring_system_remote_accessor.elf --fb-in-buffer-before-get auto
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+from bench_stream import Viewer, percentile, run_command
+
+PROFILES = {
+    "baseline": {},
+    "delay": {"delay_ms": 100},
+    "jitter": {"delay_ms": 50, "jitter_ms": 40},
+    "loss_1": {"delay_ms": 20, "loss": 0.01},
+    "loss_5": {"delay_ms": 20, "loss": 0.05},
+    "bandwidth": {"delay_ms": 20, "bandwidth_kbps": 2000},
+}
+
+RECOVERY_WINDOW_S = 1.0
+RECOVERY_FPS_RATIO = 0.9
+
+
+def wait_for_port(host, port, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            socket.create_connection((host, port), timeout=1).close()
+            return
+        except OSError:
+            time.sleep(0.2)
+    raise RuntimeError(f"nothing listens on {host}:{port}")
+
+
+def set_impairment(host, port, impairment):
+    with socket.create_connection((host, port), timeout=5) as sock:
+        sock.sendall(json.dumps(impairment).encode() + b"\n")
+        reply = json.loads(sock.makefile().readline())
+    if reply["status"] != "ok":
+        raise RuntimeError(reply["error"])
+
+
+def stalls(arrivals, start, end, threshold_s):
+    """Gaps between frames longer than threshold, including gaps at phase boundaries."""
+    times = [start] + [t for t, _ in arrivals if start <= t < end] + [end]
+    return [b - a for a, b in zip(times, times[1:]) if b - a > threshold_s]
+
+
+def recovery_time(arrivals, start, end, target_fps):
+    times = [t for t, _ in arrivals if start <= t < end]
+    window_start = start
+    while window_start + RECOVERY_WINDOW_S <= end:
+        frames = sum(1 for t in times if window_start <= t < window_start + RECOVERY_WINDOW_S)
+        if frames / RECOVERY_WINDOW_S >= RECOVERY_FPS_RATIO * target_fps:
+            return window_start - start
+        window_start += 0.1
+    return None
+
+
+def phase_result(arrivals, start, end, stall_threshold_s):
+    in_phase = [(t, latency) for t, latency in arrivals if start <= t < end]
+    latencies = [latency for _, latency in in_phase if latency is not None]
+    gaps = stalls(arrivals, start, end, stall_threshold_s)
+    return {
+        "fps": round(len(in_phase) / (end - start), 2),
+        "stalls": len(gaps),
+        "longest_stall_ms": round(max(gaps, default=0) * 1000, 1),
+        "latency_p50_ms": round(percentile(latencies, 50), 2),
+        "latency_p99_ms": round(percentile(latencies, 99), 2),
+    }
+
+
+class ReconnectingViewer(threading.Thread):
+    """Viewer that connects again when stream ends, e.g. when accessor reconnects to server over other transport."""
+
+    def __init__(self, host, port, deadline):
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.deadline = deadline
+        self.arrivals = []
+        self.error = None
+
+    def run(self):
+        while time.monotonic() < self.deadline:
+            viewer = Viewer(self.host, self.port, "/stream", self.deadline)
+            viewer.run()
+            self.arrivals.extend(viewer.arrivals)
+            self.error = viewer.error or self.error
+            time.sleep(0.1)
+
+
+def run_profile(args, name, impairment):
+    set_impairment(args.host, args.admin_port, {})
+    warmup_s, impaired_s, recovery_s = args.warmup, args.impaired, args.recovery
+
+    start = time.monotonic()
+    viewer = ReconnectingViewer(args.host, args.port + 1, start + warmup_s + impaired_s + recovery_s)
+    viewer.start()
+
+    time.sleep(max(0.0, start + warmup_s - time.monotonic()))
+    impaired_at = time.monotonic()
+    set_impairment(args.host, args.admin_port, impairment)
+    time.sleep(max(0.0, impaired_at + impaired_s - time.monotonic()))
+    recovery_at = time.monotonic()
+    set_impairment(args.host, args.admin_port, {})
+    viewer.join(recovery_s + 10)
+    end = recovery_at + recovery_s
+
+    stall_threshold_s = max(3 / args.fps, 0.25)
+    warmup = phase_result(viewer.arrivals, start, impaired_at, stall_threshold_s)
+    recovery = recovery_time(viewer.arrivals, recovery_at, end, warmup["fps"])
+    return {
+        "profile": name,
+        "impairment": impairment,
+        "warmup": warmup,
+        "impaired": phase_result(viewer.arrivals, impaired_at, recovery_at, stall_threshold_s),
+        "recovery": phase_result(viewer.arrivals, recovery_at, end, stall_threshold_s),
+        "recovery_s": round(recovery, 2) if recovery is not None else None,
+        "error": viewer.error,
+    }
+
+
+def get_status(args):
+    with urllib.request.urlopen(f"http://{args.host}:{args.port}/get_status", timeout=5) as response:
+        return json.load(response)
+
+
+def configure_stream(args):
+    """Waits until accessor is connected to emulator, then applies frame configuration and starts stream."""
+    body = {"frame": {
+        "fps": args.fps,
+        "frame_max_len": max(args.frame_len, 16 * 1024),
+        "buffered_fbs": args.buffered_fbs,
+        "fb_in_buffer_before_get": args.fb_in_buffer_before_get,
+    }}
+    deadline = time.monotonic() + 30
+    while True:
+        try:
+            status = run_command(args.host, args.port, "/reconfigure", body=body)
+            if status["state"] == "done":
+                break
+        except (urllib.error.URLError, OSError):
+            pass
+        if time.monotonic() > deadline:
+            raise RuntimeError("accessor did not accept frame configuration")
+        time.sleep(0.5)
+
+    status = run_command(args.host, args.port, "/start_stream")
+    if status["state"] != "done":
+        raise RuntimeError(f"start stream failed: {status}")
+
+
+def run_transport(args, transport, profiles):
+    processes = []
+    if not args.no_emulator:
+        emulator = os.path.join(os.path.dirname(os.path.abspath(__file__)), "espfsp_server_emulator.py")
+        processes.append(subprocess.Popen(
+            [sys.executable, emulator, "--frame-len", str(args.frame_len), "--admin-port", str(args.admin_port)]
+            + (["--frames-dir", args.frames_dir] if args.frames_dir else []),
+            stdout=subprocess.DEVNULL))
+        wait_for_port(args.host, args.admin_port, 10)
+    if args.accessor:
+        env = dict(os.environ, ESPFSP_MOCK_NET="1", ACCESSOR_SERVER_ADDR=args.host, ACCESSOR_TRANSPORT=transport)
+        processes.append(subprocess.Popen([args.accessor], env=env, stdout=subprocess.DEVNULL))
+
+    try:
+        wait_for_port(args.host, args.port, 30)
+        configure_stream(args)
+        results = []
+        for name in profiles:
+            result = run_profile(args, name, PROFILES[name])
+            result["transport"] = transport
+            # In auto mode transport may have been switched during profile
+            result["transport_in_use"] = get_status(args)["transport"]
+            results.append(result)
+            if not args.json:
+                print_result(result)
+        return results
+    finally:
+        for process in reversed(processes):
+            process.terminate()
+            process.wait(10)
+
+
+def print_result(result):
+    phases = "  ".join(
+        f"{phase} {result[phase]['fps']} fps, {result[phase]['stalls']} stalls "
+        f"(max {result[phase]['longest_stall_ms']} ms), p99 {result[phase]['latency_p99_ms']} ms"
+        for phase in ("warmup", "impaired", "recovery"))
+    recovery = f"{result['recovery_s']} s" if result["recovery_s"] is not None else "not recovered"
+    transport = result["transport"]
+    if result["transport_in_use"] != transport:
+        transport += "->" + result["transport_in_use"]
+    print(f"{transport:8} {result['profile']:9} {phases}  recovery {recovery}", flush=True)
+    if result["error"]:
+        print(f"error: {result['error']}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--accessor", help="host build ELF, started for every transport; not started if not given")
+    parser.add_argument("--no-emulator", action="store_true", help="use already running emulator")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080, help="control server port, stream server is next one")
+    parser.add_argument("--admin-port", type=int, default=5005)
+    parser.add_argument("--transport", default="tcp,udp,auto", help="comma separated, from: tcp, udp, auto")
+    parser.add_argument("--profiles", default=",".join(PROFILES), help="comma separated, from: " + ", ".join(PROFILES))
+    parser.add_argument("--frames-dir")
+    parser.add_argument("--frame-len", type=int, default=30000, help="frames are padded to this many bytes")
+    parser.add_argument("--fps", type=int, default=20)
+    parser.add_argument("--buffered-fbs", type=int, default=10)
+    parser.add_argument("--fb-in-buffer-before-get", type=lambda v: v if v == "auto" else int(v), default=0,
+                        help="frames, or auto for adaptive playout")
+    parser.add_argument("--warmup", type=float, default=5.0, help="seconds of clean link before impairment")
+    parser.add_argument("--impaired", type=float, default=10.0, help="seconds of impaired link")
+    parser.add_argument("--recovery", type=float, default=10.0, help="seconds of clean link after impairment")
+    parser.add_argument("--json", action="store_true", help="print results as JSON")
+    args = parser.parse_args()
+
+    profiles = args.profiles.split(",")
+    for name in profiles:
+        if name not in PROFILES:
+            parser.error(f"unknown profile {name}")
+
+    # Transport is chosen when accessor starts, so already running one is only measured with its own
+    transports = args.transport.split(",")
+    for transport in transports:
+        if transport not in ("tcp", "udp", "auto"):
+            parser.error(f"unknown transport {transport}")
+    if not args.accessor and len(transports) > 1:
+        parser.error("more than one transport needs --accessor")
+
+    results = []
+    for transport in transports:
+        results.extend(run_transport(args, transport, profiles))
+
+    if args.json:
+        print(json.dumps(results))
+
+
+if __name__ == "__main__":
+    main()
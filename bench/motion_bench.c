@@ -0,0 +1,243 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ *
+ * Measures per-frame cost of motion detector (main/motion_detector.c) on host. Frames are JPEG files, or every
+ * frame of recorder segment given by its .SEG file. Every frame is decoded to luminance map many times and time
+ * of the fastest and median run is reported, then frames are fed in order through background model, the way
+ * detector task does, with score of each.
+ *
+ *   cc -O2 -Imain -o motion_bench bench/motion_bench.c main/motion_detector.c main/jpeg_reader.c
+ *   ./motion_bench vga_00.jpg vga_01.jpg vga_02.jpg
+ *   ./motion_bench /sdcard/00000012.SEG
+ *
+ * Time on ESP32 is several times longer than on desktop CPU. Device reports its own in /metrics as
+ * accessor_motion_frame_seconds.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "strings.h"
+#include "time.h"
+
+#include "motion_detector.h"
+
+#define MAX_CELLS (200 * 150)
+#define MAX_FRAMES 4096
+#define DEFAULT_RUNS 50
+
+typedef struct
+{
+    char name[64];
+    uint8_t *buf;
+    size_t len;
+} bench_frame_t;
+
+static bench_frame_t frames[MAX_FRAMES];
+static int frames_count = 0;
+
+static motion_dc_decoder_t decoder;
+static uint8_t luma[MAX_CELLS];
+static uint16_t background[MAX_CELLS];
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len > 0 ? *len : 1);
+    if (buf != NULL && fread(buf, 1, *len, f) != *len)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+
+    return buf;
+}
+
+static void add_frame(const char *name, const uint8_t *buf, size_t len)
+{
+    if (frames_count == MAX_FRAMES)
+    {
+        return;
+    }
+
+    bench_frame_t *frame = &frames[frames_count++];
+    snprintf(frame->name, sizeof(frame->name), "%s", name);
+    frame->buf = malloc(len);
+    frame->len = len;
+    memcpy(frame->buf, buf, len);
+}
+
+// Data file keeps frames back to back, so they are split on SOI and EOI markers without index. Entropy coded
+// data never has EOI in it, as every 0xff byte there is followed by 0x00 or restart marker.
+static int load_segment(const char *path)
+{
+    size_t len;
+    uint8_t *data = read_file(path, &len);
+    if (data == NULL)
+    {
+        fprintf(stderr, "%s: can not read\n", path);
+        return -1;
+    }
+
+    const char *base = strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 : path;
+    size_t start = 0;
+    for (size_t i = 2; i + 1 < len; ++i)
+    {
+        if (data[i] != 0xff || data[i + 1] != 0xd9)
+        {
+            continue;
+        }
+
+        if (data[start] == 0xff && data[start + 1] == 0xd8)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "%s@%zu", base, start);
+            add_frame(name, data + start, i + 2 - start);
+        }
+        start = i + 2;
+        i = start + 1;
+    }
+
+    free(data);
+    return 0;
+}
+
+static const char *result_name(motion_dc_result_t result)
+{
+    switch (result)
+    {
+    case MOTION_DC_OK:
+        return "ok";
+    case MOTION_DC_UNSUPPORTED:
+        return "unsupported";
+    case MOTION_DC_CORRUPT:
+        return "corrupt";
+    default:
+        return "too large";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int runs = DEFAULT_RUNS;
+    int first_arg = 1;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0)
+    {
+        runs = atoi(argv[2]);
+        first_arg = 3;
+    }
+    if (first_arg >= argc || runs < 1)
+    {
+        fprintf(stderr, "usage: %s [-n runs] frame.jpg... | segment.SEG...\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = first_arg; i < argc; ++i)
+    {
+        size_t len = strlen(argv[i]);
+        if (len > 4 && strcasecmp(argv[i] + len - 4, ".SEG") == 0)
+        {
+            if (load_segment(argv[i]) != 0)
+            {
+                return 1;
+            }
+            continue;
+        }
+
+        uint8_t *buf = read_file(argv[i], &len);
+        if (buf == NULL)
+        {
+            fprintf(stderr, "%s: can not read\n", argv[i]);
+            return 1;
+        }
+        add_frame(strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i], buf, len);
+        free(buf);
+    }
+
+    motion_dc_map_t map = { .luma = luma, .capacity = MAX_CELLS };
+    double *times = malloc(runs * sizeof(double));
+    double total_median = 0;
+    int decoded = 0;
+
+    printf("%-28s %8s %9s %10s %10s\n", "frame", "bytes", "map", "min us", "median us");
+    for (int i = 0; i < frames_count; ++i)
+    {
+        motion_dc_result_t result = MOTION_DC_OK;
+        for (int run = 0; run < runs; ++run)
+        {
+            double start = now_us();
+            result = motion_dc_decode(&decoder, frames[i].buf, frames[i].len, &map);
+            times[run] = now_us() - start;
+        }
+
+        if (result != MOTION_DC_OK)
+        {
+            printf("%-28s %8zu %9s\n", frames[i].name, frames[i].len, result_name(result));
+            continue;
+        }
+
+        qsort(times, runs, sizeof(double), compare_double);
+        printf("%-28s %8zu %4ux%-4u %10.1f %10.1f\n", frames[i].name, frames[i].len, map.cols, map.rows, times[0],
+               times[runs / 2]);
+        total_median += times[runs / 2];
+        decoded++;
+    }
+
+    // Frames in order through model, as detector task sees them
+    motion_model_t model = { .background = background, .capacity = MAX_CELLS };
+    motion_config_t config = { .sensitivity = 60, .min_area_permille = 20, .learn_shift = 5 };
+    double model_total = 0;
+    int model_frames = 0;
+
+    printf("\n%-28s %10s %8s %6s\n", "frame", "model us", "score", "shift");
+    for (int i = 0; i < frames_count; ++i)
+    {
+        if (motion_dc_decode(&decoder, frames[i].buf, frames[i].len, &map) != MOTION_DC_OK)
+        {
+            continue;
+        }
+
+        motion_result_t result;
+        double start = now_us();
+        motion_model_update(&model, &map, &config, &result);
+        double elapsed = now_us() - start;
+        model_total += elapsed;
+        model_frames++;
+
+        printf("%-28s %10.1f %8.3f %6d%s\n", frames[i].name, elapsed, result.score_permille / 1000.0,
+               result.global_shift, result.zone_mask != 0 ? "  motion" : "");
+    }
+
+    if (decoded > 0)
+    {
+        printf("\n%d frames: decode %.1f us, model %.1f us per frame on average (median of %d runs)\n", decoded,
+               total_median / decoded, model_frames > 0 ? model_total / model_frames : 0.0, runs);
+    }
+
+    free(times);
+    return 0;
+}
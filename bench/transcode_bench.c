@@ -0,0 +1,281 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ *
+ * Measures DCT domain transcoder (main/jpeg_transcoder.c) on host. Every frame is transcoded to every requested
+ * variant many times, and size of result with time of the fastest and median run is reported. With -o results
+ * are also written as <frame>.s<scale>q<quality>.jpg, so they can be looked at.
+ *
+ * With -m cols frames are instead transcoded to first variant and laid out as mosaic of that many columns, as
+ * /mosaic does, and time of composing it is reported. With -o it is written as mosaic.jpg.
+ *
+ *   cc -O2 -Imain -o transcode_bench bench/transcode_bench.c main/jpeg_transcoder.c main/jpeg_reader.c -lm
+ *   ./transcode_bench -v 2:0 -v 4:40 -v 1:30 vga_00.jpg uxga_00.jpg
+ *   ./transcode_bench -m 2 -v 4:0 cam1.jpg cam2.jpg cam3.jpg
+ *
+ * Time on ESP32 is several times longer than on desktop CPU. Device reports its own in /metrics as
+ * accessor_transcoder_frame_seconds.
+ */
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#include "jpeg_transcoder.h"
+
+// The same band as transcoder service reserves, UXGA 4:2:0 at scale 2
+#define BAND_COEFFICIENTS (2 * 100 * 6 * 16)
+#define MAX_VARIANTS 8
+#define MAX_TILES 16
+#define DEFAULT_RUNS 20
+
+static jpeg_transcoder_t transcoder;
+static int16_t band[BAND_COEFFICIENTS];
+static jpeg_reader_tables_t column_tables[JPEG_TRANSCODER_MAX_MOSAIC_COLS];
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len > 0 ? *len : 1);
+    if (buf != NULL && fread(buf, 1, *len, f) != *len)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+
+    return buf;
+}
+
+static void write_file(const char *path, const uint8_t *buf, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL || fwrite(buf, 1, len, f) != len)
+    {
+        fprintf(stderr, "%s: can not write\n", path);
+    }
+    if (f != NULL)
+    {
+        fclose(f);
+    }
+}
+
+static const char *result_name(jpeg_transcode_result_t result)
+{
+    switch (result)
+    {
+    case JPEG_TRANSCODE_OK:
+        return "ok";
+    case JPEG_TRANSCODE_UNSUPPORTED:
+        return "unsupported";
+    case JPEG_TRANSCODE_CORRUPT:
+        return "corrupt";
+    default:
+        return "too large";
+    }
+}
+
+static int run_mosaic(char **paths, int count, int cols, const jpeg_transcode_params_t *params, double *times,
+                      int runs, const char *out_dir)
+{
+    jpeg_mosaic_tile_t tiles[MAX_TILES];
+    size_t total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        size_t len;
+        uint8_t *buf = read_file(paths[i], &len);
+        if (buf == NULL)
+        {
+            fprintf(stderr, "%s: can not read\n", paths[i]);
+            return 1;
+        }
+
+        size_t capacity = len + len / 8 + 1024;
+        uint8_t *tile = malloc(capacity);
+        size_t tile_len = 0;
+        jpeg_transcode_result_t result = jpeg_transcode(&transcoder, buf, len, params, tile, capacity, &tile_len);
+        free(buf);
+        if (result != JPEG_TRANSCODE_OK)
+        {
+            printf("%s: %s, left gray\n", paths[i], result_name(result));
+            free(tile);
+            tile = NULL;
+        }
+        tiles[i] = (jpeg_mosaic_tile_t) { .buf = tile, .len = tile_len };
+        total += tile_len;
+    }
+
+    // Gray cells take a few bits per block
+    size_t out_capacity = total + total / 8 + 1024 + count * 16384;
+    uint8_t *out = malloc(out_capacity);
+    jpeg_transcode_result_t result = JPEG_TRANSCODE_OK;
+    size_t out_len = 0;
+    for (int run = 0; run < runs; ++run)
+    {
+        double start = now_us();
+        result = jpeg_transcode_mosaic(&transcoder, column_tables, tiles, count, cols, out, out_capacity, &out_len);
+        times[run] = now_us() - start;
+    }
+
+    if (result != JPEG_TRANSCODE_OK)
+    {
+        printf("mosaic: %s\n", result_name(result));
+    }
+    else
+    {
+        qsort(times, runs, sizeof(double), compare_double);
+        printf("mosaic of %d tiles s%uq%u: %zu bytes from %zu, min %.1f us, median %.1f us\n", count, params->scale,
+               params->quality, out_len, total, times[0], times[runs / 2]);
+        if (out_dir != NULL)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/mosaic.jpg", out_dir);
+            write_file(path, out, out_len);
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        free((uint8_t *) tiles[i].buf);
+    }
+    free(out);
+    return result == JPEG_TRANSCODE_OK ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    jpeg_transcode_params_t variants[MAX_VARIANTS];
+    int variants_count = 0;
+    int runs = DEFAULT_RUNS;
+    const char *out_dir = NULL;
+    int mosaic_cols = 0;
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (strcmp(argv[arg], "-n") == 0)
+        {
+            runs = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-m") == 0)
+        {
+            mosaic_cols = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-o") == 0)
+        {
+            out_dir = argv[arg + 1];
+        }
+        else if (strcmp(argv[arg], "-v") == 0 && variants_count < MAX_VARIANTS)
+        {
+            unsigned scale = 0, quality = 0;
+            sscanf(argv[arg + 1], "%u:%u", &scale, &quality);
+            variants[variants_count].scale = scale;
+            variants[variants_count].quality = quality;
+            variants_count++;
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (arg >= argc || runs < 1 || mosaic_cols < 0 || mosaic_cols > JPEG_TRANSCODER_MAX_MOSAIC_COLS ||
+        (mosaic_cols > 0 && argc - arg > MAX_TILES))
+    {
+        fprintf(stderr, "usage: %s [-n runs] [-o dir] [-m cols] [-v scale:quality]... frame.jpg...\n", argv[0]);
+        return 1;
+    }
+    if (variants_count == 0)
+    {
+        variants[variants_count++] = (jpeg_transcode_params_t) { .scale = 2, .quality = 0 };
+        variants[variants_count++] = (jpeg_transcode_params_t) { .scale = 4, .quality = 0 };
+        variants[variants_count++] = (jpeg_transcode_params_t) { .scale = 8, .quality = 0 };
+        variants[variants_count++] = (jpeg_transcode_params_t) { .scale = 1, .quality = 40 };
+    }
+
+    jpeg_transcoder_init(&transcoder, band, BAND_COEFFICIENTS);
+    double *times = malloc(runs * sizeof(double));
+
+    if (mosaic_cols > 0)
+    {
+        int ret = run_mosaic(argv + arg, argc - arg, mosaic_cols, &variants[0], times, runs, out_dir);
+        free(times);
+        return ret;
+    }
+
+    printf("%-24s %7s %8s %8s %6s %10s %10s\n", "frame", "variant", "bytes", "out", "ratio", "min us", "median us");
+    for (; arg < argc; ++arg)
+    {
+        size_t len;
+        uint8_t *buf = read_file(argv[arg], &len);
+        if (buf == NULL)
+        {
+            fprintf(stderr, "%s: can not read\n", argv[arg]);
+            return 1;
+        }
+
+        size_t out_capacity = len + len / 8 + 1024;
+        uint8_t *out = malloc(out_capacity);
+        const char *name = strrchr(argv[arg], '/') != NULL ? strrchr(argv[arg], '/') + 1 : argv[arg];
+
+        for (int v = 0; v < variants_count; ++v)
+        {
+            jpeg_transcode_result_t result = JPEG_TRANSCODE_OK;
+            size_t out_len = 0;
+            for (int run = 0; run < runs; ++run)
+            {
+                double start = now_us();
+                result = jpeg_transcode(&transcoder, buf, len, &variants[v], out, out_capacity, &out_len);
+                times[run] = now_us() - start;
+            }
+
+            char variant[16];
+            snprintf(variant, sizeof(variant), "s%uq%u", variants[v].scale, variants[v].quality);
+            if (result != JPEG_TRANSCODE_OK)
+            {
+                printf("%-24s %7s %8zu %8s\n", name, variant, len, result_name(result));
+                continue;
+            }
+
+            qsort(times, runs, sizeof(double), compare_double);
+            printf("%-24s %7s %8zu %8zu %6.2f %10.1f %10.1f\n", name, variant, len, out_len, (double) out_len / len,
+                   times[0], times[runs / 2]);
+
+            if (out_dir != NULL)
+            {
+                char path[512];
+                int stem_len = strrchr(name, '.') != NULL ? (int) (strrchr(name, '.') - name) : (int) strlen(name);
+                snprintf(path, sizeof(path), "%s/%.*s.%s.jpg", out_dir, stem_len, name, variant);
+                write_file(path, out, out_len);
+            }
+        }
+
+        free(out);
+        free(buf);
+    }
+
+    free(times);
+    return 0;
+}
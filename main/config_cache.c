@@ -0,0 +1,221 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "config_cache.h"
+#include "metrics.h"
+
+#define CONFIG_CACHE_SOURCES 8
+#define CONFIG_CACHE_SOURCE_NAME_LEN 30
+#define CONFIG_CACHE_FETCH_TIMEOUT 2000
+
+static const char *TAG = "CONFIG_CACHE";
+
+typedef struct
+{
+    char name[CONFIG_CACHE_SOURCE_NAME_LEN];
+    bool in_use;
+    uint32_t last_used;
+
+    espfsp_frame_config_t frame_config;
+    uint32_t frame_version;
+    bool frame_valid;
+
+    espfsp_cam_config_t cam_config;
+    uint32_t cam_version;
+    bool cam_valid;
+} config_cache_entry_t;
+
+static SemaphoreHandle_t mutex = NULL;
+static config_cache_entry_t entries[CONFIG_CACHE_SOURCES];
+static config_cache_entry_t *current = NULL;
+
+// Shared by all entries, so ETag of one source is never reused by another one
+static uint32_t version = 0;
+static uint32_t use_counter = 0;
+
+esp_err_t config_cache_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+void config_cache_reset(void)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    memset(entries, 0, sizeof(entries));
+    current = NULL;
+    xSemaphoreGive(mutex);
+}
+
+bool config_cache_select_source(const char *name)
+{
+    config_cache_entry_t *entry = NULL;
+    config_cache_entry_t *lru = &entries[0];
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (int i = 0; i < CONFIG_CACHE_SOURCES; ++i)
+    {
+        if (entries[i].in_use && strncmp(entries[i].name, name, CONFIG_CACHE_SOURCE_NAME_LEN) == 0)
+        {
+            entry = &entries[i];
+            break;
+        }
+
+        if (!entries[i].in_use || (lru->in_use && entries[i].last_used < lru->last_used))
+        {
+            lru = &entries[i];
+        }
+    }
+
+    if (entry == NULL)
+    {
+        entry = lru;
+        memset(entry, 0, sizeof(*entry));
+        strncpy(entry->name, name, CONFIG_CACHE_SOURCE_NAME_LEN - 1);
+        entry->in_use = true;
+    }
+
+    entry->last_used = ++use_counter;
+    current = entry;
+
+    bool cached = entry->frame_valid && entry->cam_valid;
+    xSemaphoreGive(mutex);
+
+    return cached;
+}
+
+esp_err_t config_cache_get_source(char *name, size_t name_len)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (current != NULL)
+    {
+        strncpy(name, current->name, name_len - 1);
+        name[name_len - 1] = '\0';
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(mutex);
+
+    return ret;
+}
+
+esp_err_t config_cache_get_frame(espfsp_frame_config_t *frame_config, uint32_t *frame_version)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (current != NULL && current->frame_valid)
+    {
+        *frame_config = current->frame_config;
+        *frame_version = current->frame_version;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(mutex);
+
+    return ret;
+}
+
+esp_err_t config_cache_get_cam(espfsp_cam_config_t *cam_config, uint32_t *cam_version)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (current != NULL && current->cam_valid)
+    {
+        *cam_config = current->cam_config;
+        *cam_version = current->cam_version;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(mutex);
+
+    return ret;
+}
+
+// Has to be called with mutex taken
+static bool is_current(const char *source)
+{
+    return current != NULL && strncmp(current->name, source, CONFIG_CACHE_SOURCE_NAME_LEN) == 0;
+}
+
+void config_cache_put_frame(const char *source, const espfsp_frame_config_t *frame_config)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (is_current(source))
+    {
+        current->frame_config = *frame_config;
+        current->frame_version = ++version;
+        current->frame_valid = true;
+    }
+    xSemaphoreGive(mutex);
+}
+
+void config_cache_put_cam(const char *source, const espfsp_cam_config_t *cam_config)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (is_current(source))
+    {
+        current->cam_config = *cam_config;
+        current->cam_version = ++version;
+        current->cam_valid = true;
+    }
+    xSemaphoreGive(mutex);
+}
+
+esp_err_t config_cache_fetch_frame(espfsp_client_play_handler_t client)
+{
+    char source[CONFIG_CACHE_SOURCE_NAME_LEN];
+    espfsp_frame_config_t frame_config;
+
+    if (config_cache_get_source(source, sizeof(source)) != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = METRICS_TIME_CALL(METRICS_CALL_GET_FRAME,
+        espfsp_client_play_get_frame(client, &frame_config, CONFIG_CACHE_FETCH_TIMEOUT));
+    if (ret == ESP_OK)
+    {
+        config_cache_put_frame(source, &frame_config);
+    }
+
+    return ret;
+}
+
+esp_err_t config_cache_fetch_cam(espfsp_client_play_handler_t client)
+{
+    char source[CONFIG_CACHE_SOURCE_NAME_LEN];
+    espfsp_cam_config_t cam_config;
+
+    if (config_cache_get_source(source, sizeof(source)) != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = METRICS_TIME_CALL(METRICS_CALL_GET_CAM,
+        espfsp_client_play_get_cam(client, &cam_config, CONFIG_CACHE_FETCH_TIMEOUT));
+    if (ret == ESP_OK)
+    {
+        config_cache_put_cam(source, &cam_config);
+    }
+
+    return ret;
+}
@@ -0,0 +1,34 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "espfsp_client_play.h"
+
+esp_err_t config_cache_init(void);
+
+// Drops configurations of all sources, e.g. when server module changes
+void config_cache_reset(void);
+
+// Makes source current one. Returns true if its configurations are already cached.
+bool config_cache_select_source(const char *name);
+
+// Returns ESP_ERR_NOT_FOUND when no source was selected yet
+esp_err_t config_cache_get_source(char *name, size_t name_len);
+
+// Return ESP_ERR_NOT_FOUND when current source has no cached configuration. Version changes on every update of
+// cached configuration, so it can be used as ETag.
+esp_err_t config_cache_get_frame(espfsp_frame_config_t *frame_config, uint32_t *version);
+esp_err_t config_cache_get_cam(espfsp_cam_config_t *cam_config, uint32_t *version);
+
+// Configuration is stored only if given source is still current one, so result of call that finished after
+// source was changed is dropped
+void config_cache_put_frame(const char *source, const espfsp_frame_config_t *frame_config);
+void config_cache_put_cam(const char *source, const espfsp_cam_config_t *cam_config);
+
+// Read configuration of current source from ESPFSP and store it in cache. Block for up to 2 s, so they are called
+// from control worker only. Return ESP_ERR_NOT_FOUND when no source was selected yet.
+esp_err_t config_cache_fetch_frame(espfsp_client_play_handler_t client);
+esp_err_t config_cache_fetch_cam(espfsp_client_play_handler_t client);
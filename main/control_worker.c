@@ -0,0 +1,666 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+#include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+#include "config_cache.h"
+#include "control_worker.h"
+#include "metrics.h"
+#include "frame_pool.h"
+#include "playout.h"
+
+#define CONFIG_CONTROL_STACK_SIZE 4096
+#define CONFIG_CONTROL_PRIORITY 5
+
+#define CONFIG_CONTROL_QUEUE_LEN 8
+#define CONFIG_CONTROL_STATUS_LEN 16
+#define CONFIG_CONTROL_MAX_WAITERS 4
+
+static const char *TAG = "CONTROL_WORKER";
+
+typedef struct
+{
+    uint32_t id;
+    control_cmd_t cmd;
+} queued_cmd_t;
+
+// Long-poll request waiting for command to finish
+typedef struct
+{
+    httpd_req_t *req;
+    uint32_t id;
+    int64_t deadline;
+} status_waiter_t;
+
+static espfsp_client_play_handler_t client_handler = NULL;
+static frame_dispatcher_handle_t stream_dispatcher = NULL;
+
+// Guards queue, statuses and waiters. Running flag and worker handle are changed only with it taken, so worker
+// is never notified after it is gone and no waiter is added after its final answer.
+static SemaphoreHandle_t mutex = NULL;
+static SemaphoreHandle_t task_done = NULL;
+static TaskHandle_t worker = NULL;
+static volatile bool running = false;
+static volatile bool stream_started = false;
+
+static queued_cmd_t queue[CONFIG_CONTROL_QUEUE_LEN];
+static int queue_len = 0;
+
+static control_cmd_status_t statuses[CONFIG_CONTROL_STATUS_LEN];
+static int statuses_next = 0;
+static uint32_t next_id = 0;
+
+static status_waiter_t waiters[CONFIG_CONTROL_MAX_WAITERS];
+
+// Commands with the same target override each other, e.g. stop stream cancels queued start
+static int cmd_target(control_cmd_type_t type)
+{
+    return type == CONTROL_CMD_STOP_STREAM ? CONTROL_CMD_START_STREAM : type;
+}
+
+// Commands queued before barrier apply to state it changes, so they are not merged across it. Start and stop
+// are barriers too, as settings changed between them apply to stopped stream.
+static bool is_barrier(control_cmd_type_t type)
+{
+    return type == CONTROL_CMD_SET_SOURCE || type == CONTROL_CMD_RECONFIGURE ||
+           type == CONTROL_CMD_START_STREAM || type == CONTROL_CMD_STOP_STREAM;
+}
+
+// Has to be called with mutex taken
+static control_cmd_status_t *find_status(uint32_t id)
+{
+    for (int i = 0; i < CONFIG_CONTROL_STATUS_LEN; ++i)
+    {
+        if (statuses[i].id == id && id != 0)
+        {
+            return &statuses[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Has to be called with mutex taken. Oldest status is overwritten.
+static void add_status(uint32_t id)
+{
+    control_cmd_status_t *status = &statuses[statuses_next];
+    statuses_next = (statuses_next + 1) % CONFIG_CONTROL_STATUS_LEN;
+
+    status->id = id;
+    status->state = CONTROL_CMD_STATE_QUEUED;
+    status->err = ESP_OK;
+    status->merged_into = 0;
+}
+
+static void set_state(uint32_t id, control_cmd_state_t state, esp_err_t err)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    control_cmd_status_t *status = find_status(id);
+    if (status != NULL)
+    {
+        status->state = state;
+        status->err = err;
+    }
+    xSemaphoreGive(mutex);
+}
+
+static bool is_finished(control_cmd_state_t state)
+{
+    return state != CONTROL_CMD_STATE_QUEUED && state != CONTROL_CMD_STATE_RUNNING;
+}
+
+// Configuration applied by command is cached for source selected when it was sent. Only this worker selects
+// sources, so it is the one configured on client.
+static void current_source(char *name, size_t name_len)
+{
+    if (config_cache_get_source(name, name_len) != ESP_OK)
+    {
+        name[0] = '\0';
+    }
+}
+
+static esp_err_t apply_cam_config(const espfsp_cam_config_t *cam_config)
+{
+    char source[30];
+    current_source(source, sizeof(source));
+
+    esp_err_t ret = METRICS_TIME_CALL(METRICS_CALL_RECONFIGURE_CAM,
+        espfsp_client_play_reconfigure_cam(client_handler, (espfsp_cam_config_t *) cam_config));
+    if (ret == ESP_OK)
+    {
+        config_cache_put_cam(source, cam_config);
+    }
+
+    return ret;
+}
+
+// frame_max_len 0 asks for length recommended from observed frame sizes, PLAYOUT_DEPTH_AUTO asks for depth and
+// buffers chosen by playout controller
+static esp_err_t apply_frame_config(const espfsp_frame_config_t *requested)
+{
+    char source[30];
+    current_source(source, sizeof(source));
+
+    espfsp_frame_config_t frame_config = *requested;
+    bool adaptive = playout_resolve(&frame_config);
+    if (frame_config.frame_max_len == CONTROL_FRAME_MAX_LEN_AUTO)
+    {
+        frame_config.frame_max_len = frame_pool_recommended_max_len();
+        ESP_LOGI(TAG, "Using recommended frame_max_len %lu", (unsigned long) frame_config.frame_max_len);
+    }
+
+    esp_err_t ret = METRICS_TIME_CALL(METRICS_CALL_RECONFIGURE_FRAME,
+        espfsp_client_play_reconfigure_frame(client_handler, &frame_config));
+    if (ret == ESP_OK)
+    {
+        config_cache_put_frame(source, &frame_config);
+        frame_pool_set_frame_max_len(frame_config.frame_max_len);
+        playout_frame_config_applied(&frame_config, adaptive);
+    }
+
+    return ret;
+}
+
+// Running stream is stopped once for whole batch, so viewers see single gap instead of one per changed setting
+static esp_err_t run_reconfigure(const control_reconfigure_t *reconfigure)
+{
+    esp_err_t ret = ESP_OK;
+    bool restart = stream_started;
+
+    if (restart)
+    {
+        metrics_reconfigure_started();
+        ret = METRICS_TIME_CALL(METRICS_CALL_STOP_STREAM, espfsp_client_play_stop_stream(client_handler));
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    if (reconfigure->has_source)
+    {
+        ret = METRICS_TIME_CALL(METRICS_CALL_SET_SOURCE,
+            espfsp_client_play_set_source(client_handler, reconfigure->source_name));
+        if (ret == ESP_OK && !config_cache_select_source(reconfigure->source_name))
+        {
+            // Fields given in batch are put into cache below, so only missing ones are read from source
+            if (!reconfigure->has_frame)
+            {
+                config_cache_fetch_frame(client_handler);
+            }
+            if (!reconfigure->has_cam)
+            {
+                config_cache_fetch_cam(client_handler);
+            }
+        }
+    }
+
+    if (ret == ESP_OK && reconfigure->has_frame)
+    {
+        ret = apply_frame_config(&reconfigure->frame_config);
+    }
+
+    if (ret == ESP_OK && reconfigure->has_cam)
+    {
+        ret = apply_cam_config(&reconfigure->cam_config);
+    }
+
+    // Stream is brought back even if some step failed, error of the failed step is reported
+    if (restart)
+    {
+        esp_err_t start_ret = METRICS_TIME_CALL(METRICS_CALL_START_STREAM,
+            espfsp_client_play_start_stream(client_handler));
+        if (start_ret == ESP_OK)
+        {
+            frame_dispatcher_wake(stream_dispatcher);
+        }
+        else
+        {
+            stream_started = false;
+            ret = ret == ESP_OK ? start_ret : ret;
+        }
+    }
+
+    return ret;
+}
+
+static esp_err_t run_cmd(const control_cmd_t *cmd)
+{
+    esp_err_t ret = ESP_FAIL;
+    int64_t start = esp_timer_get_time();
+
+    switch (cmd->type)
+    {
+    case CONTROL_CMD_SET_SOURCE:
+        ret = METRICS_TIME_CALL(METRICS_CALL_SET_SOURCE,
+            espfsp_client_play_set_source(client_handler, cmd->source_name));
+        if (ret == ESP_OK && !config_cache_select_source(cmd->source_name))
+        {
+            // Read once per source, so UI polling configurations is served from cache
+            config_cache_fetch_frame(client_handler);
+            config_cache_fetch_cam(client_handler);
+        }
+        break;
+
+    case CONTROL_CMD_SET_FRAME:
+        ret = apply_frame_config(&cmd->frame_config);
+        break;
+
+    case CONTROL_CMD_SET_CAM:
+        ret = apply_cam_config(&cmd->cam_config);
+        break;
+
+    case CONTROL_CMD_START_STREAM:
+        ret = METRICS_TIME_CALL(METRICS_CALL_START_STREAM, espfsp_client_play_start_stream(client_handler));
+        if (ret == ESP_OK)
+        {
+            stream_started = true;
+            frame_dispatcher_wake(stream_dispatcher);
+        }
+        break;
+
+    case CONTROL_CMD_STOP_STREAM:
+        ret = METRICS_TIME_CALL(METRICS_CALL_STOP_STREAM, espfsp_client_play_stop_stream(client_handler));
+        if (ret == ESP_OK)
+        {
+            stream_started = false;
+        }
+        break;
+
+    case CONTROL_CMD_RECONFIGURE:
+        ret = run_reconfigure(&cmd->reconfigure);
+        break;
+
+    case CONTROL_CMD_FETCH_CONFIG:
+    {
+        // Queued by configuration readers on cache miss, e.g. when read after source change failed. Only missing
+        // configurations are read, reader may have missed just one of them.
+        espfsp_frame_config_t frame_config;
+        espfsp_cam_config_t cam_config;
+        uint32_t version;
+
+        ret = ESP_OK;
+        if (config_cache_get_frame(&frame_config, &version) != ESP_OK)
+        {
+            ret = config_cache_fetch_frame(client_handler);
+        }
+        if (config_cache_get_cam(&cam_config, &version) != ESP_OK)
+        {
+            esp_err_t cam_ret = config_cache_fetch_cam(client_handler);
+            ret = ret == ESP_OK ? cam_ret : ret;
+        }
+        break;
+    }
+    }
+
+    ESP_LOGI(TAG, "Command %d finished in %lld ms: %s",
+             cmd->type, (long long) ((esp_timer_get_time() - start) / 1000), esp_err_to_name(ret));
+    return ret;
+}
+
+bool control_worker_is_stream_started(void)
+{
+    return stream_started;
+}
+
+const char *control_worker_state_name(control_cmd_state_t state)
+{
+    switch (state)
+    {
+    case CONTROL_CMD_STATE_QUEUED: return "queued";
+    case CONTROL_CMD_STATE_RUNNING: return "running";
+    case CONTROL_CMD_STATE_DONE: return "done";
+    case CONTROL_CMD_STATE_FAILED: return "failed";
+    case CONTROL_CMD_STATE_MERGED: return "merged";
+    default: return "unknown";
+    }
+}
+
+static esp_err_t send_status(httpd_req_t *req, const control_cmd_status_t *status)
+{
+    char json_response[160];
+
+    snprintf(json_response, sizeof(json_response),
+             "{\"id\": %lu, \"state\": \"%s\", \"error\": \"%s\", \"merged_into\": %lu}",
+             (unsigned long) status->id, control_worker_state_name(status->state),
+             esp_err_to_name(status->err), (unsigned long) status->merged_into);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+}
+
+// Answers waiters whose command is finished or whose timeout passed. Returns time until the nearest deadline.
+static TickType_t answer_waiters(bool all)
+{
+    status_waiter_t ready[CONFIG_CONTROL_MAX_WAITERS];
+    control_cmd_status_t ready_status[CONFIG_CONTROL_MAX_WAITERS];
+    int ready_len = 0;
+
+    int64_t now = esp_timer_get_time();
+    int64_t nearest = INT64_MAX;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_CONTROL_MAX_WAITERS; ++i)
+    {
+        if (waiters[i].req == NULL)
+        {
+            continue;
+        }
+
+        control_cmd_status_t *status = find_status(waiters[i].id);
+        if (all || status == NULL || is_finished(status->state) || waiters[i].deadline <= now)
+        {
+            ready[ready_len] = waiters[i];
+            if (status != NULL)
+            {
+                ready_status[ready_len] = *status;
+            }
+            else
+            {
+                memset(&ready_status[ready_len], 0, sizeof(control_cmd_status_t));
+                ready_status[ready_len].id = waiters[i].id;
+            }
+            ready_len++;
+            waiters[i].req = NULL;
+        }
+        else if (waiters[i].deadline < nearest)
+        {
+            nearest = waiters[i].deadline;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    // Network writes are done without mutex, so submitting commands is never blocked by slow client
+    for (int i = 0; i < ready_len; ++i)
+    {
+        send_status(ready[i].req, &ready_status[i]);
+        httpd_req_async_handler_complete(ready[i].req);
+    }
+
+    return nearest == INT64_MAX ? portMAX_DELAY : pdMS_TO_TICKS((nearest - now) / 1000 + 1);
+}
+
+static void worker_task(void *pvParameters)
+{
+    while (running)
+    {
+        TickType_t wait = answer_waiters(false);
+
+        queued_cmd_t queued;
+        bool has_cmd = false;
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (queue_len > 0)
+        {
+            queued = queue[0];
+            memmove(&queue[0], &queue[1], (queue_len - 1) * sizeof(queued_cmd_t));
+            queue_len--;
+            has_cmd = true;
+
+            control_cmd_status_t *status = find_status(queued.id);
+            if (status != NULL)
+            {
+                status->state = CONTROL_CMD_STATE_RUNNING;
+            }
+        }
+        xSemaphoreGive(mutex);
+
+        if (!has_cmd)
+        {
+            ulTaskNotifyTake(pdTRUE, wait);
+            continue;
+        }
+
+        esp_err_t ret = run_cmd(&queued.cmd);
+        set_state(queued.id, ret == ESP_OK ? CONTROL_CMD_STATE_DONE : CONTROL_CMD_STATE_FAILED, ret);
+    }
+
+    answer_waiters(true);
+
+    xSemaphoreGive(task_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t control_worker_init(espfsp_client_play_handler_t client, frame_dispatcher_handle_t dispatcher)
+{
+    if (mutex == NULL)
+    {
+        mutex = xSemaphoreCreateMutex();
+        task_done = xSemaphoreCreateBinary();
+        if (mutex == NULL || task_done == NULL)
+        {
+            ESP_LOGE(TAG, "Semaphores creation failed");
+            return ESP_FAIL;
+        }
+    }
+
+    client_handler = client;
+    stream_dispatcher = dispatcher;
+    queue_len = 0;
+    stream_started = false;
+
+    // Task is created with mutex taken, so handle is set before anyone can notify it
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    running = true;
+    BaseType_t xStatus = xTaskCreate(
+        worker_task,
+        "control_worker",
+        CONFIG_CONTROL_STACK_SIZE,
+        NULL,
+        CONFIG_CONTROL_PRIORITY,
+        &worker);
+    if (xStatus != pdPASS)
+    {
+        running = false;
+        worker = NULL;
+    }
+    xSemaphoreGive(mutex);
+
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Worker task creation failed");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t control_worker_deinit(void)
+{
+    if (mutex == NULL)
+    {
+        return ESP_OK;
+    }
+
+    // From now on commands and waiters are refused, waiters added before are answered by worker on its way out
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool was_running = running;
+    running = false;
+    if (was_running)
+    {
+        xTaskNotifyGive(worker);
+    }
+    xSemaphoreGive(mutex);
+
+    if (!was_running)
+    {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(task_done, portMAX_DELAY);
+
+    // Commands of removed client will never run
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    worker = NULL;
+    for (int i = 0; i < queue_len; ++i)
+    {
+        control_cmd_status_t *status = find_status(queue[i].id);
+        if (status != NULL)
+        {
+            status->state = CONTROL_CMD_STATE_FAILED;
+            status->err = ESP_ERR_INVALID_STATE;
+        }
+    }
+    queue_len = 0;
+    xSemaphoreGive(mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t control_worker_submit(const control_cmd_t *cmd, uint32_t *id)
+{
+    if (mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (!running)
+    {
+        xSemaphoreGive(mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t new_id = ++next_id;
+    bool merged = false;
+
+    // Newest queued command for the same target is dropped and new one is queued at tail, so commands run in
+    // order they were sent. Source change, reconfiguration batch, start and stop are barriers, as commands queued
+    // before them apply to previous state. New barrier itself merges only with one at queue tail, batch is always
+    // queued as it is.
+    for (int i = queue_len - 1; i >= 0 && cmd->type != CONTROL_CMD_RECONFIGURE; --i)
+    {
+        if (cmd_target(queue[i].cmd.type) == cmd_target(cmd->type))
+        {
+            control_cmd_status_t *status = find_status(queue[i].id);
+            if (status != NULL)
+            {
+                status->state = CONTROL_CMD_STATE_MERGED;
+                status->merged_into = new_id;
+            }
+
+            memmove(&queue[i], &queue[i + 1], (queue_len - i - 1) * sizeof(queued_cmd_t));
+            queue_len--;
+            merged = true;
+            break;
+        }
+
+        if (is_barrier(queue[i].cmd.type) || is_barrier(cmd->type))
+        {
+            break;
+        }
+    }
+
+    // Merged command made room for new one
+    if (!merged && queue_len == CONFIG_CONTROL_QUEUE_LEN)
+    {
+        next_id--;
+        xSemaphoreGive(mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    queue[queue_len].id = new_id;
+    queue[queue_len].cmd = *cmd;
+    queue_len++;
+
+    add_status(new_id);
+
+    // Waiters of merged command are answered by worker
+    xTaskNotifyGive(worker);
+    xSemaphoreGive(mutex);
+
+    *id = new_id;
+    return ESP_OK;
+}
+
+control_cmd_status_t control_worker_get_status(uint32_t id)
+{
+    control_cmd_status_t result = { .id = id, .state = CONTROL_CMD_STATE_UNKNOWN, .err = ESP_OK, .merged_into = 0 };
+
+    // Nothing was submitted before worker was started for the first time
+    if (mutex == NULL)
+    {
+        return result;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    control_cmd_status_t *status = find_status(id);
+    if (status != NULL)
+    {
+        result = *status;
+    }
+    xSemaphoreGive(mutex);
+
+    return result;
+}
+
+esp_err_t control_worker_send_status(httpd_req_t *req, uint32_t id)
+{
+    control_cmd_status_t status = control_worker_get_status(id);
+    return send_status(req, &status);
+}
+
+esp_err_t control_worker_wait_status(httpd_req_t *req, uint32_t id, uint32_t timeout_ms)
+{
+    control_cmd_status_t status = control_worker_get_status(id);
+    if (mutex == NULL || !running || is_finished(status.state) || timeout_ms == 0)
+    {
+        return send_status(req, &status);
+    }
+
+    httpd_req_t *async_req = NULL;
+    esp_err_t ret = httpd_req_async_handler_begin(req, &async_req);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Async request begin failed");
+        return send_status(req, &status);
+    }
+
+    bool added = false;
+
+    // Worker that is stopping answers only waiters added before, so no new one is added then
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_CONTROL_MAX_WAITERS && running; ++i)
+    {
+        if (waiters[i].req == NULL)
+        {
+            waiters[i].req = async_req;
+            waiters[i].id = id;
+            waiters[i].deadline = esp_timer_get_time() + (int64_t) timeout_ms * 1000;
+            added = true;
+            break;
+        }
+    }
+    if (added)
+    {
+        xTaskNotifyGive(worker);
+    }
+    xSemaphoreGive(mutex);
+
+    if (!added)
+    {
+        // Too many waiting requests or worker is stopping, answer with current state
+        status = control_worker_get_status(id);
+        send_status(async_req, &status);
+        return httpd_req_async_handler_complete(async_req);
+    }
+
+    return ESP_OK;
+}
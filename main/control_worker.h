@@ -0,0 +1,87 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "esp_http_server.h"
+#include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+
+typedef enum
+{
+    CONTROL_CMD_SET_SOURCE,
+    CONTROL_CMD_SET_FRAME,
+    CONTROL_CMD_SET_CAM,
+    CONTROL_CMD_START_STREAM,
+    CONTROL_CMD_STOP_STREAM,
+    CONTROL_CMD_RECONFIGURE,
+    CONTROL_CMD_FETCH_CONFIG, // Reads frame and camera configurations of current source missing in cache
+} control_cmd_type_t;
+
+// Value of frame_max_len replaced by length recommended by frame pool when command is run
+#define CONTROL_FRAME_MAX_LEN_AUTO 0
+
+// Batch applied in order source, frame, camera, with stream restarted at most once
+typedef struct
+{
+    bool has_source;
+    bool has_frame;
+    bool has_cam;
+    char source_name[30];
+    espfsp_frame_config_t frame_config;
+    espfsp_cam_config_t cam_config;
+} control_reconfigure_t;
+
+typedef struct
+{
+    control_cmd_type_t type;
+    union
+    {
+        char source_name[30];
+        espfsp_frame_config_t frame_config;
+        espfsp_cam_config_t cam_config;
+        control_reconfigure_t reconfigure;
+    };
+} control_cmd_t;
+
+typedef enum
+{
+    CONTROL_CMD_STATE_UNKNOWN,
+    CONTROL_CMD_STATE_QUEUED,
+    CONTROL_CMD_STATE_RUNNING,
+    CONTROL_CMD_STATE_DONE,
+    CONTROL_CMD_STATE_FAILED,
+    CONTROL_CMD_STATE_MERGED, // Replaced by newer command for the same target before it was run
+} control_cmd_state_t;
+
+typedef struct
+{
+    uint32_t id;
+    control_cmd_state_t state;
+    esp_err_t err;
+    uint32_t merged_into;
+} control_cmd_status_t;
+
+// Starts worker task that runs ESPFSP control calls of given client one after another
+esp_err_t control_worker_init(espfsp_client_play_handler_t client, frame_dispatcher_handle_t dispatcher);
+esp_err_t control_worker_deinit(void);
+
+// Queues command and returns its ID at once. Queued command for the same target is dropped in favour of the new
+// one, queued at tail, reconfiguration batches are never merged. Returns ESP_ERR_NO_MEM when queue is full.
+esp_err_t control_worker_submit(const control_cmd_t *cmd, uint32_t *id);
+
+// Returns status of one of recently submitted commands
+control_cmd_status_t control_worker_get_status(uint32_t id);
+
+// Answers request with status of command
+esp_err_t control_worker_send_status(httpd_req_t *req, uint32_t id);
+
+// Takes over request and answers it with command status once command is finished or timeout passes
+esp_err_t control_worker_wait_status(httpd_req_t *req, uint32_t id, uint32_t timeout_ms);
+
+// Stream state as left by last start, stop or reconfiguration command
+bool control_worker_is_stream_started(void);
+
+const char *control_worker_state_name(control_cmd_state_t state);
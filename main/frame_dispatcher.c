@@ -0,0 +1,991 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdlib.h"
+#include "stdatomic.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_timer.h"
+#include "sys/socket.h"
+#include "netinet/in.h"
+#include "arpa/inet.h"
+#include "esp_http_server.h"
+
+#include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+#include "stream_writer.h"
+#include "metrics.h"
+#include "frame_pool.h"
+#include "playout.h"
+#include "replay.h"
+#include "recorder.h"
+#include "motion.h"
+#include "transcoder.h"
+
+#define CONFIG_DISPATCHER_SLOTS 4
+#define CONFIG_DISPATCHER_MAX_VIEWERS 4
+
+#define CONFIG_DISPATCHER_PRODUCER_STACK_SIZE 4096
+#define CONFIG_DISPATCHER_PRODUCER_PRIORITY 5
+#define CONFIG_DISPATCHER_SENDER_STACK_SIZE 3072
+#define CONFIG_DISPATCHER_SENDER_PRIORITY 5
+
+#define CONFIG_DISPATCHER_GET_FB_TIMEOUT 1000
+#define CONFIG_DISPATCHER_VIEWER_WAIT_TIMEOUT 1000
+
+// Viewer that needs longer than this to send a frame copies it out of the ring before sending
+#define CONFIG_DISPATCHER_SLOW_SEND_US 30000
+
+static const char *TAG = "FRAME_DISPATCHER";
+
+// Frame buffer taken from ESPFSP. It is returned when last reference is dropped. Ring itself holds one
+// reference to the latest slot, so frame is kept until newer one arrives.
+typedef struct
+{
+    espfsp_fb_t *fb;
+    uint32_t seq;
+    int64_t timestamp;
+    int refs;
+} frame_slot_t;
+
+// Snapshot and its refcount are kept in front of frame copy, in one frame pool allocation
+typedef struct
+{
+    frame_snapshot_t snapshot;
+    atomic_int refs;
+} snapshot_copy_t;
+
+typedef struct
+{
+    struct frame_dispatcher *dispatcher;
+    httpd_req_t *req; // Asynchronous request of MJPEG viewer, NULL for WebSocket one
+    httpd_handle_t server;
+    int fd;
+    TaskHandle_t task;
+    uint32_t last_seq; // Last frame taken for sending
+    uint32_t seen_seq; // Last frame taken or passed over as not due yet
+    bool in_use;
+    transcoder_variant_handle_t variant; // NULL when frames are sent as received
+
+    // Frame rate decimation, interval 0 when every frame is sent
+    int64_t frame_interval;
+    int64_t next_due;
+
+    // Held while writing to socket, so it is not closed under sender
+    SemaphoreHandle_t send_mutex;
+    volatile bool closed;
+
+    // Text message waiting to be sent to WebSocket viewer
+    char text[128];
+    bool text_pending;
+
+    frame_viewer_stats_t stats;
+} frame_viewer_t;
+
+struct frame_dispatcher
+{
+    espfsp_client_play_handler_t client;
+    bool primary;
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t producer_done;
+    TaskHandle_t producer;
+
+    frame_slot_t slots[CONFIG_DISPATCHER_SLOTS];
+    frame_slot_t *latest;
+    uint32_t seq;
+
+    snapshot_copy_t *snapshot; // Cached copy for snapshot requests, holds one reference
+
+    frame_viewer_t viewers[CONFIG_DISPATCHER_MAX_VIEWERS];
+    int viewers_count;
+
+    volatile bool running;
+};
+
+// Has to be called with mutex taken. Returns frame buffer that should be given back to ESPFSP, if any.
+static espfsp_fb_t *slot_unref(frame_slot_t *slot)
+{
+    espfsp_fb_t *fb = NULL;
+
+    slot->refs--;
+    if (slot->refs == 0)
+    {
+        fb = slot->fb;
+        slot->fb = NULL;
+    }
+
+    return fb;
+}
+
+// Has to be called with mutex taken. Decimated viewer takes frames on schedule of their timestamps, not of their
+// arrival, so jitter of network does not change spacing. Quarter of interval is tolerated, as frame due at 100 ms
+// may be stamped at 99 ms.
+static bool is_due(frame_viewer_t *viewer, uint32_t seq, int64_t timestamp)
+{
+    viewer->seen_seq = seq;
+    return viewer->frame_interval == 0 || viewer->last_seq == 0 ||
+           timestamp >= viewer->next_due - viewer->frame_interval / 4;
+}
+
+// Has to be called with mutex taken
+static void take_seq(frame_viewer_t *viewer, uint32_t seq, int64_t timestamp)
+{
+    // Latest frame wins. Everything published in between was not sent to this viewer.
+    if (viewer->last_seq != 0)
+    {
+        uint32_t skipped = seq - viewer->last_seq - 1;
+        uint32_t dropped = skipped;
+        if (viewer->frame_interval != 0)
+        {
+            // Only frames due while viewer was still sending are dropped, the rest were not wanted anyway
+            int64_t late = timestamp - viewer->next_due;
+            dropped = late >= viewer->frame_interval ? late / viewer->frame_interval : 0;
+            dropped = dropped < skipped ? dropped : skipped;
+        }
+
+        viewer->stats.queue_depth = seq - viewer->last_seq;
+        viewer->stats.frames_dropped += dropped;
+        viewer->stats.frames_decimated += skipped - dropped;
+        metrics_frames_skipped(dropped);
+    }
+
+    if (viewer->frame_interval != 0)
+    {
+        // Schedule is kept while viewer keeps up, and starts over from this frame when it fell behind
+        viewer->next_due = viewer->last_seq != 0 && viewer->next_due + viewer->frame_interval > timestamp ?
+            viewer->next_due + viewer->frame_interval : timestamp + viewer->frame_interval;
+    }
+    viewer->last_seq = seq;
+}
+
+static frame_slot_t *acquire_latest(frame_dispatcher_handle_t dispatcher, frame_viewer_t *viewer)
+{
+    frame_slot_t *slot = NULL;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    frame_slot_t *latest = dispatcher->latest;
+    if (latest != NULL && latest->seq != viewer->seen_seq && is_due(viewer, latest->seq, latest->timestamp))
+    {
+        slot = latest;
+        slot->refs++;
+        take_seq(viewer, slot->seq, slot->timestamp);
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    return slot;
+}
+
+// Transcoded frames keep sequence numbers and timestamps of source ones, so frames skipped by transcoder count as
+// dropped too and decimation follows the same schedule
+static transcoder_frame_t *acquire_transcoded(frame_dispatcher_handle_t dispatcher, frame_viewer_t *viewer)
+{
+    transcoder_frame_t *frame = transcoder_acquire(viewer->variant, viewer->seen_seq);
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    bool due = is_due(viewer, frame->seq, frame->timestamp);
+    if (due)
+    {
+        take_seq(viewer, frame->seq, frame->timestamp);
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (!due)
+    {
+        transcoder_release(frame);
+        return NULL;
+    }
+
+    return frame;
+}
+
+static void release(frame_dispatcher_handle_t dispatcher, frame_slot_t *slot)
+{
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    espfsp_fb_t *fb = slot_unref(slot);
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (fb != NULL)
+    {
+        espfsp_client_play_return_fb(dispatcher->client, fb);
+    }
+}
+
+// Returns sequence number given to frame, 0 when it was dropped. Dropped frame is left to caller to return.
+static uint32_t publish(frame_dispatcher_handle_t dispatcher, espfsp_fb_t *fb, int64_t timestamp)
+{
+    frame_slot_t *slot = NULL;
+    espfsp_fb_t *fb_to_return = NULL;
+    uint32_t seq = 0;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+
+    for (int i = 0; i < CONFIG_DISPATCHER_SLOTS; ++i)
+    {
+        if (dispatcher->slots[i].fb == NULL)
+        {
+            slot = &dispatcher->slots[i];
+            break;
+        }
+    }
+
+    if (slot == NULL)
+    {
+        // Every slot is still being sent by some viewer. Drop incoming frame rather than wait for them.
+        metrics_frame_publish_dropped();
+    }
+    else
+    {
+        slot->fb = fb;
+        slot->seq = ++dispatcher->seq;
+        slot->timestamp = timestamp;
+        slot->refs = 1;
+        seq = slot->seq;
+
+        if (dispatcher->latest != NULL)
+        {
+            fb_to_return = slot_unref(dispatcher->latest);
+        }
+        dispatcher->latest = slot;
+
+        for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+        {
+            if (dispatcher->viewers[i].task != NULL)
+            {
+                xTaskNotifyGive(dispatcher->viewers[i].task);
+            }
+        }
+    }
+
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (fb_to_return != NULL)
+    {
+        espfsp_client_play_return_fb(dispatcher->client, fb_to_return);
+    }
+
+    return seq;
+}
+
+static void producer_task(void *pvParameters)
+{
+    frame_dispatcher_handle_t dispatcher = (frame_dispatcher_handle_t) pvParameters;
+
+    while (dispatcher->running)
+    {
+        // Blocks until ESPFSP data task completes frame, so no delay is needed to feed WD
+        int64_t wait_start = esp_timer_get_time();
+        espfsp_fb_t *fb = espfsp_client_play_get_fb(dispatcher->client, CONFIG_DISPATCHER_GET_FB_TIMEOUT);
+        if (!fb)
+        {
+            // ESPFSP returns at once when stream is not started. Sleep for the rest of timeout unless woken up
+            // by frame_dispatcher_wake, instead of spinning.
+            int64_t waited_ms = (esp_timer_get_time() - wait_start) / 1000;
+            if (waited_ms < CONFIG_DISPATCHER_GET_FB_TIMEOUT)
+            {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_DISPATCHER_GET_FB_TIMEOUT - waited_ms));
+            }
+            continue;
+        }
+
+        if (dispatcher->primary)
+        {
+            metrics_frame_received(esp_timer_get_time() - wait_start);
+            frame_pool_observe(fb->len);
+            playout_frame_received();
+        }
+
+        // Published frame stays in ring at least until producer publishes next one, so it is still valid here.
+        // Copies taken after publishing never delay live viewers.
+        int64_t timestamp = esp_timer_get_time();
+        uint32_t seq = publish(dispatcher, fb, timestamp);
+        if (dispatcher->primary)
+        {
+            replay_add_frame(fb->buf, fb->len, timestamp);
+            recorder_add_frame(fb->buf, fb->len);
+            motion_add_frame(fb->buf, fb->len);
+        }
+        if (seq != 0 && dispatcher->primary)
+        {
+            transcoder_add_frame(fb->buf, fb->len, seq, timestamp);
+        }
+        if (seq == 0)
+        {
+            espfsp_client_play_return_fb(dispatcher->client, fb);
+        }
+    }
+
+    xSemaphoreGive(dispatcher->producer_done);
+    vTaskDelete(NULL);
+}
+
+static bool is_slow_viewer(frame_viewer_t *viewer, size_t len)
+{
+    uint32_t throughput = viewer->stats.throughput;
+    return throughput > 0 && ((uint64_t) len * 1000000 / throughput) > CONFIG_DISPATCHER_SLOW_SEND_US;
+}
+
+static esp_err_t write_frame(frame_viewer_t *viewer, const uint8_t *buf, size_t len, uint32_t seq,
+                             int64_t timestamp)
+{
+    esp_err_t ret = ESP_FAIL;
+
+    xSemaphoreTake(viewer->send_mutex, portMAX_DELAY);
+    if (!viewer->closed)
+    {
+        ret = viewer->req != NULL ?
+            stream_writer_mjpeg_send_part(viewer->req, buf, len) :
+            stream_writer_ws_send_frame(viewer->fd, seq, timestamp, buf, len);
+    }
+    xSemaphoreGive(viewer->send_mutex);
+
+    return ret;
+}
+
+static void account_sent(frame_viewer_t *viewer, size_t len, int64_t send_time, bool copying)
+{
+    frame_dispatcher_handle_t dispatcher = viewer->dispatcher;
+
+    metrics_frame_sent(len, send_time);
+
+    uint32_t throughput = (uint64_t) len * 1000000 / (send_time > 0 ? send_time : 1);
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    viewer->stats.frames_sent++;
+    viewer->stats.bytes_sent += len;
+    viewer->stats.throughput = viewer->stats.throughput == 0 ?
+        throughput : (viewer->stats.throughput * 7 + throughput) / 8;
+    viewer->stats.copying = copying;
+    xSemaphoreGive(dispatcher->mutex);
+}
+
+static esp_err_t send_slot(frame_viewer_t *viewer, frame_slot_t *slot)
+{
+    frame_dispatcher_handle_t dispatcher = viewer->dispatcher;
+    const uint8_t *buf = slot->fb->buf;
+    size_t len = slot->fb->len;
+    uint32_t seq = slot->seq;
+    int64_t timestamp = slot->timestamp;
+    uint8_t *copy_buf = NULL;
+
+    // Slow viewer sends its own copy, so ESPFSP buffer goes back to the ring at once instead of being held for
+    // the whole transfer. Copy is taken from frame pool only for the time of sending.
+    if (is_slow_viewer(viewer, len))
+    {
+        copy_buf = frame_pool_alloc(len);
+        if (copy_buf != NULL)
+        {
+            memcpy(copy_buf, buf, len);
+            buf = copy_buf;
+            release(dispatcher, slot);
+            slot = NULL;
+        }
+    }
+
+    int64_t send_start = esp_timer_get_time();
+    esp_err_t ret = write_frame(viewer, buf, len, seq, timestamp);
+    int64_t send_time = esp_timer_get_time() - send_start;
+
+    bool copying = slot == NULL;
+    if (slot != NULL)
+    {
+        release(dispatcher, slot);
+    }
+    frame_pool_free(copy_buf);
+
+    if (ret == ESP_OK)
+    {
+        account_sent(viewer, len, send_time, copying);
+    }
+
+    return ret;
+}
+
+// Transcoded frame is a copy already, so it is never held in ring
+static esp_err_t send_transcoded(frame_viewer_t *viewer, transcoder_frame_t *frame)
+{
+    size_t len = frame->len;
+
+    int64_t send_start = esp_timer_get_time();
+    esp_err_t ret = write_frame(viewer, frame->buf, len, frame->seq, frame->timestamp);
+    int64_t send_time = esp_timer_get_time() - send_start;
+
+    transcoder_release(frame);
+
+    if (ret == ESP_OK)
+    {
+        account_sent(viewer, len, send_time, false);
+    }
+
+    return ret;
+}
+
+static esp_err_t send_pending_text(frame_viewer_t *viewer)
+{
+    frame_dispatcher_handle_t dispatcher = viewer->dispatcher;
+    char text[sizeof(viewer->text)];
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    bool text_pending = viewer->text_pending;
+    if (text_pending)
+    {
+        strcpy(text, viewer->text);
+        viewer->text_pending = false;
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (!text_pending)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_FAIL;
+    xSemaphoreTake(viewer->send_mutex, portMAX_DELAY);
+    if (!viewer->closed)
+    {
+        ret = stream_writer_ws_send_text(viewer->fd, text);
+    }
+    xSemaphoreGive(viewer->send_mutex);
+
+    return ret;
+}
+
+static void get_peer_addr(int fd, char *addr, size_t addr_len)
+{
+    struct sockaddr_in6 peer;
+    socklen_t peer_len = sizeof(peer);
+
+    strncpy(addr, "unknown", addr_len);
+    if (getpeername(fd, (struct sockaddr *) &peer, &peer_len) == 0)
+    {
+        inet_ntop(AF_INET6, &peer.sin6_addr, addr, addr_len);
+    }
+}
+
+static void sender_task(void *pvParameters)
+{
+    frame_viewer_t *viewer = (frame_viewer_t *) pvParameters;
+    frame_dispatcher_handle_t dispatcher = viewer->dispatcher;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    viewer->task = xTaskGetCurrentTaskHandle();
+    xSemaphoreGive(dispatcher->mutex);
+
+    esp_err_t ret = ESP_OK;
+    if (viewer->req != NULL)
+    {
+        ret = stream_writer_mjpeg_begin(viewer->req);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Send HTTP response head failed");
+        }
+    }
+
+    while (ret == ESP_OK && dispatcher->running && !viewer->closed)
+    {
+        ret = send_pending_text(viewer);
+        if (ret != ESP_OK)
+        {
+            break;
+        }
+
+        frame_slot_t *slot = NULL;
+        transcoder_frame_t *frame = NULL;
+        if (viewer->variant != NULL)
+        {
+            frame = acquire_transcoded(dispatcher, viewer);
+        }
+        else
+        {
+            slot = acquire_latest(dispatcher, viewer);
+        }
+
+        if (slot == NULL && frame == NULL)
+        {
+            // Woken up by producer as soon as new frame is published, or by transcoder once it is transcoded.
+            // Timeout only lets task check stop request.
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_DISPATCHER_VIEWER_WAIT_TIMEOUT));
+            continue;
+        }
+
+        ret = slot != NULL ? send_slot(viewer, slot) : send_transcoded(viewer, frame);
+    }
+
+    ESP_LOGI(TAG, "Viewer %s finished: sent %lu frames, dropped %lu frames",
+             viewer->stats.addr, (unsigned long) viewer->stats.frames_sent, (unsigned long) viewer->stats.frames_dropped);
+
+    if (viewer->variant != NULL)
+    {
+        transcoder_close(viewer->variant);
+    }
+
+    // Socket closed by server may already belong to new connection, so only open one is closed. Close callback
+    // marks viewer closed before it takes send mutex, so socket is still open while mutex is held here.
+    xSemaphoreTake(viewer->send_mutex, portMAX_DELAY);
+    if (viewer->req != NULL)
+    {
+        if (!viewer->closed)
+        {
+            stream_writer_mjpeg_end(viewer->req);
+        }
+        httpd_req_async_handler_complete(viewer->req);
+    }
+    else if (!viewer->closed)
+    {
+        httpd_sess_trigger_close(viewer->server, viewer->fd);
+    }
+    xSemaphoreGive(viewer->send_mutex);
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    viewer->req = NULL;
+    viewer->task = NULL;
+    viewer->variant = NULL;
+    viewer->in_use = false;
+    dispatcher->viewers_count--;
+    xSemaphoreGive(dispatcher->mutex);
+
+    vTaskDelete(NULL);
+}
+
+frame_dispatcher_handle_t frame_dispatcher_init(espfsp_client_play_handler_t client, bool primary)
+{
+    frame_dispatcher_handle_t dispatcher = (frame_dispatcher_handle_t) calloc(1, sizeof(struct frame_dispatcher));
+    if (dispatcher == NULL)
+    {
+        ESP_LOGE(TAG, "Dispatcher allocation failed");
+        return NULL;
+    }
+
+    dispatcher->client = client;
+    dispatcher->primary = primary;
+    dispatcher->running = true;
+    dispatcher->mutex = xSemaphoreCreateMutex();
+    dispatcher->producer_done = xSemaphoreCreateBinary();
+    if (dispatcher->mutex == NULL || dispatcher->producer_done == NULL)
+    {
+        ESP_LOGE(TAG, "Dispatcher semaphores creation failed");
+        goto err;
+    }
+
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+    {
+        dispatcher->viewers[i].send_mutex = xSemaphoreCreateMutex();
+        if (dispatcher->viewers[i].send_mutex == NULL)
+        {
+            ESP_LOGE(TAG, "Viewer semaphore creation failed");
+            goto err;
+        }
+    }
+
+    BaseType_t xStatus = xTaskCreate(
+        producer_task,
+        "frame_producer",
+        CONFIG_DISPATCHER_PRODUCER_STACK_SIZE,
+        dispatcher,
+        CONFIG_DISPATCHER_PRODUCER_PRIORITY,
+        &dispatcher->producer);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Producer task creation failed");
+        goto err;
+    }
+
+    return dispatcher;
+
+err:
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+    {
+        if (dispatcher->viewers[i].send_mutex != NULL)
+        {
+            vSemaphoreDelete(dispatcher->viewers[i].send_mutex);
+        }
+    }
+    if (dispatcher->mutex != NULL)
+    {
+        vSemaphoreDelete(dispatcher->mutex);
+    }
+    if (dispatcher->producer_done != NULL)
+    {
+        vSemaphoreDelete(dispatcher->producer_done);
+    }
+    free(dispatcher);
+    return NULL;
+}
+
+esp_err_t frame_dispatcher_deinit(frame_dispatcher_handle_t dispatcher)
+{
+    dispatcher->running = false;
+    xTaskNotifyGive(dispatcher->producer);
+    xSemaphoreTake(dispatcher->producer_done, portMAX_DELAY);
+
+    // Sender tasks notice stop request after their current frame
+    while (true)
+    {
+        xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+        int viewers_count = dispatcher->viewers_count;
+        for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+        {
+            if (dispatcher->viewers[i].task != NULL)
+            {
+                xTaskNotifyGive(dispatcher->viewers[i].task);
+            }
+        }
+        xSemaphoreGive(dispatcher->mutex);
+
+        if (viewers_count == 0)
+        {
+            break;
+        }
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    for (int i = 0; i < CONFIG_DISPATCHER_SLOTS; ++i)
+    {
+        if (dispatcher->slots[i].fb != NULL)
+        {
+            espfsp_client_play_return_fb(dispatcher->client, dispatcher->slots[i].fb);
+        }
+    }
+
+    if (dispatcher->snapshot != NULL)
+    {
+        frame_dispatcher_release_snapshot(&dispatcher->snapshot->snapshot);
+    }
+
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+    {
+        vSemaphoreDelete(dispatcher->viewers[i].send_mutex);
+    }
+    vSemaphoreDelete(dispatcher->producer_done);
+    vSemaphoreDelete(dispatcher->mutex);
+    free(dispatcher);
+    return ESP_OK;
+}
+
+void frame_dispatcher_wake(frame_dispatcher_handle_t dispatcher)
+{
+    xTaskNotifyGive(dispatcher->producer);
+}
+
+static frame_viewer_t *claim_viewer(frame_dispatcher_handle_t dispatcher, httpd_handle_t server, int fd)
+{
+    frame_viewer_t *viewer = NULL;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+    {
+        if (!dispatcher->viewers[i].in_use)
+        {
+            viewer = &dispatcher->viewers[i];
+            viewer->in_use = true;
+            dispatcher->viewers_count++;
+            break;
+        }
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (viewer == NULL)
+    {
+        ESP_LOGE(TAG, "No free viewer slot");
+        return NULL;
+    }
+
+    viewer->dispatcher = dispatcher;
+    viewer->req = NULL;
+    viewer->server = server;
+    viewer->fd = fd;
+    viewer->closed = false;
+    viewer->text_pending = false;
+    viewer->last_seq = 0;
+    viewer->seen_seq = 0;
+    viewer->variant = NULL;
+    viewer->frame_interval = 0;
+    viewer->next_due = 0;
+    memset(&viewer->stats, 0, sizeof(viewer->stats));
+    viewer->stats.scale = 1;
+    get_peer_addr(fd, viewer->stats.addr, sizeof(viewer->stats.addr));
+
+    return viewer;
+}
+
+static void unclaim_viewer(frame_dispatcher_handle_t dispatcher, frame_viewer_t *viewer)
+{
+    if (viewer->variant != NULL)
+    {
+        transcoder_close(viewer->variant);
+    }
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    viewer->req = NULL;
+    viewer->variant = NULL;
+    viewer->in_use = false;
+    dispatcher->viewers_count--;
+    xSemaphoreGive(dispatcher->mutex);
+}
+
+static esp_err_t start_sender(frame_viewer_t *viewer)
+{
+    BaseType_t xStatus = xTaskCreate(
+        sender_task,
+        "frame_sender",
+        CONFIG_DISPATCHER_SENDER_STACK_SIZE,
+        viewer,
+        CONFIG_DISPATCHER_SENDER_PRIORITY,
+        NULL);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Sender task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t frame_dispatcher_add_viewer(frame_dispatcher_handle_t dispatcher, httpd_req_t *req,
+                                      const frame_viewer_options_t *options)
+{
+    frame_viewer_t *viewer = claim_viewer(dispatcher, req->handle, httpd_req_to_sockfd(req));
+    if (viewer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (options != NULL && (options->scale != 1 || options->quality != 0))
+    {
+        // Transcoder is fed by primary dispatcher only
+        if (!dispatcher->primary)
+        {
+            unclaim_viewer(dispatcher, viewer);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        // Opened before request is taken over, so handler can still answer it when variant is not available
+        ret = transcoder_open(options->scale, options->quality, &viewer->variant);
+        if (ret != ESP_OK)
+        {
+            unclaim_viewer(dispatcher, viewer);
+            return ret;
+        }
+        viewer->stats.scale = options->scale;
+        viewer->stats.quality = options->quality;
+    }
+    if (options != NULL && options->fps != 0)
+    {
+        viewer->frame_interval = 1000000 / options->fps;
+        viewer->stats.fps = options->fps;
+    }
+
+    ret = httpd_req_async_handler_begin(req, &viewer->req);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Async request begin failed");
+        unclaim_viewer(dispatcher, viewer);
+        return ret;
+    }
+
+    ret = start_sender(viewer);
+    if (ret != ESP_OK)
+    {
+        httpd_req_async_handler_complete(viewer->req);
+        unclaim_viewer(dispatcher, viewer);
+        return ret;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t frame_dispatcher_add_ws_viewer(frame_dispatcher_handle_t dispatcher, httpd_handle_t server, int fd)
+{
+    frame_viewer_t *viewer = claim_viewer(dispatcher, server, fd);
+    if (viewer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = start_sender(viewer);
+    if (ret != ESP_OK)
+    {
+        unclaim_viewer(dispatcher, viewer);
+        return ret;
+    }
+
+    return ESP_OK;
+}
+
+static frame_viewer_t *find_viewer(frame_dispatcher_handle_t dispatcher, int fd)
+{
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS; ++i)
+    {
+        if (dispatcher->viewers[i].in_use && dispatcher->viewers[i].fd == fd)
+        {
+            return &dispatcher->viewers[i];
+        }
+    }
+
+    return NULL;
+}
+
+esp_err_t frame_dispatcher_ws_queue_text(frame_dispatcher_handle_t dispatcher, int fd, const char *text)
+{
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    frame_viewer_t *viewer = find_viewer(dispatcher, fd);
+    if (viewer == NULL || viewer->req != NULL || strlen(text) >= sizeof(viewer->text))
+    {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        // Sent by sender task between frames, so caller never waits for frame transfer in progress
+        strcpy(viewer->text, text);
+        viewer->text_pending = true;
+        if (viewer->task != NULL)
+        {
+            xTaskNotifyGive(viewer->task);
+        }
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    return ret;
+}
+
+void frame_dispatcher_close_socket(frame_dispatcher_handle_t dispatcher, int fd)
+{
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    frame_viewer_t *viewer = find_viewer(dispatcher, fd);
+    if (viewer != NULL)
+    {
+        viewer->closed = true;
+
+        // Abort write in progress, then wait for sender to leave socket
+        shutdown(fd, SHUT_RDWR);
+        xSemaphoreTake(viewer->send_mutex, portMAX_DELAY);
+        xSemaphoreGive(viewer->send_mutex);
+
+        if (viewer->task != NULL)
+        {
+            xTaskNotifyGive(viewer->task);
+        }
+    }
+    xSemaphoreGive(dispatcher->mutex);
+}
+
+// Has to be called with mutex taken, or on copy not shared yet
+static frame_snapshot_t *snapshot_ref(snapshot_copy_t *copy)
+{
+    atomic_fetch_add_explicit(&copy->refs, 1, memory_order_relaxed);
+    return &copy->snapshot;
+}
+
+esp_err_t frame_dispatcher_get_snapshot(frame_dispatcher_handle_t dispatcher, frame_snapshot_t **snapshot)
+{
+    *snapshot = NULL;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    frame_slot_t *slot = dispatcher->latest;
+    if (slot == NULL)
+    {
+        xSemaphoreGive(dispatcher->mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (dispatcher->snapshot != NULL && dispatcher->snapshot->snapshot.seq == slot->seq)
+    {
+        *snapshot = snapshot_ref(dispatcher->snapshot);
+        xSemaphoreGive(dispatcher->mutex);
+        return ESP_OK;
+    }
+
+    // Slot is held only for the time of copying, like by slow viewer
+    slot->refs++;
+    xSemaphoreGive(dispatcher->mutex);
+
+    snapshot_copy_t *copy = (snapshot_copy_t *) frame_pool_alloc(sizeof(snapshot_copy_t) + slot->fb->len);
+    if (copy != NULL)
+    {
+        uint8_t *buf = (uint8_t *) (copy + 1);
+        memcpy(buf, slot->fb->buf, slot->fb->len);
+        copy->snapshot.buf = buf;
+        copy->snapshot.len = slot->fb->len;
+        copy->snapshot.seq = slot->seq;
+        copy->snapshot.timestamp = slot->timestamp;
+        atomic_init(&copy->refs, 1);
+    }
+    release(dispatcher, slot);
+
+    if (copy == NULL)
+    {
+        ESP_LOGE(TAG, "Snapshot allocation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    snapshot_copy_t *old = NULL;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    // Other request could have cached the same or newer frame meanwhile
+    if (dispatcher->snapshot == NULL || (int32_t) (copy->snapshot.seq - dispatcher->snapshot->snapshot.seq) > 0)
+    {
+        old = dispatcher->snapshot;
+        dispatcher->snapshot = copy;
+        snapshot_ref(copy);
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    if (old != NULL)
+    {
+        frame_dispatcher_release_snapshot(&old->snapshot);
+    }
+
+    *snapshot = &copy->snapshot;
+    return ESP_OK;
+}
+
+void frame_dispatcher_release_snapshot(frame_snapshot_t *snapshot)
+{
+    snapshot_copy_t *copy = (snapshot_copy_t *) snapshot;
+
+    if (atomic_fetch_sub_explicit(&copy->refs, 1, memory_order_acq_rel) == 1)
+    {
+        frame_pool_free((uint8_t *) copy);
+    }
+}
+
+int frame_dispatcher_get_viewers_count(frame_dispatcher_handle_t dispatcher)
+{
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    int count = dispatcher->viewers_count;
+    xSemaphoreGive(dispatcher->mutex);
+
+    return count;
+}
+
+int frame_dispatcher_get_viewers_stats(frame_dispatcher_handle_t dispatcher, frame_viewer_stats_t *stats, int stats_len)
+{
+    int count = 0;
+
+    xSemaphoreTake(dispatcher->mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_DISPATCHER_MAX_VIEWERS && count < stats_len; ++i)
+    {
+        if (dispatcher->viewers[i].in_use)
+        {
+            stats[count++] = dispatcher->viewers[i].stats;
+        }
+    }
+    xSemaphoreGive(dispatcher->mutex);
+
+    return count;
+}
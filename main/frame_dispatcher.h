@@ -0,0 +1,79 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "esp_http_server.h"
+#include "espfsp_client_play.h"
+
+typedef struct frame_dispatcher *frame_dispatcher_handle_t;
+
+typedef struct
+{
+    char addr[48];
+    uint32_t frames_sent;
+    uint32_t frames_dropped;
+    uint32_t frames_decimated; // Skipped on purpose to keep frame rate viewer asked for
+    uint64_t bytes_sent;
+    uint32_t throughput; // Bytes per second, moving average of measured sends
+    uint32_t queue_depth; // Frames published since previous send, all but newest were skipped
+    bool copying; // Viewer is slow and sends frames from own copy instead of holding ring buffer
+    uint8_t scale; // Variant viewer asked for, scale 1 and quality 0 for frames as received
+    uint8_t quality;
+    uint8_t fps; // 0 for every frame
+} frame_viewer_stats_t;
+
+// Variant of stream for viewer. Scale 1 and quality 0 serve frames as received, anything else is made by
+// transcoder and shared with viewers that asked for the same variant.
+typedef struct
+{
+    uint8_t scale; // 1, 2, 4 or 8
+    uint8_t quality; // 1-100, 0 keeps quality of source
+    uint8_t fps; // Frames are taken evenly spaced by their timestamps, 0 takes every frame
+} frame_viewer_options_t;
+
+// Copy of latest frame, shared by every snapshot request until newer frame is published
+typedef struct
+{
+    const uint8_t *buf;
+    size_t len;
+    uint32_t seq;
+    int64_t timestamp; // esp_timer time of frame reception, as in WebSocket frame header
+} frame_snapshot_t;
+
+// Starts producer task that pulls every frame from ESPFSP client once and shares it between all viewers. Primary
+// dispatcher serves client of selected source and also hands its frames to replay, recording, motion detection,
+// transcoder and reception metrics. Dispatchers of other sources only serve their own viewers.
+frame_dispatcher_handle_t frame_dispatcher_init(espfsp_client_play_handler_t client, bool primary);
+esp_err_t frame_dispatcher_deinit(frame_dispatcher_handle_t dispatcher);
+
+// Wakes producer waiting for stream to be started
+void frame_dispatcher_wake(frame_dispatcher_handle_t dispatcher);
+
+// Takes over request as asynchronous one and serves it as MJPEG stream from separate sender task. Options may be
+// NULL for frames as received. Errors of transcoder_open are returned when variant can not be opened, and
+// ESP_ERR_NOT_SUPPORTED when variant is asked from dispatcher that is not primary one.
+esp_err_t frame_dispatcher_add_viewer(frame_dispatcher_handle_t dispatcher, httpd_req_t *req,
+                                      const frame_viewer_options_t *options);
+
+// Serves WebSocket connection with binary frames, each carrying header defined in stream_writer.h and JPEG
+esp_err_t frame_dispatcher_add_ws_viewer(frame_dispatcher_handle_t dispatcher, httpd_handle_t server, int fd);
+
+// Queues text message for WebSocket viewer. It is sent between frames by viewer sender task.
+esp_err_t frame_dispatcher_ws_queue_text(frame_dispatcher_handle_t dispatcher, int fd, const char *text);
+
+// Has to be called from server close callback before socket is closed, so no viewer writes to it afterwards
+void frame_dispatcher_close_socket(frame_dispatcher_handle_t dispatcher, int fd);
+
+// Gives latest published frame as snapshot, copying it out of ring only when no copy of it is cached yet, so
+// requests never hold ESPFSP buffers while sending. Returns ESP_ERR_NOT_FOUND when no frame was published yet.
+// Snapshot has to be released, it stays valid even after dispatcher is deinitialized.
+esp_err_t frame_dispatcher_get_snapshot(frame_dispatcher_handle_t dispatcher, frame_snapshot_t **snapshot);
+void frame_dispatcher_release_snapshot(frame_snapshot_t *snapshot);
+
+int frame_dispatcher_get_viewers_count(frame_dispatcher_handle_t dispatcher);
+
+// Returns number of stats filled for currently connected viewers
+int frame_dispatcher_get_viewers_stats(frame_dispatcher_handle_t dispatcher, frame_viewer_stats_t *stats, int stats_len);
@@ -0,0 +1,247 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "frame_pool.h"
+
+#define CONFIG_FRAME_POOL_BLOCK_LEN (4 * 1024)
+#define CONFIG_FRAME_POOL_BLOCKS 64
+
+// Histogram has one bucket per block length, frames above last bucket are counted in it
+#define CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS 64
+// Counts are halved when their sum reaches this, so histogram follows changes of scene and configuration
+#define CONFIG_FRAME_POOL_HISTOGRAM_WINDOW 1024
+#define CONFIG_FRAME_POOL_MIN_OBSERVED 64
+
+#define CONFIG_FRAME_POOL_DEFAULT_MAX_LEN (100 * 1014)
+#define CONFIG_FRAME_POOL_MIN_MAX_LEN (16 * 1024)
+// Recommendation is 99th percentile with 25% headroom
+#define CONFIG_FRAME_POOL_HEADROOM_PERCENT 125
+// Frame longer than this percent of configured limit means longer ones are probably dropped by client
+#define CONFIG_FRAME_POOL_NEAR_LIMIT_PERCENT 90
+
+static const char *TAG = "FRAME_POOL";
+
+// Allocation is a run of free blocks, its length in blocks is kept at first block, so buffer can be freed by
+// pointer only
+static uint8_t *region = NULL;
+static uint64_t used_blocks = 0;
+static uint8_t run_len[CONFIG_FRAME_POOL_BLOCKS];
+static uint32_t fallback_allocs = 0;
+
+static uint32_t histogram[CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS];
+static uint32_t histogram_sum = 0;
+static uint32_t frames_observed = 0;
+static uint32_t frame_len_max = 0;
+static uint32_t frame_max_len = CONFIG_FRAME_POOL_DEFAULT_MAX_LEN;
+static bool near_limit = false;
+
+static SemaphoreHandle_t mutex = NULL;
+
+_Static_assert(CONFIG_FRAME_POOL_BLOCKS <= 64, "Used blocks are kept in 64-bit mask");
+
+esp_err_t frame_pool_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    region = (uint8_t *) heap_caps_malloc(CONFIG_FRAME_POOL_BLOCK_LEN * CONFIG_FRAME_POOL_BLOCKS, MALLOC_CAP_SPIRAM);
+    if (region == NULL)
+    {
+        // Pool is an optimization only, every allocation goes to heap then
+        ESP_LOGW(TAG, "Pool region allocation failed");
+    }
+
+    return ESP_OK;
+}
+
+static uint64_t run_mask(int first, int blocks)
+{
+    uint64_t mask = blocks == 64 ? UINT64_MAX : (((uint64_t) 1 << blocks) - 1);
+    return mask << first;
+}
+
+// Has to be called with mutex taken. First fit, frames are short lived, so fragmentation does not build up.
+static int find_run(int blocks)
+{
+    for (int first = 0; first + blocks <= CONFIG_FRAME_POOL_BLOCKS; ++first)
+    {
+        if ((used_blocks & run_mask(first, blocks)) == 0)
+        {
+            return first;
+        }
+    }
+
+    return -1;
+}
+
+uint8_t *frame_pool_alloc(size_t len)
+{
+    int blocks = (len + CONFIG_FRAME_POOL_BLOCK_LEN - 1) / CONFIG_FRAME_POOL_BLOCK_LEN;
+    int first = -1;
+
+    if (region != NULL && blocks > 0 && blocks <= CONFIG_FRAME_POOL_BLOCKS)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        first = find_run(blocks);
+        if (first >= 0)
+        {
+            used_blocks |= run_mask(first, blocks);
+            run_len[first] = blocks;
+        }
+        else
+        {
+            fallback_allocs++;
+        }
+        xSemaphoreGive(mutex);
+    }
+    else
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        fallback_allocs++;
+        xSemaphoreGive(mutex);
+    }
+
+    if (first >= 0)
+    {
+        return region + first * CONFIG_FRAME_POOL_BLOCK_LEN;
+    }
+
+    return (uint8_t *) heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+}
+
+void frame_pool_free(uint8_t *buf)
+{
+    if (buf == NULL)
+    {
+        return;
+    }
+
+    if (region == NULL || buf < region || buf >= region + CONFIG_FRAME_POOL_BLOCK_LEN * CONFIG_FRAME_POOL_BLOCKS)
+    {
+        heap_caps_free(buf);
+        return;
+    }
+
+    int first = (buf - region) / CONFIG_FRAME_POOL_BLOCK_LEN;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    used_blocks &= ~run_mask(first, run_len[first]);
+    run_len[first] = 0;
+    xSemaphoreGive(mutex);
+}
+
+void frame_pool_observe(size_t len)
+{
+    int bucket = len / CONFIG_FRAME_POOL_BLOCK_LEN;
+    bucket = bucket < CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS ? bucket : CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS - 1;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (histogram_sum >= CONFIG_FRAME_POOL_HISTOGRAM_WINDOW)
+    {
+        histogram_sum = 0;
+        for (int i = 0; i < CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS; ++i)
+        {
+            histogram[i] /= 2;
+            histogram_sum += histogram[i];
+        }
+    }
+
+    histogram[bucket]++;
+    histogram_sum++;
+    frames_observed++;
+    frame_len_max = len > frame_len_max ? len : frame_len_max;
+    if ((uint64_t) len * 100 > (uint64_t) frame_max_len * CONFIG_FRAME_POOL_NEAR_LIMIT_PERCENT)
+    {
+        near_limit = true;
+    }
+
+    xSemaphoreGive(mutex);
+}
+
+void frame_pool_set_frame_max_len(uint32_t len)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    frame_max_len = len;
+    near_limit = false;
+    xSemaphoreGive(mutex);
+}
+
+// Has to be called with mutex taken. Returns upper bound of bucket holding given percentile.
+static uint32_t percentile(int p)
+{
+    uint32_t rank = ((uint64_t) histogram_sum * p + 99) / 100;
+    uint32_t cumulative = 0;
+
+    for (int i = 0; i < CONFIG_FRAME_POOL_HISTOGRAM_BUCKETS; ++i)
+    {
+        cumulative += histogram[i];
+        if (cumulative >= rank && cumulative > 0)
+        {
+            return (i + 1) * CONFIG_FRAME_POOL_BLOCK_LEN;
+        }
+    }
+
+    return 0;
+}
+
+// Has to be called with mutex taken
+static uint32_t recommend(void)
+{
+    if (frames_observed < CONFIG_FRAME_POOL_MIN_OBSERVED)
+    {
+        return frame_max_len;
+    }
+
+    uint32_t len = (uint64_t) percentile(99) * CONFIG_FRAME_POOL_HEADROOM_PERCENT / 100;
+
+    // Frames longer than limit are never seen, so only way to learn about them is to let limit grow
+    if (near_limit && len < frame_max_len * 2)
+    {
+        len = frame_max_len * 2;
+    }
+
+    len = len < CONFIG_FRAME_POOL_MIN_MAX_LEN ? CONFIG_FRAME_POOL_MIN_MAX_LEN : len;
+    return (len + CONFIG_FRAME_POOL_BLOCK_LEN - 1) / CONFIG_FRAME_POOL_BLOCK_LEN * CONFIG_FRAME_POOL_BLOCK_LEN;
+}
+
+uint32_t frame_pool_recommended_max_len(void)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t len = recommend();
+    xSemaphoreGive(mutex);
+
+    return len;
+}
+
+void frame_pool_get_stats(frame_pool_stats_t *stats)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    stats->pool_len = region != NULL ? CONFIG_FRAME_POOL_BLOCK_LEN * CONFIG_FRAME_POOL_BLOCKS : 0;
+    stats->used_len = __builtin_popcountll(used_blocks) * CONFIG_FRAME_POOL_BLOCK_LEN;
+    stats->fallback_allocs = fallback_allocs;
+    stats->frames_observed = frames_observed;
+    stats->frame_len_p50 = percentile(50);
+    stats->frame_len_p99 = percentile(99);
+    stats->frame_len_max = frame_len_max;
+    stats->frame_max_len = frame_max_len;
+    stats->recommended_max_len = recommend();
+
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,44 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+
+typedef struct
+{
+    size_t pool_len;
+    size_t used_len;
+    uint32_t fallback_allocs; // Frames that did not fit in pool and were allocated from heap
+    uint32_t frames_observed;
+    uint32_t frame_len_p50;
+    uint32_t frame_len_p99;
+    uint32_t frame_len_max;
+    uint32_t frame_max_len; // Limit currently configured in ESPFSP client
+    uint32_t recommended_max_len;
+} frame_pool_stats_t;
+
+// Reserves one PSRAM region, which is handed out in runs of fixed size blocks
+esp_err_t frame_pool_init(void);
+
+// Returns buffer of at least len bytes. Frame that does not fit in free blocks is allocated from heap instead,
+// so callers never have to handle pool exhaustion separately. NULL only when heap is exhausted too.
+uint8_t *frame_pool_alloc(size_t len);
+void frame_pool_free(uint8_t *buf);
+
+// Adds frame received from ESPFSP to running histogram of frame sizes
+void frame_pool_observe(size_t len);
+
+// Tells limit of frame length currently configured in ESPFSP client. Frames above it are dropped by client and
+// never observed, so frames close to limit make recommendation grow past it.
+void frame_pool_set_frame_max_len(uint32_t frame_max_len);
+
+// frame_max_len covering nearly all observed frames with headroom. Configured limit until enough frames are observed.
+uint32_t frame_pool_recommended_max_len(void);
+
+void frame_pool_get_stats(frame_pool_stats_t *stats);
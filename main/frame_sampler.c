@@ -0,0 +1,24 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "frame_sampler.h"
+
+bool frame_sampler_take(frame_sampler_t *sampler, int64_t timestamp, uint32_t fps)
+{
+    int64_t interval = 1000000 / fps;
+    if (timestamp < sampler->next_due)
+    {
+        return false;
+    }
+
+    sampler->next_due = sampler->next_due + interval > timestamp ? sampler->next_due + interval :
+                                                                   timestamp + interval;
+    return true;
+}
+
+void frame_sampler_reset(frame_sampler_t *sampler)
+{
+    sampler->next_due = 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stdint.h"
+
+// Takes frames on average at given rate, whatever rate they come at. Late frame is not made up for, schedule
+// starts over from it instead, so frames taken after pause are not bunched.
+typedef struct
+{
+    int64_t next_due;
+} frame_sampler_t;
+
+// Returns true when frame of given esp_timer time is taken
+bool frame_sampler_take(frame_sampler_t *sampler, int64_t timestamp, uint32_t fps);
+
+// Takes next frame whenever it comes, as after rate change
+void frame_sampler_reset(frame_sampler_t *sampler);
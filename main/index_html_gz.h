@@ -1,183 +0,0 @@
-const uint8_t index_html_gz[] = {
-    0x1f, 0x8b, 0x08, 0x08, 0x8a, 0x03, 0x98, 0x67, 0x00, 0x03, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e,
-    0x68, 0x74, 0x6d, 0x6c, 0x00, 0xdd, 0x5b, 0xeb, 0x73, 0xdb, 0x36, 0x12, 0xff, 0x9e, 0xbf, 0x02,
-    0x65, 0x72, 0x23, 0x79, 0x26, 0xd4, 0x23, 0xce, 0xc3, 0xd1, 0x49, 0xca, 0x34, 0xae, 0xd3, 0xcb,
-    0x4d, 0xd2, 0xc9, 0xc5, 0x69, 0xbf, 0xca, 0x10, 0x09, 0x4a, 0x68, 0x28, 0x82, 0x47, 0x82, 0x7e,
-    0x34, 0xf5, 0xff, 0x7e, 0x8b, 0x07, 0x45, 0x10, 0x04, 0x29, 0x3a, 0x71, 0x7a, 0x37, 0xc7, 0xc9,
-    0x58, 0x12, 0xb9, 0xd8, 0xe7, 0x0f, 0xbb, 0x8b, 0x95, 0x32, 0xff, 0x21, 0x64, 0x01, 0xbf, 0x49,
-    0x09, 0xda, 0xf2, 0x5d, 0xbc, 0x7c, 0x30, 0x2f, 0x5f, 0x08, 0x0e, 0x97, 0x0f, 0x10, 0x5c, 0xf3,
-    0x1d, 0xe1, 0x18, 0x05, 0x5b, 0x9c, 0xe5, 0x84, 0x2f, 0xbc, 0x82, 0x47, 0xfe, 0x89, 0x67, 0x3e,
-    0x4a, 0xf0, 0x8e, 0x2c, 0xbc, 0x4b, 0x4a, 0xae, 0x52, 0x96, 0x71, 0x0f, 0x05, 0x2c, 0xe1, 0x24,
-    0x01, 0xd2, 0x2b, 0x1a, 0xf2, 0xed, 0x22, 0x24, 0x97, 0x34, 0x20, 0xbe, 0xfc, 0xf0, 0x98, 0x26,
-    0x94, 0x53, 0x1c, 0xfb, 0x79, 0x80, 0x63, 0xb2, 0x98, 0x96, 0x7c, 0x38, 0xe5, 0x31, 0x59, 0x9e,
-    0x9d, 0x7f, 0x38, 0x7e, 0x82, 0x4e, 0x81, 0x5d, 0x86, 0xd1, 0x39, 0xcf, 0x08, 0xde, 0xcd, 0xc7,
-    0xea, 0x91, 0x22, 0xcb, 0xf9, 0x4d, 0xf9, 0x5e, 0x5c, 0x6b, 0x16, 0xde, 0xa0, 0x2f, 0xfb, 0x8f,
-    0xe2, 0x8a, 0x40, 0xb6, 0x1f, 0xe1, 0x1d, 0x8d, 0x6f, 0x66, 0xe8, 0xc7, 0x0c, 0x44, 0x3d, 0x46,
-    0x39, 0x4e, 0x72, 0x3f, 0x27, 0x19, 0x8d, 0xfe, 0x5e, 0xa3, 0x5d, 0xe3, 0xe0, 0xf3, 0x26, 0x63,
-    0x45, 0x12, 0xce, 0xd0, 0xc3, 0xe8, 0x38, 0x7a, 0x1a, 0x3d, 0xaf, 0x13, 0x04, 0x2c, 0x66, 0x19,
-    0x3c, 0x3b, 0x3e, 0x3e, 0xae, 0x3f, 0xd8, 0xe1, 0x6c, 0x43, 0x93, 0x19, 0x9a, 0xd4, 0x6f, 0x87,
-    0x34, 0x4f, 0x63, 0x0c, 0x82, 0xa3, 0x98, 0x5c, 0xd7, 0x1f, 0xb1, 0x4b, 0x92, 0x45, 0x31, 0xbb,
-    0x9a, 0xa1, 0x2d, 0x0d, 0x43, 0x92, 0x54, 0x4f, 0x6f, 0xf7, 0xef, 0x46, 0x39, 0x0d, 0xc9, 0x1a,
-    0x67, 0x96, 0x49, 0xd2, 0x71, 0x33, 0x74, 0x3c, 0x99, 0xa4, 0xd7, 0x1d, 0x06, 0xbc, 0x3c, 0x39,
-    0x99, 0x06, 0x6e, 0x03, 0xae, 0xb6, 0x94, 0x93, 0xfa, 0x93, 0x14, 0x87, 0x21, 0x4d, 0x36, 0x33,
-    0xf4, 0xa4, 0xc9, 0x95, 0x5d, 0xfb, 0xf9, 0x16, 0x87, 0x42, 0xd9, 0x27, 0xe9, 0x35, 0x9a, 0xa0,
-    0x67, 0xf0, 0x37, 0xdb, 0xac, 0xf1, 0x70, 0xf2, 0x18, 0xe9, 0x7f, 0xa3, 0xe9, 0x51, 0x6f, 0xdb,
-    0xc5, 0x1d, 0x3f, 0xa4, 0x19, 0x09, 0x38, 0x65, 0xe0, 0x35, 0xd0, 0xaa, 0xd8, 0x25, 0x75, 0x9a,
-    0x0d, 0x4e, 0x5d, 0xba, 0x94, 0x6e, 0xf3, 0x81, 0x31, 0x2e, 0x38, 0xab, 0x3f, 0xdd, 0x12, 0xba,
-    0xd9, 0xf2, 0x19, 0x9a, 0x4e, 0x26, 0x97, 0x5b, 0x87, 0x11, 0xf4, 0x0f, 0x69, 0xe2, 0x9a, 0x65,
-    0x21, 0xc9, 0x7c, 0xb8, 0xe5, 0xf4, 0xba, 0x86, 0xab, 0x0d, 0x24, 0xa1, 0x34, 0x38, 0x17, 0x9c,
-    0x30, 0xed, 0x6d, 0x29, 0x8e, 0xe9, 0x26, 0xf1, 0xc1, 0xd9, 0xbb, 0x1c, 0xcc, 0x04, 0xa6, 0x24,
-    0xab, 0x13, 0xfc, 0x5e, 0xe4, 0x9c, 0x46, 0x37, 0xbe, 0x96, 0xe9, 0x26, 0xaa, 0xe3, 0x32, 0xb2,
-    0x50, 0x9b, 0xb2, 0x9c, 0x2a, 0x3f, 0x46, 0xf4, 0x9a, 0x84, 0xf5, 0x87, 0x99, 0x72, 0x88, 0x85,
-    0x4b, 0xce, 0xd2, 0xc6, 0xbd, 0x35, 0xe3, 0x9c, 0xed, 0x1a, 0xb7, 0x63, 0x12, 0x71, 0x27, 0xd6,
-    0xfa, 0x00, 0x78, 0x5d, 0x00, 0xcf, 0xc4, 0x72, 0xe4, 0x1e, 0x69, 0x53, 0x01, 0xa6, 0x27, 0x4f,
-    0x6d, 0xc6, 0x72, 0xc7, 0x42, 0xa8, 0x08, 0x50, 0x3c, 0xb7, 0x1f, 0xb6, 0x03, 0xb8, 0x72, 0x92,
-    0x5f, 0x6e, 0xd3, 0x93, 0x97, 0x2f, 0xd7, 0xd1, 0xd4, 0x36, 0x53, 0xc4, 0x7e, 0x86, 0x12, 0x96,
-    0xd8, 0x0c, 0x14, 0x2a, 0x32, 0x1c, 0xd2, 0x02, 0xa2, 0x75, 0xd2, 0x10, 0x5d, 0x64, 0xb9, 0x60,
-    0x9b, 0x32, 0x5a, 0x0f, 0x91, 0x6d, 0xef, 0x6c, 0x2b, 0x7c, 0x63, 0x59, 0xed, 0x50, 0xef, 0xc5,
-    0xe4, 0x45, 0x10, 0xbc, 0xe8, 0xe0, 0x03, 0xc0, 0xc2, 0xeb, 0x98, 0x84, 0x87, 0x59, 0x85, 0xd3,
-    0xf0, 0x59, 0xb8, 0x76, 0xeb, 0x9b, 0x30, 0xee, 0xe3, 0x18, 0x22, 0x65, 0x62, 0xc3, 0x4c, 0x32,
-    0xac, 0xc8, 0x20, 0x1d, 0x3b, 0x63, 0xa5, 0xf2, 0x9a, 0x2f, 0xf1, 0x32, 0x6d, 0x40, 0x40, 0x3f,
-    0x2d, 0x91, 0x53, 0x27, 0xa8, 0x24, 0x44, 0x2c, 0xdb, 0xb5, 0x9a, 0xd0, 0x9d, 0x8c, 0xa6, 0xcf,
-    0x9a, 0xc9, 0xa8, 0x3b, 0x4a, 0x66, 0xb2, 0x9a, 0x20, 0x00, 0x17, 0x7a, 0xde, 0x23, 0x59, 0xf5,
-    0xcf, 0x0e, 0x31, 0x5e, 0x93, 0xd8, 0xb2, 0x66, 0x9f, 0x00, 0xd6, 0x31, 0x0b, 0x3e, 0xbb, 0x2b,
-    0x83, 0x70, 0x8e, 0xca, 0x9c, 0xed, 0x68, 0x6f, 0x6c, 0x05, 0x67, 0xbd, 0xa9, 0x74, 0xa1, 0x49,
-    0x5a, 0xd8, 0x69, 0x4a, 0x17, 0x07, 0xa8, 0xa6, 0xc1, 0x10, 0xd2, 0xe0, 0xdf, 0x90, 0x2f, 0xb3,
-    0xe8, 0x51, 0x8b, 0x83, 0x1b, 0xfe, 0xeb, 0x8c, 0x69, 0x15, 0x00, 0x78, 0x02, 0xf6, 0xe4, 0x2c,
-    0xa6, 0x21, 0xa0, 0x2f, 0x0c, 0x3b, 0x83, 0xd4, 0xb0, 0xab, 0xbf, 0xbb, 0xe9, 0x6e, 0xd3, 0x80,
-    0xe4, 0xb5, 0xaf, 0x8d, 0x14, 0xf6, 0xd9, 0xda, 0x5f, 0xfb, 0x65, 0x11, 0x38, 0x71, 0xd4, 0x80,
-    0x9a, 0x5a, 0x2e, 0xdb, 0xee, 0x0a, 0x9e, 0x4a, 0xd3, 0xed, 0xd4, 0xd5, 0x79, 0xa8, 0xc8, 0x36,
-    0xeb, 0xd8, 0x41, 0x37, 0xbb, 0x13, 0x9d, 0xb9, 0x6d, 0x55, 0xf5, 0x74, 0x6f, 0xd8, 0x92, 0x6f,
-    0x53, 0xb0, 0x8e, 0xfc, 0xc1, 0x00, 0x57, 0x04, 0x55, 0x9c, 0x83, 0x20, 0x70, 0xa9, 0xf2, 0x30,
-    0x61, 0xbe, 0x4a, 0x22, 0xb9, 0xbf, 0x23, 0x79, 0x8e, 0x37, 0xa4, 0x6d, 0x83, 0xd4, 0xb3, 0x6e,
-    0x27, 0x8b, 0xd1, 0x25, 0xcd, 0x29, 0x64, 0xbf, 0x9e, 0x7b, 0x4d, 0xf1, 0x9a, 0x8f, 0x75, 0x47,
-    0x38, 0x1f, 0xab, 0x7e, 0x75, 0x2e, 0x5a, 0x42, 0xdd, 0x2c, 0x86, 0xf4, 0x12, 0x05, 0x31, 0xce,
-    0xf3, 0x85, 0xa7, 0x1b, 0x2b, 0xaf, 0x6a, 0x1d, 0x6b, 0x4f, 0x95, 0x6b, 0x3d, 0x44, 0x43, 0xf1,
-    0x21, 0x83, 0x6c, 0x0e, 0xed, 0x22, 0xe7, 0xe0, 0xb7, 0xdc, 0x58, 0x22, 0x97, 0x6d, 0xa7, 0xcb,
-    0x73, 0x49, 0x01, 0x12, 0xa7, 0xd6, 0x33, 0x95, 0x2b, 0x20, 0xfd, 0xed, 0xb9, 0x88, 0xbe, 0xda,
-    0xd3, 0x0b, 0xd0, 0x27, 0xf8, 0x30, 0x9b, 0x8f, 0x25, 0x95, 0xb5, 0x32, 0x27, 0x31, 0xe8, 0x60,
-    0xca, 0x57, 0x2b, 0x6b, 0x54, 0x92, 0x92, 0xa5, 0x12, 0x05, 0x97, 0x38, 0x2e, 0xa0, 0xe7, 0x06,
-    0x9f, 0xe0, 0xd8, 0x5b, 0xbe, 0x13, 0x2f, 0xf3, 0xb1, 0x7a, 0x76, 0x70, 0x51, 0x46, 0x76, 0x8c,
-    0x03, 0xf3, 0x8f, 0xf2, 0xd5, 0xbd, 0x0c, 0x1c, 0x2b, 0x55, 0x3a, 0x68, 0x21, 0xc0, 0x2b, 0x83,
-    0x00, 0xee, 0x8d, 0xfc, 0x51, 0x7d, 0x6e, 0xb1, 0x53, 0x65, 0x30, 0xc3, 0xcc, 0x72, 0x39, 0x12,
-    0xf6, 0x2e, 0x3c, 0x4e, 0xae, 0xe1, 0xfc, 0x00, 0x01, 0x0f, 0xc8, 0x96, 0xc5, 0x00, 0xcb, 0x85,
-    0x77, 0x26, 0x8a, 0x2f, 0x7a, 0xfb, 0x01, 0xed, 0x49, 0xcb, 0x32, 0x69, 0xf1, 0xd6, 0x05, 0x4d,
-    0x31, 0xe7, 0xbe, 0x12, 0x20, 0xf4, 0xe2, 0xa8, 0x8c, 0x98, 0x22, 0x31, 0x40, 0x30, 0x06, 0x14,
-    0x2c, 0x1f, 0xf4, 0x00, 0x85, 0x59, 0x33, 0x9d, 0x98, 0x50, 0x60, 0x76, 0x80, 0x42, 0xb0, 0xac,
-    0x58, 0xe4, 0xb2, 0xf3, 0xc3, 0x34, 0x21, 0x99, 0x2b, 0xba, 0xa9, 0x24, 0x6d, 0x6e, 0x0e, 0xaf,
-    0xd4, 0x4a, 0x6f, 0x12, 0x6f, 0xf9, 0x0b, 0x43, 0x9a, 0x06, 0xe1, 0x4b, 0x4c, 0x63, 0xe1, 0x91,
-    0xd1, 0x7c, 0x9c, 0xda, 0x61, 0x94, 0x06, 0xb6, 0xf9, 0x69, 0x23, 0xfc, 0xa4, 0xb8, 0x78, 0xcb,
-    0x9f, 0x85, 0xa3, 0x4a, 0x33, 0xbe, 0xc6, 0x53, 0x0e, 0xaf, 0xc8, 0x23, 0x1c, 0x6c, 0x23, 0x87,
-    0x5f, 0x0c, 0x35, 0x38, 0xdb, 0x6c, 0x62, 0xe2, 0xe7, 0x92, 0x1a, 0x22, 0xc6, 0x71, 0xc6, 0xf7,
-    0xc7, 0xbf, 0xfb, 0xd1, 0xa4, 0x3c, 0x53, 0xea, 0x5d, 0xed, 0xd0, 0x47, 0x76, 0x2d, 0x42, 0x9b,
-    0x40, 0x92, 0xee, 0x13, 0x80, 0x2f, 0x1e, 0xb8, 0x62, 0x65, 0xec, 0x05, 0x58, 0xb2, 0xfa, 0x3d,
-    0x25, 0x9b, 0xd5, 0xbf, 0x0b, 0x38, 0x01, 0xf0, 0x1b, 0x6f, 0xf9, 0xcf, 0x0f, 0x67, 0x3f, 0xa3,
-    0x7f, 0xa9, 0x4f, 0xee, 0xbd, 0x20, 0x79, 0x54, 0xfb, 0xa1, 0xc1, 0xa2, 0xb6, 0x23, 0xd4, 0x09,
-    0xbb, 0x29, 0xe6, 0xc1, 0x41, 0xb5, 0xa2, 0x0c, 0x96, 0xae, 0x44, 0x59, 0xf2, 0x96, 0x6f, 0xc4,
-    0x7b, 0x74, 0x2e, 0x4a, 0x54, 0x5f, 0x95, 0x8c, 0xe5, 0x2d, 0x0a, 0x99, 0x02, 0x0e, 0xab, 0x93,
-    0xc2, 0x91, 0x25, 0x5e, 0x09, 0x97, 0x62, 0xee, 0x2d, 0x3f, 0x88, 0x4f, 0xe8, 0x8d, 0xfc, 0xd4,
-    0x5b, 0xa5, 0x1a, 0x8b, 0x16, 0xa5, 0xea, 0x62, 0x1c, 0x6a, 0x69, 0xf4, 0xa9, 0xd5, 0x79, 0xb1,
-    0xde, 0x51, 0xae, 0x52, 0x45, 0x03, 0x28, 0x36, 0xfe, 0xe4, 0xf2, 0xb1, 0x60, 0xfd, 0xad, 0x98,
-    0xd4, 0xe1, 0xe8, 0x01, 0x49, 0xe9, 0xe3, 0x3b, 0x21, 0x32, 0x4a, 0x61, 0x47, 0xbf, 0xf9, 0x70,
-    0xde, 0xcb, 0xab, 0x82, 0xd8, 0xe1, 0x48, 0xc9, 0xa3, 0x3b, 0xa4, 0x2a, 0xf8, 0xd0, 0x85, 0xad,
-    0x62, 0x92, 0x94, 0x00, 0x7b, 0x8f, 0xaf, 0xd1, 0x3b, 0x92, 0x6c, 0xa0, 0x65, 0xeb, 0x25, 0xbd,
-    0xc6, 0xc3, 0xa5, 0x47, 0x5d, 0x48, 0xb7, 0x46, 0xeb, 0x22, 0x8a, 0x48, 0x46, 0xc2, 0x55, 0xb4,
-    0x06, 0xed, 0x5f, 0xcb, 0x4f, 0xfd, 0x21, 0x5f, 0x5b, 0xed, 0x50, 0xa5, 0xce, 0xfd, 0x80, 0x6f,
-    0xd6, 0x2b, 0x9a, 0xac, 0xd4, 0x8a, 0xd5, 0x9a, 0xc0, 0x3d, 0xb2, 0x82, 0x84, 0x2b, 0xea, 0x2e,
-    0x0e, 0x6f, 0x90, 0xf4, 0x55, 0x4b, 0x9d, 0xb4, 0x3d, 0xd4, 0xc2, 0xc9, 0xe5, 0xab, 0x36, 0xa1,
-    0x77, 0xd9, 0x03, 0x36, 0x30, 0xef, 0xb0, 0x05, 0x8c, 0xb7, 0x8d, 0x26, 0x4c, 0xcf, 0x3c, 0xcc,
-    0x26, 0x4c, 0xb4, 0xfb, 0xb2, 0x38, 0xca, 0x64, 0xef, 0x8b, 0x11, 0x22, 0x14, 0x46, 0x84, 0x63,
-    0xbe, 0xf0, 0x7e, 0x83, 0x9e, 0x8d, 0xe9, 0x32, 0xe0, 0x21, 0xd9, 0xe7, 0x2d, 0xbc, 0xb2, 0x1d,
-    0x94, 0x8d, 0xa5, 0xe7, 0x90, 0x97, 0x07, 0x19, 0x4d, 0x8d, 0xb6, 0x05, 0x84, 0xe6, 0x1c, 0xa9,
-    0x0a, 0xf3, 0x5a, 0x19, 0xbc, 0x40, 0x21, 0x0b, 0x8a, 0x1d, 0xa8, 0x32, 0x02, 0xd7, 0x9c, 0xc5,
-    0x44, 0xbc, 0x7d, 0x7d, 0xf3, 0x36, 0x1c, 0x0e, 0x6a, 0x95, 0x68, 0x60, 0xf4, 0xfd, 0x8a, 0x8d,
-    0xba, 0xff, 0x9b, 0xd4, 0xb2, 0x8b, 0x4d, 0xcd, 0x9c, 0x26, 0x1b, 0x20, 0xd7, 0x85, 0xf6, 0xb0,
-    0x46, 0x46, 0x89, 0x76, 0xe8, 0xa3, 0x1e, 0x9c, 0x96, 0x2d, 0x45, 0xa7, 0x4e, 0x76, 0xff, 0xd1,
-    0x64, 0x97, 0x30, 0xad, 0xd6, 0x7b, 0xdd, 0xd5, 0x77, 0xb0, 0x6b, 0xf6, 0x28, 0x0e, 0xf5, 0x64,
-    0xdb, 0x25, 0xda, 0xde, 0x4e, 0xc5, 0xaa, 0x86, 0xb7, 0x8d, 0x85, 0x6e, 0x2a, 0x7b, 0x70, 0xd1,
-    0x4d, 0xa2, 0x8b, 0x11, 0x57, 0x5d, 0xe0, 0x61, 0x97, 0x57, 0xdd, 0xa3, 0x60, 0x53, 0x4d, 0x02,
-    0x60, 0x67, 0xd0, 0x7c, 0xdf, 0xd2, 0x00, 0x87, 0x08, 0xc7, 0x39, 0x31, 0x28, 0xa2, 0x22, 0x51,
-    0x67, 0xb4, 0x7c, 0xcb, 0xae, 0x7e, 0x61, 0x9c, 0x46, 0x34, 0xc0, 0xe2, 0xc6, 0x50, 0xbb, 0xe8,
-    0xc8, 0x3a, 0xdc, 0x94, 0x6e, 0xaf, 0x28, 0x4d, 0xbd, 0x02, 0x90, 0xc4, 0x89, 0x56, 0x6d, 0x38,
-    0x00, 0x90, 0x0f, 0xac, 0x63, 0xbd, 0xb9, 0x72, 0x24, 0xd2, 0xc0, 0xa9, 0x1e, 0x65, 0x2e, 0x90,
-    0x96, 0xd8, 0x41, 0x2f, 0x77, 0xd4, 0xa8, 0x9c, 0x26, 0xc2, 0x92, 0x81, 0x9c, 0x27, 0x0e, 0x0e,
-    0x2e, 0x51, 0x27, 0x45, 0xb1, 0x40, 0x1c, 0x37, 0x0f, 0xd3, 0xcb, 0x99, 0x64, 0x7f, 0xf2, 0x6a,
-    0x56, 0x74, 0x2a, 0xce, 0xc4, 0x62, 0xe1, 0xc3, 0xa7, 0x01, 0x8e, 0x9e, 0x4d, 0x0e, 0xaf, 0x0d,
-    0xf6, 0x2b, 0xa2, 0x28, 0x3a, 0x4c, 0xae, 0x0f, 0xc7, 0x62, 0x81, 0x9c, 0xd7, 0xf4, 0x54, 0x50,
-    0x1e, 0x98, 0x3f, 0xca, 0xa9, 0x82, 0x58, 0x7a, 0xd2, 0x6f, 0xd1, 0xf5, 0xb9, 0x9c, 0x34, 0x88,
-    0x15, 0x5d, 0xb3, 0x86, 0xc3, 0xac, 0xfe, 0x78, 0x9b, 0x84, 0xe4, 0x5a, 0x29, 0x3d, 0x11, 0x4e,
-    0xa9, 0x1f, 0x98, 0x4b, 0xf8, 0x88, 0x93, 0xf0, 0x08, 0xa7, 0x29, 0x01, 0x47, 0x6e, 0x69, 0x1c,
-    0x0e, 0x4d, 0x56, 0x47, 0xd6, 0x2a, 0xc0, 0xfc, 0x27, 0xba, 0x23, 0xac, 0xe0, 0xc3, 0xe1, 0x11,
-    0x5a, 0x2c, 0x2d, 0xa0, 0x36, 0x34, 0x11, 0x67, 0xc8, 0x4b, 0x32, 0xb4, 0xf0, 0x78, 0xfb, 0x58,
-    0x4c, 0x8e, 0x27, 0xb5, 0x79, 0xc9, 0xfe, 0xad, 0x99, 0x83, 0x47, 0xe0, 0xf8, 0xb3, 0x4b, 0xd0,
-    0xf2, 0x1d, 0xcd, 0x01, 0xb0, 0x24, 0x1b, 0x0e, 0x82, 0x98, 0x06, 0x9f, 0x07, 0x8f, 0x91, 0x4b,
-    0x3c, 0x8d, 0xd0, 0xd0, 0xd8, 0x7a, 0xf6, 0x36, 0x92, 0x06, 0x70, 0x96, 0x2a, 0x82, 0x86, 0x52,
-    0x88, 0xc0, 0x36, 0x75, 0x2e, 0x81, 0x73, 0x46, 0xcb, 0x9a, 0xca, 0x00, 0xd3, 0x53, 0x76, 0xe2,
-    0xee, 0x30, 0x23, 0x22, 0x3c, 0xd8, 0x6a, 0x62, 0x93, 0x45, 0x95, 0x13, 0x5d, 0x8b, 0xb7, 0x38,
-    0x81, 0x44, 0xda, 0xee, 0x04, 0x63, 0xb5, 0x3c, 0xcc, 0xa3, 0xc5, 0x02, 0x60, 0xa0, 0x0e, 0xf4,
-    0x03, 0xa7, 0x5b, 0xcc, 0xfc, 0x39, 0xda, 0x0f, 0x98, 0xf7, 0xb9, 0xab, 0x9f, 0xa3, 0xda, 0x98,
-    0xf0, 0xac, 0xb0, 0x78, 0x34, 0xc9, 0xb5, 0x9e, 0x68, 0x30, 0xe8, 0xe5, 0x62, 0x2b, 0x4f, 0xdf,
-    0x11, 0x28, 0x66, 0xd1, 0x00, 0x99, 0x9d, 0xee, 0x42, 0xaf, 0xd0, 0xc5, 0x2b, 0x51, 0x2f, 0x16,
-    0x8f, 0xbe, 0x90, 0x24, 0x60, 0x21, 0xf9, 0xf5, 0xe3, 0xdb, 0x53, 0xb6, 0x4b, 0xa1, 0xb5, 0x80,
-    0x7c, 0xeb, 0xb0, 0xe2, 0xe8, 0xf6, 0x02, 0xcd, 0x1a, 0x86, 0xc8, 0x48, 0x0f, 0x2f, 0xc6, 0xa0,
-    0xf9, 0x4a, 0x2d, 0x7a, 0xf4, 0x45, 0xbd, 0xde, 0x5e, 0x1c, 0x35, 0x9c, 0x33, 0xe2, 0x5b, 0x92,
-    0x0c, 0x81, 0x27, 0x88, 0x01, 0x67, 0x3b, 0x77, 0x5a, 0x19, 0xed, 0x92, 0x6a, 0xc4, 0x3e, 0xbb,
-    0x62, 0x5b, 0x5e, 0x38, 0x26, 0x19, 0xd4, 0x07, 0x3d, 0x80, 0x29, 0x4f, 0x09, 0xa8, 0x48, 0x43,
-    0x28, 0x1f, 0x21, 0xca, 0x8b, 0x00, 0x30, 0x98, 0x47, 0x45, 0x1c, 0xdf, 0xd8, 0x05, 0x64, 0x1f,
-    0x82, 0xb6, 0xd0, 0x5b, 0x32, 0xde, 0x60, 0x2a, 0x22, 0xcf, 0x99, 0xe6, 0x5e, 0xba, 0xba, 0x14,
-    0xda, 0xca, 0xbf, 0x71, 0xf7, 0xd6, 0xe1, 0x1a, 0xc8, 0x2d, 0xe0, 0x49, 0x92, 0x65, 0x22, 0x87,
-    0xb7, 0x39, 0x46, 0x84, 0x98, 0x41, 0x16, 0x94, 0x64, 0xc3, 0xc1, 0x99, 0xa4, 0xd6, 0xf2, 0xb5,
-    0x3a, 0x33, 0x40, 0x87, 0x7c, 0xdc, 0xa2, 0x8d, 0x36, 0xc6, 0xb5, 0xd4, 0x65, 0xc0, 0xad, 0x99,
-    0xcf, 0x8e, 0x9c, 0xf5, 0xde, 0xcc, 0x24, 0xf6, 0x58, 0x58, 0xc2, 0x63, 0x30, 0x96, 0x34, 0xab,
-    0xb2, 0xb3, 0xfc, 0x2b, 0x70, 0x51, 0x6f, 0x56, 0xdc, 0x7b, 0xb5, 0xbc, 0x6a, 0xc9, 0xb9, 0xde,
-    0x49, 0x0c, 0xce, 0x21, 0xb5, 0xea, 0x3e, 0x7c, 0xd0, 0xce, 0xc1, 0xec, 0x8d, 0x47, 0x79, 0x16,
-    0xc0, 0xca, 0x8b, 0x2d, 0xe7, 0xe9, 0x6c, 0x3c, 0x7e, 0xf4, 0x45, 0xcc, 0x29, 0x65, 0xdd, 0xd8,
-    0xb2, 0x9c, 0x8b, 0x93, 0xca, 0xed, 0xec, 0x64, 0x3a, 0x56, 0x4b, 0x2e, 0xfa, 0xf2, 0x94, 0xc5,
-    0x4f, 0x1f, 0x00, 0x84, 0x5e, 0x72, 0x22, 0xdc, 0xa2, 0xd1, 0x41, 0x40, 0xd7, 0x61, 0xe4, 0x55,
-    0xc0, 0x96, 0x71, 0xd2, 0x92, 0xbd, 0x7b, 0x80, 0x73, 0x4d, 0x90, 0xbb, 0x32, 0x1a, 0x38, 0xaa,
-    0x8a, 0x58, 0x2b, 0x8c, 0x58, 0xfa, 0x5f, 0x44, 0x91, 0xa3, 0x6c, 0x98, 0x57, 0x37, 0x8c, 0xaa,
-    0xb1, 0xde, 0xdd, 0x70, 0xe4, 0x79, 0x5f, 0x0b, 0x11, 0x71, 0x4c, 0xfc, 0x0e, 0x08, 0x81, 0xfd,
-    0xf0, 0x97, 0x02, 0x04, 0xe7, 0x37, 0x49, 0x50, 0xc1, 0x44, 0x62, 0x41, 0x1e, 0xd2, 0xc1, 0xbd,
-    0x11, 0xdd, 0x34, 0xc0, 0xc2, 0x33, 0xfb, 0x67, 0x31, 0xa5, 0x41, 0x1c, 0x55, 0xe0, 0x40, 0xf8,
-    0x0a, 0x53, 0xbe, 0x47, 0x16, 0x34, 0x37, 0xab, 0x40, 0xf2, 0x53, 0x33, 0x3d, 0x57, 0x2a, 0x14,
-    0xb8, 0xf9, 0xa1, 0x07, 0x70, 0xf8, 0x36, 0x83, 0x4e, 0x37, 0x21, 0x57, 0xe8, 0x4c, 0xa5, 0xe9,
-    0xca, 0x7b, 0x52, 0x1c, 0x92, 0x12, 0x90, 0x12, 0x57, 0x64, 0x32, 0x37, 0x38, 0x53, 0x6f, 0x8b,
-    0x11, 0x6a, 0xe1, 0xde, 0x84, 0xbd, 0x46, 0xbf, 0xe7, 0x70, 0xd8, 0xb2, 0x7b, 0x5b, 0x71, 0xb5,
-    0x1e, 0xf6, 0xa2, 0x14, 0x8a, 0xd6, 0xbe, 0x49, 0x51, 0x7c, 0x47, 0x70, 0x13, 0xfd, 0xf9, 0x67,
-    0xa3, 0xd2, 0x77, 0x33, 0x32, 0xa7, 0x54, 0x0e, 0x96, 0xe6, 0xe3, 0x3b, 0x33, 0x37, 0xe7, 0x4e,
-    0x4d, 0xde, 0xe6, 0xd3, 0xbb, 0xeb, 0xed, 0x9e, 0x18, 0x39, 0x2c, 0x70, 0x13, 0xba, 0x04, 0xde,
-    0x22, 0x09, 0x6d, 0xa4, 0x6a, 0xb9, 0x0b, 0x24, 0xce, 0x2a, 0x2e, 0xa1, 0x21, 0xf2, 0x8c, 0x89,
-    0x8e, 0xb6, 0x62, 0x7e, 0xdb, 0x77, 0xa3, 0x9c, 0xe2, 0xdd, 0x77, 0xda, 0x26, 0x41, 0x7d, 0x46,
-    0x54, 0x5e, 0xf7, 0xb6, 0x49, 0xd4, 0x37, 0x11, 0xff, 0x0b, 0xbb, 0xc4, 0xfe, 0xe6, 0xa1, 0x89,
-    0x0e, 0x9b, 0xe2, 0xce, 0x38, 0xac, 0x7f, 0x97, 0xe0, 0x16, 0x50, 0x3d, 0xff, 0x2a, 0xf6, 0xe6,
-    0xb7, 0x02, 0x6e, 0x01, 0x26, 0xc5, 0xf7, 0x00, 0x76, 0x2d, 0xa2, 0xdf, 0x82, 0xec, 0xbc, 0x3c,
-    0x89, 0x0e, 0xd5, 0x14, 0xee, 0x1e, 0xa0, 0xad, 0x4f, 0x30, 0x92, 0xdd, 0x2b, 0x39, 0x4d, 0x76,
-    0x9f, 0x8b, 0x94, 0x3c, 0x38, 0xdb, 0x7c, 0x17, 0xe4, 0x83, 0x0e, 0x7a, 0xac, 0xd9, 0x0f, 0xe9,
-    0x8d, 0x51, 0xdb, 0x85, 0xf2, 0x0b, 0xf2, 0xe0, 0x14, 0x26, 0xdf, 0xdd, 0x7a, 0x82, 0xa9, 0x4b,
-    0x5d, 0xc3, 0xfa, 0x5a, 0x35, 0xed, 0xa4, 0x34, 0xd2, 0xc9, 0xbd, 0x60, 0x63, 0x7f, 0xfe, 0x90,
-    0xca, 0x76, 0x1d, 0x5d, 0x9a, 0xa6, 0xba, 0xdc, 0x66, 0x1a, 0x6e, 0x1b, 0xdd, 0x3b, 0x67, 0xea,
-    0xc1, 0xc5, 0xfd, 0x65, 0x4c, 0xc7, 0x08, 0xbb, 0xbc, 0xee, 0x2d, 0x5d, 0x76, 0xc8, 0x68, 0xcb,
-    0x90, 0xe5, 0x57, 0xe8, 0xfd, 0x53, 0xa4, 0x3d, 0x72, 0x1f, 0xd1, 0x04, 0xfe, 0xfe, 0xe3, 0xd3,
-    0xfb, 0x77, 0xba, 0x51, 0x75, 0xda, 0xa7, 0x57, 0x8d, 0x62, 0xf9, 0xb5, 0x98, 0x1c, 0x43, 0x4c,
-    0xda, 0xec, 0xb4, 0xa7, 0xf0, 0x23, 0xf9, 0xf5, 0x89, 0x98, 0x7f, 0x88, 0x61, 0xc8, 0x70, 0xa0,
-    0x7f, 0x02, 0xe0, 0x34, 0xb3, 0xab, 0xa7, 0xed, 0xe0, 0xab, 0xa7, 0x79, 0x5d, 0xac, 0x0d, 0xdb,
-    0x47, 0x90, 0x1f, 0xcf, 0x30, 0x84, 0x56, 0x03, 0xae, 0xf5, 0x94, 0x51, 0xf9, 0x79, 0xdd, 0x18,
-    0xba, 0x5b, 0xc3, 0x6d, 0x45, 0xd0, 0x26, 0x58, 0x5c, 0x6b, 0xd7, 0xa1, 0x42, 0x69, 0x70, 0x70,
-    0x91, 0xe5, 0xc1, 0xda, 0xaf, 0x39, 0xba, 0x64, 0x8e, 0xc7, 0x25, 0x87, 0xbb, 0x8d, 0xa1, 0x2c,
-    0x1e, 0xe2, 0xfa, 0xca, 0x1c, 0x7b, 0x88, 0xad, 0xb8, 0xd4, 0xa1, 0x4f, 0xe9, 0xd1, 0x3f, 0x1d,
-    0xf6, 0x63, 0xad, 0x8e, 0x28, 0x6d, 0xbc, 0x0f, 0xe7, 0x9f, 0x6e, 0xe7, 0xde, 0x1e, 0x8e, 0xf7,
-    0x21, 0xc7, 0x37, 0x0a, 0x61, 0x07, 0xcb, 0xc6, 0xde, 0x35, 0xa7, 0xe3, 0x4a, 0x5e, 0xdb, 0x79,
-    0xee, 0xdb, 0x6a, 0x91, 0x1e, 0xc5, 0x35, 0xd2, 0xf1, 0x37, 0x76, 0x13, 0xda, 0x9e, 0xae, 0x9a,
-    0xf1, 0x95, 0xc9, 0xc4, 0x59, 0x28, 0xba, 0x7a, 0xab, 0xc6, 0x2f, 0x66, 0xa0, 0xbf, 0x6a, 0x86,
-    0x4e, 0x7d, 0xc9, 0x2c, 0x62, 0x47, 0xc4, 0x03, 0xc7, 0xce, 0x91, 0xf7, 0x47, 0x69, 0x26, 0x5f,
-    0x7f, 0x22, 0x11, 0x2e, 0x62, 0x6e, 0x17, 0x5a, 0x95, 0x52, 0x84, 0x90, 0x9f, 0x30, 0xc7, 0x90,
-    0x05, 0x44, 0x4d, 0xf8, 0xf5, 0xe3, 0xbb, 0x73, 0x82, 0xb3, 0x60, 0xfb, 0x01, 0x43, 0x29, 0xcf,
-    0x87, 0xe2, 0xde, 0x1b, 0x4d, 0xa2, 0xa4, 0x8d, 0x38, 0xce, 0x40, 0xf3, 0xa3, 0xa3, 0x11, 0x67,
-    0xe7, 0x3c, 0x03, 0x4d, 0x6d, 0xc6, 0xe6, 0x1e, 0x05, 0x9b, 0x5e, 0x3d, 0xfa, 0x52, 0x0a, 0x69,
-    0x9f, 0xe4, 0xb6, 0x6c, 0x8d, 0x81, 0xfe, 0x1d, 0x89, 0x3d, 0x8d, 0x1d, 0x38, 0xf6, 0x5d, 0xf7,
-    0x26, 0x6b, 0xce, 0x5c, 0x83, 0x3a, 0xeb, 0x81, 0x09, 0xf9, 0xda, 0x7c, 0xb2, 0xfb, 0xac, 0xfa,
-    0xff, 0x15, 0x2f, 0x69, 0xd2, 0x37, 0x45, 0x4c, 0xfd, 0xea, 0xe1, 0x7b, 0x04, 0x2c, 0xaa, 0x71,
-    0x6e, 0xc4, 0x4b, 0xbc, 0xce, 0xc7, 0xe5, 0x0f, 0x17, 0xe6, 0x63, 0xf5, 0x13, 0xd6, 0xf9, 0x58,
-    0xfd, 0x47, 0xac, 0xff, 0x00, 0x80, 0xc7, 0x30, 0x96, 0xa0, 0x35, 0x00, 0x00
-};
-const size_t index_html_gz_len = 2877;
\ No newline at end of file
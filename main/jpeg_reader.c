@@ -0,0 +1,359 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "jpeg_reader.h"
+
+#define MARKER_SOF0 0xC0
+#define MARKER_SOF1 0xC1
+#define MARKER_DHT 0xC4
+#define MARKER_RST0 0xD0
+#define MARKER_RST7 0xD7
+#define MARKER_SOI 0xD8
+#define MARKER_EOI 0xD9
+#define MARKER_SOS 0xDA
+#define MARKER_DQT 0xDB
+#define MARKER_DRI 0xDD
+
+const uint8_t jpeg_natural_order[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool build_table(jpeg_huffman_table_t *table, const uint8_t *counts, const uint8_t *symbols, int total)
+{
+    memcpy(table->symbols, symbols, total);
+    memset(table->fast_len, 0, sizeof(table->fast_len));
+
+    int32_t code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; ++len)
+    {
+        table->value_offset[len] = k - code;
+        for (int i = 0; i < counts[len - 1]; ++i, ++k, ++code)
+        {
+            // More codes of this length than there are bit patterns for
+            if (code >= (1 << len))
+            {
+                return false;
+            }
+
+            if (len <= JPEG_READER_FAST_BITS)
+            {
+                // Every lookup index that starts with this code
+                int shift = JPEG_READER_FAST_BITS - len;
+                for (int j = 0; j < (1 << shift); ++j)
+                {
+                    table->fast_len[(code << shift) | j] = len;
+                    table->fast_symbol[(code << shift) | j] = symbols[k];
+                }
+            }
+        }
+        table->max_code[len] = counts[len - 1] != 0 ? code - 1 : -1;
+        code <<= 1;
+    }
+    table->max_code[17] = INT32_MAX;
+
+    return true;
+}
+
+static jpeg_reader_result_t parse_dqt(jpeg_reader_tables_t *tables, const uint8_t *seg, const uint8_t *seg_end)
+{
+    while (seg < seg_end)
+    {
+        int precision = seg[0] >> 4;
+        int id = seg[0] & 0x0F;
+        size_t table_len = precision == 0 ? 1 + 64 : 1 + 128;
+        if (id >= JPEG_READER_QUANT_TABLES || precision > 1 || seg + table_len > seg_end)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        for (int k = 0; k < 64; ++k)
+        {
+            tables->quant[id][k] = precision == 0 ? seg[1 + k] : read_u16(seg + 1 + 2 * k);
+        }
+        seg += table_len;
+    }
+
+    return JPEG_READER_OK;
+}
+
+static jpeg_reader_result_t parse_dht(jpeg_reader_tables_t *tables, const uint8_t *seg, const uint8_t *seg_end)
+{
+    while (seg < seg_end)
+    {
+        int table_class = seg[0] >> 4;
+        int id = seg[0] & 0x0F;
+        if (table_class > 1 || id >= JPEG_READER_HUFFMAN_TABLES || seg + 17 > seg_end)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        const uint8_t *counts = seg + 1;
+        int total = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            total += counts[i];
+        }
+        if (total > 256 || seg + 17 + total > seg_end)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        jpeg_huffman_table_t *table = table_class == 0 ? &tables->dc_tables[id] : &tables->ac_tables[id];
+        table->defined = build_table(table, counts, seg + 17, total);
+        if (!table->defined)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+        seg += 17 + total;
+    }
+
+    return JPEG_READER_OK;
+}
+
+static jpeg_reader_result_t parse_sof(jpeg_scan_t *scan, const uint8_t *seg, const uint8_t *seg_end)
+{
+    if (seg_end - seg < 6)
+    {
+        return JPEG_READER_CORRUPT;
+    }
+    if (seg[0] != 8)
+    {
+        return JPEG_READER_UNSUPPORTED;
+    }
+
+    scan->height = read_u16(seg + 1);
+    scan->width = read_u16(seg + 3);
+    scan->components_count = seg[5];
+    // Height defined later by DNL marker is not supported
+    if (scan->height == 0 || scan->width == 0 ||
+        (scan->components_count != 1 && scan->components_count != JPEG_READER_MAX_COMPONENTS))
+    {
+        return JPEG_READER_UNSUPPORTED;
+    }
+    if (seg_end - seg < 6 + 3 * scan->components_count)
+    {
+        return JPEG_READER_CORRUPT;
+    }
+
+    scan->h_max = 1;
+    scan->v_max = 1;
+    for (int i = 0; i < scan->components_count; ++i)
+    {
+        jpeg_component_t *component = &scan->components[i];
+        component->id = seg[6 + 3 * i];
+        component->h = seg[7 + 3 * i] >> 4;
+        component->v = seg[7 + 3 * i] & 0x0F;
+        component->tq = seg[8 + 3 * i];
+        if (component->h < 1 || component->h > 4 || component->v < 1 || component->v > 4 ||
+            component->tq >= JPEG_READER_QUANT_TABLES)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        scan->h_max = component->h > scan->h_max ? component->h : scan->h_max;
+        scan->v_max = component->v > scan->v_max ? component->v : scan->v_max;
+    }
+
+    if (scan->components_count == 1)
+    {
+        scan->components[0].h = 1;
+        scan->components[0].v = 1;
+        scan->h_max = 1;
+        scan->v_max = 1;
+    }
+
+    return JPEG_READER_OK;
+}
+
+static jpeg_reader_result_t parse_sos(jpeg_reader_tables_t *tables, jpeg_scan_t *scan, const uint8_t *seg,
+                                      const uint8_t *seg_end, const uint8_t *end)
+{
+    if (scan->components_count == 0)
+    {
+        return JPEG_READER_CORRUPT;
+    }
+
+    int components_count = seg < seg_end ? seg[0] : 0;
+    if (seg_end - seg < 1 + 2 * components_count + 3 || components_count < 1 ||
+        components_count > JPEG_READER_MAX_COMPONENTS)
+    {
+        return JPEG_READER_CORRUPT;
+    }
+    // Components coded in separate scans would need every scan walked, which cameras do not produce
+    if (components_count != scan->components_count)
+    {
+        return JPEG_READER_UNSUPPORTED;
+    }
+
+    // Blocks of MCU follow order of components in scan, so they are kept in that order
+    jpeg_component_t frame_components[JPEG_READER_MAX_COMPONENTS];
+    memcpy(frame_components, scan->components, sizeof(frame_components));
+
+    for (int i = 0; i < components_count; ++i)
+    {
+        uint8_t id = seg[1 + 2 * i];
+        uint8_t dc_id = seg[2 + 2 * i] >> 4;
+        uint8_t ac_id = seg[2 + 2 * i] & 0x0F;
+
+        int found = -1;
+        for (int j = 0; j < scan->components_count; ++j)
+        {
+            found = frame_components[j].id == id ? j : found;
+        }
+        if (found < 0 || dc_id >= JPEG_READER_HUFFMAN_TABLES || ac_id >= JPEG_READER_HUFFMAN_TABLES ||
+            !tables->dc_tables[dc_id].defined || !tables->ac_tables[ac_id].defined)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        // Every component of frame has to be in scan once
+        for (int j = 0; j < i; ++j)
+        {
+            if (scan->components[j].id == id)
+            {
+                return JPEG_READER_CORRUPT;
+            }
+        }
+
+        jpeg_component_t *component = &scan->components[i];
+        *component = frame_components[found];
+        component->dc_table = &tables->dc_tables[dc_id];
+        component->ac_table = &tables->ac_tables[ac_id];
+        component->prediction = 0;
+    }
+
+    const uint8_t *spectral = seg + 1 + 2 * components_count;
+    if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0)
+    {
+        return JPEG_READER_UNSUPPORTED;
+    }
+
+    scan->mcu_cols = (scan->width + 8 * scan->h_max - 1) / (8 * scan->h_max);
+    scan->mcu_rows = (scan->height + 8 * scan->v_max - 1) / (8 * scan->v_max);
+    scan->restart_left = scan->restart_interval;
+    memset(&scan->reader, 0, sizeof(scan->reader));
+    scan->reader.pos = seg_end;
+    scan->reader.end = end;
+
+    return JPEG_READER_OK;
+}
+
+jpeg_reader_result_t jpeg_reader_begin(jpeg_reader_tables_t *tables, const uint8_t *buf, size_t len,
+                                       jpeg_scan_t *scan)
+{
+    const uint8_t *pos = buf;
+    const uint8_t *end = buf + len;
+
+    memset(scan, 0, sizeof(*scan));
+    if (len < 4 || buf[0] != 0xFF || buf[1] != MARKER_SOI)
+    {
+        return JPEG_READER_CORRUPT;
+    }
+    pos += 2;
+
+    while (end - pos >= 4)
+    {
+        if (pos[0] != 0xFF)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+
+        uint8_t marker = pos[1];
+        if (marker == 0xFF)
+        {
+            pos++; // Fill byte
+            continue;
+        }
+        pos += 2;
+        if (marker == MARKER_EOI)
+        {
+            break;
+        }
+        if ((marker >= MARKER_RST0 && marker <= MARKER_RST7) || marker == 0x01)
+        {
+            continue; // Markers without segment
+        }
+
+        uint16_t seg_len = read_u16(pos);
+        if (seg_len < 2 || seg_len > end - pos)
+        {
+            return JPEG_READER_CORRUPT;
+        }
+        const uint8_t *seg = pos + 2;
+        const uint8_t *seg_end = pos + seg_len;
+        pos = seg_end;
+
+        jpeg_reader_result_t ret = JPEG_READER_OK;
+        switch (marker)
+        {
+        case MARKER_DQT:
+            ret = parse_dqt(tables, seg, seg_end);
+            break;
+        case MARKER_DHT:
+            ret = parse_dht(tables, seg, seg_end);
+            break;
+        case MARKER_SOF0:
+        case MARKER_SOF1:
+            ret = parse_sof(scan, seg, seg_end);
+            break;
+        case MARKER_DRI:
+            scan->restart_interval = seg_len >= 4 ? read_u16(seg) : 0;
+            break;
+        case MARKER_SOS:
+            return parse_sos(tables, scan, seg, seg_end, end);
+        default:
+            // Other frame types (progressive, lossless, arithmetic coded) and DAC
+            if (marker >= 0xC2 && marker <= 0xCF)
+            {
+                ret = JPEG_READER_UNSUPPORTED;
+            }
+            break;
+        }
+
+        if (ret != JPEG_READER_OK)
+        {
+            return ret;
+        }
+    }
+
+    return JPEG_READER_CORRUPT;
+}
+
+bool jpeg_reader_restart(jpeg_scan_t *scan)
+{
+    jpeg_bit_reader_t *reader = &scan->reader;
+    reader->bits = 0;
+    reader->count = 0;
+    reader->padding = 0;
+    reader->marker = false;
+
+    for (int i = 0; i < scan->components_count; ++i)
+    {
+        scan->components[i].prediction = 0;
+    }
+
+    while (reader->pos + 1 < reader->end)
+    {
+        if (reader->pos[0] == 0xFF && reader->pos[1] >= MARKER_RST0 && reader->pos[1] <= MARKER_RST7)
+        {
+            reader->pos += 2;
+            return true;
+        }
+        reader->pos++;
+    }
+
+    return false;
+}
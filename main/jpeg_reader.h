@@ -0,0 +1,303 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+// Reader of baseline JPEG frames as camera produces them, down to quantized DCT coefficients. Headers are parsed
+// by jpeg_reader_begin, then entropy coded data is walked MCU by MCU with inline functions below, so every user
+// takes only as much of every block as it needs.
+//
+// Nothing here depends on ESP-IDF, so it is built on host by benchmarks in bench/ as it is.
+
+#define JPEG_READER_MAX_COMPONENTS 3
+#define JPEG_READER_HUFFMAN_TABLES 4
+#define JPEG_READER_QUANT_TABLES 4
+#define JPEG_READER_FAST_BITS 9
+
+// Entropy coded data is padded with zero bytes once marker or end of buffer is reached. More of them than bit
+// buffer holds means decoding went past end of scan, so frame is corrupt or cut.
+#define JPEG_READER_MAX_PADDING_BYTES 4
+
+typedef enum
+{
+    JPEG_READER_OK = 0,
+    JPEG_READER_UNSUPPORTED, // Progressive, 12-bit, arithmetic coded or otherwise not baseline frame
+    JPEG_READER_CORRUPT,
+} jpeg_reader_result_t;
+
+typedef struct
+{
+    // Codes up to JPEG_READER_FAST_BITS long are decoded by single lookup, length 0 means longer code
+    uint8_t fast_len[1 << JPEG_READER_FAST_BITS];
+    uint8_t fast_symbol[1 << JPEG_READER_FAST_BITS];
+    int32_t max_code[18];
+    int32_t value_offset[17];
+    uint8_t symbols[256];
+    bool defined;
+} jpeg_huffman_table_t;
+
+// Tables are kept between frames, as camera repeats the same ones in every frame. Caller owns it, so it can be
+// placed away from small task stacks.
+typedef struct
+{
+    jpeg_huffman_table_t dc_tables[JPEG_READER_HUFFMAN_TABLES];
+    jpeg_huffman_table_t ac_tables[JPEG_READER_HUFFMAN_TABLES];
+    uint16_t quant[JPEG_READER_QUANT_TABLES][64]; // In zigzag order, as stored in frame
+} jpeg_reader_tables_t;
+
+typedef struct
+{
+    uint8_t id;
+    uint8_t h; // Sampling factors, which are also blocks of component in one MCU
+    uint8_t v;
+    uint8_t tq;
+    const jpeg_huffman_table_t *dc_table;
+    const jpeg_huffman_table_t *ac_table;
+    int32_t prediction;
+} jpeg_component_t;
+
+// Bits are kept MSB first. Byte stuffing is undone while filling, and marker stops reading.
+typedef struct
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+    uint32_t bits;
+    int count;
+    bool marker;
+    int padding;
+} jpeg_bit_reader_t;
+
+// Frame with all components in one interleaved scan, components in order of scan. Frame of single component is
+// coded with one block in MCU whatever its sampling factors are, so they are set to 1 for it.
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    int components_count;
+    jpeg_component_t components[JPEG_READER_MAX_COMPONENTS];
+    uint8_t h_max;
+    uint8_t v_max;
+    uint16_t restart_interval;
+    uint32_t mcu_cols;
+    uint32_t mcu_rows;
+
+    jpeg_bit_reader_t reader;
+    uint32_t restart_left;
+} jpeg_scan_t;
+
+// Natural (row by row) index of every coefficient in zigzag order
+extern const uint8_t jpeg_natural_order[64];
+
+// Parses frame headers up to start of scan and prepares scan for reading its first MCU
+jpeg_reader_result_t jpeg_reader_begin(jpeg_reader_tables_t *tables, const uint8_t *buf, size_t len,
+                                       jpeg_scan_t *scan);
+
+// Skips to restart marker that has to follow restart interval and starts bit reading after it
+bool jpeg_reader_restart(jpeg_scan_t *scan);
+
+static inline void jpeg_reader_fill_bits(jpeg_bit_reader_t *reader)
+{
+    while (reader->count <= 24)
+    {
+        uint32_t byte = 0;
+        if (!reader->marker && reader->pos < reader->end)
+        {
+            byte = *reader->pos;
+            if (byte == 0xFF)
+            {
+                if (reader->pos + 1 < reader->end && reader->pos[1] == 0x00)
+                {
+                    reader->pos += 2;
+                }
+                else
+                {
+                    // Reader stays at marker
+                    reader->marker = true;
+                    byte = 0;
+                    reader->padding++;
+                }
+            }
+            else
+            {
+                reader->pos++;
+            }
+        }
+        else
+        {
+            reader->padding++;
+        }
+
+        reader->bits |= byte << (24 - reader->count);
+        reader->count += 8;
+    }
+}
+
+static inline void jpeg_reader_consume_bits(jpeg_bit_reader_t *reader, int len)
+{
+    reader->bits <<= len;
+    reader->count -= len;
+}
+
+static inline int jpeg_reader_decode_symbol(jpeg_bit_reader_t *reader, const jpeg_huffman_table_t *table)
+{
+    jpeg_reader_fill_bits(reader);
+
+    uint32_t peek = reader->bits >> (32 - JPEG_READER_FAST_BITS);
+    int len = table->fast_len[peek];
+    if (len != 0)
+    {
+        jpeg_reader_consume_bits(reader, len);
+        return table->fast_symbol[peek];
+    }
+
+    uint32_t code16 = reader->bits >> 16;
+    for (len = JPEG_READER_FAST_BITS + 1; len <= 16; ++len)
+    {
+        int32_t code = code16 >> (16 - len);
+        if (code <= table->max_code[len])
+        {
+            jpeg_reader_consume_bits(reader, len);
+            return table->symbols[table->value_offset[len] + code];
+        }
+    }
+
+    return -1;
+}
+
+static inline int32_t jpeg_reader_receive_extend(jpeg_bit_reader_t *reader, int size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+    if (reader->count < size)
+    {
+        jpeg_reader_fill_bits(reader);
+    }
+
+    int32_t value = reader->bits >> (32 - size);
+    jpeg_reader_consume_bits(reader, size);
+    return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+// Handles restart interval before every MCU. False when restart marker is missing.
+static inline bool jpeg_reader_start_mcu(jpeg_scan_t *scan)
+{
+    if (scan->restart_interval == 0)
+    {
+        return true;
+    }
+
+    if (scan->restart_left == 0)
+    {
+        if (!jpeg_reader_restart(scan))
+        {
+            return false;
+        }
+        scan->restart_left = scan->restart_interval;
+    }
+    scan->restart_left--;
+
+    return true;
+}
+
+// False when MCU was decoded from padding past end of entropy coded data
+static inline bool jpeg_reader_end_mcu(const jpeg_scan_t *scan)
+{
+    return scan->reader.padding <= JPEG_READER_MAX_PADDING_BYTES;
+}
+
+// Gives quantized DC coefficient of next block of component
+static inline bool jpeg_reader_decode_dc(jpeg_scan_t *scan, jpeg_component_t *component, int32_t *dc)
+{
+    int size = jpeg_reader_decode_symbol(&scan->reader, component->dc_table);
+    if (size < 0 || size > 11)
+    {
+        return false;
+    }
+
+    component->prediction += jpeg_reader_receive_extend(&scan->reader, size);
+    *dc = component->prediction;
+    return true;
+}
+
+// Walks past AC codes of block for users that need only DC coefficient
+static inline bool jpeg_reader_skip_ac(jpeg_scan_t *scan, const jpeg_component_t *component)
+{
+    jpeg_bit_reader_t *reader = &scan->reader;
+    const jpeg_huffman_table_t *table = component->ac_table;
+    int k = 1;
+    while (k < 64)
+    {
+        int symbol = jpeg_reader_decode_symbol(reader, table);
+        if (symbol < 0)
+        {
+            return false;
+        }
+
+        int run = symbol >> 4;
+        int size = symbol & 0x0F;
+        if (size == 0)
+        {
+            if (run != 15)
+            {
+                break; // End of block
+            }
+            k += 16;
+            continue;
+        }
+
+        if (reader->count < size)
+        {
+            jpeg_reader_fill_bits(reader);
+        }
+        jpeg_reader_consume_bits(reader, size);
+        k += run + 1;
+    }
+
+    return k <= 64;
+}
+
+// Stores quantized AC coefficients of block in zigzag order. Only nonzero ones are written, so block has to be
+// cleared by caller.
+static inline bool jpeg_reader_decode_ac(jpeg_scan_t *scan, const jpeg_component_t *component, int16_t *block)
+{
+    jpeg_bit_reader_t *reader = &scan->reader;
+    const jpeg_huffman_table_t *table = component->ac_table;
+    int k = 1;
+    while (k < 64)
+    {
+        int symbol = jpeg_reader_decode_symbol(reader, table);
+        if (symbol < 0)
+        {
+            return false;
+        }
+
+        int run = symbol >> 4;
+        int size = symbol & 0x0F;
+        if (size == 0)
+        {
+            if (run != 15)
+            {
+                break; // End of block
+            }
+            k += 16;
+            continue;
+        }
+
+        k += run;
+        if (k > 63)
+        {
+            return false;
+        }
+        block[k++] = jpeg_reader_receive_extend(reader, size);
+    }
+
+    return k <= 64;
+}
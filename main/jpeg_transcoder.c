@@ -0,0 +1,906 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "math.h"
+
+#include "jpeg_transcoder.h"
+
+#define MARKER_SOF0 0xC0
+#define MARKER_DHT 0xC4
+#define MARKER_SOI 0xD8
+#define MARKER_EOI 0xD9
+#define MARKER_SOS 0xDA
+#define MARKER_DQT 0xDB
+#define MARKER_APP0 0xE0
+
+#define TRANSFORM_BITS 12
+// First pass of transform keeps 4 fractional bits, so second one still fits in 32 bits
+#define FIRST_PASS_SHIFT (TRANSFORM_BITS - 4)
+#define SECOND_PASS_SHIFT (2 * TRANSFORM_BITS - FIRST_PASS_SHIFT)
+
+// Dequantized coefficients of 8-bit samples never exceed it, larger ones come only from corrupt data
+#define MAX_COEFFICIENT 2047
+// Largest quantized value of standard Huffman tables (size 10 for AC, DC difference of two such stays in 11)
+#define MAX_QUANTIZED 1023
+// Limit of ITU T.81 for interleaved scan
+#define MAX_MCU_BLOCKS 10
+
+// ITU T.81 K.1 tables in zigzag order
+static const uint8_t standard_quant[2][64] = {
+    {
+        16, 11, 12, 14, 12, 10, 16, 14, 13, 14, 18, 17, 16, 19, 24, 40,
+        26, 24, 22, 22, 24, 49, 35, 37, 29, 40, 58, 51, 61, 60, 57, 51,
+        56, 55, 64, 72, 92, 78, 64, 68, 87, 69, 55, 56, 80, 109, 81, 87,
+        95, 98, 103, 104, 103, 62, 77, 113, 121, 112, 100, 120, 92, 101, 103, 99,
+    },
+    {
+        17, 18, 18, 24, 21, 24, 47, 26, 26, 47, 99, 66, 56, 66, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    },
+};
+
+// ITU T.81 K.3 tables as DHT segment body: class and id, code counts per length, symbols
+static const uint8_t standard_dht[] = {
+    // Luminance DC
+    0x00,
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+    // Chrominance DC
+    0x01,
+    0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+    // Luminance AC
+    0x10,
+    0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+    // Chrominance AC
+    0x11,
+    0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 119,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t jfif_app0[] = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+
+// Bits are collected MSB first and written with byte stuffing. Writing past end only sets overflow.
+typedef struct
+{
+    uint8_t *pos;
+    uint8_t *end;
+    uint32_t bits;
+    int count;
+    bool overflow;
+} bit_writer_t;
+
+// Source coefficient of zigzag index and its place among kept low frequencies of block
+typedef struct
+{
+    uint8_t zigzag;
+    uint8_t pos;
+} kept_coefficient_t;
+
+// Tile of mosaic while its grid row is written
+typedef struct
+{
+    jpeg_scan_t scan;
+    bool valid;
+    const uint16_t *source_quant[JPEG_READER_MAX_COMPONENTS];
+    bool requantize[JPEG_READER_MAX_COMPONENTS];
+} mosaic_cell_t;
+
+static inline void put_byte(bit_writer_t *writer, uint8_t byte)
+{
+    if (writer->pos == writer->end)
+    {
+        writer->overflow = true;
+        return;
+    }
+    *writer->pos++ = byte;
+}
+
+static void put_u16(bit_writer_t *writer, uint16_t value)
+{
+    put_byte(writer, value >> 8);
+    put_byte(writer, value & 0xFF);
+}
+
+static void put_marker(bit_writer_t *writer, uint8_t marker, size_t body_len)
+{
+    put_byte(writer, 0xFF);
+    put_byte(writer, marker);
+    if (body_len != 0)
+    {
+        put_u16(writer, body_len + 2);
+    }
+}
+
+static void put_raw(bit_writer_t *writer, const uint8_t *data, size_t len)
+{
+    if ((size_t) (writer->end - writer->pos) < len)
+    {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->pos, data, len);
+    writer->pos += len;
+}
+
+static inline void put_bits(bit_writer_t *writer, uint32_t value, int len)
+{
+    // Output is discarded after overflow, and bits left unwritten would make shifts overrun
+    if (writer->overflow)
+    {
+        return;
+    }
+
+    writer->bits = (writer->bits << len) | (value & ((1u << len) - 1));
+    writer->count += len;
+    while (writer->count >= 8)
+    {
+        writer->count -= 8;
+        uint8_t byte = writer->bits >> writer->count;
+        if (writer->end - writer->pos < 2)
+        {
+            writer->overflow = true;
+            return;
+        }
+        *writer->pos++ = byte;
+        if (byte == 0xFF)
+        {
+            *writer->pos++ = 0x00;
+        }
+    }
+}
+
+static void flush_bits(bit_writer_t *writer)
+{
+    // Last byte is padded with ones
+    if (writer->count > 0)
+    {
+        put_bits(writer, 0x7F, 8 - writer->count);
+    }
+}
+
+static inline int bit_length(uint32_t value)
+{
+    return value == 0 ? 0 : 32 - __builtin_clz(value);
+}
+
+static inline void put_value(bit_writer_t *writer, const jpeg_huffman_code_t *code, int32_t value, int size)
+{
+    put_bits(writer, code->code, code->len);
+    if (size != 0)
+    {
+        put_bits(writer, value < 0 ? value - 1 : value, size);
+    }
+}
+
+// Block is quantized and in zigzag order
+static void encode_block(const jpeg_transcoder_t *transcoder, bit_writer_t *writer, int table, const int16_t *block,
+                         int32_t *prediction)
+{
+    int32_t diff = block[0] - *prediction;
+    *prediction = block[0];
+    int size = bit_length(diff < 0 ? -diff : diff);
+    put_value(writer, &transcoder->dc_codes[table][size], diff, size);
+
+    const jpeg_huffman_code_t *ac_codes = transcoder->ac_codes[table];
+    int run = 0;
+    for (int k = 1; k < 64; ++k)
+    {
+        int32_t value = block[k];
+        if (value == 0)
+        {
+            run++;
+            continue;
+        }
+
+        while (run > 15)
+        {
+            put_bits(writer, ac_codes[0xF0].code, ac_codes[0xF0].len);
+            run -= 16;
+        }
+        size = bit_length(value < 0 ? -value : value);
+        put_value(writer, &ac_codes[(run << 4) | size], value, size);
+        run = 0;
+    }
+
+    if (run > 0)
+    {
+        put_bits(writer, ac_codes[0x00].code, ac_codes[0x00].len);
+    }
+}
+
+static inline int16_t quantize(int32_t value, int32_t divisor)
+{
+    int32_t quantized = value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+    return quantized > MAX_QUANTIZED ? MAX_QUANTIZED : (quantized < -MAX_QUANTIZED ? -MAX_QUANTIZED : quantized);
+}
+
+static inline int16_t clamp_coefficient(int32_t value)
+{
+    return value > MAX_COEFFICIENT ? MAX_COEFFICIENT : (value < -MAX_COEFFICIENT ? -MAX_COEFFICIENT : value);
+}
+
+// Orthonormal DCT-II basis, the one JPEG uses
+static double dct_basis(int size, int k, int x)
+{
+    return sqrt((k == 0 ? 1.0 : 2.0) / size) * cos((2 * x + 1) * k * M_PI / (2 * size));
+}
+
+// Row u of transform gives frequency u of output block from lowest n frequencies of each of 'scale' source blocks
+// in a row. Every source block is taken back to n samples by n-point inverse DCT (scaled by sqrt(n / 8), so mean
+// is kept), and these 8 samples are taken to frequencies by 8-point DCT. Both steps are folded into one matrix.
+static void build_transform(int16_t *transform, int scale)
+{
+    int n = 8 / scale;
+    for (int u = 0; u < 8; ++u)
+    {
+        for (int m = 0; m < 8; ++m)
+        {
+            int block = m / n;
+            int k = m % n;
+            double sum = 0;
+            for (int x = 0; x < n; ++x)
+            {
+                sum += dct_basis(8, u, block * n + x) * dct_basis(n, k, x);
+            }
+            transform[u * 8 + m] = lround(sum * sqrt(n / 8.0) * (1 << TRANSFORM_BITS));
+        }
+    }
+}
+
+// Output = T * X * T', where X holds low frequencies of source blocks side by side. Rows of X that are all zero,
+// which is most of them for flat areas, are skipped in both passes.
+static void transform_block(const int16_t *transform, const int32_t *x, uint8_t rows_mask, int32_t *out)
+{
+    int32_t tmp[64];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if ((rows_mask & (1 << i)) == 0)
+        {
+            continue;
+        }
+        const int32_t *row = x + i * 8;
+        for (int u = 0; u < 8; ++u)
+        {
+            const int16_t *t = transform + u * 8;
+            int32_t acc = 0;
+            for (int m = 0; m < 8; ++m)
+            {
+                acc += row[m] * t[m];
+            }
+            tmp[i * 8 + u] = (acc + (1 << (FIRST_PASS_SHIFT - 1))) >> FIRST_PASS_SHIFT;
+        }
+    }
+
+    for (int v = 0; v < 8; ++v)
+    {
+        const int16_t *t = transform + v * 8;
+        int32_t acc[8] = {0};
+        for (int i = 0; i < 8; ++i)
+        {
+            if ((rows_mask & (1 << i)) == 0)
+            {
+                continue;
+            }
+            for (int u = 0; u < 8; ++u)
+            {
+                acc[u] += t[i] * tmp[i * 8 + u];
+            }
+        }
+        for (int u = 0; u < 8; ++u)
+        {
+            out[v * 8 + u] = (acc[u] + (1 << (SECOND_PASS_SHIFT - 1))) >> SECOND_PASS_SHIFT;
+        }
+    }
+}
+
+static const uint8_t *build_codes(jpeg_huffman_code_t *codes, const uint8_t *spec)
+{
+    const uint8_t *counts = spec;
+    const uint8_t *symbols = spec + 16;
+    uint16_t code = 0;
+    int k = 0;
+
+    for (int len = 1; len <= 16; ++len)
+    {
+        for (int i = 0; i < counts[len - 1]; ++i, ++k, ++code)
+        {
+            codes[symbols[k]].code = code;
+            codes[symbols[k]].len = len;
+        }
+        code <<= 1;
+    }
+
+    return symbols + k;
+}
+
+void jpeg_transcoder_init(jpeg_transcoder_t *transcoder, int16_t *band, size_t band_capacity)
+{
+    const uint8_t *spec = standard_dht;
+    while (spec < standard_dht + sizeof(standard_dht))
+    {
+        int table_class = spec[0] >> 4;
+        int id = spec[0] & 0x0F;
+        spec = build_codes(table_class == 0 ? transcoder->dc_codes[id] : transcoder->ac_codes[id], spec + 1);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        build_transform(transcoder->transforms[i], 2 << i);
+    }
+
+    transcoder->band = band;
+    transcoder->band_capacity = band_capacity;
+}
+
+// Output tables are standard ones scaled as libjpeg does, but never finer than source, as requantizing to finer
+// step only costs bytes
+static void set_output_quant(jpeg_transcoder_t *transcoder, const jpeg_scan_t *scan, uint8_t quality)
+{
+    int factor = quality == 0 ? 0 : (quality < 50 ? 5000 / quality : 200 - 2 * quality);
+
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        uint8_t tq = scan->components[c].tq;
+        const uint16_t *source = transcoder->tables.quant[tq];
+        const uint8_t *standard = standard_quant[tq == scan->components[0].tq ? 0 : 1];
+
+        for (int k = 0; k < 64; ++k)
+        {
+            int32_t value = quality == 0 ? source[k] : (standard[k] * factor + 50) / 100;
+            value = value > source[k] ? value : source[k];
+            transcoder->quant[tq][k] = value < 1 ? 1 : (value > 255 ? 255 : value);
+        }
+    }
+}
+
+static void write_headers(const jpeg_transcoder_t *transcoder, bit_writer_t *writer, const jpeg_scan_t *scan,
+                          uint16_t width, uint16_t height)
+{
+    put_marker(writer, MARKER_SOI, 0);
+    put_marker(writer, MARKER_APP0, sizeof(jfif_app0));
+    put_raw(writer, jfif_app0, sizeof(jfif_app0));
+
+    uint8_t written = 0;
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        uint8_t tq = scan->components[c].tq;
+        if (written & (1 << tq))
+        {
+            continue;
+        }
+        written |= 1 << tq;
+
+        put_marker(writer, MARKER_DQT, 1 + 64);
+        put_byte(writer, tq);
+        for (int k = 0; k < 64; ++k)
+        {
+            put_byte(writer, transcoder->quant[tq][k]);
+        }
+    }
+
+    put_marker(writer, MARKER_SOF0, 6 + 3 * scan->components_count);
+    put_byte(writer, 8);
+    put_u16(writer, height);
+    put_u16(writer, width);
+    put_byte(writer, scan->components_count);
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        put_byte(writer, scan->components[c].id);
+        put_byte(writer, (scan->components[c].h << 4) | scan->components[c].v);
+        put_byte(writer, scan->components[c].tq);
+    }
+
+    put_marker(writer, MARKER_DHT, sizeof(standard_dht));
+    put_raw(writer, standard_dht, sizeof(standard_dht));
+
+    // First component uses luminance tables, the rest chrominance ones
+    put_marker(writer, MARKER_SOS, 1 + 2 * scan->components_count + 3);
+    put_byte(writer, scan->components_count);
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        put_byte(writer, scan->components[c].id);
+        put_byte(writer, c == 0 ? 0x00 : 0x11);
+    }
+    put_byte(writer, 0);
+    put_byte(writer, 63);
+    put_byte(writer, 0);
+}
+
+// Block is quantized with source table and in zigzag order
+static void requantize_block(int16_t *block, const uint16_t *source_quant, const uint16_t *quant)
+{
+    for (int k = 0; k < 64; ++k)
+    {
+        if (block[k] != 0)
+        {
+            block[k] = quantize(clamp_coefficient(block[k] * source_quant[k]), quant[k]);
+        }
+    }
+}
+
+static jpeg_transcode_result_t requantize_scan(jpeg_transcoder_t *transcoder, jpeg_scan_t *scan,
+                                               bit_writer_t *writer)
+{
+    int32_t predictions[JPEG_READER_MAX_COMPONENTS] = {0};
+    int16_t block[64];
+
+    for (uint32_t mcu = 0; mcu < scan->mcu_cols * scan->mcu_rows; ++mcu)
+    {
+        if (!jpeg_reader_start_mcu(scan))
+        {
+            return JPEG_TRANSCODE_CORRUPT;
+        }
+
+        for (int c = 0; c < scan->components_count; ++c)
+        {
+            jpeg_component_t *component = &scan->components[c];
+            const uint16_t *source_quant = transcoder->tables.quant[component->tq];
+            const uint16_t *quant = transcoder->quant[component->tq];
+
+            for (int i = 0; i < component->h * component->v; ++i)
+            {
+                int32_t dc;
+                memset(block, 0, sizeof(block));
+                if (!jpeg_reader_decode_dc(scan, component, &dc) || !jpeg_reader_decode_ac(scan, component, block))
+                {
+                    return JPEG_TRANSCODE_CORRUPT;
+                }
+                block[0] = clamp_coefficient(dc);
+                requantize_block(block, source_quant, quant);
+                encode_block(transcoder, writer, c == 0 ? 0 : 1, block, &predictions[c]);
+            }
+        }
+
+        if (!jpeg_reader_end_mcu(scan))
+        {
+            return JPEG_TRANSCODE_CORRUPT;
+        }
+        if (writer->overflow)
+        {
+            return JPEG_TRANSCODE_TOO_LARGE;
+        }
+    }
+
+    return JPEG_TRANSCODE_OK;
+}
+
+static jpeg_transcode_result_t downscale_scan(jpeg_transcoder_t *transcoder, jpeg_scan_t *scan, int scale,
+                                              bit_writer_t *writer)
+{
+    int n = 8 / scale;
+    const int16_t *transform = transcoder->transforms[scale == 2 ? 0 : (scale == 4 ? 1 : 2)];
+
+    // Band keeps 'scale' MCU rows of every component, n x n coefficients per block
+    size_t band_offsets[JPEG_READER_MAX_COMPONENTS];
+    uint32_t band_cols[JPEG_READER_MAX_COMPONENTS];
+    size_t band_len = 0;
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        band_offsets[c] = band_len;
+        band_cols[c] = scan->mcu_cols * scan->components[c].h;
+        band_len += (size_t) scale * scan->components[c].v * band_cols[c] * n * n;
+    }
+    if (band_len > transcoder->band_capacity)
+    {
+        return JPEG_TRANSCODE_TOO_LARGE;
+    }
+
+    kept_coefficient_t kept[16];
+    int kept_count = 0;
+    for (int k = 0; k < 64; ++k)
+    {
+        int row = jpeg_natural_order[k] / 8;
+        int col = jpeg_natural_order[k] % 8;
+        if (row < n && col < n)
+        {
+            kept[kept_count].zigzag = k;
+            kept[kept_count].pos = row * n + col;
+            kept_count++;
+        }
+    }
+
+    uint32_t out_mcu_cols = (scan->mcu_cols + scale - 1) / scale;
+    int32_t predictions[JPEG_READER_MAX_COMPONENTS] = {0};
+    int16_t block[64];
+    int32_t x[64];
+    int32_t out[64];
+
+    for (uint32_t mcu_y = 0; mcu_y < scan->mcu_rows; ++mcu_y)
+    {
+        uint32_t band_row = mcu_y % scale;
+        for (uint32_t mcu_x = 0; mcu_x < scan->mcu_cols; ++mcu_x)
+        {
+            if (!jpeg_reader_start_mcu(scan))
+            {
+                return JPEG_TRANSCODE_CORRUPT;
+            }
+
+            for (int c = 0; c < scan->components_count; ++c)
+            {
+                jpeg_component_t *component = &scan->components[c];
+                const uint16_t *source_quant = transcoder->tables.quant[component->tq];
+
+                for (int by = 0; by < component->v; ++by)
+                {
+                    for (int bx = 0; bx < component->h; ++bx)
+                    {
+                        uint32_t col = mcu_x * component->h + bx;
+                        uint32_t row = band_row * component->v + by;
+                        int16_t *kept_block = transcoder->band + band_offsets[c] + (row * band_cols[c] + col) * n * n;
+
+                        int32_t dc;
+                        if (!jpeg_reader_decode_dc(scan, component, &dc))
+                        {
+                            return JPEG_TRANSCODE_CORRUPT;
+                        }
+
+                        // Scale 8 needs only DC, AC codes are just walked past
+                        if (n == 1)
+                        {
+                            kept_block[0] = clamp_coefficient(dc * source_quant[0]);
+                            if (!jpeg_reader_skip_ac(scan, component))
+                            {
+                                return JPEG_TRANSCODE_CORRUPT;
+                            }
+                            continue;
+                        }
+
+                        memset(block, 0, sizeof(block));
+                        if (!jpeg_reader_decode_ac(scan, component, block))
+                        {
+                            return JPEG_TRANSCODE_CORRUPT;
+                        }
+                        block[0] = clamp_coefficient(dc);
+                        for (int i = 0; i < kept_count; ++i)
+                        {
+                            int k = kept[i].zigzag;
+                            kept_block[kept[i].pos] = clamp_coefficient(block[k] * source_quant[k]);
+                        }
+                    }
+                }
+            }
+
+            if (!jpeg_reader_end_mcu(scan))
+            {
+                return JPEG_TRANSCODE_CORRUPT;
+            }
+        }
+
+        if (band_row != (uint32_t) scale - 1 && mcu_y != scan->mcu_rows - 1)
+        {
+            continue;
+        }
+
+        // Band is full, or frame ended. Blocks past last decoded row or column repeat the last one.
+        for (uint32_t out_mcu_x = 0; out_mcu_x < out_mcu_cols; ++out_mcu_x)
+        {
+            for (int c = 0; c < scan->components_count; ++c)
+            {
+                const jpeg_component_t *component = &scan->components[c];
+                const uint16_t *quant = transcoder->quant[component->tq];
+                uint32_t last_col = band_cols[c] - 1;
+                uint32_t last_row = (band_row + 1) * component->v - 1;
+
+                for (int by = 0; by < component->v; ++by)
+                {
+                    for (int bx = 0; bx < component->h; ++bx)
+                    {
+                        uint32_t out_col = out_mcu_x * component->h + bx;
+                        uint8_t rows_mask = 0;
+
+                        for (int sy = 0; sy < scale; ++sy)
+                        {
+                            uint32_t row = by * scale + sy;
+                            row = row > last_row ? last_row : row;
+                            for (int sx = 0; sx < scale; ++sx)
+                            {
+                                uint32_t col = out_col * scale + sx;
+                                col = col > last_col ? last_col : col;
+                                const int16_t *kept_block =
+                                    transcoder->band + band_offsets[c] + (row * band_cols[c] + col) * n * n;
+
+                                for (int i = 0; i < n; ++i)
+                                {
+                                    int32_t *x_row = x + (sy * n + i) * 8 + sx * n;
+                                    for (int j = 0; j < n; ++j)
+                                    {
+                                        x_row[j] = kept_block[i * n + j];
+                                        rows_mask |= (x_row[j] != 0) << (sy * n + i);
+                                    }
+                                }
+                            }
+                        }
+
+                        transform_block(transform, x, rows_mask, out);
+                        for (int k = 0; k < 64; ++k)
+                        {
+                            block[k] = quantize(out[jpeg_natural_order[k]], quant[k]);
+                        }
+                        encode_block(transcoder, writer, c == 0 ? 0 : 1, block, &predictions[c]);
+                    }
+                }
+            }
+
+            if (writer->overflow)
+            {
+                return JPEG_TRANSCODE_TOO_LARGE;
+            }
+        }
+    }
+
+    return JPEG_TRANSCODE_OK;
+}
+
+jpeg_transcode_result_t jpeg_transcode(jpeg_transcoder_t *transcoder, const uint8_t *buf, size_t len,
+                                       const jpeg_transcode_params_t *params, uint8_t *out, size_t out_capacity,
+                                       size_t *out_len)
+{
+    int scale = params->scale;
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+    {
+        return JPEG_TRANSCODE_UNSUPPORTED;
+    }
+
+    jpeg_scan_t scan;
+    jpeg_reader_result_t ret = jpeg_reader_begin(&transcoder->tables, buf, len, &scan);
+    if (ret != JPEG_READER_OK)
+    {
+        return ret == JPEG_READER_UNSUPPORTED ? JPEG_TRANSCODE_UNSUPPORTED : JPEG_TRANSCODE_CORRUPT;
+    }
+
+    set_output_quant(transcoder, &scan, params->quality);
+
+    bit_writer_t writer = { .pos = out, .end = out + out_capacity };
+    write_headers(transcoder, &writer, &scan, (scan.width + scale - 1) / scale, (scan.height + scale - 1) / scale);
+
+    jpeg_transcode_result_t result = scale == 1 ? requantize_scan(transcoder, &scan, &writer) :
+                                                  downscale_scan(transcoder, &scan, scale, &writer);
+    if (result != JPEG_TRANSCODE_OK)
+    {
+        return result;
+    }
+
+    flush_bits(&writer);
+    put_marker(&writer, MARKER_EOI, 0);
+    if (writer.overflow)
+    {
+        return JPEG_TRANSCODE_TOO_LARGE;
+    }
+
+    *out_len = writer.pos - out;
+    return JPEG_TRANSCODE_OK;
+}
+
+static bool same_sampling(const jpeg_scan_t *scan, const jpeg_scan_t *reference)
+{
+    if (scan->components_count != reference->components_count)
+    {
+        return false;
+    }
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        if (scan->components[c].h != reference->components[c].h || scan->components[c].v != reference->components[c].v)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void begin_cell(const jpeg_transcoder_t *transcoder, mosaic_cell_t *cell, jpeg_reader_tables_t *tables,
+                       const jpeg_mosaic_tile_t *tile, const jpeg_scan_t *reference)
+{
+    cell->valid = tile != NULL && tile->buf != NULL &&
+                  jpeg_reader_begin(tables, tile->buf, tile->len, &cell->scan) == JPEG_READER_OK &&
+                  same_sampling(&cell->scan, reference);
+    if (!cell->valid)
+    {
+        return;
+    }
+
+    for (int c = 0; c < cell->scan.components_count; ++c)
+    {
+        cell->source_quant[c] = tables->quant[cell->scan.components[c].tq];
+        cell->requantize[c] = memcmp(cell->source_quant[c], transcoder->quant[reference->components[c].tq],
+                                     sizeof(transcoder->quant[0])) != 0;
+    }
+}
+
+// MCU is decoded whole before any of it is written, so tile found corrupt halfway is still replaced by gray one
+static bool read_mcu(const jpeg_transcoder_t *transcoder, mosaic_cell_t *cell, const jpeg_scan_t *reference,
+                     int16_t (*blocks)[64])
+{
+    jpeg_scan_t *scan = &cell->scan;
+    if (!jpeg_reader_start_mcu(scan))
+    {
+        return false;
+    }
+
+    for (int c = 0; c < scan->components_count; ++c)
+    {
+        jpeg_component_t *component = &scan->components[c];
+        const uint16_t *quant = transcoder->quant[reference->components[c].tq];
+
+        for (int i = 0; i < component->h * component->v; ++i, ++blocks)
+        {
+            int16_t *block = *blocks;
+            int32_t dc;
+            memset(block, 0, sizeof(*blocks));
+            if (!jpeg_reader_decode_dc(scan, component, &dc) || !jpeg_reader_decode_ac(scan, component, block))
+            {
+                return false;
+            }
+            block[0] = clamp_coefficient(dc);
+
+            if (cell->requantize[c])
+            {
+                requantize_block(block, cell->source_quant[c], quant);
+                continue;
+            }
+            for (int k = 0; k < 64; ++k)
+            {
+                block[k] = block[k] > MAX_QUANTIZED ? MAX_QUANTIZED :
+                                                      (block[k] < -MAX_QUANTIZED ? -MAX_QUANTIZED : block[k]);
+            }
+        }
+    }
+
+    return jpeg_reader_end_mcu(scan);
+}
+
+jpeg_transcode_result_t jpeg_transcode_mosaic(jpeg_transcoder_t *transcoder, jpeg_reader_tables_t *column_tables,
+                                              const jpeg_mosaic_tile_t *tiles, int count, int cols, uint8_t *out,
+                                              size_t out_capacity, size_t *out_len)
+{
+    if (count < 1 || cols < 1 || cols > JPEG_TRANSCODER_MAX_MOSAIC_COLS)
+    {
+        return JPEG_TRANSCODE_UNSUPPORTED;
+    }
+
+    // Headers of every tile are parsed once up front for size of cells, and again when its grid row is written
+    jpeg_scan_t reference;
+    bool found = false;
+    uint32_t cell_cols = 0;
+    uint32_t cell_rows = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        jpeg_scan_t scan;
+        if (tiles[i].buf == NULL ||
+            jpeg_reader_begin(&column_tables[0], tiles[i].buf, tiles[i].len, &scan) != JPEG_READER_OK)
+        {
+            continue;
+        }
+
+        if (!found)
+        {
+            int blocks = 0;
+            for (int c = 0; c < scan.components_count; ++c)
+            {
+                blocks += scan.components[c].h * scan.components[c].v;
+            }
+            if (blocks > MAX_MCU_BLOCKS)
+            {
+                continue;
+            }
+
+            reference = scan;
+            found = true;
+            for (int c = 0; c < scan.components_count; ++c)
+            {
+                uint8_t tq = scan.components[c].tq;
+                memcpy(transcoder->quant[tq], column_tables[0].quant[tq], sizeof(transcoder->quant[tq]));
+            }
+        }
+        else if (!same_sampling(&scan, &reference))
+        {
+            continue;
+        }
+
+        cell_cols = scan.mcu_cols > cell_cols ? scan.mcu_cols : cell_cols;
+        cell_rows = scan.mcu_rows > cell_rows ? scan.mcu_rows : cell_rows;
+    }
+    if (!found)
+    {
+        return JPEG_TRANSCODE_UNSUPPORTED;
+    }
+
+    int grid_cols = count < cols ? count : cols;
+    int grid_rows = (count + cols - 1) / cols;
+    uint32_t width = grid_cols * cell_cols * 8 * reference.h_max;
+    uint32_t height = grid_rows * cell_rows * 8 * reference.v_max;
+    if (width > UINT16_MAX || height > UINT16_MAX)
+    {
+        return JPEG_TRANSCODE_TOO_LARGE;
+    }
+
+    bit_writer_t writer = { .pos = out, .end = out + out_capacity };
+    write_headers(transcoder, &writer, &reference, width, height);
+
+    mosaic_cell_t cells[JPEG_TRANSCODER_MAX_MOSAIC_COLS];
+    int32_t predictions[JPEG_READER_MAX_COMPONENTS] = {0};
+    int16_t blocks[MAX_MCU_BLOCKS][64];
+
+    for (int grid_row = 0; grid_row < grid_rows; ++grid_row)
+    {
+        for (int col = 0; col < grid_cols; ++col)
+        {
+            int i = grid_row * cols + col;
+            begin_cell(transcoder, &cells[col], &column_tables[col], i < count ? &tiles[i] : NULL, &reference);
+        }
+
+        for (uint32_t mcu_y = 0; mcu_y < cell_rows; ++mcu_y)
+        {
+            for (int col = 0; col < grid_cols; ++col)
+            {
+                mosaic_cell_t *cell = &cells[col];
+                for (uint32_t mcu_x = 0; mcu_x < cell_cols; ++mcu_x)
+                {
+                    bool inside = cell->valid && mcu_y < cell->scan.mcu_rows && mcu_x < cell->scan.mcu_cols;
+                    if (inside && !read_mcu(transcoder, cell, &reference, blocks))
+                    {
+                        cell->valid = false;
+                        inside = false;
+                    }
+                    if (!inside)
+                    {
+                        // Zero DC is mid gray, after level shift
+                        memset(blocks, 0, sizeof(blocks));
+                    }
+
+                    int16_t (*block)[64] = blocks;
+                    for (int c = 0; c < reference.components_count; ++c)
+                    {
+                        const jpeg_component_t *component = &reference.components[c];
+                        for (int b = 0; b < component->h * component->v; ++b, ++block)
+                        {
+                            encode_block(transcoder, &writer, c == 0 ? 0 : 1, *block, &predictions[c]);
+                        }
+                    }
+                }
+            }
+
+            if (writer.overflow)
+            {
+                return JPEG_TRANSCODE_TOO_LARGE;
+            }
+        }
+    }
+
+    flush_bits(&writer);
+    put_marker(&writer, MARKER_EOI, 0);
+    if (writer.overflow)
+    {
+        return JPEG_TRANSCODE_TOO_LARGE;
+    }
+
+    *out_len = writer.pos - out;
+    return JPEG_TRANSCODE_OK;
+}
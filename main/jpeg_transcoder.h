@@ -0,0 +1,85 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "jpeg_reader.h"
+
+// Smaller or lower quality variant of baseline JPEG frame made without decoding it to pixels. Quantized
+// coefficients are read from entropy coded data and new frame is built from them in DCT domain:
+//
+// - Scale 1 only requantizes every coefficient with coarser tables.
+// - Scale 2, 4 and 8 keep lowest 4x4, 2x2 or 1x1 frequencies of every block, which is the block scaled down in
+//   DCT domain, and merge them from 2x2, 4x4 or 8x8 neighbouring blocks into one output block by single matrix
+//   product, then quantize it.
+//
+// Output keeps sampling factors of source, is entropy coded with standard tables (ITU T.81 K.3) and has no
+// restart markers. Only as many MCU rows as merged into one output MCU row are kept, in band given by caller.
+//
+// Nothing here depends on ESP-IDF, so it is built on host by bench/transcode_bench.c as it is.
+
+#define JPEG_TRANSCODER_MAX_SCALE 8
+#define JPEG_TRANSCODER_MAX_MOSAIC_COLS 4
+
+typedef enum
+{
+    JPEG_TRANSCODE_OK = 0,
+    JPEG_TRANSCODE_UNSUPPORTED, // Source is not baseline frame
+    JPEG_TRANSCODE_CORRUPT,
+    JPEG_TRANSCODE_TOO_LARGE, // Output or band does not fit in given capacity
+} jpeg_transcode_result_t;
+
+typedef struct
+{
+    uint8_t scale; // 1, 2, 4 or 8
+    uint8_t quality; // 1-100 as in libjpeg, 0 keeps tables of source. Output is never finer quantized than source.
+} jpeg_transcode_params_t;
+
+typedef struct
+{
+    uint16_t code;
+    uint8_t len;
+} jpeg_huffman_code_t;
+
+// Source tables are kept between frames, as camera repeats the same ones in every frame. Caller owns it, so it
+// can be placed away from small task stacks.
+typedef struct
+{
+    jpeg_reader_tables_t tables;
+    jpeg_huffman_code_t dc_codes[2][12]; // Luminance and chrominance
+    jpeg_huffman_code_t ac_codes[2][256];
+    int16_t transforms[3][64]; // For scale 2, 4 and 8, in 4.12 fixed point
+    uint16_t quant[JPEG_READER_QUANT_TABLES][64]; // Output tables of current frame, zigzag order
+    int16_t *band; // Dequantized low frequencies of blocks waiting to be merged
+    size_t band_capacity; // In coefficients
+} jpeg_transcoder_t;
+
+typedef struct
+{
+    const uint8_t *buf; // NULL leaves cell gray
+    size_t len;
+} jpeg_mosaic_tile_t;
+
+// Builds output Huffman codes and transforms. Band needs scale * MCU columns * blocks in MCU * (8 / scale)^2
+// coefficients for the largest source frame, which is most for scale 2.
+void jpeg_transcoder_init(jpeg_transcoder_t *transcoder, int16_t *band, size_t band_capacity);
+
+// Writes variant of frame to out. Output longer than out_capacity is not written and reported as too large.
+jpeg_transcode_result_t jpeg_transcode(jpeg_transcoder_t *transcoder, const uint8_t *buf, size_t len,
+                                       const jpeg_transcode_params_t *params, uint8_t *out, size_t out_capacity,
+                                       size_t *out_len);
+
+// Writes tiles side by side, 'cols' of them in a row, as one frame. Cells are MCU aligned and as large as the
+// largest tile, so blocks are moved as they are and only requantized when tables of tile differ from output ones,
+// which are taken from first readable tile. Tiles have to share its sampling factors; cells of other, missing or
+// corrupt tiles, and parts of cells past smaller tiles, are left gray. Tiles of one grid row are read side by side,
+// so every column needs its own tables. UNSUPPORTED is returned when no tile can be read.
+jpeg_transcode_result_t jpeg_transcode_mosaic(jpeg_transcoder_t *transcoder, jpeg_reader_tables_t *column_tables,
+                                              const jpeg_mosaic_tile_t *tiles, int count, int cols, uint8_t *out,
+                                              size_t out_capacity, size_t *out_len);
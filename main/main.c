@@ -4,13 +4,63 @@
  */
 
 #include <unistd.h>
+#include <stdlib.h>
 #include "esp_log.h"
+#include "esp_err.h"
+
+#include "udps_handler.h"
+#include "web_handler.h"
+#include "config_cache.h"
+#include "frame_pool.h"
+#include "playout.h"
+#include "replay.h"
+#include "recorder.h"
+#include "playback.h"
+#include "motion.h"
+#include "transcoder.h"
+#include "source_sessions.h"
+#include "mosaic.h"
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+
+#define CONFIG_HOST_SERVER_ADDR "127.0.0.1"
+
+// Host build is used for benchmarks. It has no WiFi, so servers are started at once and client connects to server
+// module given by ACCESSOR_SERVER_ADDR with data transport given by ACCESSOR_TRANSPORT (tcp, udp or auto).
+void app_main(void)
+{
+    ESP_ERROR_CHECK(config_cache_init());
+    ESP_ERROR_CHECK(frame_pool_init());
+    ESP_ERROR_CHECK(playout_init());
+    ESP_ERROR_CHECK(replay_init());
+    ESP_ERROR_CHECK(recorder_init());
+    ESP_ERROR_CHECK(playback_init());
+    ESP_ERROR_CHECK(motion_init());
+    ESP_ERROR_CHECK(transcoder_init());
+    ESP_ERROR_CHECK(source_sessions_init());
+    ESP_ERROR_CHECK(mosaic_init());
+
+    httpd_handle_t server = start_webserver();
+    httpd_handle_t stream_server = start_stream_server();
+
+    const char *server_addr = getenv("ACCESSOR_SERVER_ADDR");
+    const char *transport_name = getenv("ACCESSOR_TRANSPORT");
+    udps_transport_t transport = UDPS_TRANSPORT_TCP;
+    if (transport_name != NULL)
+    {
+        ESP_ERROR_CHECK(udps_transport_from_name(transport_name, &transport));
+    }
+    ESP_ERROR_CHECK(udps_init(server_addr != NULL ? server_addr : CONFIG_HOST_SERVER_ADDR, transport));
+
+    while (server && stream_server) { sleep(5); }
+}
+
+#else
+
 #include "nvs_flash.h"
 #include "esp_wifi.h"
 
-#include "udps_handler.h"
 #include "wifi_handler.h"
-#include "web_handler.h"
 
 void app_main(void)
 {
@@ -25,6 +75,16 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(wifi_init());
+    ESP_ERROR_CHECK(config_cache_init());
+    ESP_ERROR_CHECK(frame_pool_init());
+    ESP_ERROR_CHECK(playout_init());
+    ESP_ERROR_CHECK(replay_init());
+    ESP_ERROR_CHECK(recorder_init());
+    ESP_ERROR_CHECK(playback_init());
+    ESP_ERROR_CHECK(motion_init());
+    ESP_ERROR_CHECK(transcoder_init());
+    ESP_ERROR_CHECK(source_sessions_init());
+    ESP_ERROR_CHECK(mosaic_init());
     // ESP_ERROR_CHECK(udps_init());
 
     static httpd_handle_t server = NULL;
@@ -40,3 +100,5 @@ void app_main(void)
 
     while (server && stream_server) { sleep(5); }
 }
+
+#endif
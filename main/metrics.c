@@ -0,0 +1,296 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdarg.h"
+#include "stdatomic.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "esp_http_server.h"
+
+#include "metrics.h"
+
+#define CONFIG_METRICS_BUCKETS 10
+#define CONFIG_METRICS_LINE_LEN 256
+#define CONFIG_METRICS_CHUNK_LEN 1536
+
+static const char *TAG = "METRICS";
+
+// 64-bit counter made of two 32-bit atomics, as 64-bit atomics are not lock-free on Xtensa.
+// Writer carries overflow of low word into high one, reader retries when high word changed in between.
+// Low word can wrap before writer carries it, so value lower than last one read is taken as carry still to come.
+typedef struct
+{
+    atomic_uint lo;
+    atomic_uint hi;
+    uint64_t last; // Only used by reader, which is server task
+} counter64_t;
+
+typedef struct
+{
+    atomic_uint buckets[CONFIG_METRICS_BUCKETS + 1]; // Last one is +Inf
+    counter64_t sum_us;
+} histogram_t;
+
+// Upper bounds of histogram buckets in microseconds, the same for every histogram
+static const uint32_t bucket_bounds_us[CONFIG_METRICS_BUCKETS] = {
+    1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+};
+
+static const char *call_names[METRICS_CALL_MAX] = {
+    [METRICS_CALL_SET_SOURCE] = "set_source",
+    [METRICS_CALL_RECONFIGURE_FRAME] = "reconfigure_frame",
+    [METRICS_CALL_RECONFIGURE_CAM] = "reconfigure_cam",
+    [METRICS_CALL_START_STREAM] = "start_stream",
+    [METRICS_CALL_STOP_STREAM] = "stop_stream",
+    [METRICS_CALL_GET_SOURCES] = "get_sources",
+    [METRICS_CALL_GET_FRAME] = "get_frame",
+    [METRICS_CALL_GET_CAM] = "get_cam",
+};
+
+static atomic_uint frames_received;
+static atomic_uint frames_publish_dropped;
+static atomic_uint frames_sent;
+static atomic_uint frames_skipped;
+static counter64_t bytes_sent;
+
+static histogram_t get_fb_wait;
+static histogram_t frame_send;
+static histogram_t first_frame;
+static histogram_t control_calls[METRICS_CALL_MAX];
+static atomic_uint control_errors[METRICS_CALL_MAX];
+
+// Milliseconds since boot when reconfiguration started, 0 when nothing is measured
+static atomic_uint reconfigure_start_ms;
+
+static void counter64_add(counter64_t *counter, uint32_t value)
+{
+    uint32_t old = atomic_fetch_add_explicit(&counter->lo, value, memory_order_relaxed);
+    if (old + value < old)
+    {
+        atomic_fetch_add_explicit(&counter->hi, 1, memory_order_relaxed);
+    }
+}
+
+static uint64_t counter64_get(counter64_t *counter)
+{
+    uint32_t hi, lo;
+
+    do
+    {
+        hi = atomic_load_explicit(&counter->hi, memory_order_relaxed);
+        lo = atomic_load_explicit(&counter->lo, memory_order_relaxed);
+    } while (hi != atomic_load_explicit(&counter->hi, memory_order_relaxed));
+
+    uint64_t value = ((uint64_t) hi << 32) | lo;
+    if (value < counter->last)
+    {
+        value += 1ULL << 32;
+    }
+    counter->last = value;
+
+    return value;
+}
+
+static void histogram_observe(histogram_t *histogram, int64_t value_us)
+{
+    uint32_t value = value_us < 0 ? 0 : (value_us > UINT32_MAX ? UINT32_MAX : (uint32_t) value_us);
+
+    int bucket = 0;
+    while (bucket < CONFIG_METRICS_BUCKETS && value > bucket_bounds_us[bucket])
+    {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+    counter64_add(&histogram->sum_us, value);
+}
+
+void metrics_frame_received(int64_t wait_us)
+{
+    atomic_fetch_add_explicit(&frames_received, 1, memory_order_relaxed);
+    histogram_observe(&get_fb_wait, wait_us);
+
+    if (atomic_load_explicit(&reconfigure_start_ms, memory_order_relaxed) != 0)
+    {
+        uint32_t start_ms = atomic_exchange_explicit(&reconfigure_start_ms, 0, memory_order_relaxed);
+        if (start_ms != 0)
+        {
+            uint32_t now_ms = esp_timer_get_time() / 1000;
+            histogram_observe(&first_frame, (int64_t) (now_ms - start_ms) * 1000);
+        }
+    }
+}
+
+uint32_t metrics_get_frames_received(void)
+{
+    return atomic_load_explicit(&frames_received, memory_order_relaxed);
+}
+
+void metrics_frame_publish_dropped(void)
+{
+    atomic_fetch_add_explicit(&frames_publish_dropped, 1, memory_order_relaxed);
+}
+
+void metrics_frame_sent(size_t len, int64_t send_us)
+{
+    atomic_fetch_add_explicit(&frames_sent, 1, memory_order_relaxed);
+    counter64_add(&bytes_sent, len);
+    histogram_observe(&frame_send, send_us);
+}
+
+void metrics_frames_skipped(uint32_t frames)
+{
+    atomic_fetch_add_explicit(&frames_skipped, frames, memory_order_relaxed);
+}
+
+void metrics_control_call(metrics_call_t call, int64_t latency_us, esp_err_t ret)
+{
+    histogram_observe(&control_calls[call], latency_us);
+    if (ret != ESP_OK)
+    {
+        atomic_fetch_add_explicit(&control_errors[call], 1, memory_order_relaxed);
+    }
+}
+
+void metrics_reconfigure_started(void)
+{
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+    atomic_store_explicit(&reconfigure_start_ms, now_ms != 0 ? now_ms : 1, memory_order_relaxed);
+}
+
+// Lines are collected into chunks, so scrape does not cost one socket write per line
+typedef struct
+{
+    httpd_req_t *req;
+    esp_err_t ret;
+    size_t len;
+    char buf[CONFIG_METRICS_CHUNK_LEN];
+} chunk_writer_t;
+
+static void flush(chunk_writer_t *writer)
+{
+    if (writer->len > 0 && writer->ret == ESP_OK)
+    {
+        writer->ret = httpd_resp_send_chunk(writer->req, writer->buf, writer->len);
+    }
+    writer->len = 0;
+}
+
+static void send_line(chunk_writer_t *writer, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void send_line(chunk_writer_t *writer, const char *fmt, ...)
+{
+    if (sizeof(writer->buf) - writer->len < CONFIG_METRICS_LINE_LEN)
+    {
+        flush(writer);
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(writer->buf + writer->len, CONFIG_METRICS_LINE_LEN, fmt, args);
+    va_end(args);
+
+    if (len < 0 || len >= CONFIG_METRICS_LINE_LEN)
+    {
+        ESP_LOGE(TAG, "Metrics line truncated");
+        return;
+    }
+
+    writer->len += len;
+}
+
+static void send_counter(chunk_writer_t *writer, const char *name, const char *help, uint64_t value)
+{
+    send_line(writer, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    send_line(writer, "%s %llu\n", name, (unsigned long long) value);
+}
+
+// Buckets are read one by one without lock, so count may be off by frames recorded during scrape
+static void send_histogram(chunk_writer_t *writer, const char *name, const char *labels, histogram_t *histogram)
+{
+    uint64_t cumulative = 0;
+    const char *sep = labels[0] != '\0' ? "," : "";
+
+    char selector[48] = "";
+    if (labels[0] != '\0')
+    {
+        snprintf(selector, sizeof(selector), "{%s}", labels);
+    }
+
+    for (int i = 0; i <= CONFIG_METRICS_BUCKETS; ++i)
+    {
+        cumulative += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+
+        if (i < CONFIG_METRICS_BUCKETS)
+        {
+            send_line(writer, "%s_bucket{%s%sle=\"%g\"} %llu\n",
+                      name, labels, sep, bucket_bounds_us[i] / 1e6, (unsigned long long) cumulative);
+        }
+        else
+        {
+            send_line(writer, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long) cumulative);
+        }
+    }
+
+    send_line(writer, "%s_sum%s %.6f\n", name, selector, counter64_get(&histogram->sum_us) / 1e6);
+    send_line(writer, "%s_count%s %llu\n", name, selector, (unsigned long long) cumulative);
+}
+
+esp_err_t metrics_send_chunks(httpd_req_t *req)
+{
+    static chunk_writer_t chunk_writer;
+    chunk_writer_t *writer = &chunk_writer;
+
+    // Buffer is static, as it is too big for server task stack. Only server task sends metrics.
+    writer->req = req;
+    writer->ret = ESP_OK;
+    writer->len = 0;
+
+    send_counter(writer, "accessor_frames_received_total", "Frames pulled from ESPFSP client",
+                 atomic_load_explicit(&frames_received, memory_order_relaxed));
+    send_counter(writer, "accessor_frames_publish_dropped_total", "Frames dropped because every slot was in use",
+                 atomic_load_explicit(&frames_publish_dropped, memory_order_relaxed));
+    send_counter(writer, "accessor_frames_sent_total", "Frames sent to all viewers",
+                 atomic_load_explicit(&frames_sent, memory_order_relaxed));
+    send_counter(writer, "accessor_frames_skipped_total", "Frames skipped by viewers to catch up with latest one",
+                 atomic_load_explicit(&frames_skipped, memory_order_relaxed));
+    send_counter(writer, "accessor_bytes_sent_total", "JPEG bytes sent to all viewers", counter64_get(&bytes_sent));
+
+    send_line(writer, "# HELP accessor_get_fb_wait_seconds Time spent waiting in espfsp_client_play_get_fb\n"
+                      "# TYPE accessor_get_fb_wait_seconds histogram\n");
+    send_histogram(writer, "accessor_get_fb_wait_seconds", "", &get_fb_wait);
+
+    send_line(writer, "# HELP accessor_frame_send_seconds Time of writing one frame to viewer socket\n"
+                      "# TYPE accessor_frame_send_seconds histogram\n");
+    send_histogram(writer, "accessor_frame_send_seconds", "", &frame_send);
+
+    send_line(writer, "# HELP accessor_reconfigure_first_frame_seconds Time from reconfiguration to first frame\n"
+                      "# TYPE accessor_reconfigure_first_frame_seconds histogram\n");
+    send_histogram(writer, "accessor_reconfigure_first_frame_seconds", "", &first_frame);
+
+    send_line(writer, "# HELP accessor_control_call_seconds Latency of ESPFSP control calls\n"
+                      "# TYPE accessor_control_call_seconds histogram\n");
+    for (int i = 0; i < METRICS_CALL_MAX; ++i)
+    {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "call=\"%s\"", call_names[i]);
+        send_histogram(writer, "accessor_control_call_seconds", labels, &control_calls[i]);
+    }
+
+    send_line(writer, "# HELP accessor_control_call_errors_total Failed ESPFSP control calls\n"
+                      "# TYPE accessor_control_call_errors_total counter\n");
+    for (int i = 0; i < METRICS_CALL_MAX; ++i)
+    {
+        send_line(writer, "accessor_control_call_errors_total{call=\"%s\"} %u\n",
+                  call_names[i], atomic_load_explicit(&control_errors[i], memory_order_relaxed));
+    }
+
+    flush(writer);
+    return writer->ret;
+}
@@ -0,0 +1,48 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+
+typedef enum
+{
+    METRICS_CALL_SET_SOURCE,
+    METRICS_CALL_RECONFIGURE_FRAME,
+    METRICS_CALL_RECONFIGURE_CAM,
+    METRICS_CALL_START_STREAM,
+    METRICS_CALL_STOP_STREAM,
+    METRICS_CALL_GET_SOURCES,
+    METRICS_CALL_GET_FRAME,
+    METRICS_CALL_GET_CAM,
+    METRICS_CALL_MAX,
+} metrics_call_t;
+
+// Recording functions only use relaxed atomic operations, so they can be called from stream hot paths of any task
+
+void metrics_frame_received(int64_t wait_us);
+void metrics_frame_publish_dropped(void);
+void metrics_frame_sent(size_t len, int64_t send_us);
+void metrics_frames_skipped(uint32_t frames);
+void metrics_control_call(metrics_call_t call, int64_t latency_us, esp_err_t ret);
+
+uint32_t metrics_get_frames_received(void);
+
+// Starts measuring time to first frame received after stream is reconfigured
+void metrics_reconfigure_started(void);
+
+// Runs ESPFSP control call and records its latency and result
+#define METRICS_TIME_CALL(call, expr) ({                                   \
+    int64_t _metrics_start = esp_timer_get_time();                         \
+    esp_err_t _metrics_ret = (expr);                                       \
+    metrics_control_call((call), esp_timer_get_time() - _metrics_start, _metrics_ret); \
+    _metrics_ret;                                                          \
+})
+
+// Sends all metrics in text exposition format as response chunks. Response is not finished, so caller can append
+// its own metrics before sending final chunk.
+esp_err_t metrics_send_chunks(httpd_req_t *req);
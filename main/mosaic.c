@@ -0,0 +1,438 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+#include "stream_writer.h"
+#include "frame_pool.h"
+#include "frame_dispatcher.h"
+#include "source_sessions.h"
+#include "jpeg_transcoder.h"
+#include "mosaic.h"
+
+#define CONFIG_MOSAIC_MAX_VIEWERS 2
+#define CONFIG_MOSAIC_SENDER_STACK_SIZE 4096
+// Below live stream senders, so composing never delays live frames
+#define CONFIG_MOSAIC_SENDER_PRIORITY 4
+
+// Tiles of every viewer, so viewers of the same sources and scale share them
+#define CONFIG_MOSAIC_CACHE_LEN (MOSAIC_MAX_TILES * CONFIG_MOSAIC_MAX_VIEWERS)
+#define CONFIG_MOSAIC_CACHE_MAX_AGE_US (5 * 1000000LL)
+
+// Band for UXGA 4:2:0 at scale 2, as transcoder reserves
+#define CONFIG_MOSAIC_BAND_COEFFICIENTS (2 * 100 * 6 * 16)
+
+// Gray cell costs a few bits per block, so output is given room for one UXGA cell of them besides tiles
+#define CONFIG_MOSAIC_GRAY_CELL_LEN (16 * 1024)
+
+static const char *TAG = "MOSAIC";
+
+typedef struct
+{
+    stream_writer_session_t stream;
+    bool in_use;
+
+    char sources[MOSAIC_MAX_TILES][MOSAIC_SOURCE_NAME_LEN];
+    int count;
+    int cols;
+    uint8_t scale;
+    int64_t frame_interval;
+    int64_t sent_timestamps[MOSAIC_MAX_TILES]; // Frames of last sent mosaic, 0 for gray tile
+} mosaic_viewer_t;
+
+// Source frame transcoded to scale of mosaic. Frames are told apart by dispatcher and reception timestamp.
+typedef struct
+{
+    frame_dispatcher_handle_t dispatcher;
+    int64_t timestamp;
+    uint8_t scale;
+    uint8_t *buf;
+    size_t len;
+    int64_t last_used;
+} mosaic_tile_t;
+
+// Guards viewers and stats
+static SemaphoreHandle_t mutex = NULL;
+
+// Guards transcoder, column tables and tile cache, held for whole composing of one frame
+static SemaphoreHandle_t codec_mutex = NULL;
+static jpeg_transcoder_t *transcoder = NULL;
+static jpeg_reader_tables_t *column_tables = NULL;
+static mosaic_tile_t cache[CONFIG_MOSAIC_CACHE_LEN];
+
+static mosaic_viewer_t viewers[CONFIG_MOSAIC_MAX_VIEWERS];
+static mosaic_stats_t stats;
+
+esp_err_t mosaic_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    codec_mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL || codec_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < CONFIG_MOSAIC_MAX_VIEWERS; ++i)
+    {
+        esp_err_t ret = stream_writer_session_init(&viewers[i].stream);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    // Mosaic is made at few frames per second, so unlike transcoder of stream variants it keeps even Huffman
+    // tables in PSRAM and leaves internal RAM alone
+    transcoder = (jpeg_transcoder_t *) heap_caps_calloc(1, sizeof(jpeg_transcoder_t), MALLOC_CAP_SPIRAM);
+    column_tables = (jpeg_reader_tables_t *) heap_caps_calloc(JPEG_TRANSCODER_MAX_MOSAIC_COLS,
+                                                              sizeof(jpeg_reader_tables_t), MALLOC_CAP_SPIRAM);
+    int16_t *band = (int16_t *) heap_caps_malloc(CONFIG_MOSAIC_BAND_COEFFICIENTS * sizeof(int16_t),
+                                                 MALLOC_CAP_SPIRAM);
+    if (transcoder == NULL || column_tables == NULL || band == NULL)
+    {
+        ESP_LOGW(TAG, "Mosaic buffers allocation failed, mosaic is disabled");
+        heap_caps_free(transcoder);
+        heap_caps_free(column_tables);
+        heap_caps_free(band);
+        transcoder = NULL;
+        column_tables = NULL;
+        return ESP_OK;
+    }
+    jpeg_transcoder_init(transcoder, band, CONFIG_MOSAIC_BAND_COEFFICIENTS);
+
+    return ESP_OK;
+}
+
+static void drop_tile(mosaic_tile_t *tile)
+{
+    frame_pool_free(tile->buf);
+    memset(tile, 0, sizeof(*tile));
+}
+
+// Has to be called with codec mutex taken. Returns NULL when frame can not be transcoded, so tile is left gray.
+static const mosaic_tile_t *get_tile(frame_dispatcher_handle_t dispatcher, const frame_snapshot_t *snapshot,
+                                     uint8_t scale, int64_t now, bool *cached)
+{
+    *cached = false;
+
+    mosaic_tile_t *slot = NULL;
+    for (int i = 0; i < CONFIG_MOSAIC_CACHE_LEN; ++i)
+    {
+        mosaic_tile_t *tile = &cache[i];
+        if (tile->buf != NULL && tile->dispatcher == dispatcher && tile->scale == scale)
+        {
+            if (tile->timestamp == snapshot->timestamp)
+            {
+                tile->last_used = now;
+                *cached = true;
+                return tile;
+            }
+            // Older frame of the same source is replaced
+            slot = tile;
+        }
+        else if (slot == NULL && tile->buf == NULL)
+        {
+            slot = tile;
+        }
+    }
+    for (int i = 0; slot == NULL && i < CONFIG_MOSAIC_CACHE_LEN; ++i)
+    {
+        slot = slot == NULL || cache[i].last_used < slot->last_used ? &cache[i] : slot;
+    }
+
+    size_t capacity = snapshot->len + snapshot->len / 8 + 1024;
+    uint8_t *scratch = frame_pool_alloc(capacity);
+    if (scratch == NULL)
+    {
+        return NULL;
+    }
+
+    jpeg_transcode_params_t params = { .scale = scale, .quality = 0 };
+    size_t len = 0;
+    jpeg_transcode_result_t ret = jpeg_transcode(transcoder, snapshot->buf, snapshot->len, &params, scratch,
+                                                 capacity, &len);
+    // Tile is kept only in as much as it needs
+    uint8_t *buf = ret == JPEG_TRANSCODE_OK ? frame_pool_alloc(len) : NULL;
+    if (buf != NULL)
+    {
+        memcpy(buf, scratch, len);
+    }
+    frame_pool_free(scratch);
+
+    if (buf == NULL)
+    {
+        ESP_LOGD(TAG, "Tile to scale %u failed: %d", scale, ret);
+        return NULL;
+    }
+
+    if (slot->buf != NULL)
+    {
+        drop_tile(slot);
+    }
+    slot->dispatcher = dispatcher;
+    slot->timestamp = snapshot->timestamp;
+    slot->scale = scale;
+    slot->buf = buf;
+    slot->len = len;
+    slot->last_used = now;
+
+    return slot;
+}
+
+// Has to be called with codec mutex taken
+static void drop_stale_tiles(int64_t now)
+{
+    for (int i = 0; i < CONFIG_MOSAIC_CACHE_LEN; ++i)
+    {
+        if (cache[i].buf != NULL && now - cache[i].last_used > CONFIG_MOSAIC_CACHE_MAX_AGE_US)
+        {
+            drop_tile(&cache[i]);
+        }
+    }
+}
+
+// Gives composed frame in frame pool buffer, or NULL when no source has new frame since last one sent or none can
+// be read
+static uint8_t *compose(mosaic_viewer_t *viewer, size_t *out_len)
+{
+    frame_dispatcher_handle_t dispatchers[MOSAIC_MAX_TILES] = {0};
+    frame_snapshot_t *snapshots[MOSAIC_MAX_TILES] = {0};
+    bool changed = false;
+
+    // Sources are held only while snapshots are taken, which stay valid after session is closed
+    for (int i = 0; i < viewer->count; ++i)
+    {
+        if (source_sessions_acquire(viewer->sources[i], &dispatchers[i]) != ESP_OK)
+        {
+            dispatchers[i] = NULL;
+        }
+        else
+        {
+            if (frame_dispatcher_get_snapshot(dispatchers[i], &snapshots[i]) != ESP_OK)
+            {
+                snapshots[i] = NULL;
+            }
+            source_sessions_release(dispatchers[i]);
+        }
+
+        int64_t timestamp = snapshots[i] != NULL ? snapshots[i]->timestamp : 0;
+        changed = changed || timestamp != viewer->sent_timestamps[i];
+        viewer->sent_timestamps[i] = timestamp;
+    }
+
+    uint8_t *out = NULL;
+    if (changed)
+    {
+        int64_t start = esp_timer_get_time();
+        jpeg_mosaic_tile_t tiles[MOSAIC_MAX_TILES] = {0};
+        uint32_t tiles_transcoded = 0;
+        uint32_t tiles_cached = 0;
+        size_t capacity = 1024 + viewer->count * CONFIG_MOSAIC_GRAY_CELL_LEN;
+
+        xSemaphoreTake(codec_mutex, portMAX_DELAY);
+        drop_stale_tiles(start);
+        for (int i = 0; i < viewer->count; ++i)
+        {
+            if (snapshots[i] == NULL)
+            {
+                continue;
+            }
+
+            if (viewer->scale == 1)
+            {
+                tiles[i].buf = snapshots[i]->buf;
+                tiles[i].len = snapshots[i]->len;
+            }
+            else
+            {
+                bool cached;
+                const mosaic_tile_t *tile = get_tile(dispatchers[i], snapshots[i], viewer->scale, start, &cached);
+                tiles_transcoded += tile != NULL && !cached;
+                tiles_cached += cached;
+                tiles[i].buf = tile != NULL ? tile->buf : NULL;
+                tiles[i].len = tile != NULL ? tile->len : 0;
+            }
+            // Tiles are requantized to tables of first one, which can take more bytes than they had
+            capacity += tiles[i].len + tiles[i].len / 8;
+        }
+
+        out = frame_pool_alloc(capacity);
+        jpeg_transcode_result_t ret = JPEG_TRANSCODE_TOO_LARGE;
+        if (out != NULL)
+        {
+            ret = jpeg_transcode_mosaic(transcoder, column_tables, tiles, viewer->count, viewer->cols, out,
+                                        capacity, out_len);
+        }
+        xSemaphoreGive(codec_mutex);
+
+        if (ret != JPEG_TRANSCODE_OK)
+        {
+            // No tile could be read, which is normal until sources send their first frames
+            if (ret != JPEG_TRANSCODE_UNSUPPORTED)
+            {
+                ESP_LOGW(TAG, "Composing mosaic failed: %d", ret);
+            }
+            frame_pool_free(out);
+            out = NULL;
+        }
+
+        int64_t compose_time = esp_timer_get_time() - start;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.tiles_transcoded += tiles_transcoded;
+        stats.tiles_cached += tiles_cached;
+        if (out != NULL)
+        {
+            stats.frames_composed++;
+            // Moving average over about 16 frames
+            stats.compose_us = stats.compose_us - stats.compose_us / 16 + compose_time / 16;
+        }
+        else if (ret != JPEG_TRANSCODE_UNSUPPORTED)
+        {
+            stats.frames_failed++;
+        }
+        xSemaphoreGive(mutex);
+    }
+
+    for (int i = 0; i < viewer->count; ++i)
+    {
+        if (snapshots[i] != NULL)
+        {
+            frame_dispatcher_release_snapshot(snapshots[i]);
+        }
+    }
+
+    return out;
+}
+
+static void sender_task(void *pvParameters)
+{
+    mosaic_viewer_t *viewer = (mosaic_viewer_t *) pvParameters;
+    stream_writer_session_t *stream = &viewer->stream;
+    uint32_t frames_sent = 0;
+
+    stream_writer_session_attach(stream);
+
+    esp_err_t ret = stream_writer_session_mjpeg_begin(stream);
+    int64_t next_due = esp_timer_get_time();
+
+    while (ret == ESP_OK && stream_writer_session_wait_until(stream, next_due))
+    {
+        // Late frame is not made up for, so slow composing lowers frame rate instead of bursting
+        next_due += viewer->frame_interval;
+        int64_t now = esp_timer_get_time();
+        next_due = next_due < now ? now + viewer->frame_interval : next_due;
+
+        size_t len = 0;
+        uint8_t *buf = compose(viewer, &len);
+        if (buf == NULL)
+        {
+            continue;
+        }
+
+        ret = stream_writer_session_mjpeg_send_part(stream, buf, len);
+
+        frame_pool_free(buf);
+        frames_sent++;
+    }
+
+    ESP_LOGI(TAG, "Mosaic finished: sent %lu frames", (unsigned long) frames_sent);
+
+    stream_writer_session_finish(stream);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    viewer->in_use = false;
+    stats.viewers--;
+    xSemaphoreGive(mutex);
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t mosaic_add_viewer(httpd_req_t *req, const char (*sources)[MOSAIC_SOURCE_NAME_LEN], int count, int cols,
+                            uint8_t scale, uint8_t fps)
+{
+    mosaic_viewer_t *viewer = NULL;
+
+    if (transcoder == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (count < 1 || count > MOSAIC_MAX_TILES || cols < 1 || cols > JPEG_TRANSCODER_MAX_MOSAIC_COLS ||
+        (scale != 1 && scale != 2 && scale != 4 && scale != 8) || fps == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOSAIC_MAX_VIEWERS; ++i)
+    {
+        if (!viewers[i].in_use)
+        {
+            viewer = &viewers[i];
+            viewer->in_use = true;
+            stats.viewers++;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    if (viewer == NULL)
+    {
+        ESP_LOGE(TAG, "No free mosaic viewer slot");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(viewer->sources, sources, count * MOSAIC_SOURCE_NAME_LEN);
+    viewer->count = count;
+    viewer->cols = cols;
+    viewer->scale = scale;
+    viewer->frame_interval = 1000000 / fps;
+    memset(viewer->sent_timestamps, 0, sizeof(viewer->sent_timestamps));
+
+    esp_err_t ret = stream_writer_session_start(&viewer->stream, req, sender_task, "mosaic_sender",
+                                                CONFIG_MOSAIC_SENDER_STACK_SIZE, CONFIG_MOSAIC_SENDER_PRIORITY,
+                                                viewer);
+    if (ret != ESP_OK)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        viewer->in_use = false;
+        stats.viewers--;
+        xSemaphoreGive(mutex);
+    }
+
+    return ret;
+}
+
+void mosaic_close_socket(int fd)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOSAIC_MAX_VIEWERS; ++i)
+    {
+        if (viewers[i].in_use && viewers[i].stream.fd == fd)
+        {
+            stream_writer_session_close(&viewers[i].stream);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void mosaic_get_stats(mosaic_stats_t *stats_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->available = transcoder != NULL;
+    xSemaphoreGive(mutex);
+}
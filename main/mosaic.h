@@ -0,0 +1,42 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define MOSAIC_MAX_TILES 4
+#define MOSAIC_SOURCE_NAME_LEN 30
+
+typedef struct
+{
+    bool available;
+    int viewers;
+    uint32_t frames_composed;
+    uint32_t frames_failed;
+    uint32_t tiles_transcoded;
+    uint32_t tiles_cached; // Tiles reused from cache, frame of source did not change since it was transcoded
+    uint32_t compose_us; // Averaged over recent frames, transcoding of tiles included
+} mosaic_stats_t;
+
+// Reserves transcoder and tables for tiles. Mosaic is disabled, not failed, when they can not be reserved.
+esp_err_t mosaic_init(void);
+
+// Takes over request as asynchronous one and streams as MJPEG, from separate task, latest frames of given sources
+// laid out 'cols' in a row, each scaled down by scale (1, 2, 4 or 8), at most fps times per second. Sources are
+// held only while their frames are taken, so session of source that went away is opened again on next frame.
+// Returns ESP_ERR_NOT_SUPPORTED when mosaic is disabled and ESP_ERR_NO_MEM when every viewer slot is taken.
+esp_err_t mosaic_add_viewer(httpd_req_t *req, const char (*sources)[MOSAIC_SOURCE_NAME_LEN], int count, int cols,
+                            uint8_t scale, uint8_t fps);
+
+// Has to be called from server close callback before socket is closed, so no mosaic writes to it afterwards
+void mosaic_close_socket(int fd);
+
+void mosaic_get_stats(mosaic_stats_t *stats);
@@ -0,0 +1,572 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdio.h"
+#include "sys/time.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+#include "stream_writer.h"
+#include "frame_pool.h"
+#include "frame_sampler.h"
+#include "motion.h"
+
+// Luminance map of UXGA frame, the largest camera gives
+#define CONFIG_MOTION_MAX_CELLS (200 * 150)
+#define CONFIG_MOTION_MAX_FPS 15
+
+#define CONFIG_MOTION_DEFAULT_SENSITIVITY 60
+#define CONFIG_MOTION_DEFAULT_MIN_AREA_PERMILLE 20
+#define CONFIG_MOTION_DEFAULT_LEARN_SHIFT 5
+
+// Motion starts after this many frames in a row with changed zone, and ends after this long without one
+#define CONFIG_MOTION_TRIGGER_FRAMES 2
+#define CONFIG_MOTION_HOLD_MS 3000
+
+#define CONFIG_MOTION_EVENTS_LEN 32
+#define CONFIG_MOTION_MAX_SUBSCRIBERS 4
+// Comment line sent to idle subscribers, so closed connections are found and proxies keep them open
+#define CONFIG_MOTION_KEEPALIVE_MS 15000
+#define CONFIG_MOTION_SSE_EVENT_LEN 192
+
+#define CONFIG_MOTION_TASK_STACK_SIZE 3072
+// Below every sender and recorder, detection only uses time left over
+#define CONFIG_MOTION_TASK_PRIORITY 2
+
+static const char *TAG = "MOTION";
+
+static const char subscriber_head[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "retry: 3000\n\n";
+
+// Written by detector task and subscribing request. Slot is released only by detector task.
+typedef struct
+{
+    stream_writer_session_t stream;
+    bool in_use;
+    bool ready; // Head and missed events are sent
+    volatile bool failed;
+    bool finished; // Response is ended, slot waits only for close callbacks
+    int closing; // Close callbacks still using session, slot is not released until they are done
+} motion_subscriber_t;
+
+// Guards pending frame, config, state, events and subscriber slots, never held while writing to socket
+static SemaphoreHandle_t mutex = NULL;
+static TaskHandle_t task = NULL;
+static bool available = false;
+static volatile bool enabled = false;
+static volatile bool reset_model = false;
+
+// Frame waiting for detector, at most one
+static uint8_t *pending_buf = NULL;
+static size_t pending_len = 0;
+static frame_sampler_t sampler;
+
+// Owned by detector task
+static motion_dc_decoder_t *decoder = NULL;
+static motion_dc_map_t map;
+static motion_model_t model;
+static int trigger_frames = 0;
+static int64_t last_trigger = 0;
+static uint32_t motion_zone_mask = 0;
+static uint16_t motion_score_permille = 0;
+
+static motion_config_t config = {
+    .sensitivity = CONFIG_MOTION_DEFAULT_SENSITIVITY,
+    .min_area_permille = CONFIG_MOTION_DEFAULT_MIN_AREA_PERMILLE,
+    .learn_shift = CONFIG_MOTION_DEFAULT_LEARN_SHIFT,
+    .zones_count = 0,
+};
+
+static motion_event_t events[CONFIG_MOTION_EVENTS_LEN];
+static uint32_t next_event_id = 1;
+static motion_subscriber_t subscribers[CONFIG_MOTION_MAX_SUBSCRIBERS];
+static motion_stats_t stats;
+
+static int64_t wall_clock_us(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+int motion_format_event(const motion_event_t *event, char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "{\"id\": %lu, \"type\": \"%s\", \"timestamp\": %.3f, \"zones\": %lu, \"score\": %.3f}",
+                    (unsigned long) event->id, event->type == MOTION_EVENT_START ? "start" : "end",
+                    event->timestamp / 1000000.0, (unsigned long) event->zone_mask,
+                    event->score_permille / 1000.0);
+}
+
+static int format_sse_event(const motion_event_t *event, char *buf)
+{
+    int len = snprintf(buf, CONFIG_MOTION_SSE_EVENT_LEN, "id: %lu\nevent: motion\ndata: ", (unsigned long) event->id);
+    len += motion_format_event(event, buf + len, CONFIG_MOTION_SSE_EVENT_LEN - len - 2);
+    buf[len++] = '\n';
+    buf[len++] = '\n';
+
+    return len;
+}
+
+// Sends event, or comment when there is no event, to every subscriber that got its missed events already
+static void send_to_subscribers(const motion_event_t *event, const char *comment)
+{
+    motion_subscriber_t *ready[CONFIG_MOTION_MAX_SUBSCRIBERS];
+    int ready_count = 0;
+
+    char buf[CONFIG_MOTION_SSE_EVENT_LEN];
+    size_t len = event != NULL ? format_sse_event(event, buf) : strlen(comment);
+    const char *text = event != NULL ? buf : comment;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOTION_MAX_SUBSCRIBERS; ++i)
+    {
+        if (subscribers[i].in_use && subscribers[i].ready && !subscribers[i].failed)
+        {
+            ready[ready_count++] = &subscribers[i];
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    for (int i = 0; i < ready_count; ++i)
+    {
+        if (stream_writer_session_send(&ready[i]->stream, text, len) != ESP_OK)
+        {
+            ready[i]->failed = true;
+        }
+    }
+}
+
+// Ends responses of subscribers that could not be written to. Only detector task releases slots.
+static void release_failed_subscribers(void)
+{
+    for (int i = 0; i < CONFIG_MOTION_MAX_SUBSCRIBERS; ++i)
+    {
+        motion_subscriber_t *subscriber = &subscribers[i];
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        bool release = subscriber->in_use && subscriber->failed;
+        xSemaphoreGive(mutex);
+        if (!release)
+        {
+            continue;
+        }
+
+        // Waits for subscribing request to finish sending missed events
+        if (!subscriber->finished)
+        {
+            stream_writer_session_finish(&subscriber->stream);
+            subscriber->finished = true;
+        }
+
+        // Slot is released on later pass when close callback is still using it, it notifies task when done
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        if (subscriber->closing == 0)
+        {
+            subscriber->in_use = false;
+            subscriber->ready = false;
+            stats.subscribers--;
+        }
+        xSemaphoreGive(mutex);
+    }
+}
+
+static void emit_event(motion_event_type_t type, uint32_t zone_mask, uint16_t score_permille)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    motion_event_t *event = &events[next_event_id % CONFIG_MOTION_EVENTS_LEN];
+    event->id = next_event_id++;
+    event->type = type;
+    event->timestamp = wall_clock_us();
+    event->zone_mask = zone_mask;
+    event->score_permille = score_permille;
+    motion_event_t copy = *event;
+    stats.active = type == MOTION_EVENT_START;
+    stats.events++;
+    xSemaphoreGive(mutex);
+
+    ESP_LOGI(TAG, "Motion %s: zones 0x%lx, score %u", type == MOTION_EVENT_START ? "started" : "ended",
+             (unsigned long) zone_mask, score_permille);
+    send_to_subscribers(&copy, NULL);
+}
+
+// Motion ends once no zone changed for hold time, checked also when frames stop coming
+static void check_hold(int64_t now)
+{
+    if (stats.active && now - last_trigger > CONFIG_MOTION_HOLD_MS * 1000LL)
+    {
+        emit_event(MOTION_EVENT_END, motion_zone_mask, motion_score_permille);
+        motion_zone_mask = 0;
+        motion_score_permille = 0;
+    }
+}
+
+static void analyze_frame(const uint8_t *buf, size_t len)
+{
+    if (reset_model)
+    {
+        model.initialized = false;
+        reset_model = false;
+    }
+
+    int64_t start = esp_timer_get_time();
+    motion_dc_result_t ret = motion_dc_decode(decoder, buf, len, &map);
+    int64_t decoded = esp_timer_get_time();
+
+    if (ret != MOTION_DC_OK)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.frames_unsupported++;
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    motion_config_t frame_config = config;
+    xSemaphoreGive(mutex);
+
+    motion_result_t result;
+    motion_model_update(&model, &map, &frame_config, &result);
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    stats.frames_analyzed++;
+    stats.cols = map.cols;
+    stats.rows = map.rows;
+    stats.zone_mask = result.zone_mask;
+    stats.score_permille = result.score_permille;
+    // Moving average over about 16 frames
+    stats.decode_us = stats.decode_us - stats.decode_us / 16 + (decoded - start) / 16;
+    stats.model_us = stats.model_us - stats.model_us / 16 + (now - decoded) / 16;
+    xSemaphoreGive(mutex);
+
+    if (result.zone_mask == 0)
+    {
+        trigger_frames = 0;
+        if (!stats.active)
+        {
+            // Single changed frame, like noise, is forgotten
+            motion_zone_mask = 0;
+            motion_score_permille = 0;
+        }
+        check_hold(now);
+        return;
+    }
+
+    last_trigger = now;
+    motion_zone_mask |= result.zone_mask;
+    motion_score_permille = result.score_permille > motion_score_permille ? result.score_permille :
+                                                                           motion_score_permille;
+    if (!stats.active && ++trigger_frames >= CONFIG_MOTION_TRIGGER_FRAMES)
+    {
+        emit_event(MOTION_EVENT_START, result.zone_mask, result.score_permille);
+    }
+}
+
+static void detector_task(void *pvParameters)
+{
+    int64_t last_keepalive = esp_timer_get_time();
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(stats.active ? CONFIG_MOTION_HOLD_MS : CONFIG_MOTION_KEEPALIVE_MS));
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        uint8_t *buf = pending_buf;
+        size_t len = pending_len;
+        pending_buf = NULL;
+        xSemaphoreGive(mutex);
+
+        if (buf != NULL)
+        {
+            analyze_frame(buf, len);
+            frame_pool_free(buf);
+        }
+
+        int64_t now = esp_timer_get_time();
+        check_hold(now);
+        if (now - last_keepalive >= CONFIG_MOTION_KEEPALIVE_MS * 1000LL)
+        {
+            send_to_subscribers(NULL, ": keepalive\n\n");
+            last_keepalive = now;
+        }
+        release_failed_subscribers();
+    }
+}
+
+esp_err_t motion_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < CONFIG_MOTION_MAX_SUBSCRIBERS; ++i)
+    {
+        esp_err_t ret = stream_writer_session_init(&subscribers[i].stream);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    // Huffman tables are looked up for every coefficient, so they stay in internal RAM. Map and background are
+    // walked in order and can live in PSRAM.
+    decoder = (motion_dc_decoder_t *) heap_caps_calloc(1, sizeof(motion_dc_decoder_t), MALLOC_CAP_DEFAULT);
+    map.luma = (uint8_t *) heap_caps_malloc(CONFIG_MOTION_MAX_CELLS, MALLOC_CAP_SPIRAM);
+    model.background = (uint16_t *) heap_caps_malloc(CONFIG_MOTION_MAX_CELLS * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (decoder == NULL || map.luma == NULL || model.background == NULL)
+    {
+        ESP_LOGW(TAG, "Detector buffers allocation failed, motion detection is disabled");
+        return ESP_OK;
+    }
+    map.capacity = CONFIG_MOTION_MAX_CELLS;
+    model.capacity = CONFIG_MOTION_MAX_CELLS;
+
+    BaseType_t xStatus = xTaskCreate(
+        detector_task,
+        "motion_detector",
+        CONFIG_MOTION_TASK_STACK_SIZE,
+        NULL,
+        CONFIG_MOTION_TASK_PRIORITY,
+        &task);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Detector task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    available = true;
+    enabled = true;
+    return ESP_OK;
+}
+
+void motion_add_frame(const uint8_t *buf, size_t len)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    if (!frame_sampler_take(&sampler, esp_timer_get_time(), CONFIG_MOTION_MAX_FPS))
+    {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool busy = pending_buf != NULL;
+    xSemaphoreGive(mutex);
+
+    // Frame is copied only when detector can take it, so busy detector costs producer nothing
+    uint8_t *copy = busy ? NULL : frame_pool_alloc(len);
+    if (copy == NULL)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.frames_skipped++;
+        xSemaphoreGive(mutex);
+        return;
+    }
+    memcpy(copy, buf, len);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pending_buf = copy;
+    pending_len = len;
+    xSemaphoreGive(mutex);
+
+    xTaskNotifyGive(task);
+}
+
+void motion_set_enabled(bool enable)
+{
+    if (!available)
+    {
+        return;
+    }
+
+    // Background is learned again from first frame after detection is back on
+    reset_model = true;
+    enabled = enable;
+}
+
+void motion_get_config(motion_config_t *config_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *config_out = config;
+    xSemaphoreGive(mutex);
+}
+
+esp_err_t motion_set_config(const motion_config_t *new_config)
+{
+    if (new_config->sensitivity < 1 || new_config->sensitivity > 100 || new_config->min_area_permille > 1000 ||
+        new_config->learn_shift > 12 || new_config->zones_count < 0 ||
+        new_config->zones_count > MOTION_DETECTOR_MAX_ZONES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < new_config->zones_count; ++i)
+    {
+        const motion_zone_t *zone = &new_config->zones[i];
+        if (zone->w == 0 || zone->h == 0 || zone->x + zone->w > 100 || zone->y + zone->h > 100)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    config = *new_config;
+    xSemaphoreGive(mutex);
+
+    return ESP_OK;
+}
+
+int motion_get_events(uint32_t after_id, motion_event_t *events_out, int max_events)
+{
+    int count = 0;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t first_id = next_event_id > CONFIG_MOTION_EVENTS_LEN ? next_event_id - CONFIG_MOTION_EVENTS_LEN : 1;
+    for (uint32_t id = after_id + 1 > first_id ? after_id + 1 : first_id; id < next_event_id && count < max_events;
+         ++id)
+    {
+        events_out[count++] = events[id % CONFIG_MOTION_EVENTS_LEN];
+    }
+    xSemaphoreGive(mutex);
+
+    return count;
+}
+
+esp_err_t motion_add_subscriber(httpd_req_t *req, uint32_t last_event_id)
+{
+    if (!available)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    motion_subscriber_t *subscriber = NULL;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOTION_MAX_SUBSCRIBERS; ++i)
+    {
+        if (!subscribers[i].in_use)
+        {
+            subscriber = &subscribers[i];
+            subscriber->in_use = true;
+            subscriber->ready = false;
+            subscriber->failed = false;
+            subscriber->finished = false;
+            subscriber->closing = 0;
+            stats.subscribers++;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    if (subscriber == NULL)
+    {
+        ESP_LOGE(TAG, "No free subscriber slot");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = stream_writer_session_begin(&subscriber->stream, req);
+    if (ret != ESP_OK)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        subscriber->in_use = false;
+        stats.subscribers--;
+        xSemaphoreGive(mutex);
+        return ret;
+    }
+
+    // Subscriber becomes ready with session locked, so events emitted from now on wait until head and events
+    // emitted before are sent
+    bool failed = !stream_writer_session_lock(&subscriber->stream);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t end_id = next_event_id;
+    subscriber->ready = true;
+    xSemaphoreGive(mutex);
+
+    httpd_req_t *async_req = subscriber->stream.req;
+    failed = failed || stream_writer_send(async_req, subscriber_head, sizeof(subscriber_head) - 1) != ESP_OK;
+    uint32_t id = last_event_id + 1;
+    while (!failed)
+    {
+        motion_event_t event;
+        if (motion_get_events(id - 1, &event, 1) != 1 || event.id >= end_id)
+        {
+            break;
+        }
+        char buf[CONFIG_MOTION_SSE_EVENT_LEN];
+        failed = stream_writer_send(async_req, buf, format_sse_event(&event, buf)) != ESP_OK;
+        id = event.id + 1;
+    }
+    stream_writer_session_unlock(&subscriber->stream);
+
+    if (failed)
+    {
+        subscriber->failed = true;
+        xTaskNotifyGive(task);
+    }
+
+    return ESP_OK;
+}
+
+void motion_close_socket(int fd)
+{
+    motion_subscriber_t *subscriber = NULL;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOTION_MAX_SUBSCRIBERS; ++i)
+    {
+        if (subscribers[i].in_use && subscribers[i].stream.fd == fd)
+        {
+            subscriber = &subscribers[i];
+            subscriber->failed = true;
+            subscriber->closing++;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    // Mutex is not held, as subscribing request takes it with session locked
+    if (subscriber != NULL)
+    {
+        stream_writer_session_close(&subscriber->stream);
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        subscriber->closing--;
+        xSemaphoreGive(mutex);
+    }
+
+    if (task != NULL)
+    {
+        xTaskNotifyGive(task);
+    }
+}
+
+void motion_get_stats(motion_stats_t *stats_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->enabled = enabled;
+    xSemaphoreGive(mutex);
+}
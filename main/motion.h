@@ -0,0 +1,76 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#include "motion_detector.h"
+
+typedef enum
+{
+    MOTION_EVENT_START,
+    MOTION_EVENT_END,
+} motion_event_type_t;
+
+typedef struct
+{
+    uint32_t id; // Grows by one with every event, starting from 1
+    motion_event_type_t type;
+    int64_t timestamp; // Wall clock time in microseconds, the same clock recordings are indexed by
+    uint32_t zone_mask; // Zones that triggered, for end event all of them during motion
+    uint16_t score_permille; // For end event highest one during motion
+} motion_event_t;
+
+typedef struct
+{
+    bool enabled;
+    bool active;
+    uint32_t zone_mask;
+    uint16_t score_permille;
+    uint16_t cols; // Luminance map size of last frame
+    uint16_t rows;
+    uint32_t frames_analyzed;
+    uint32_t frames_skipped; // Detector still busy with previous frame
+    uint32_t frames_unsupported;
+    uint32_t decode_us; // Averaged over recent frames
+    uint32_t model_us;
+    uint32_t events;
+    int subscribers;
+} motion_stats_t;
+
+// Reserves luminance map and background model and starts detector task. Detection is disabled, not failed, when
+// they can not be reserved.
+esp_err_t motion_init(void);
+
+// Hands received frame to detector task, unless it is still busy with previous one. Never blocks.
+void motion_add_frame(const uint8_t *buf, size_t len);
+
+void motion_set_enabled(bool enabled);
+
+void motion_get_config(motion_config_t *config);
+
+// ESP_ERR_INVALID_ARG when zones do not fit in frame or values are out of range
+esp_err_t motion_set_config(const motion_config_t *config);
+
+// Copies up to max_events kept events newer than after_id, oldest first, and returns their number
+int motion_get_events(uint32_t after_id, motion_event_t *events, int max_events);
+
+// Formats event as JSON object
+int motion_format_event(const motion_event_t *event, char *buf, size_t len);
+
+// Takes over request as asynchronous one and sends events as Server-Sent Events from detector task. Kept events
+// newer than last_event_id are sent first, so reconnecting client misses nothing still kept.
+esp_err_t motion_add_subscriber(httpd_req_t *req, uint32_t last_event_id);
+
+// Has to be called from server close callback before socket is closed, so no event is written to it afterwards
+void motion_close_socket(int fd);
+
+void motion_get_stats(motion_stats_t *stats);
@@ -0,0 +1,182 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "motion_detector.h"
+
+static motion_dc_result_t from_reader_result(jpeg_reader_result_t result)
+{
+    return result == JPEG_READER_UNSUPPORTED ? MOTION_DC_UNSUPPORTED : MOTION_DC_CORRUPT;
+}
+
+motion_dc_result_t motion_dc_decode(motion_dc_decoder_t *decoder, const uint8_t *buf, size_t len,
+                                    motion_dc_map_t *map)
+{
+    jpeg_scan_t scan;
+    jpeg_reader_result_t ret = jpeg_reader_begin(&decoder->tables, buf, len, &scan);
+    if (ret != JPEG_READER_OK)
+    {
+        return from_reader_result(ret);
+    }
+
+    // Luminance is first component of scan. Its blocks beyond frame edge only pad MCUs and are not kept.
+    jpeg_component_t *luma = &scan.components[0];
+    uint32_t luma_width = ((uint32_t) scan.width * luma->h + scan.h_max - 1) / scan.h_max;
+    uint32_t luma_height = ((uint32_t) scan.height * luma->v + scan.v_max - 1) / scan.v_max;
+    uint16_t cols = (luma_width + 7) / 8;
+    uint16_t rows = (luma_height + 7) / 8;
+    if ((size_t) cols * rows > map->capacity)
+    {
+        return MOTION_DC_TOO_LARGE;
+    }
+    map->cols = cols;
+    map->rows = rows;
+
+    int32_t luma_quant = decoder->tables.quant[luma->tq][0];
+
+    for (uint32_t mcu_y = 0; mcu_y < scan.mcu_rows; ++mcu_y)
+    {
+        for (uint32_t mcu_x = 0; mcu_x < scan.mcu_cols; ++mcu_x)
+        {
+            if (!jpeg_reader_start_mcu(&scan))
+            {
+                return MOTION_DC_CORRUPT;
+            }
+
+            for (int c = 0; c < scan.components_count; ++c)
+            {
+                jpeg_component_t *component = &scan.components[c];
+                for (int by = 0; by < component->v; ++by)
+                {
+                    for (int bx = 0; bx < component->h; ++bx)
+                    {
+                        int32_t dc;
+                        if (!jpeg_reader_decode_dc(&scan, component, &dc))
+                        {
+                            return MOTION_DC_CORRUPT;
+                        }
+
+                        if (component == luma)
+                        {
+                            uint32_t x = mcu_x * component->h + bx;
+                            uint32_t y = mcu_y * component->v + by;
+                            if (x < cols && y < rows)
+                            {
+                                // DC coefficient is 8 times mean of level shifted samples
+                                int32_t value = dc * luma_quant / 8 + 128;
+                                map->luma[y * cols + x] = value < 0 ? 0 : (value > 255 ? 255 : value);
+                            }
+                        }
+
+                        if (!jpeg_reader_skip_ac(&scan, component))
+                        {
+                            return MOTION_DC_CORRUPT;
+                        }
+                    }
+                }
+            }
+
+            if (!jpeg_reader_end_mcu(&scan))
+            {
+                return MOTION_DC_CORRUPT;
+            }
+        }
+    }
+
+    return MOTION_DC_OK;
+}
+
+void motion_model_update(motion_model_t *model, const motion_dc_map_t *map, const motion_config_t *config,
+                         motion_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    size_t cells = (size_t) map->cols * map->rows;
+    if (cells == 0 || cells > model->capacity)
+    {
+        model->initialized = false;
+        return;
+    }
+
+    if (!model->initialized || model->cols != map->cols || model->rows != map->rows)
+    {
+        for (size_t i = 0; i < cells; ++i)
+        {
+            model->background[i] = map->luma[i] << 8;
+        }
+        model->cols = map->cols;
+        model->rows = map->rows;
+        model->initialized = true;
+        return;
+    }
+
+    // Exposure change moves every block the same way, so it is taken out and only local change is left
+    int64_t sum = 0;
+    for (size_t i = 0; i < cells; ++i)
+    {
+        sum += (map->luma[i] << 8) - model->background[i];
+    }
+    int32_t global_shift = sum / (int64_t) cells;
+    result->global_shift = global_shift / 256;
+
+    int sensitivity = config->sensitivity < 1 ? 1 : (config->sensitivity > 100 ? 100 : config->sensitivity);
+    int32_t threshold = (2 + (100 - sensitivity) * 62 / 99) << 8;
+
+    motion_zone_t whole_frame = { .x = 0, .y = 0, .w = 100, .h = 100 };
+    const motion_zone_t *zones = config->zones_count > 0 ? config->zones : &whole_frame;
+    int zones_count = config->zones_count > 0 ? config->zones_count : 1;
+
+    uint16_t x0[MOTION_DETECTOR_MAX_ZONES], x1[MOTION_DETECTOR_MAX_ZONES];
+    uint16_t y0[MOTION_DETECTOR_MAX_ZONES], y1[MOTION_DETECTOR_MAX_ZONES];
+    uint32_t changed[MOTION_DETECTOR_MAX_ZONES] = {0};
+    for (int z = 0; z < zones_count; ++z)
+    {
+        x0[z] = zones[z].x * map->cols / 100;
+        x1[z] = (zones[z].x + zones[z].w) * map->cols / 100;
+        y0[z] = zones[z].y * map->rows / 100;
+        y1[z] = (zones[z].y + zones[z].h) * map->rows / 100;
+        // Zone smaller than block still covers one
+        x1[z] = x1[z] > x0[z] ? (x1[z] < map->cols ? x1[z] : map->cols) : x0[z] + 1;
+        y1[z] = y1[z] > y0[z] ? (y1[z] < map->rows ? y1[z] : map->rows) : y0[z] + 1;
+    }
+
+    for (uint16_t y = 0; y < map->rows; ++y)
+    {
+        const uint8_t *luma = map->luma + (size_t) y * map->cols;
+        uint16_t *background = model->background + (size_t) y * map->cols;
+
+        for (uint16_t x = 0; x < map->cols; ++x)
+        {
+            int32_t target = luma[x] << 8;
+            int32_t diff = target - background[x];
+            bool moved = abs(diff - global_shift) > threshold;
+
+            if (moved)
+            {
+                for (int z = 0; z < zones_count; ++z)
+                {
+                    changed[z] += x >= x0[z] && x < x1[z] && y >= y0[z] && y < y1[z];
+                }
+            }
+
+            // Moving object is learned slower, so it is not taken into background while still moving
+            background[x] += diff >> (moved ? config->learn_shift + 2 : config->learn_shift);
+        }
+    }
+
+    for (int z = 0; z < zones_count; ++z)
+    {
+        uint32_t area = (uint32_t) (x1[z] - x0[z]) * (y1[z] - y0[z]);
+        result->zone_permille[z] = changed[z] * 1000 / area;
+        if (result->zone_permille[z] >= config->min_area_permille && changed[z] > 0)
+        {
+            result->zone_mask |= 1 << z;
+        }
+        result->score_permille = result->zone_permille[z] > result->score_permille ? result->zone_permille[z] :
+                                                                                     result->score_permille;
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "jpeg_reader.h"
+
+// Motion detection on JPEG frames without decoding them. Entropy coded data is walked only as far as needed to
+// get DC coefficient of every luminance block, which is mean brightness of 8x8 pixels, so frame is seen as 1/8
+// scale luminance map. Neither dequantization of AC coefficients nor IDCT is done.
+//
+// Nothing here depends on ESP-IDF, so it is built on host by bench/motion_bench.c as it is.
+
+#define MOTION_DETECTOR_MAX_ZONES 4
+
+typedef enum
+{
+    MOTION_DC_OK = 0,
+    MOTION_DC_UNSUPPORTED, // Progressive, 12-bit, arithmetic coded or otherwise not baseline frame
+    MOTION_DC_CORRUPT,
+    MOTION_DC_TOO_LARGE, // Luminance map does not fit in given capacity
+} motion_dc_result_t;
+
+// Tables are kept between frames, as camera repeats the same ones in every frame. Caller owns it, so it can be
+// placed away from small task stacks.
+typedef struct
+{
+    jpeg_reader_tables_t tables;
+} motion_dc_decoder_t;
+
+// Mean luminance (0-255) of every 8x8 block, row by row
+typedef struct
+{
+    uint8_t *luma;
+    size_t capacity;
+    uint16_t cols;
+    uint16_t rows;
+} motion_dc_map_t;
+
+// Rectangle in percent of frame width and height
+typedef struct
+{
+    uint8_t x;
+    uint8_t y;
+    uint8_t w;
+    uint8_t h;
+} motion_zone_t;
+
+typedef struct
+{
+    uint8_t sensitivity; // 1-100, higher one takes smaller brightness change of block as motion
+    uint16_t min_area_permille; // Part of zone that has to change to report motion in it
+    uint8_t learn_shift; // Background moves towards frame by 1/2^learn_shift of difference every frame
+    motion_zone_t zones[MOTION_DETECTOR_MAX_ZONES];
+    int zones_count; // No zones is the same as one zone covering whole frame
+} motion_config_t;
+
+// Background is kept in 8.8 fixed point, so slow learning rates do not stall on rounding
+typedef struct
+{
+    uint16_t *background;
+    size_t capacity;
+    uint16_t cols;
+    uint16_t rows;
+    bool initialized;
+} motion_model_t;
+
+typedef struct
+{
+    uint16_t zone_permille[MOTION_DETECTOR_MAX_ZONES]; // Changed part of every zone
+    uint32_t zone_mask; // Zones with changed part at least min_area_permille
+    uint16_t score_permille; // Highest of zone_permille
+    int16_t global_shift; // Mean brightness change of whole frame, taken out before comparing blocks
+} motion_result_t;
+
+// Fills luminance map from baseline JPEG. Frames with 1 or 3 components and any sampling factors are handled.
+motion_dc_result_t motion_dc_decode(motion_dc_decoder_t *decoder, const uint8_t *buf, size_t len,
+                                    motion_dc_map_t *map);
+
+// Compares map with background, then moves background towards it. Model starts over when map size changes, and
+// first frame after that only sets background.
+void motion_model_update(motion_model_t *model, const motion_dc_map_t *map, const motion_config_t *config,
+                         motion_result_t *result);
@@ -0,0 +1,652 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/stat.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+#include "stream_writer.h"
+#include "frame_pool.h"
+#include "recorder.h"
+#include "playback.h"
+
+// Every session keeps up to two files open, which counts against FATFS max_files of recorder mount
+#define CONFIG_PLAYBACK_MAX_SESSIONS 2
+#define CONFIG_PLAYBACK_SENDER_STACK_SIZE 4096
+// Below live stream senders, so reading storage never delays live frames
+#define CONFIG_PLAYBACK_SENDER_PRIORITY 4
+
+// Index entries are read in batches of this many, frames one at a time into frame pool buffer of their length
+#define CONFIG_PLAYBACK_ENTRY_BATCH 32
+#define CONFIG_PLAYBACK_MAX_FRAME_LEN (512 * 1024)
+// Downloads go through buffer of this length
+#define CONFIG_PLAYBACK_READ_LEN (8 * 1024)
+
+// Pause in recording longer than this, like device being off, is skipped instead of played back in real time
+#define CONFIG_PLAYBACK_MAX_GAP_US (2 * 1000000LL)
+
+static const char *TAG = "PLAYBACK";
+
+typedef struct
+{
+    stream_writer_session_t stream;
+    bool in_use;
+    uint32_t frames_sent;
+
+    // Playback of frames
+    uint32_t segment;
+    int64_t from;
+    int64_t to;
+    float speed;
+
+    // Download of file
+    int file_fd;
+    uint32_t offset;
+    uint32_t len;
+    char head[384];
+} playback_session_t;
+
+static SemaphoreHandle_t mutex = NULL;
+static playback_session_t sessions[CONFIG_PLAYBACK_MAX_SESSIONS];
+static int sessions_count = 0;
+static playback_stats_t stats;
+
+esp_err_t playback_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < CONFIG_PLAYBACK_MAX_SESSIONS; ++i)
+    {
+        esp_err_t ret = stream_writer_session_init(&sessions[i].stream);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static int open_file(uint32_t segment, bool index_file)
+{
+    char path[96];
+    int len = snprintf(path, sizeof(path), "%s/", recorder_get_dir());
+    snprintf(path + len, sizeof(path) - len, index_file ? RECORDER_INDEX_NAME : RECORDER_SEGMENT_NAME,
+             (unsigned long) segment);
+
+    return open(path, O_RDONLY);
+}
+
+// Opens index and returns number of entries in it. Entries of frames still being written are not there yet.
+static esp_err_t open_index(uint32_t segment, int *index_fd, recorder_index_header_t *header, uint32_t *entries)
+{
+    *index_fd = open_file(segment, true);
+    if (*index_fd < 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (read(*index_fd, header, sizeof(*header)) != sizeof(*header) || header->magic != RECORDER_INDEX_MAGIC ||
+        header->entry_len != sizeof(recorder_index_entry_t) || fstat(*index_fd, &st) != 0)
+    {
+        close(*index_fd);
+        *index_fd = -1;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    *entries = (st.st_size - sizeof(*header)) / sizeof(recorder_index_entry_t);
+    return ESP_OK;
+}
+
+static esp_err_t read_entry(int index_fd, uint32_t i, recorder_index_entry_t *entry)
+{
+    off_t offset = sizeof(recorder_index_header_t) + (off_t) i * sizeof(recorder_index_entry_t);
+    return pread(index_fd, entry, sizeof(*entry), offset) == sizeof(*entry) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t playback_get_segment(uint32_t segment, playback_segment_t *info)
+{
+    if (recorder_get_dir() == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int index_fd;
+    recorder_index_header_t header;
+    uint32_t entries;
+    esp_err_t ret = open_index(segment, &index_fd, &header, &entries);
+    if (ret != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    info->start_time = header.start_time;
+    info->end_time = header.start_time;
+    info->frames = entries;
+    info->index_len = sizeof(header) + entries * sizeof(recorder_index_entry_t);
+    info->data_len = 0;
+
+    recorder_index_entry_t last;
+    if (entries > 0 && read_entry(index_fd, entries - 1, &last) == ESP_OK)
+    {
+        info->end_time = last.timestamp;
+        info->data_len = last.offset + last.len;
+    }
+    close(index_fd);
+
+    return ESP_OK;
+}
+
+// Finds readable segment at or after given one and before end
+static bool find_readable(uint32_t *segment, uint32_t end, int64_t *start_time)
+{
+    for (; *segment < end; (*segment)++)
+    {
+        int index_fd;
+        recorder_index_header_t header;
+        uint32_t entries;
+        if (open_index(*segment, &index_fd, &header, &entries) == ESP_OK)
+        {
+            close(index_fd);
+            *start_time = header.start_time;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Segments are numbered in order of their start time, so one covering timestamp is found by binary search,
+// opening only a few index files
+static esp_err_t find_segment(int64_t timestamp, uint32_t *segment)
+{
+    recorder_stats_t recorder;
+    recorder_get_stats(&recorder);
+
+    uint32_t lo = recorder.first_segment;
+    uint32_t hi = recorder.next_segment;
+    bool found = false;
+    *segment = recorder.first_segment;
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t readable = mid;
+        int64_t start_time;
+        if (!find_readable(&readable, hi, &start_time))
+        {
+            hi = mid;
+            continue;
+        }
+
+        found = true;
+        if (start_time <= timestamp)
+        {
+            *segment = readable;
+            lo = readable + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// First entry with timestamp not before given one, timestamps grow within segment
+static uint32_t find_entry(int index_fd, uint32_t entries, int64_t timestamp)
+{
+    uint32_t lo = 0;
+    uint32_t hi = entries;
+
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        recorder_index_entry_t entry;
+        if (read_entry(index_fd, mid, &entry) != ESP_OK)
+        {
+            return entries;
+        }
+
+        if (entry.timestamp < timestamp)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static esp_err_t session_send(playback_session_t *session, const uint8_t *buf, size_t len, bool part)
+{
+    esp_err_t ret = part ? stream_writer_session_mjpeg_send_part(&session->stream, buf, len) :
+                           stream_writer_session_send(&session->stream, buf, len);
+
+    if (ret == ESP_OK)
+    {
+        session->frames_sent += part ? 1 : 0;
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.frames_sent += part ? 1 : 0;
+        stats.bytes_sent += len;
+        xSemaphoreGive(mutex);
+    }
+
+    return ret;
+}
+
+static void finish_session(playback_session_t *session)
+{
+    // Response is written past server, which can not tell where it ends, so connection is closed after it
+    stream_writer_session_finish(&session->stream);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    session->in_use = false;
+    sessions_count--;
+    xSemaphoreGive(mutex);
+
+    vTaskDelete(NULL);
+}
+
+// Plays frames of one segment from given entry, returns false once range end is reached or viewer is gone
+static bool play_segment(playback_session_t *session, uint32_t segment, int64_t *first_timestamp,
+                         int64_t *wall_start, int64_t *last_timestamp)
+{
+    int index_fd;
+    recorder_index_header_t header;
+    uint32_t entries;
+    if (open_index(segment, &index_fd, &header, &entries) != ESP_OK)
+    {
+        return true;
+    }
+
+    int data_fd = open_file(segment, false);
+    if (data_fd < 0)
+    {
+        close(index_fd);
+        return true;
+    }
+
+    bool more = true;
+    uint32_t i = find_entry(index_fd, entries, session->from);
+
+    while (more && i < entries && !session->stream.closed)
+    {
+        recorder_index_entry_t batch[CONFIG_PLAYBACK_ENTRY_BATCH];
+        uint32_t batch_len = entries - i < CONFIG_PLAYBACK_ENTRY_BATCH ? entries - i : CONFIG_PLAYBACK_ENTRY_BATCH;
+        off_t offset = sizeof(header) + (off_t) i * sizeof(recorder_index_entry_t);
+        if (pread(index_fd, batch, batch_len * sizeof(recorder_index_entry_t), offset) !=
+            (ssize_t) (batch_len * sizeof(recorder_index_entry_t)))
+        {
+            break;
+        }
+        i += batch_len;
+
+        for (uint32_t j = 0; j < batch_len && more && !session->stream.closed; ++j)
+        {
+            recorder_index_entry_t *entry = &batch[j];
+            if (entry->timestamp > session->to)
+            {
+                more = false;
+                break;
+            }
+            if (entry->len == 0 || entry->len > CONFIG_PLAYBACK_MAX_FRAME_LEN)
+            {
+                continue;
+            }
+
+            uint8_t *buf = frame_pool_alloc(entry->len);
+            if (buf == NULL)
+            {
+                continue;
+            }
+            // Short read means data of segment being recorded is not flushed yet, and playback ends there
+            if (pread(data_fd, buf, entry->len, entry->offset) != (ssize_t) entry->len)
+            {
+                frame_pool_free(buf);
+                i = entries;
+                break;
+            }
+
+            // Frames keep their original spacing scaled by speed, except for gaps in recording
+            if (*first_timestamp == 0 || entry->timestamp < *last_timestamp ||
+                entry->timestamp - *last_timestamp > CONFIG_PLAYBACK_MAX_GAP_US)
+            {
+                *first_timestamp = entry->timestamp;
+                *wall_start = esp_timer_get_time();
+            }
+            *last_timestamp = entry->timestamp;
+
+            int64_t due = *wall_start + (int64_t) ((entry->timestamp - *first_timestamp) / session->speed);
+            stream_writer_session_wait_until(&session->stream, due);
+
+            more = session_send(session, buf, entry->len, true) == ESP_OK;
+            frame_pool_free(buf);
+        }
+    }
+
+    close(data_fd);
+    close(index_fd);
+    return more && !session->stream.closed;
+}
+
+static void play_task(void *pvParameters)
+{
+    playback_session_t *session = (playback_session_t *) pvParameters;
+    stream_writer_session_attach(&session->stream);
+
+    int64_t first_timestamp = 0;
+    int64_t wall_start = 0;
+    int64_t last_timestamp = 0;
+
+    bool more = stream_writer_session_mjpeg_begin(&session->stream) == ESP_OK;
+    for (uint32_t segment = session->segment; more; ++segment)
+    {
+        // Segments started after playback are played too, up to the one being recorded
+        recorder_stats_t recorder;
+        recorder_get_stats(&recorder);
+        if (segment >= recorder.next_segment)
+        {
+            break;
+        }
+
+        more = play_segment(session, segment, &first_timestamp, &wall_start, &last_timestamp);
+    }
+
+    ESP_LOGI(TAG, "Playback finished: sent %lu frames", (unsigned long) session->frames_sent);
+    finish_session(session);
+}
+
+static void download_task(void *pvParameters)
+{
+    playback_session_t *session = (playback_session_t *) pvParameters;
+    stream_writer_session_attach(&session->stream);
+
+    uint8_t *buf = frame_pool_alloc(CONFIG_PLAYBACK_READ_LEN);
+    esp_err_t ret = buf != NULL ? session_send(session, (uint8_t *) session->head, strlen(session->head), false) :
+                                  ESP_ERR_NO_MEM;
+
+    uint32_t offset = session->offset;
+    uint32_t end = session->offset + session->len;
+    while (ret == ESP_OK && offset < end)
+    {
+        size_t len = end - offset < CONFIG_PLAYBACK_READ_LEN ? end - offset : CONFIG_PLAYBACK_READ_LEN;
+        ssize_t read_len = pread(session->file_fd, buf, len, offset);
+        if (read_len <= 0)
+        {
+            // Client learns about truncated body from Content-Length
+            ESP_LOGE(TAG, "Segment read failed at %lu", (unsigned long) offset);
+            break;
+        }
+
+        ret = session_send(session, buf, read_len, false);
+        offset += read_len;
+    }
+
+    if (buf != NULL)
+    {
+        frame_pool_free(buf);
+    }
+    close(session->file_fd);
+    session->file_fd = -1;
+
+    finish_session(session);
+}
+
+static playback_session_t *take_session(void)
+{
+    playback_session_t *session = NULL;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_PLAYBACK_MAX_SESSIONS; ++i)
+    {
+        if (!sessions[i].in_use)
+        {
+            session = &sessions[i];
+            session->in_use = true;
+            session->file_fd = -1;
+            sessions_count++;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    if (session == NULL)
+    {
+        ESP_LOGE(TAG, "No free playback session slot");
+    }
+
+    return session;
+}
+
+static void release_session(playback_session_t *session)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    session->in_use = false;
+    sessions_count--;
+    xSemaphoreGive(mutex);
+}
+
+static esp_err_t start_session(playback_session_t *session, httpd_req_t *req, TaskFunction_t task,
+                               const char *name)
+{
+    session->frames_sent = 0;
+
+    esp_err_t ret = stream_writer_session_start(&session->stream, req, task, name, CONFIG_PLAYBACK_SENDER_STACK_SIZE,
+                                                CONFIG_PLAYBACK_SENDER_PRIORITY, session);
+    if (ret == ESP_OK)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.sessions_started++;
+        xSemaphoreGive(mutex);
+    }
+
+    return ret;
+}
+
+esp_err_t playback_add_viewer(httpd_req_t *req, int64_t from, int64_t to, float speed)
+{
+    if (recorder_get_dir() == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    uint32_t segment;
+    if (find_segment(from, &segment) != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    playback_session_t *session = take_session();
+    if (session == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    session->segment = segment;
+    session->from = from;
+    session->to = to;
+    session->speed = speed;
+
+    esp_err_t ret = start_session(session, req, play_task, "playback_sender");
+    if (ret != ESP_OK)
+    {
+        release_session(session);
+    }
+
+    return ret;
+}
+
+// Parses single range of "bytes=first-last", "bytes=first-" or "bytes=-suffix_len" form. Anything else, like
+// multiple ranges, is ignored and whole file is sent, which is allowed answer to any Range.
+static bool parse_range(const char *range, uint32_t size, uint32_t *offset, uint32_t *len, bool *satisfiable)
+{
+    *satisfiable = true;
+    if (range == NULL || strncmp(range, "bytes=", 6) != 0 || strchr(range, ',') != NULL)
+    {
+        return false;
+    }
+
+    const char *spec = range + 6;
+    char *end;
+    if (*spec == '-')
+    {
+        unsigned long suffix_len = strtoul(spec + 1, &end, 10);
+        if (end == spec + 1 || *end != '\0')
+        {
+            return false;
+        }
+        *satisfiable = suffix_len > 0 && size > 0;
+        suffix_len = suffix_len < size ? suffix_len : size;
+        *offset = size - suffix_len;
+        *len = suffix_len;
+        return true;
+    }
+
+    unsigned long first = strtoul(spec, &end, 10);
+    if (end == spec || *end != '-')
+    {
+        return false;
+    }
+    const char *last_spec = end + 1;
+    unsigned long last = size > 0 ? size - 1 : 0;
+    if (*last_spec != '\0')
+    {
+        last = strtoul(last_spec, &end, 10);
+        if (end == last_spec || *end != '\0' || last < first)
+        {
+            return false;
+        }
+        last = last < size - 1 ? last : size - 1;
+    }
+
+    *satisfiable = first < size;
+    *offset = first;
+    *len = *satisfiable ? last - first + 1 : 0;
+    return true;
+}
+
+esp_err_t playback_add_download(httpd_req_t *req, uint32_t segment, bool index_file, const char *range)
+{
+    if (recorder_get_dir() == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    int file_fd = open_file(segment, index_file);
+    struct stat st;
+    if (file_fd < 0 || fstat(file_fd, &st) != 0)
+    {
+        if (file_fd >= 0)
+        {
+            close(file_fd);
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Segment being recorded grows meanwhile, its size at the moment of request is sent
+    uint32_t size = st.st_size;
+    uint32_t offset = 0;
+    uint32_t len = size;
+    bool satisfiable;
+    bool partial = parse_range(range, size, &offset, &len, &satisfiable);
+
+    if (!satisfiable)
+    {
+        close(file_fd);
+
+        char content_range[32];
+        snprintf(content_range, sizeof(content_range), "bytes */%lu", (unsigned long) size);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    playback_session_t *session = take_session();
+    if (session == NULL)
+    {
+        close(file_fd);
+        return ESP_ERR_NO_MEM;
+    }
+
+    char name[16];
+    snprintf(name, sizeof(name), index_file ? RECORDER_INDEX_NAME : RECORDER_SEGMENT_NAME, (unsigned long) segment);
+
+    int head_len = snprintf(session->head, sizeof(session->head),
+                            "HTTP/1.1 %s\r\n"
+                            "Content-Type: application/octet-stream\r\n"
+                            "Content-Disposition: attachment; filename=\"%s\"\r\n"
+                            "Content-Length: %lu\r\n"
+                            "Accept-Ranges: bytes\r\n"
+                            "Access-Control-Allow-Origin: *\r\n"
+                            "Connection: close\r\n",
+                            partial ? "206 Partial Content" : "200 OK", name, (unsigned long) len);
+    if (partial)
+    {
+        head_len += snprintf(session->head + head_len, sizeof(session->head) - head_len,
+                             "Content-Range: bytes %lu-%lu/%lu\r\n", (unsigned long) offset,
+                             (unsigned long) (offset + len - 1), (unsigned long) size);
+    }
+    snprintf(session->head + head_len, sizeof(session->head) - head_len, "\r\n");
+
+    session->file_fd = file_fd;
+    session->offset = offset;
+    session->len = len;
+
+    esp_err_t ret = start_session(session, req, download_task, "playback_download");
+    if (ret != ESP_OK)
+    {
+        close(file_fd);
+        session->file_fd = -1;
+        release_session(session);
+    }
+
+    return ret;
+}
+
+void playback_close_socket(int fd)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_PLAYBACK_MAX_SESSIONS; ++i)
+    {
+        if (sessions[i].in_use && sessions[i].stream.fd == fd)
+        {
+            stream_writer_session_close(&sessions[i].stream);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void playback_get_stats(playback_stats_t *stats_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->sessions = sessions_count;
+    xSemaphoreGive(mutex);
+}
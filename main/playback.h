@@ -0,0 +1,50 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+typedef struct
+{
+    int64_t start_time; // Wall clock time in microseconds, from index header
+    int64_t end_time; // Timestamp of last indexed frame, start_time when there is none
+    uint32_t frames;
+    uint32_t data_len;
+    uint32_t index_len;
+} playback_segment_t;
+
+typedef struct
+{
+    uint32_t sessions_started;
+    uint32_t frames_sent;
+    uint64_t bytes_sent;
+    int sessions;
+} playback_stats_t;
+
+esp_err_t playback_init(void);
+
+// Reads segment index header and last entry, without going through frames. ESP_ERR_NOT_FOUND when segment is not
+// on storage or recording is disabled.
+esp_err_t playback_get_segment(uint32_t segment, playback_segment_t *info);
+
+// Takes over request as asynchronous one and streams as MJPEG recorded frames with timestamps from given range,
+// at given speed, from separate task. Frames are found through segment indexes and read from storage one at a time.
+// ESP_ERR_NOT_SUPPORTED when recording is disabled, ESP_ERR_NOT_FOUND when no segment covers range.
+esp_err_t playback_add_viewer(httpd_req_t *req, int64_t from, int64_t to, float speed);
+
+// Sends data or index file of segment, or its part given by value of Range header (may be NULL), from separate task.
+// Errors that can be told before taking over request (missing segment, unsatisfiable range) are answered here.
+esp_err_t playback_add_download(httpd_req_t *req, uint32_t segment, bool index_file, const char *range);
+
+// Has to be called from server close callback before socket is closed, so no playback writes to it afterwards
+void playback_close_socket(int fd);
+
+void playback_get_stats(playback_stats_t *stats);
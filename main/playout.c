@@ -0,0 +1,212 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "control_worker.h"
+#include "playout.h"
+
+#define CONFIG_PLAYOUT_WINDOW_US 5000000
+#define CONFIG_PLAYOUT_MIN_WINDOW_FRAMES 10
+
+// Gap longer than this many frame intervals freezes picture and counts as stall. Gap longer than pause is not
+// a stall, but stream stopped or reconfigured, so measurement starts again.
+#define CONFIG_PLAYOUT_STALL_INTERVALS 2
+#define CONFIG_PLAYOUT_PAUSE_US 2000000
+
+// Depth grows while stalls are above target and shrinks after calm windows, down to what measured jitter needs
+#define CONFIG_PLAYOUT_TARGET_STALL_PERMILLE 10
+#define CONFIG_PLAYOUT_CALM_WINDOWS 3
+#define CONFIG_PLAYOUT_JITTER_DEPTH_FACTOR 2
+#define CONFIG_PLAYOUT_MAX_DEPTH 8
+// Buffers beyond prefetch depth, so data task has where to put frames while accessor holds some
+#define CONFIG_PLAYOUT_SPARE_FBS 2
+
+#define CONFIG_PLAYOUT_DEFAULT_FPS 15
+
+static const char *TAG = "PLAYOUT";
+
+static SemaphoreHandle_t mutex = NULL;
+
+static espfsp_frame_config_t applied = { .fps = CONFIG_PLAYOUT_DEFAULT_FPS };
+static bool adaptive = false;
+static uint16_t target_depth = 0;
+
+static int64_t last_arrival = 0;
+static int64_t window_start = 0;
+static uint32_t window_frames = 0;
+static uint32_t window_stalls = 0;
+static uint32_t calm_windows = 0;
+
+static uint32_t jitter_us = 0;
+static uint32_t stall_permille = 0;
+static uint32_t windows = 0;
+
+esp_err_t playout_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static uint32_t interval_us(void)
+{
+    return 1000000 / (applied.fps > 0 ? applied.fps : 1);
+}
+
+// Has to be called with mutex taken. Returns true when depth has changed.
+static bool finish_window(void)
+{
+    stall_permille = window_stalls * 1000 / window_frames;
+    windows++;
+
+    if (!adaptive)
+    {
+        return false;
+    }
+
+    uint32_t interval = interval_us();
+    uint32_t needed = ((uint64_t) jitter_us * CONFIG_PLAYOUT_JITTER_DEPTH_FACTOR + interval - 1) / interval;
+    uint32_t depth = target_depth;
+
+    if (stall_permille > CONFIG_PLAYOUT_TARGET_STALL_PERMILLE)
+    {
+        depth = depth + 1 > needed ? depth + 1 : needed;
+        calm_windows = 0;
+    }
+    else if (++calm_windows >= CONFIG_PLAYOUT_CALM_WINDOWS && depth > needed)
+    {
+        // Probe one step down, latency is only lowered while it costs no stalls
+        depth--;
+        calm_windows = 0;
+    }
+
+    depth = depth < CONFIG_PLAYOUT_MAX_DEPTH ? depth : CONFIG_PLAYOUT_MAX_DEPTH;
+    if (depth == target_depth)
+    {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Jitter %lu us, stalls %lu/1000, depth %u -> %lu",
+             (unsigned long) jitter_us, (unsigned long) stall_permille, target_depth, (unsigned long) depth);
+    target_depth = depth;
+    return true;
+}
+
+void playout_frame_received(void)
+{
+    int64_t now = esp_timer_get_time();
+    bool changed = false;
+    control_cmd_t cmd = { .type = CONTROL_CMD_SET_FRAME };
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    int64_t gap = now - last_arrival;
+    if (last_arrival == 0 || gap > CONFIG_PLAYOUT_PAUSE_US)
+    {
+        window_start = now;
+        window_frames = 0;
+        window_stalls = 0;
+    }
+    else
+    {
+        // Smoothed the same way as RTP interarrival jitter, with gain 1/16
+        int64_t deviation = llabs(gap - (int64_t) interval_us());
+        jitter_us = (int64_t) jitter_us + (deviation - (int64_t) jitter_us) / 16;
+
+        if (gap > (int64_t) interval_us() * CONFIG_PLAYOUT_STALL_INTERVALS)
+        {
+            window_stalls++;
+        }
+    }
+    last_arrival = now;
+    window_frames++;
+
+    if (now - window_start >= CONFIG_PLAYOUT_WINDOW_US && window_frames >= CONFIG_PLAYOUT_MIN_WINDOW_FRAMES)
+    {
+        changed = finish_window();
+        window_start = now;
+        window_frames = 0;
+        window_stalls = 0;
+
+        cmd.frame_config = applied;
+        cmd.frame_config.fb_in_buffer_before_get = PLAYOUT_DEPTH_AUTO;
+    }
+
+    xSemaphoreGive(mutex);
+
+    // Applied by control worker like any other change, so it is never run over user's command
+    if (changed)
+    {
+        uint32_t id;
+        if (control_worker_submit(&cmd, &id) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Depth change not queued");
+
+            // Tried again after next window
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            target_depth = applied.fb_in_buffer_before_get;
+            xSemaphoreGive(mutex);
+        }
+    }
+}
+
+bool playout_resolve(espfsp_frame_config_t *frame_config)
+{
+    if (frame_config->fb_in_buffer_before_get != PLAYOUT_DEPTH_AUTO)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    frame_config->fb_in_buffer_before_get = target_depth;
+    frame_config->buffered_fbs = target_depth + CONFIG_PLAYOUT_SPARE_FBS;
+    xSemaphoreGive(mutex);
+
+    return true;
+}
+
+void playout_frame_config_applied(const espfsp_frame_config_t *frame_config, bool is_adaptive)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    applied = *frame_config;
+    adaptive = is_adaptive;
+    target_depth = frame_config->fb_in_buffer_before_get;
+
+    // Stalls measured so far belong to previous configuration
+    last_arrival = 0;
+    calm_windows = 0;
+
+    xSemaphoreGive(mutex);
+}
+
+void playout_get_stats(playout_stats_t *stats)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    stats->adaptive = adaptive;
+    stats->depth = applied.fb_in_buffer_before_get;
+    stats->buffered_fbs = applied.buffered_fbs;
+    stats->jitter_us = jitter_us;
+    stats->stall_permille = stall_permille;
+    stats->window = windows;
+
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,40 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stdint.h"
+
+#include "espfsp_client_play.h"
+
+// Value of fb_in_buffer_before_get that turns adaptive playout on. Depth and buffered_fbs are then chosen by
+// playout controller when command is run.
+#define PLAYOUT_DEPTH_AUTO 0xFFFF
+
+typedef struct
+{
+    bool adaptive;
+    uint16_t depth; // fb_in_buffer_before_get in use
+    uint16_t buffered_fbs;
+    uint32_t jitter_us; // Smoothed deviation of frame inter-arrival time from frame interval
+    uint32_t stall_permille; // Stalls per thousand frames in last finished window
+    uint32_t window; // Number of finished measurement windows, changes whenever stats above change
+} playout_stats_t;
+
+esp_err_t playout_init(void);
+
+// Called by frame dispatcher for every frame got from ESPFSP. Once per window it compares stall rate with target
+// and, in adaptive mode, queues new frame configuration when depth should change.
+void playout_frame_received(void);
+
+// Replaces PLAYOUT_DEPTH_AUTO with depth chosen by controller, also sizing buffered_fbs for it. Returns true when
+// configuration asked for adaptive playout.
+bool playout_resolve(espfsp_frame_config_t *frame_config);
+
+// Tells frame configuration applied to ESPFSP client and whether it was resolved from adaptive one
+void playout_frame_config_applied(const espfsp_frame_config_t *frame_config, bool adaptive);
+
+void playout_get_stats(playout_stats_t *stats);
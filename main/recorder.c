@@ -0,0 +1,534 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "strings.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "dirent.h"
+#include "sys/stat.h"
+#include "sys/time.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "sys/statvfs.h"
+#else
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include "driver/sdmmc_host.h"
+#include "esp_netif_sntp.h"
+#endif
+
+#include "frame_pool.h"
+#include "frame_sampler.h"
+#include "recorder.h"
+
+#define CONFIG_RECORDER_MOUNT_POINT "/sdcard"
+#define CONFIG_RECORDER_SNTP_SERVER "pool.ntp.org"
+
+// Wall clock before this (2024-01-01) is taken as not set yet by SNTP
+#define CONFIG_RECORDER_MIN_VALID_TIME 1704067200LL
+
+#define CONFIG_RECORDER_SEGMENT_US (60 * 1000000LL)
+#define CONFIG_RECORDER_MAX_FPS 10
+
+// Frames wait for writer as frame pool copies, so only short burst of slow writes is absorbed
+#define CONFIG_RECORDER_QUEUE_LEN 8
+// Data is written in whole chunks at chunk aligned offsets. Partial chunk is written at sync and rewritten
+// in full later, so card never sees unaligned write in the middle of file.
+#define CONFIG_RECORDER_CHUNK_LEN (16 * 1024)
+#define CONFIG_RECORDER_PENDING_ENTRIES 64
+#define CONFIG_RECORDER_SYNC_INTERVAL_MS 5000
+
+// Oldest segments are deleted while less than this percent of storage is free
+#define CONFIG_RECORDER_MIN_FREE_PERCENT 10
+
+#define CONFIG_RECORDER_WRITER_STACK_SIZE 4096
+#define CONFIG_RECORDER_WRITER_PRIORITY 3
+
+static const char *TAG = "RECORDER";
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    int64_t timestamp;
+} recorder_frame_t;
+
+static char dir[64];
+static bool enabled = false;
+static QueueHandle_t queue = NULL;
+static SemaphoreHandle_t stats_mutex = NULL;
+static frame_sampler_t sampler; // Fed with esp_timer time, as wall clock can jump when synchronized
+static volatile bool clock_valid = false;
+
+// Owned by writer task
+static int data_fd = -1;
+static int index_fd = -1;
+static int64_t segment_start = 0;
+static uint8_t *chunk = NULL;
+static uint32_t chunk_offset = 0; // File offset of chunk start
+static uint32_t chunk_len = 0;
+static recorder_index_entry_t pending[CONFIG_RECORDER_PENDING_ENTRIES];
+static int pending_count = 0;
+static int64_t last_sync = 0;
+
+static recorder_stats_t stats;
+
+static void segment_path(char *path, size_t path_len, const char *format, uint32_t segment)
+{
+    int len = snprintf(path, path_len, "%s/", dir);
+    snprintf(path + len, path_len - len, format, (unsigned long) segment);
+}
+
+static uint64_t get_free_bytes(uint64_t *total_bytes)
+{
+#ifdef CONFIG_IDF_TARGET_LINUX
+    struct statvfs fs;
+    if (statvfs(dir, &fs) != 0)
+    {
+        return 0;
+    }
+    *total_bytes = (uint64_t) fs.f_blocks * fs.f_frsize;
+    return (uint64_t) fs.f_bavail * fs.f_frsize;
+#else
+    uint64_t free_bytes = 0;
+    if (esp_vfs_fat_info(CONFIG_RECORDER_MOUNT_POINT, total_bytes, &free_bytes) != ESP_OK)
+    {
+        return 0;
+    }
+    return free_bytes;
+#endif
+}
+
+static void delete_oldest_segments(void)
+{
+    uint64_t total_bytes = 0;
+    uint64_t free_bytes = get_free_bytes(&total_bytes);
+
+    // Segment being written is never deleted
+    while (free_bytes * 100 < total_bytes * CONFIG_RECORDER_MIN_FREE_PERCENT &&
+           stats.first_segment + 1 < stats.next_segment)
+    {
+        char path[96];
+        segment_path(path, sizeof(path), RECORDER_SEGMENT_NAME, stats.first_segment);
+        unlink(path);
+        segment_path(path, sizeof(path), RECORDER_INDEX_NAME, stats.first_segment);
+        unlink(path);
+
+        xSemaphoreTake(stats_mutex, portMAX_DELAY);
+        stats.first_segment++;
+        stats.segments_deleted++;
+        xSemaphoreGive(stats_mutex);
+
+        free_bytes = get_free_bytes(&total_bytes);
+    }
+
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.free_bytes = free_bytes;
+    xSemaphoreGive(stats_mutex);
+}
+
+static void count_write_error(void)
+{
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.write_errors++;
+    xSemaphoreGive(stats_mutex);
+}
+
+static esp_err_t write_at(int fd, uint32_t offset, const void *buf, size_t len)
+{
+    if (lseek(fd, offset, SEEK_SET) < 0 || write(fd, buf, len) != (ssize_t) len)
+    {
+        ESP_LOGE(TAG, "Write failed");
+        count_write_error();
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// Appends entries of frames that are completely written, so index never points past data on storage
+static void commit_entries(uint32_t written_len)
+{
+    int committed = 0;
+    while (committed < pending_count && pending[committed].offset + pending[committed].len <= written_len)
+    {
+        committed++;
+    }
+
+    if (committed == 0)
+    {
+        return;
+    }
+
+    if (write(index_fd, pending, committed * sizeof(recorder_index_entry_t)) !=
+        (ssize_t) (committed * sizeof(recorder_index_entry_t)))
+    {
+        ESP_LOGE(TAG, "Index write failed");
+        count_write_error();
+    }
+
+    pending_count -= committed;
+    memmove(pending, pending + committed, pending_count * sizeof(recorder_index_entry_t));
+}
+
+static void write_full_chunk(void)
+{
+    write_at(data_fd, chunk_offset, chunk, CONFIG_RECORDER_CHUNK_LEN);
+
+    chunk_offset += CONFIG_RECORDER_CHUNK_LEN;
+    chunk_len = 0;
+
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.bytes_written += CONFIG_RECORDER_CHUNK_LEN;
+    xSemaphoreGive(stats_mutex);
+
+    commit_entries(chunk_offset);
+}
+
+// Makes everything received so far durable. Partial chunk stays in buffer and is written again once full.
+static void sync_segment(void)
+{
+    if (chunk_len > 0)
+    {
+        write_at(data_fd, chunk_offset, chunk, chunk_len);
+    }
+    fsync(data_fd);
+
+    commit_entries(chunk_offset + chunk_len);
+    fsync(index_fd);
+
+    last_sync = esp_timer_get_time();
+}
+
+static void close_segment(void)
+{
+    if (data_fd < 0)
+    {
+        return;
+    }
+
+    sync_segment();
+
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.bytes_written += chunk_len;
+    xSemaphoreGive(stats_mutex);
+
+    close(data_fd);
+    close(index_fd);
+    data_fd = -1;
+    index_fd = -1;
+}
+
+static esp_err_t open_segment(int64_t start_time)
+{
+    char path[96];
+    uint32_t segment = stats.next_segment;
+
+    segment_path(path, sizeof(path), RECORDER_SEGMENT_NAME, segment);
+    data_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    segment_path(path, sizeof(path), RECORDER_INDEX_NAME, segment);
+    index_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (data_fd < 0 || index_fd < 0)
+    {
+        ESP_LOGE(TAG, "Segment %lu creation failed", (unsigned long) segment);
+        count_write_error();
+        if (data_fd >= 0)
+        {
+            close(data_fd);
+        }
+        if (index_fd >= 0)
+        {
+            close(index_fd);
+        }
+        data_fd = -1;
+        index_fd = -1;
+        return ESP_FAIL;
+    }
+
+    recorder_index_header_t header = {
+        .magic = RECORDER_INDEX_MAGIC,
+        .version = RECORDER_INDEX_VERSION,
+        .entry_len = sizeof(recorder_index_entry_t),
+        .start_time = start_time,
+    };
+    if (write(index_fd, &header, sizeof(header)) != sizeof(header))
+    {
+        ESP_LOGE(TAG, "Index header write failed");
+        count_write_error();
+    }
+
+    segment_start = start_time;
+    chunk_offset = 0;
+    chunk_len = 0;
+    pending_count = 0;
+    last_sync = esp_timer_get_time();
+
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.next_segment = segment + 1;
+    xSemaphoreGive(stats_mutex);
+
+    ESP_LOGI(TAG, "Recording segment %lu", (unsigned long) segment);
+    delete_oldest_segments();
+    return ESP_OK;
+}
+
+static void write_frame(const recorder_frame_t *frame)
+{
+    // Wall clock set back by synchronization starts new segment too, so timestamps grow within segment
+    if (data_fd >= 0 &&
+        (frame->timestamp - segment_start >= CONFIG_RECORDER_SEGMENT_US || frame->timestamp < segment_start))
+    {
+        close_segment();
+    }
+    if (data_fd < 0 && open_segment(frame->timestamp) != ESP_OK)
+    {
+        return;
+    }
+
+    if (pending_count == CONFIG_RECORDER_PENDING_ENTRIES)
+    {
+        sync_segment();
+    }
+
+    recorder_index_entry_t *entry = &pending[pending_count++];
+    entry->timestamp = frame->timestamp;
+    entry->offset = chunk_offset + chunk_len;
+    entry->len = frame->len;
+
+    size_t copied = 0;
+    while (copied < frame->len)
+    {
+        size_t len = frame->len - copied;
+        len = len < CONFIG_RECORDER_CHUNK_LEN - chunk_len ? len : CONFIG_RECORDER_CHUNK_LEN - chunk_len;
+        memcpy(chunk + chunk_len, frame->buf + copied, len);
+        chunk_len += len;
+        copied += len;
+
+        if (chunk_len == CONFIG_RECORDER_CHUNK_LEN)
+        {
+            write_full_chunk();
+        }
+    }
+
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.frames_recorded++;
+    xSemaphoreGive(stats_mutex);
+}
+
+static void writer_task(void *pvParameters)
+{
+    while (true)
+    {
+        recorder_frame_t frame;
+        if (xQueueReceive(queue, &frame, pdMS_TO_TICKS(CONFIG_RECORDER_SYNC_INTERVAL_MS)) == pdTRUE)
+        {
+            write_frame(&frame);
+            frame_pool_free(frame.buf);
+        }
+
+        if (data_fd >= 0 && esp_timer_get_time() - last_sync >= CONFIG_RECORDER_SYNC_INTERVAL_MS * 1000LL)
+        {
+            sync_segment();
+        }
+    }
+}
+
+// Continues numbering after segments already on storage, and finds oldest of them for retention
+static void find_segments(void)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        return;
+    }
+
+    bool found = false;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        unsigned long segment;
+        char extension[4];
+        if (sscanf(entry->d_name, "%8lu.%3s", &segment, extension) != 2 || strcasecmp(extension, "SEG") != 0)
+        {
+            continue;
+        }
+
+        if (!found || segment < stats.first_segment)
+        {
+            stats.first_segment = segment;
+        }
+        if (!found || segment + 1 > stats.next_segment)
+        {
+            stats.next_segment = segment + 1;
+        }
+        found = true;
+    }
+    closedir(d);
+}
+
+static esp_err_t prepare_storage(void)
+{
+#ifdef CONFIG_IDF_TARGET_LINUX
+    const char *recordings_dir = getenv("ACCESSOR_RECORDINGS_DIR");
+    if (recordings_dir == NULL)
+    {
+        ESP_LOGI(TAG, "ACCESSOR_RECORDINGS_DIR not set, recording is disabled");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    snprintf(dir, sizeof(dir), "%s", recordings_dir);
+    mkdir(dir, 0755);
+#else
+    // Slot 1 in 1-bit mode, so only CLK, CMD and D0 pins are taken
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = false,
+        // Writer keeps two files open and every playback session up to two more
+        .max_files = 8,
+        .allocation_unit_size = CONFIG_RECORDER_CHUNK_LEN,
+    };
+    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+    sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
+    slot_config.width = 1;
+    slot_config.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+
+    sdmmc_card_t *card;
+    esp_err_t ret = esp_vfs_fat_sdmmc_mount(CONFIG_RECORDER_MOUNT_POINT, &host, &slot_config, &mount_config, &card);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "SD card mount failed (%s), recording is disabled", esp_err_to_name(ret));
+        return ret;
+    }
+
+    snprintf(dir, sizeof(dir), "%s", CONFIG_RECORDER_MOUNT_POINT);
+
+    // Segments are named and indexed by wall clock time, which is right once SNTP synchronizes
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_RECORDER_SNTP_SERVER);
+    esp_netif_sntp_init(&sntp_config);
+#endif
+
+    return ESP_OK;
+}
+
+esp_err_t recorder_init(void)
+{
+    stats_mutex = xSemaphoreCreateMutex();
+    if (stats_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    if (prepare_storage() != ESP_OK)
+    {
+        return ESP_OK;
+    }
+
+    find_segments();
+
+    queue = xQueueCreate(CONFIG_RECORDER_QUEUE_LEN, sizeof(recorder_frame_t));
+    chunk = (uint8_t *) heap_caps_malloc(CONFIG_RECORDER_CHUNK_LEN, MALLOC_CAP_DEFAULT);
+    if (queue == NULL || chunk == NULL)
+    {
+        ESP_LOGE(TAG, "Writer buffers allocation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t xStatus = xTaskCreate(
+        writer_task,
+        "recorder_writer",
+        CONFIG_RECORDER_WRITER_STACK_SIZE,
+        NULL,
+        CONFIG_RECORDER_WRITER_PRIORITY,
+        NULL);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Writer task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    enabled = true;
+    ESP_LOGI(TAG, "Recording to %s from segment %lu", dir, (unsigned long) stats.next_segment);
+    return ESP_OK;
+}
+
+static void count_dropped(void)
+{
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    stats.frames_dropped++;
+    xSemaphoreGive(stats_mutex);
+}
+
+void recorder_add_frame(const uint8_t *buf, size_t len)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    if (!frame_sampler_take(&sampler, esp_timer_get_time(), CONFIG_RECORDER_MAX_FPS))
+    {
+        return;
+    }
+
+    // Segments are numbered in order of their start time, which playback search relies on. Frames taken before
+    // SNTP sets the clock would be stamped near 1970 after every reboot, so nothing is recorded until then.
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    if (now.tv_sec < CONFIG_RECORDER_MIN_VALID_TIME)
+    {
+        return;
+    }
+    if (!clock_valid)
+    {
+        clock_valid = true;
+        ESP_LOGI(TAG, "Wall clock is set, recording started");
+    }
+    int64_t timestamp = (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+
+    recorder_frame_t frame = {
+        .buf = frame_pool_alloc(len),
+        .len = len,
+        .timestamp = timestamp,
+    };
+    if (frame.buf == NULL)
+    {
+        count_dropped();
+        return;
+    }
+    memcpy(frame.buf, buf, len);
+
+    if (xQueueSend(queue, &frame, 0) != pdTRUE)
+    {
+        frame_pool_free(frame.buf);
+        count_dropped();
+    }
+}
+
+const char *recorder_get_dir(void)
+{
+    return enabled ? dir : NULL;
+}
+
+void recorder_get_stats(recorder_stats_t *stats_out)
+{
+    xSemaphoreTake(stats_mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->enabled = enabled;
+    stats_out->clock_valid = clock_valid;
+    xSemaphoreGive(stats_mutex);
+}
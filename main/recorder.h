@@ -0,0 +1,65 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+
+// Recording is a series of numbered segments, each covering fixed time. Segment is a pair of append-only files:
+// data file with JPEG frames stored back to back, and index file with header followed by one entry per frame.
+// Index entry is appended only after frame data it points to is written, so index never points past data, and
+// frames are found by index alone. Names are 8.3, as FATFS is built without long file names.
+#define RECORDER_SEGMENT_NAME "%08lu.SEG"
+#define RECORDER_INDEX_NAME "%08lu.IDX"
+
+#define RECORDER_INDEX_MAGIC 0x49534d48 // "HMSI"
+#define RECORDER_INDEX_VERSION 1
+
+// All fields are little endian
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_len;
+    int64_t start_time; // Wall clock time in microseconds, segment covers start_time up to next segment
+} recorder_index_header_t;
+
+typedef struct __attribute__((packed))
+{
+    int64_t timestamp; // Wall clock time of frame reception in microseconds
+    uint32_t offset;
+    uint32_t len;
+} recorder_index_entry_t;
+
+typedef struct
+{
+    bool enabled;
+    bool clock_valid; // Frames are recorded only once wall clock is set
+    uint32_t first_segment;
+    uint32_t next_segment; // Segment being written, when there is one, is next_segment - 1
+    uint32_t frames_recorded;
+    uint32_t frames_dropped; // Writer did not keep up, or frame copy could not be allocated
+    uint64_t bytes_written;
+    uint32_t segments_deleted;
+    uint32_t write_errors;
+    uint64_t free_bytes;
+} recorder_stats_t;
+
+// Mounts SD card (or on Linux target uses directory from ACCESSOR_RECORDINGS_DIR) and starts writer task.
+// Recording is disabled, not failed, when there is no storage.
+esp_err_t recorder_init(void);
+
+// Queues copy of received frame for writer task. Never blocks, frame is dropped when writer is behind or wall clock
+// is not set yet.
+void recorder_add_frame(const uint8_t *buf, size_t len);
+
+// Directory with segments, NULL when recording is disabled
+const char *recorder_get_dir(void);
+
+void recorder_get_stats(recorder_stats_t *stats);
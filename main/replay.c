@@ -0,0 +1,360 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+#include "stream_writer.h"
+#include "frame_pool.h"
+#include "frame_sampler.h"
+#include "replay.h"
+
+// 3 MiB keep about a minute of 10 KB frames at 5 fps, or 20 seconds of 30 KB ones
+#define CONFIG_REPLAY_BUFFER_LEN (3 * 1024 * 1024)
+#define CONFIG_REPLAY_INDEX_LEN 1024
+#define CONFIG_REPLAY_DEFAULT_MAX_FPS 5
+#define CONFIG_REPLAY_ALIGN 4
+
+#define CONFIG_REPLAY_MAX_VIEWERS 2
+#define CONFIG_REPLAY_SENDER_STACK_SIZE 3072
+// Below live stream senders, so replay never delays live frames
+#define CONFIG_REPLAY_SENDER_PRIORITY 4
+
+static const char *TAG = "REPLAY";
+
+// Frames are stored back to back in ring at their own length. Index entry of frame with sequence number seq is
+// at entries[seq % CONFIG_REPLAY_INDEX_LEN] while first_seq <= seq < next_seq, timestamps grow with seq.
+typedef struct
+{
+    int64_t timestamp;
+    uint32_t offset;
+    uint32_t len;
+} replay_entry_t;
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    uint32_t seq;
+    int64_t timestamp;
+} replay_frame_t;
+
+typedef struct
+{
+    stream_writer_session_t stream;
+    bool in_use;
+
+    int64_t start_timestamp;
+    int64_t end_timestamp;
+    float speed;
+} replay_viewer_t;
+
+static SemaphoreHandle_t mutex = NULL;
+
+static uint8_t *region = NULL;
+static uint32_t head = 0;
+static size_t used_len = 0;
+
+static replay_entry_t entries[CONFIG_REPLAY_INDEX_LEN];
+static uint32_t first_seq = 0;
+static uint32_t next_seq = 0;
+
+static uint32_t max_fps = CONFIG_REPLAY_DEFAULT_MAX_FPS;
+static frame_sampler_t sampler;
+static uint32_t frames_stored = 0;
+static uint32_t frames_evicted = 0;
+
+static replay_viewer_t viewers[CONFIG_REPLAY_MAX_VIEWERS];
+static int viewers_count = 0;
+
+esp_err_t replay_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < CONFIG_REPLAY_MAX_VIEWERS; ++i)
+    {
+        esp_err_t ret = stream_writer_session_init(&viewers[i].stream);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    region = (uint8_t *) heap_caps_malloc(CONFIG_REPLAY_BUFFER_LEN, MALLOC_CAP_SPIRAM);
+    if (region == NULL)
+    {
+        ESP_LOGW(TAG, "Ring allocation failed, replay is disabled");
+    }
+
+    return ESP_OK;
+}
+
+static bool overlaps(const replay_entry_t *entry, uint32_t start, uint32_t end)
+{
+    return entry->offset < end && entry->offset + entry->len > start;
+}
+
+// Has to be called with mutex taken
+static void evict_oldest(void)
+{
+    used_len -= entries[first_seq % CONFIG_REPLAY_INDEX_LEN].len;
+    first_seq++;
+    frames_evicted++;
+}
+
+void replay_add_frame(const uint8_t *buf, size_t len, int64_t timestamp)
+{
+    if (region == NULL || len > CONFIG_REPLAY_BUFFER_LEN)
+    {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if (!frame_sampler_take(&sampler, timestamp, max_fps))
+    {
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    uint32_t stored_len = (len + CONFIG_REPLAY_ALIGN - 1) / CONFIG_REPLAY_ALIGN * CONFIG_REPLAY_ALIGN;
+    uint32_t offset = head + stored_len <= CONFIG_REPLAY_BUFFER_LEN ? head : 0;
+
+    // Oldest frames lie right after head, and when frame does not fit before end of ring, also in skipped tail
+    while (first_seq != next_seq)
+    {
+        const replay_entry_t *oldest = &entries[first_seq % CONFIG_REPLAY_INDEX_LEN];
+        if (next_seq - first_seq < CONFIG_REPLAY_INDEX_LEN && !overlaps(oldest, offset, offset + stored_len) &&
+            !(offset == 0 && head != 0 && overlaps(oldest, head, CONFIG_REPLAY_BUFFER_LEN)))
+        {
+            break;
+        }
+        evict_oldest();
+    }
+
+    memcpy(region + offset, buf, len);
+
+    replay_entry_t *entry = &entries[next_seq % CONFIG_REPLAY_INDEX_LEN];
+    entry->timestamp = timestamp;
+    entry->offset = offset;
+    entry->len = len;
+    next_seq++;
+
+    head = offset + stored_len;
+    used_len += len;
+    frames_stored++;
+
+    xSemaphoreGive(mutex);
+}
+
+void replay_set_max_fps(uint32_t fps)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    max_fps = fps > 0 ? fps : 1;
+    frame_sampler_reset(&sampler);
+    xSemaphoreGive(mutex);
+}
+
+// Has to be called with mutex taken. Returns sequence number of first frame not older than timestamp.
+static uint32_t find_seq(int64_t timestamp)
+{
+    uint32_t low = first_seq;
+    uint32_t high = next_seq;
+
+    while (low != high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (entries[mid % CONFIG_REPLAY_INDEX_LEN].timestamp < timestamp)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+// Copies out frame with given sequence number, or first newer one when it was evicted meanwhile. Copy is taken
+// from frame pool, so ring is not held while it is sent.
+static esp_err_t read_frame(uint32_t seq, replay_frame_t *frame)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    if ((int32_t) (seq - first_seq) < 0)
+    {
+        seq = first_seq;
+    }
+    if (seq == next_seq)
+    {
+        xSemaphoreGive(mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const replay_entry_t *entry = &entries[seq % CONFIG_REPLAY_INDEX_LEN];
+    frame->buf = frame_pool_alloc(entry->len);
+    if (frame->buf != NULL)
+    {
+        memcpy(frame->buf, region + entry->offset, entry->len);
+        frame->len = entry->len;
+        frame->seq = seq;
+        frame->timestamp = entry->timestamp;
+    }
+
+    xSemaphoreGive(mutex);
+
+    return frame->buf != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void sender_task(void *pvParameters)
+{
+    replay_viewer_t *viewer = (replay_viewer_t *) pvParameters;
+    stream_writer_session_t *stream = &viewer->stream;
+    uint32_t frames_sent = 0;
+
+    stream_writer_session_attach(stream);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t seq = find_seq(viewer->start_timestamp);
+    xSemaphoreGive(mutex);
+
+    esp_err_t ret = stream_writer_session_mjpeg_begin(stream);
+    int64_t first_timestamp = 0;
+    int64_t wall_start = 0;
+
+    while (ret == ESP_OK && !stream->closed)
+    {
+        replay_frame_t frame;
+        if (read_frame(seq, &frame) != ESP_OK)
+        {
+            break;
+        }
+
+        if (frame.timestamp > viewer->end_timestamp)
+        {
+            frame_pool_free(frame.buf);
+            break;
+        }
+
+        // Frames keep their original spacing, scaled by speed
+        if (first_timestamp == 0)
+        {
+            first_timestamp = frame.timestamp;
+            wall_start = esp_timer_get_time();
+        }
+        int64_t due = wall_start + (int64_t) ((frame.timestamp - first_timestamp) / viewer->speed);
+        stream_writer_session_wait_until(stream, due);
+
+        ret = stream_writer_session_mjpeg_send_part(stream, frame.buf, frame.len);
+
+        frame_pool_free(frame.buf);
+        seq = frame.seq + 1;
+        frames_sent++;
+    }
+
+    ESP_LOGI(TAG, "Replay finished: sent %lu frames", (unsigned long) frames_sent);
+
+    stream_writer_session_finish(stream);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    viewer->in_use = false;
+    viewers_count--;
+    xSemaphoreGive(mutex);
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t replay_add_viewer(httpd_req_t *req, uint32_t seconds, float speed)
+{
+    replay_viewer_t *viewer = NULL;
+
+    if (region == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_REPLAY_MAX_VIEWERS; ++i)
+    {
+        if (!viewers[i].in_use)
+        {
+            viewer = &viewers[i];
+            viewer->in_use = true;
+            viewers_count++;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    if (viewer == NULL)
+    {
+        ESP_LOGE(TAG, "No free replay viewer slot");
+        return ESP_ERR_NO_MEM;
+    }
+
+    viewer->end_timestamp = esp_timer_get_time();
+    viewer->start_timestamp = viewer->end_timestamp - (int64_t) seconds * 1000000;
+    viewer->speed = speed;
+
+    esp_err_t ret = stream_writer_session_start(&viewer->stream, req, sender_task, "replay_sender",
+                                                CONFIG_REPLAY_SENDER_STACK_SIZE, CONFIG_REPLAY_SENDER_PRIORITY,
+                                                viewer);
+    if (ret != ESP_OK)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        viewer->in_use = false;
+        viewers_count--;
+        xSemaphoreGive(mutex);
+    }
+
+    return ret;
+}
+
+void replay_close_socket(int fd)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_REPLAY_MAX_VIEWERS; ++i)
+    {
+        if (viewers[i].in_use && viewers[i].stream.fd == fd)
+        {
+            stream_writer_session_close(&viewers[i].stream);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void replay_get_stats(replay_stats_t *stats)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    stats->buffer_len = region != NULL ? CONFIG_REPLAY_BUFFER_LEN : 0;
+    stats->used_len = used_len;
+    stats->frames = next_seq - first_seq;
+    stats->frames_stored = frames_stored;
+    stats->frames_evicted = frames_evicted;
+    stats->depth_ms = first_seq != next_seq ? (entries[(next_seq - 1) % CONFIG_REPLAY_INDEX_LEN].timestamp -
+                                               entries[first_seq % CONFIG_REPLAY_INDEX_LEN].timestamp) / 1000 : 0;
+    stats->max_fps = max_fps;
+    stats->viewers = viewers_count;
+
+    xSemaphoreGive(mutex);
+}
@@ -0,0 +1,43 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+typedef struct
+{
+    size_t buffer_len;
+    size_t used_len;
+    uint32_t frames;
+    uint32_t frames_stored;
+    uint32_t frames_evicted;
+    uint32_t depth_ms; // Time between oldest and newest frame kept
+    uint32_t max_fps; // Frames above this rate are not stored, trading frame rate for depth
+    int viewers;
+} replay_stats_t;
+
+// Reserves PSRAM ring for frames. Replay is disabled, not failed, when it can not be reserved.
+esp_err_t replay_init(void);
+
+// Copies received frame into ring with its reception timestamp, unless stored frame rate is already reached.
+// Oldest frames are evicted to make room.
+void replay_add_frame(const uint8_t *buf, size_t len, int64_t timestamp);
+
+// Sets highest frame rate stored in ring. Lower one makes ring cover longer time with the same memory.
+void replay_set_max_fps(uint32_t max_fps);
+
+// Takes over request as asynchronous one and streams as MJPEG frames of last given seconds, at given speed, from
+// separate task. Response ends with frame kept at the moment of request.
+esp_err_t replay_add_viewer(httpd_req_t *req, uint32_t seconds, float speed);
+
+// Has to be called from server close callback before socket is closed, so no replay writes to it afterwards
+void replay_close_socket(int fd);
+
+void replay_get_stats(replay_stats_t *stats);
@@ -0,0 +1,241 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdlib.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "source_list.h"
+#include "metrics.h"
+
+#define CONFIG_SOURCE_LIST_STACK_SIZE 4096
+#define CONFIG_SOURCE_LIST_PRIORITY 4
+
+#define CONFIG_SOURCE_LIST_REFRESH_PERIOD 10000
+#define CONFIG_SOURCE_LIST_TIMEOUT 1000
+
+#define CONFIG_SOURCE_LIST_INITIAL_CAPACITY 8
+#define CONFIG_SOURCE_LIST_MAX_CAPACITY 256
+
+#define SOURCE_NAME_LEN 30
+
+static const char *TAG = "SOURCE_LIST";
+
+typedef char source_name_t[SOURCE_NAME_LEN];
+
+static espfsp_client_play_handler_t client_handler = NULL;
+// Guards list, running flag and refresher handle, so refresher is never notified after it is gone
+static SemaphoreHandle_t mutex = NULL;
+static SemaphoreHandle_t task_done = NULL;
+static TaskHandle_t refresher = NULL;
+static volatile bool running = false;
+
+static source_name_t *sources = NULL;
+static int sources_len = 0;
+static int64_t updated_at = 0;
+
+// Capacity is doubled whenever server fills whole buffer, as there may be more sources than fit in it
+static int capacity = CONFIG_SOURCE_LIST_INITIAL_CAPACITY;
+
+static esp_err_t fetch_sources(void)
+{
+    while (true)
+    {
+        source_name_t *names = (source_name_t *) calloc(capacity, sizeof(source_name_t));
+        if (names == NULL)
+        {
+            ESP_LOGE(TAG, "Source names allocation failed");
+            return ESP_ERR_NO_MEM;
+        }
+
+        int names_len = capacity;
+        esp_err_t ret = METRICS_TIME_CALL(METRICS_CALL_GET_SOURCES,
+            espfsp_client_play_get_sources_timeout(client_handler, names, &names_len, CONFIG_SOURCE_LIST_TIMEOUT));
+        if (ret != ESP_OK)
+        {
+            free(names);
+            return ret;
+        }
+
+        if (names_len >= capacity && capacity < CONFIG_SOURCE_LIST_MAX_CAPACITY)
+        {
+            free(names);
+            capacity *= 2;
+            continue;
+        }
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        free(sources);
+        sources = names;
+        sources_len = names_len;
+        updated_at = esp_timer_get_time();
+        xSemaphoreGive(mutex);
+
+        return ESP_OK;
+    }
+}
+
+static void refresher_task(void *pvParameters)
+{
+    while (running)
+    {
+        if (fetch_sources() != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Sources refresh failed");
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_SOURCE_LIST_REFRESH_PERIOD));
+    }
+
+    xSemaphoreGive(task_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t source_list_init(espfsp_client_play_handler_t client)
+{
+    if (mutex == NULL)
+    {
+        mutex = xSemaphoreCreateMutex();
+        task_done = xSemaphoreCreateBinary();
+        if (mutex == NULL || task_done == NULL)
+        {
+            ESP_LOGE(TAG, "Semaphores creation failed");
+            return ESP_FAIL;
+        }
+    }
+
+    client_handler = client;
+
+    // Task is created with mutex taken, so handle is set before anyone can notify it
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    running = true;
+    BaseType_t xStatus = xTaskCreate(
+        refresher_task,
+        "source_list",
+        CONFIG_SOURCE_LIST_STACK_SIZE,
+        NULL,
+        CONFIG_SOURCE_LIST_PRIORITY,
+        &refresher);
+    if (xStatus != pdPASS)
+    {
+        running = false;
+        refresher = NULL;
+    }
+    xSemaphoreGive(mutex);
+
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Refresher task creation failed");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t source_list_deinit(void)
+{
+    if (mutex == NULL)
+    {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool was_running = running;
+    running = false;
+    if (was_running)
+    {
+        xTaskNotifyGive(refresher);
+    }
+    xSemaphoreGive(mutex);
+
+    if (!was_running)
+    {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(task_done, portMAX_DELAY);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    refresher = NULL;
+    free(sources);
+    sources = NULL;
+    sources_len = 0;
+    updated_at = 0;
+    xSemaphoreGive(mutex);
+
+    return ESP_OK;
+}
+
+void source_list_refresh(void)
+{
+    if (mutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (running)
+    {
+        xTaskNotifyGive(refresher);
+    }
+    xSemaphoreGive(mutex);
+}
+
+static size_t escape_json(char *dst, const char *src, size_t src_len)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < src_len && src[i] != '\0'; ++i)
+    {
+        if (src[i] == '"' || src[i] == '\\')
+        {
+            dst[len++] = '\\';
+        }
+        dst[len++] = (unsigned char) src[i] < 0x20 ? ' ' : src[i];
+    }
+
+    return len;
+}
+
+char *source_list_get_json(int64_t *age_ms)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    // Every character may need escaping, plus quotes and comma for each name and brackets
+    char *json = (char *) malloc(sources_len * (2 * SOURCE_NAME_LEN + 3) + 3);
+    if (json == NULL)
+    {
+        xSemaphoreGive(mutex);
+        return NULL;
+    }
+
+    size_t len = 0;
+    json[len++] = '[';
+    for (int i = 0; i < sources_len; ++i)
+    {
+        if (i > 0)
+        {
+            json[len++] = ',';
+        }
+        json[len++] = '"';
+        len += escape_json(json + len, sources[i], SOURCE_NAME_LEN);
+        json[len++] = '"';
+    }
+    json[len++] = ']';
+    json[len] = '\0';
+
+    *age_ms = updated_at == 0 ? -1 : (esp_timer_get_time() - updated_at) / 1000;
+
+    xSemaphoreGive(mutex);
+    return json;
+}
@@ -0,0 +1,19 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "espfsp_client_play.h"
+
+// Starts task that keeps list of sources of given client up to date
+esp_err_t source_list_init(espfsp_client_play_handler_t client);
+esp_err_t source_list_deinit(void);
+
+// Asks refresher task for update and returns at once
+void source_list_refresh(void);
+
+// Returns cached list as JSON array allocated with malloc, to be freed by caller. Age of the list is set to -1
+// if it was not fetched yet.
+char *source_list_get_json(int64_t *age_ms);
@@ -0,0 +1,457 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+#include "frame_pool.h"
+#include "config_cache.h"
+#include "udps_handler.h"
+#include "source_sessions.h"
+
+#define CONFIG_SOURCE_SESSIONS_MAX 3
+
+// ESPFSP frame buffers of all sessions together, main client not counted. Session is also refused when PSRAM
+// would drop under reserve left for replay, frame pool fallbacks and the rest.
+#define CONFIG_SOURCE_SESSIONS_PSRAM_BUDGET (1024 * 1024)
+#define CONFIG_SOURCE_SESSIONS_PSRAM_RESERVE (256 * 1024)
+
+// Every session client has control and data socket. Session is refused when they would not fit in sockets left by
+// main client (2), both servers with listen, control and 7 connection sockets each (18), mDNS and SNTP (2).
+#define CONFIG_SOURCE_SESSIONS_CLIENT_SOCKETS 2
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+#define CONFIG_SOURCE_SESSIONS_SOCKET_BUDGET (CONFIG_LWIP_MAX_SOCKETS - 22)
+#else
+#define CONFIG_SOURCE_SESSIONS_SOCKET_BUDGET (CONFIG_SOURCE_SESSIONS_MAX * CONFIG_SOURCE_SESSIONS_CLIENT_SOCKETS)
+#endif
+
+// Sessions serve overview and side views, so they are kept shallower and slower than main client
+#define CONFIG_SOURCE_SESSIONS_BUFFERED_FRAMES 3
+#define CONFIG_SOURCE_SESSIONS_FPS 10
+
+// Session without viewers and holders is closed after this time
+#define CONFIG_SOURCE_SESSIONS_IDLE_MS 15000
+#define CONFIG_SOURCE_SESSIONS_RETRY_MS 5000
+#define CONFIG_SOURCE_SESSIONS_CHECK_MS 1000
+
+// Session i uses local ports PORT_BASE + 2 * i and the next one, main client keeps 5003 and 5004
+#define CONFIG_SOURCE_SESSIONS_PORT_BASE 5013
+
+#define CONFIG_SOURCE_SESSIONS_TASK_STACK_SIZE 4096
+#define CONFIG_SOURCE_SESSIONS_TASK_PRIORITY 4
+
+static const char *TAG = "SOURCE_SESSIONS";
+
+typedef enum
+{
+    SESSION_FREE,
+    SESSION_STARTING, // Client is open, stream is not started yet
+    SESSION_STREAMING,
+    SESSION_CLOSING, // Not given to new holders, waits for current ones
+} session_state_t;
+
+typedef struct
+{
+    session_state_t state;
+    char name[30];
+    espfsp_client_play_handler_t client;
+    frame_dispatcher_handle_t dispatcher;
+    size_t psram_len;
+    int holders;
+    int64_t last_used;
+    int64_t retry_at;
+} source_session_t;
+
+// Taken for whole open, start and close of session, so control calls never run over closing client
+static SemaphoreHandle_t lifecycle_mutex = NULL;
+// Guards sessions table and stats, held only briefly
+static SemaphoreHandle_t mutex = NULL;
+static TaskHandle_t task = NULL;
+
+static source_session_t sessions[CONFIG_SOURCE_SESSIONS_MAX];
+static source_sessions_stats_t stats;
+
+// Has to be called with mutex taken
+static source_session_t *find_session(const char *name)
+{
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        session_state_t state = sessions[i].state;
+        if (state != SESSION_FREE && state != SESSION_CLOSING && strcmp(sessions[i].name, name) == 0)
+        {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static frame_dispatcher_handle_t hold_session(const char *name)
+{
+    frame_dispatcher_handle_t dispatcher = NULL;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    source_session_t *session = find_session(name);
+    if (session != NULL)
+    {
+        session->holders++;
+        dispatcher = session->dispatcher;
+    }
+    xSemaphoreGive(mutex);
+
+    return dispatcher;
+}
+
+// Has to be called with lifecycle mutex taken
+static esp_err_t open_session(const char *name)
+{
+    size_t psram_len = CONFIG_SOURCE_SESSIONS_BUFFERED_FRAMES * frame_pool_recommended_max_len();
+    source_session_t *session = NULL;
+    size_t used = 0;
+    int sockets = CONFIG_SOURCE_SESSIONS_CLIENT_SOCKETS;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        if (sessions[i].state != SESSION_FREE)
+        {
+            used += sessions[i].psram_len;
+            sockets += CONFIG_SOURCE_SESSIONS_CLIENT_SOCKETS;
+        }
+        else if (session == NULL)
+        {
+            session = &sessions[i];
+        }
+    }
+    bool fits = session != NULL && used + psram_len <= CONFIG_SOURCE_SESSIONS_PSRAM_BUDGET &&
+                heap_caps_get_free_size(MALLOC_CAP_SPIRAM) >= psram_len + CONFIG_SOURCE_SESSIONS_PSRAM_RESERVE &&
+                sockets <= CONFIG_SOURCE_SESSIONS_SOCKET_BUDGET;
+    if (!fits)
+    {
+        stats.sessions_rejected++;
+    }
+    xSemaphoreGive(mutex);
+
+    if (!fits)
+    {
+        ESP_LOGW(TAG, "No room for session of %s, %u of %u bytes and %d of %d sockets used", name, (unsigned) used,
+                 (unsigned) CONFIG_SOURCE_SESSIONS_PSRAM_BUDGET, sockets - CONFIG_SOURCE_SESSIONS_CLIENT_SOCKETS,
+                 CONFIG_SOURCE_SESSIONS_SOCKET_BUDGET);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int index = session - sessions;
+    espfsp_client_play_config_t config;
+    esp_err_t ret = udps_get_session_config(CONFIG_SOURCE_SESSIONS_PORT_BASE + 2 * index,
+                                            CONFIG_SOURCE_SESSIONS_PORT_BASE + 2 * index + 1, &config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    config.frame_config.frame_max_len = frame_pool_recommended_max_len();
+    config.frame_config.fps = CONFIG_SOURCE_SESSIONS_FPS;
+    config.frame_config.buffered_fbs = CONFIG_SOURCE_SESSIONS_BUFFERED_FRAMES;
+    config.frame_config.fb_in_buffer_before_get = 0;
+
+    espfsp_client_play_handler_t client = espfsp_client_play_init(&config);
+    if (client == NULL)
+    {
+        ESP_LOGE(TAG, "Client play ESPFSP init failed");
+        return ESP_FAIL;
+    }
+
+    frame_dispatcher_handle_t dispatcher = frame_dispatcher_init(client, false);
+    if (dispatcher == NULL)
+    {
+        ESP_LOGE(TAG, "Frame dispatcher init failed");
+        espfsp_client_play_deinit(client);
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    strcpy(session->name, name);
+    session->client = client;
+    session->dispatcher = dispatcher;
+    session->psram_len = psram_len;
+    session->holders = 0;
+    session->last_used = esp_timer_get_time();
+    session->retry_at = 0;
+    session->state = SESSION_STARTING;
+    stats.sessions_opened++;
+    xSemaphoreGive(mutex);
+
+    ESP_LOGI(TAG, "Session %d opened for %s", index, name);
+
+    // Stream is started by task, so request is not held by control calls
+    xTaskNotifyGive(task);
+    return ESP_OK;
+}
+
+// Has to be called with lifecycle mutex taken
+static void start_session(source_session_t *session)
+{
+    esp_err_t ret = espfsp_client_play_set_source(session->client, session->name);
+    if (ret == ESP_OK)
+    {
+        ret = espfsp_client_play_start_stream(session->client);
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (ret == ESP_OK)
+    {
+        session->state = SESSION_STREAMING;
+    }
+    else
+    {
+        session->retry_at = esp_timer_get_time() + CONFIG_SOURCE_SESSIONS_RETRY_MS * 1000LL;
+        stats.start_failures++;
+    }
+    xSemaphoreGive(mutex);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Starting stream of %s failed: %s", session->name, esp_err_to_name(ret));
+        return;
+    }
+
+    frame_dispatcher_wake(session->dispatcher);
+}
+
+// Has to be called with lifecycle mutex taken and session marked as closing
+static void close_session(source_session_t *session)
+{
+    // Holders got dispatcher before session was marked, they give it back shortly
+    while (true)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        int holders = session->holders;
+        xSemaphoreGive(mutex);
+
+        if (holders == 0)
+        {
+            break;
+        }
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    // Cleared first, so close callback of server no longer reaches dispatcher
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    frame_dispatcher_handle_t dispatcher = session->dispatcher;
+    espfsp_client_play_handler_t client = session->client;
+    session->dispatcher = NULL;
+    session->client = NULL;
+    xSemaphoreGive(mutex);
+
+    frame_dispatcher_deinit(dispatcher);
+    espfsp_client_play_deinit(client);
+
+    ESP_LOGI(TAG, "Session of %s closed", session->name);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    session->state = SESSION_FREE;
+    session->psram_len = 0;
+    xSemaphoreGive(mutex);
+}
+
+static void sessions_task(void *pvParameters)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_SOURCE_SESSIONS_CHECK_MS));
+
+        xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+        for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+        {
+            source_session_t *session = &sessions[i];
+            if (session->state == SESSION_FREE)
+            {
+                continue;
+            }
+
+            // Viewers are added only by holders, and release refreshes last use, so session with no viewers
+            // and no holders for idle time can not get new viewer before it is marked
+            int viewers = frame_dispatcher_get_viewers_count(session->dispatcher);
+            int64_t now = esp_timer_get_time();
+            bool idle = false;
+
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            if (viewers > 0)
+            {
+                session->last_used = now;
+            }
+            else if (session->holders == 0 && now - session->last_used > CONFIG_SOURCE_SESSIONS_IDLE_MS * 1000LL)
+            {
+                session->state = SESSION_CLOSING;
+                idle = true;
+            }
+            bool start = session->state == SESSION_STARTING && now >= session->retry_at;
+            xSemaphoreGive(mutex);
+
+            if (idle)
+            {
+                close_session(session);
+            }
+            else if (start)
+            {
+                start_session(session);
+            }
+        }
+        xSemaphoreGive(lifecycle_mutex);
+    }
+}
+
+esp_err_t source_sessions_init(void)
+{
+    lifecycle_mutex = xSemaphoreCreateMutex();
+    mutex = xSemaphoreCreateMutex();
+    if (lifecycle_mutex == NULL || mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    BaseType_t xStatus = xTaskCreate(
+        sessions_task,
+        "source_sessions",
+        CONFIG_SOURCE_SESSIONS_TASK_STACK_SIZE,
+        NULL,
+        CONFIG_SOURCE_SESSIONS_TASK_PRIORITY,
+        &task);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Sessions task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t source_sessions_acquire(const char *name, frame_dispatcher_handle_t *dispatcher)
+{
+    *dispatcher = NULL;
+
+    if (strlen(name) == 0 || strlen(name) >= sizeof(sessions[0].name))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Selected source already streams on main client
+    char selected[sizeof(sessions[0].name)];
+    if (config_cache_get_source(selected, sizeof(selected)) == ESP_OK && strcmp(selected, name) == 0)
+    {
+        *dispatcher = udps_acquire_dispatcher();
+        return *dispatcher != NULL ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    *dispatcher = hold_session(name);
+    if (*dispatcher != NULL)
+    {
+        return ESP_OK;
+    }
+
+    // Session could have been opened by other request while waiting for lifecycle mutex
+    xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    *dispatcher = hold_session(name);
+    if (*dispatcher == NULL)
+    {
+        ret = open_session(name);
+        *dispatcher = ret == ESP_OK ? hold_session(name) : NULL;
+    }
+    xSemaphoreGive(lifecycle_mutex);
+
+    return ret;
+}
+
+void source_sessions_release(frame_dispatcher_handle_t dispatcher)
+{
+    bool session = false;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        if (sessions[i].state != SESSION_FREE && sessions[i].dispatcher == dispatcher)
+        {
+            sessions[i].holders--;
+            sessions[i].last_used = esp_timer_get_time();
+            session = true;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    // Otherwise it is dispatcher of main client, held by udps handler
+    if (!session)
+    {
+        udps_release_dispatcher(dispatcher);
+    }
+}
+
+void source_sessions_close_socket(int fd)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        if (sessions[i].dispatcher != NULL)
+        {
+            frame_dispatcher_close_socket(sessions[i].dispatcher, fd);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void source_sessions_close_all(void)
+{
+    if (lifecycle_mutex == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        bool open = sessions[i].state != SESSION_FREE;
+        sessions[i].state = open ? SESSION_CLOSING : SESSION_FREE;
+        xSemaphoreGive(mutex);
+
+        if (open)
+        {
+            close_session(&sessions[i]);
+        }
+    }
+    xSemaphoreGive(lifecycle_mutex);
+}
+
+void source_sessions_get_stats(source_sessions_stats_t *stats_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->psram_budget = CONFIG_SOURCE_SESSIONS_PSRAM_BUDGET;
+    for (int i = 0; i < CONFIG_SOURCE_SESSIONS_MAX; ++i)
+    {
+        if (sessions[i].state == SESSION_FREE)
+        {
+            continue;
+        }
+        stats_out->sessions++;
+        stats_out->streaming += sessions[i].state == SESSION_STREAMING;
+        stats_out->psram_used += sessions[i].psram_len;
+        if (sessions[i].dispatcher != NULL)
+        {
+            stats_out->viewers += frame_dispatcher_get_viewers_count(sessions[i].dispatcher);
+        }
+    }
+    xSemaphoreGive(mutex);
+}
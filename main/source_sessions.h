@@ -0,0 +1,44 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+
+#include "frame_dispatcher.h"
+
+typedef struct
+{
+    int sessions; // Open, starting ones included
+    int streaming;
+    int viewers; // Viewers of every session
+    size_t psram_budget;
+    size_t psram_used; // Frame buffers reserved for open sessions
+    uint32_t sessions_opened;
+    uint32_t sessions_rejected; // Over budget or out of free slots
+    uint32_t start_failures;
+} source_sessions_stats_t;
+
+// Starts task that starts streams of new sessions and closes idle ones
+esp_err_t source_sessions_init(void);
+
+// Gives dispatcher serving source of given name, which has to be released. Source selected on main client is
+// served by its own dispatcher, held like one from udps_acquire_dispatcher. Other ones get session with their own ESPFSP client, opened on first use and
+// started in background, so dispatcher may have no frames yet. Returns ESP_ERR_INVALID_STATE when main client is
+// not started and ESP_ERR_NO_MEM when session would not fit in PSRAM budget or every session slot is taken.
+esp_err_t source_sessions_acquire(const char *name, frame_dispatcher_handle_t *dispatcher);
+void source_sessions_release(frame_dispatcher_handle_t dispatcher);
+
+// Has to be called from server close callback before socket is closed, so no viewer of any session writes to it
+// afterwards
+void source_sessions_close_socket(int fd);
+
+// Closes every session, e.g. when main client is stopped. Viewers of sessions are disconnected.
+void source_sessions_close_all(void);
+
+void source_sessions_get_stats(source_sessions_stats_t *stats);
@@ -0,0 +1,262 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdio.h"
+#include "stdbool.h"
+#include "stdlib.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#include "static_assets.h"
+
+// Web server and WiFi configuration server together register only a few asset URIs
+#define CONFIG_STATIC_ASSETS_MAX_ROUTES 8
+#define CONFIG_STATIC_ASSETS_MAX_HEADER_LEN 256
+
+#define CONFIG_STATIC_ASSETS_IMMUTABLE_CACHE "public, max-age=31536000, immutable"
+#define CONFIG_STATIC_ASSETS_REVALIDATE_CACHE "no-cache"
+
+static const char *TAG = "STATIC_ASSETS";
+
+typedef struct
+{
+    static_asset_t *assets;
+    size_t count;
+    const char *path;
+} static_asset_route_t;
+
+static static_asset_route_t routes[CONFIG_STATIC_ASSETS_MAX_ROUTES];
+static size_t routes_count = 0;
+
+static const char *encoding_name(static_asset_encoding_t encoding)
+{
+    switch (encoding)
+    {
+    case STATIC_ASSET_GZIP:
+        return "gzip";
+    case STATIC_ASSET_BR:
+        return "br";
+    default:
+        return NULL;
+    }
+}
+
+// FNV-1a, only used to tell versions of content apart
+static void compute_hash(const uint8_t *data, size_t len, char *hash)
+{
+    uint64_t value = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        value ^= data[i];
+        value *= 0x100000001b3ULL;
+    }
+
+    snprintf(hash, STATIC_ASSET_HASH_LEN + 1, "%016llx", (unsigned long long) value);
+}
+
+// Returns true when Accept-Encoding lists coding without q=0
+static bool accepts_encoding(const char *accept_encoding, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *token = accept_encoding;
+
+    while (*token != '\0')
+    {
+        while (*token == ' ' || *token == ',')
+        {
+            token++;
+        }
+
+        const char *end = token + strcspn(token, ",");
+        if ((size_t) (end - token) >= name_len && strncmp(token, name, name_len) == 0 &&
+            (token[name_len] == ',' || token[name_len] == ';' || token[name_len] == ' ' || token[name_len] == '\0'))
+        {
+            const char *q = strstr(token, "q=");
+            return q == NULL || q >= end || strtod(q + 2, NULL) > 0;
+        }
+
+        token = end;
+    }
+
+    return false;
+}
+
+// Prefers smallest variant in encoding client accepts. When it accepts none, identity variant is sent, or gzip one
+// as before this layer, since every browser decodes it.
+static const static_asset_t *select_variant(httpd_req_t *req, const static_asset_route_t *route)
+{
+    char accept_encoding[CONFIG_STATIC_ASSETS_MAX_HEADER_LEN] = "";
+    const static_asset_t *selected = NULL;
+    const static_asset_t *fallback = NULL;
+
+    httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept_encoding, sizeof(accept_encoding));
+
+    for (size_t i = 0; i < route->count; ++i)
+    {
+        const static_asset_t *asset = &route->assets[i];
+        if (strcmp(asset->path, route->path) != 0)
+        {
+            continue;
+        }
+
+        if (fallback == NULL || asset->encoding == STATIC_ASSET_IDENTITY ||
+            (asset->encoding == STATIC_ASSET_GZIP && fallback->encoding != STATIC_ASSET_IDENTITY))
+        {
+            fallback = asset;
+        }
+
+        const char *name = encoding_name(asset->encoding);
+        if ((name == NULL || accepts_encoding(accept_encoding, name)) && (selected == NULL || asset->len < selected->len))
+        {
+            selected = asset;
+        }
+    }
+
+    return selected != NULL ? selected : fallback;
+}
+
+static bool etag_matches(httpd_req_t *req, const char *etag)
+{
+    char if_none_match[CONFIG_STATIC_ASSETS_MAX_HEADER_LEN];
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK)
+    {
+        return false;
+    }
+
+    // List of tags, possibly weak ones, which match strong tag too for GET
+    return strcmp(if_none_match, "*") == 0 || strstr(if_none_match, etag) != NULL;
+}
+
+static bool is_hashed_url(httpd_req_t *req, const char *hash)
+{
+    char query[64];
+    char version[STATIC_ASSET_HASH_LEN + 1];
+
+    return httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+           httpd_query_key_value(query, "v", version, sizeof(version)) == ESP_OK &&
+           strcmp(version, hash) == 0;
+}
+
+static esp_err_t static_asset_handler(httpd_req_t *req)
+{
+    const static_asset_route_t *route = (const static_asset_route_t *) req->user_ctx;
+    const static_asset_t *asset = select_variant(req, route);
+    if (asset == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+        return ESP_OK;
+    }
+
+    const char *encoding = encoding_name(asset->encoding);
+    char etag[STATIC_ASSET_HASH_LEN + 8];
+    if (encoding != NULL)
+    {
+        snprintf(etag, sizeof(etag), "\"%s-%s\"", asset->hash, encoding);
+    }
+    else
+    {
+        snprintf(etag, sizeof(etag), "\"%s\"", asset->hash);
+    }
+
+    // Headers have to be set again for 304, so cached response stays valid for the same time
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    httpd_resp_set_hdr(req, "Cache-Control", is_hashed_url(req, asset->hash) ?
+        CONFIG_STATIC_ASSETS_IMMUTABLE_CACHE : CONFIG_STATIC_ASSETS_REVALIDATE_CACHE);
+
+    if (etag_matches(req, etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->content_type);
+    if (encoding != NULL)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", encoding);
+    }
+
+    return httpd_resp_send(req, (const char *) asset->data, asset->len);
+}
+
+esp_err_t static_assets_register(httpd_handle_t server, const char *uri, static_asset_t *assets, size_t count,
+                                 const char *path)
+{
+    const static_asset_t *content = NULL;
+
+    // Variants of one asset share hash, so it is computed from first of them
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (strcmp(assets[i].path, path) != 0)
+        {
+            continue;
+        }
+
+        if (content == NULL)
+        {
+            content = &assets[i];
+            if (assets[i].hash[0] == '\0')
+            {
+                compute_hash(assets[i].data, assets[i].len, assets[i].hash);
+            }
+        }
+        else
+        {
+            strcpy(assets[i].hash, content->hash);
+        }
+    }
+
+    if (content == NULL)
+    {
+        ESP_LOGE(TAG, "No asset %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Servers are started again on every reconnection, so route of asset is reused then
+    static_asset_route_t *route = NULL;
+    for (size_t i = 0; i < routes_count; ++i)
+    {
+        if (routes[i].assets == assets && strcmp(routes[i].path, path) == 0)
+        {
+            route = &routes[i];
+        }
+    }
+
+    if (route == NULL)
+    {
+        if (routes_count >= CONFIG_STATIC_ASSETS_MAX_ROUTES)
+        {
+            ESP_LOGE(TAG, "No space for route of %s", path);
+            return ESP_ERR_NO_MEM;
+        }
+
+        route = &routes[routes_count++];
+        route->assets = assets;
+        route->count = count;
+        route->path = path;
+    }
+
+    httpd_uri_t asset_uri = {
+        .uri = uri,
+        .method = HTTP_GET,
+        .handler = static_asset_handler,
+        .user_ctx = route,
+    };
+
+    esp_err_t ret = httpd_register_uri_handler(server, &asset_uri);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Registering %s failed", uri);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Serving %s at %s, version %s", path, uri, content->hash);
+    return ESP_OK;
+}
@@ -0,0 +1,38 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define STATIC_ASSET_HASH_LEN 16
+
+typedef enum
+{
+    STATIC_ASSET_IDENTITY,
+    STATIC_ASSET_GZIP,
+    STATIC_ASSET_BR,
+} static_asset_encoding_t;
+
+// One encoded variant of asset. Variants of the same asset share path and hash.
+typedef struct
+{
+    const char *path;
+    const char *content_type;
+    static_asset_encoding_t encoding;
+    const uint8_t *data;
+    size_t len;
+    char hash[STATIC_ASSET_HASH_LEN + 1]; // Hex hash of content, computed when registered if left empty
+} static_asset_t;
+
+// Registers GET handler for uri serving variants of asset with given path from table. Responses carry strong ETag
+// and are answered with 304 on revalidation. Request for "<uri>?v=<hash>" with current hash is content-hashed URL,
+// which is cached as immutable, any other is revalidated on every use.
+esp_err_t static_assets_register(httpd_handle_t server, const char *uri, static_asset_t *assets, size_t count,
+                                 const char *path);
@@ -0,0 +1,330 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "errno.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "sys/socket.h"
+#include "sys/uio.h"
+#include "esp_http_server.h"
+
+#include "stream_writer.h"
+
+static const char *TAG = "STREAM_WRITER";
+
+static const char response_head[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static esp_err_t writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t sent = writev(fd, iov, iovcnt);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "Socket write failed: errno %d", errno);
+            return ESP_FAIL;
+        }
+
+        // Skip fully sent vectors and move into partially sent one
+        while (iovcnt > 0 && (size_t) sent >= iov->iov_len)
+        {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t *) iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t stream_writer_mjpeg_begin(httpd_req_t *req)
+{
+    struct iovec iov[1] = {
+        { .iov_base = (void *) response_head, .iov_len = sizeof(response_head) - 1 },
+    };
+
+    return writev_all(httpd_req_to_sockfd(req), iov, 1);
+}
+
+esp_err_t stream_writer_mjpeg_send_part(httpd_req_t *req, const uint8_t *buf, size_t len)
+{
+    char part_buf[64];
+
+    size_t hlen = snprintf(part_buf, sizeof(part_buf),
+                           "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n",
+                           len);
+
+    struct iovec iov[3] = {
+        { .iov_base = part_buf, .iov_len = hlen },
+        { .iov_base = (void *) buf, .iov_len = len },
+        { .iov_base = (void *) "\r\n", .iov_len = 2 },
+    };
+
+    return writev_all(httpd_req_to_sockfd(req), iov, 3);
+}
+
+esp_err_t stream_writer_mjpeg_end(httpd_req_t *req)
+{
+    // Without chunked encoding, end of stream is signalled by closing connection
+    return httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+}
+
+esp_err_t stream_writer_send(httpd_req_t *req, const void *buf, size_t len)
+{
+    struct iovec iov[1] = {
+        { .iov_base = (void *) buf, .iov_len = len },
+    };
+
+    return writev_all(httpd_req_to_sockfd(req), iov, 1);
+}
+
+static size_t ws_frame_header(uint8_t *header, uint8_t opcode, size_t payload_len)
+{
+    size_t hlen = 0;
+
+    // FIN bit set, server frames are never masked
+    header[hlen++] = 0x80 | opcode;
+    if (payload_len < 126)
+    {
+        header[hlen++] = payload_len;
+    }
+    else if (payload_len <= 0xFFFF)
+    {
+        header[hlen++] = 126;
+        header[hlen++] = payload_len >> 8;
+        header[hlen++] = payload_len;
+    }
+    else
+    {
+        header[hlen++] = 127;
+        for (int i = 7; i >= 0; --i)
+        {
+            header[hlen++] = (uint64_t) payload_len >> (8 * i);
+        }
+    }
+
+    return hlen;
+}
+
+static void put_be(uint8_t *dst, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        dst[i] = value >> (8 * (bytes - 1 - i));
+    }
+}
+
+esp_err_t stream_writer_ws_send_frame(int fd, uint32_t seq, int64_t timestamp, const uint8_t *buf, size_t len)
+{
+    uint8_t ws_header[10];
+    uint8_t frame_header[STREAM_WRITER_WS_HEADER_LEN];
+
+    size_t ws_hlen = ws_frame_header(ws_header, 0x2, STREAM_WRITER_WS_HEADER_LEN + len);
+    put_be(frame_header, seq, 4);
+    put_be(frame_header + 4, timestamp, 8);
+    put_be(frame_header + 12, len, 4);
+
+    struct iovec iov[3] = {
+        { .iov_base = ws_header, .iov_len = ws_hlen },
+        { .iov_base = frame_header, .iov_len = sizeof(frame_header) },
+        { .iov_base = (void *) buf, .iov_len = len },
+    };
+
+    return writev_all(fd, iov, 3);
+}
+
+esp_err_t stream_writer_ws_send_text(int fd, const char *text)
+{
+    uint8_t ws_header[10];
+    size_t len = strlen(text);
+    size_t ws_hlen = ws_frame_header(ws_header, 0x1, len);
+
+    struct iovec iov[2] = {
+        { .iov_base = ws_header, .iov_len = ws_hlen },
+        { .iov_base = (void *) text, .iov_len = len },
+    };
+
+    return writev_all(fd, iov, 2);
+}
+
+esp_err_t stream_writer_session_init(stream_writer_session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+    session->fd = -1;
+    session->send_mutex = xSemaphoreCreateMutex();
+    if (session->send_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Session semaphore creation failed");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t stream_writer_session_begin(stream_writer_session_t *session, httpd_req_t *req)
+{
+    session->fd = httpd_req_to_sockfd(req);
+    session->task = NULL;
+    session->closed = false;
+
+    esp_err_t ret = httpd_req_async_handler_begin(req, &session->req);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Async request begin failed");
+        session->req = NULL;
+    }
+
+    return ret;
+}
+
+esp_err_t stream_writer_session_start(stream_writer_session_t *session, httpd_req_t *req, TaskFunction_t task,
+                                      const char *name, uint32_t stack_size, UBaseType_t priority, void *arg)
+{
+    esp_err_t ret = stream_writer_session_begin(session, req);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    BaseType_t xStatus = xTaskCreate(task, name, stack_size, arg, priority, NULL);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Sender task creation failed");
+        httpd_req_async_handler_complete(session->req);
+        session->req = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void stream_writer_session_attach(stream_writer_session_t *session)
+{
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    session->task = xTaskGetCurrentTaskHandle();
+    xSemaphoreGive(session->send_mutex);
+}
+
+esp_err_t stream_writer_session_mjpeg_begin(stream_writer_session_t *session)
+{
+    esp_err_t ret = ESP_FAIL;
+
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    if (!session->closed)
+    {
+        ret = stream_writer_mjpeg_begin(session->req);
+    }
+    xSemaphoreGive(session->send_mutex);
+
+    return ret;
+}
+
+esp_err_t stream_writer_session_mjpeg_send_part(stream_writer_session_t *session, const uint8_t *buf, size_t len)
+{
+    esp_err_t ret = ESP_FAIL;
+
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    if (!session->closed)
+    {
+        ret = stream_writer_mjpeg_send_part(session->req, buf, len);
+    }
+    xSemaphoreGive(session->send_mutex);
+
+    return ret;
+}
+
+esp_err_t stream_writer_session_send(stream_writer_session_t *session, const void *buf, size_t len)
+{
+    esp_err_t ret = ESP_FAIL;
+
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    if (!session->closed)
+    {
+        ret = stream_writer_send(session->req, buf, len);
+    }
+    xSemaphoreGive(session->send_mutex);
+
+    return ret;
+}
+
+bool stream_writer_session_lock(stream_writer_session_t *session)
+{
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    return !session->closed;
+}
+
+void stream_writer_session_unlock(stream_writer_session_t *session)
+{
+    xSemaphoreGive(session->send_mutex);
+}
+
+bool stream_writer_session_wait_until(stream_writer_session_t *session, int64_t due)
+{
+    int64_t tick_us = portTICK_PERIOD_MS * 1000;
+
+    int64_t wait_us = due - esp_timer_get_time();
+    while (!session->closed && wait_us > 0)
+    {
+        // Rounded up to whole tick, as shorter wait would return at once and spin until due time
+        ulTaskNotifyTake(pdTRUE, (TickType_t) ((wait_us + tick_us - 1) / tick_us));
+        wait_us = due - esp_timer_get_time();
+    }
+
+    return !session->closed;
+}
+
+void stream_writer_session_finish(stream_writer_session_t *session)
+{
+    // Socket of closed session may already be given to new connection, which must not be closed instead. Close
+    // callback marks session closed before it takes send mutex, so socket is still open while mutex is held here.
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    if (!session->closed)
+    {
+        stream_writer_mjpeg_end(session->req);
+    }
+    httpd_req_async_handler_complete(session->req);
+
+    // Cleared with send mutex, so close callback never notifies task that is gone
+    session->req = NULL;
+    session->task = NULL;
+    xSemaphoreGive(session->send_mutex);
+}
+
+void stream_writer_session_close(stream_writer_session_t *session)
+{
+    session->closed = true;
+
+    // Abort write in progress, then wait for sender to leave socket
+    shutdown(session->fd, SHUT_RDWR);
+    xSemaphoreTake(session->send_mutex, portMAX_DELAY);
+    if (session->task != NULL)
+    {
+        xTaskNotifyGive(session->task);
+    }
+    xSemaphoreGive(session->send_mutex);
+}
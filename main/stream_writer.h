@@ -0,0 +1,81 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_http_server.h"
+
+// Writes multipart response head straight to request socket. Body is not chunk encoded, so response is
+// terminated by closing connection in stream_writer_mjpeg_end.
+esp_err_t stream_writer_mjpeg_begin(httpd_req_t *req);
+
+// Sends part header, JPEG and part trailer with single scatter-gather write, without copying JPEG
+esp_err_t stream_writer_mjpeg_send_part(httpd_req_t *req, const uint8_t *buf, size_t len);
+
+esp_err_t stream_writer_mjpeg_end(httpd_req_t *req);
+
+// Writes bytes straight to request socket, for responses that are made by caller from head to body
+esp_err_t stream_writer_send(httpd_req_t *req, const void *buf, size_t len);
+
+// Size of header that precedes JPEG in every binary WebSocket frame: sequence number (u32), timestamp of frame
+// reception in microseconds (u64) and JPEG length (u32), all big endian
+#define STREAM_WRITER_WS_HEADER_LEN 16
+
+// Sends header and JPEG as one unmasked binary WebSocket frame with single scatter-gather write
+esp_err_t stream_writer_ws_send_frame(int fd, uint32_t seq, int64_t timestamp, const uint8_t *buf, size_t len);
+
+esp_err_t stream_writer_ws_send_text(int fd, const char *text);
+
+// Asynchronous request served by sender task of its own, like replay, playback or mosaic, or written by tasks of
+// user, like motion events. Writers hold send mutex while writing to socket, so server close callback can abort
+// write in progress and wait for writer to leave socket before it is closed. Slots of sessions and their counts
+// are kept by users.
+typedef struct
+{
+    httpd_req_t *req;
+    int fd;
+    TaskHandle_t task;
+    SemaphoreHandle_t send_mutex;
+    volatile bool closed;
+} stream_writer_session_t;
+
+esp_err_t stream_writer_session_init(stream_writer_session_t *session);
+
+// Takes over request as asynchronous one, for session written by tasks of user
+esp_err_t stream_writer_session_begin(stream_writer_session_t *session, httpd_req_t *req);
+
+// Takes over request as asynchronous one and starts sender task, which is given arg. When error is returned
+// request is not taken over and can still be answered by caller.
+esp_err_t stream_writer_session_start(stream_writer_session_t *session, httpd_req_t *req, TaskFunction_t task,
+                                      const char *name, uint32_t stack_size, UBaseType_t priority, void *arg);
+
+// Has to be called by sender task before anything else, so it is woken up when socket is closed
+void stream_writer_session_attach(stream_writer_session_t *session);
+
+// Write like their stream_writer_* counterparts, failing once socket is closed
+esp_err_t stream_writer_session_mjpeg_begin(stream_writer_session_t *session);
+esp_err_t stream_writer_session_mjpeg_send_part(stream_writer_session_t *session, const uint8_t *buf, size_t len);
+esp_err_t stream_writer_session_send(stream_writer_session_t *session, const void *buf, size_t len);
+
+// Keeps other writers out while several writes to session->req are done with stream_writer_* functions, which must
+// not be interleaved with them. Returns false when socket is closed, lock is taken anyway.
+bool stream_writer_session_lock(stream_writer_session_t *session);
+void stream_writer_session_unlock(stream_writer_session_t *session);
+
+// Sleeps until given esp_timer time, or less when socket is closed. Returns false when socket is closed.
+bool stream_writer_session_wait_until(stream_writer_session_t *session, int64_t due);
+
+// Ends response by closing connection, unless socket was closed already, and completes asynchronous request after
+// writer holding session lock is done. Has to be called before slot of session is freed.
+void stream_writer_session_finish(stream_writer_session_t *session);
+
+// Has to be called from server close callback before socket is closed, so sender no longer writes to it
+void stream_writer_session_close(stream_writer_session_t *session);
@@ -0,0 +1,405 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#include "string.h"
+#include "stdatomic.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "frame_pool.h"
+#include "jpeg_transcoder.h"
+#include "transcoder.h"
+
+#define CONFIG_TRANSCODER_MAX_VARIANTS 4
+// Viewers waiting for the same variant, as many as dispatcher serves
+#define CONFIG_TRANSCODER_MAX_WAITERS 4
+
+// Band for UXGA 4:2:0 at scale 2: two MCU rows of 100 MCUs, 6 blocks each, 4x4 coefficients per block
+#define CONFIG_TRANSCODER_BAND_COEFFICIENTS (2 * 100 * 6 * 16)
+
+#define CONFIG_TRANSCODER_TASK_STACK_SIZE 4096
+// Below senders and producer, so transcoding never delays full size stream
+#define CONFIG_TRANSCODER_TASK_PRIORITY 4
+
+static const char *TAG = "TRANSCODER";
+
+// Frame and its refcount are kept in front of transcoded data, in one frame pool allocation
+typedef struct
+{
+    transcoder_frame_t frame;
+    atomic_int refs;
+} transcoder_copy_t;
+
+struct transcoder_variant
+{
+    jpeg_transcode_params_t params;
+    int viewers;
+    transcoder_copy_t *latest; // Holds one reference
+    TaskHandle_t waiters[CONFIG_TRANSCODER_MAX_WAITERS];
+    int waiters_count;
+};
+
+// Guards pending frame, variants and stats, never held while transcoding
+static SemaphoreHandle_t mutex = NULL;
+static TaskHandle_t task = NULL;
+static bool available = false;
+
+// Frame waiting for transcoder, at most one
+static uint8_t *pending_buf = NULL;
+static size_t pending_len = 0;
+static uint32_t pending_seq = 0;
+static int64_t pending_timestamp = 0;
+
+// Owned by transcoder task
+static jpeg_transcoder_t *transcoder = NULL;
+
+static struct transcoder_variant variants[CONFIG_TRANSCODER_MAX_VARIANTS];
+static transcoder_stats_t stats;
+
+// Has to be called with mutex taken, or on copy not shared yet
+static transcoder_frame_t *copy_ref(transcoder_copy_t *copy)
+{
+    atomic_fetch_add_explicit(&copy->refs, 1, memory_order_relaxed);
+    return &copy->frame;
+}
+
+static transcoder_copy_t *copy_output(const uint8_t *out, size_t out_len, uint32_t seq, int64_t timestamp)
+{
+    transcoder_copy_t *copy = (transcoder_copy_t *) frame_pool_alloc(sizeof(transcoder_copy_t) + out_len);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    uint8_t *buf = (uint8_t *) (copy + 1);
+    memcpy(buf, out, out_len);
+    copy->frame.buf = buf;
+    copy->frame.len = out_len;
+    copy->frame.seq = seq;
+    copy->frame.timestamp = timestamp;
+    atomic_init(&copy->refs, 1);
+
+    return copy;
+}
+
+static void transcode_variant(struct transcoder_variant *variant, const uint8_t *buf, size_t len, uint32_t seq,
+                              int64_t timestamp, uint8_t *out, size_t out_capacity)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    jpeg_transcode_params_t params = variant->params;
+    bool open = variant->viewers > 0;
+    xSemaphoreGive(mutex);
+
+    if (!open)
+    {
+        return;
+    }
+
+    size_t out_len = 0;
+    int64_t start = esp_timer_get_time();
+    jpeg_transcode_result_t ret = jpeg_transcode(transcoder, buf, len, &params, out, out_capacity, &out_len);
+    int64_t transcode_time = esp_timer_get_time() - start;
+
+    // Output is written to scratch buffer as large as source, and kept only in as much as it needs
+    transcoder_copy_t *copy = ret == JPEG_TRANSCODE_OK ? copy_output(out, out_len, seq, timestamp) : NULL;
+    if (copy == NULL)
+    {
+        ESP_LOGD(TAG, "Frame %lu to scale %u quality %u failed: %d",
+                 (unsigned long) seq, params.scale, params.quality, ret);
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.frames_failed++;
+        xSemaphoreGive(mutex);
+        return;
+    }
+
+    transcoder_copy_t *old = copy;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // Variant could have been closed, or even opened again for other viewers, while frame was transcoded
+    if (variant->viewers > 0 && variant->params.scale == params.scale && variant->params.quality == params.quality)
+    {
+        old = variant->latest;
+        variant->latest = copy;
+        for (int i = 0; i < variant->waiters_count; ++i)
+        {
+            xTaskNotifyGive(variant->waiters[i]);
+        }
+        variant->waiters_count = 0;
+    }
+    stats.frames_transcoded++;
+    stats.bytes_in += len;
+    stats.bytes_out += out_len;
+    // Moving average over about 16 frames
+    stats.transcode_us = stats.transcode_us - stats.transcode_us / 16 + transcode_time / 16;
+    xSemaphoreGive(mutex);
+
+    if (old != NULL)
+    {
+        transcoder_release(&old->frame);
+    }
+}
+
+static void transcoder_task(void *pvParameters)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        uint8_t *buf = pending_buf;
+        size_t len = pending_len;
+        uint32_t seq = pending_seq;
+        int64_t timestamp = pending_timestamp;
+        pending_buf = NULL;
+        xSemaphoreGive(mutex);
+
+        if (buf == NULL)
+        {
+            continue;
+        }
+
+        // Requantized frame can come out slightly larger than source when source uses optimized Huffman tables
+        size_t out_capacity = len + len / 8 + 1024;
+        uint8_t *out = frame_pool_alloc(out_capacity);
+        if (out == NULL)
+        {
+            ESP_LOGE(TAG, "Output buffer allocation failed");
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            stats.frames_failed++;
+            xSemaphoreGive(mutex);
+        }
+        else
+        {
+            for (int i = 0; i < CONFIG_TRANSCODER_MAX_VARIANTS; ++i)
+            {
+                transcode_variant(&variants[i], buf, len, seq, timestamp, out, out_capacity);
+            }
+            frame_pool_free(out);
+        }
+
+        frame_pool_free(buf);
+    }
+}
+
+esp_err_t transcoder_init(void)
+{
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Mutex creation failed");
+        return ESP_FAIL;
+    }
+
+    // Huffman tables and codes are looked up for every coefficient, so they stay in internal RAM. Band is walked
+    // block by block and can live in PSRAM.
+    transcoder = (jpeg_transcoder_t *) heap_caps_calloc(1, sizeof(jpeg_transcoder_t), MALLOC_CAP_DEFAULT);
+    int16_t *band = (int16_t *) heap_caps_malloc(CONFIG_TRANSCODER_BAND_COEFFICIENTS * sizeof(int16_t),
+                                                 MALLOC_CAP_SPIRAM);
+    if (transcoder == NULL || band == NULL)
+    {
+        ESP_LOGW(TAG, "Transcoder buffers allocation failed, transcoding is disabled");
+        heap_caps_free(transcoder);
+        heap_caps_free(band);
+        transcoder = NULL;
+        return ESP_OK;
+    }
+    jpeg_transcoder_init(transcoder, band, CONFIG_TRANSCODER_BAND_COEFFICIENTS);
+
+    BaseType_t xStatus = xTaskCreate(
+        transcoder_task,
+        "transcoder",
+        CONFIG_TRANSCODER_TASK_STACK_SIZE,
+        NULL,
+        CONFIG_TRANSCODER_TASK_PRIORITY,
+        &task);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Transcoder task creation failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    available = true;
+    return ESP_OK;
+}
+
+esp_err_t transcoder_open(uint8_t scale, uint8_t quality, transcoder_variant_handle_t *variant)
+{
+    *variant = NULL;
+
+    if (!available)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if ((scale != 1 && scale != 2 && scale != 4 && scale != 8) || quality > 100)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct transcoder_variant *free_variant = NULL;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_TRANSCODER_MAX_VARIANTS; ++i)
+    {
+        if (variants[i].viewers == 0)
+        {
+            free_variant = free_variant == NULL ? &variants[i] : free_variant;
+        }
+        else if (variants[i].params.scale == scale && variants[i].params.quality == quality)
+        {
+            *variant = &variants[i];
+            break;
+        }
+    }
+
+    if (*variant == NULL && free_variant != NULL)
+    {
+        *variant = free_variant;
+        free_variant->params.scale = scale;
+        free_variant->params.quality = quality;
+        free_variant->latest = NULL;
+        free_variant->waiters_count = 0;
+        stats.variants++;
+    }
+    if (*variant != NULL)
+    {
+        (*variant)->viewers++;
+    }
+    xSemaphoreGive(mutex);
+
+    if (*variant == NULL)
+    {
+        ESP_LOGE(TAG, "No free variant slot");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void transcoder_close(transcoder_variant_handle_t variant)
+{
+    transcoder_copy_t *latest = NULL;
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    // Task of viewer is about to be deleted, so it must not be notified any more
+    for (int i = 0; i < variant->waiters_count; ++i)
+    {
+        if (variant->waiters[i] == current)
+        {
+            variant->waiters[i] = variant->waiters[--variant->waiters_count];
+            break;
+        }
+    }
+
+    variant->viewers--;
+    if (variant->viewers == 0)
+    {
+        latest = variant->latest;
+        variant->latest = NULL;
+        variant->waiters_count = 0;
+        stats.variants--;
+    }
+    xSemaphoreGive(mutex);
+
+    if (latest != NULL)
+    {
+        transcoder_release(&latest->frame);
+    }
+}
+
+void transcoder_add_frame(const uint8_t *buf, size_t len, uint32_t seq, int64_t timestamp)
+{
+    if (!available)
+    {
+        return;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool open = stats.variants > 0;
+    bool busy = pending_buf != NULL;
+    if (open && busy)
+    {
+        stats.frames_skipped++;
+    }
+    xSemaphoreGive(mutex);
+
+    // Frame is copied only when some viewer needs it and transcoder can take it, so producer pays nothing for
+    // viewers of full size stream
+    if (!open || busy)
+    {
+        return;
+    }
+
+    uint8_t *copy = frame_pool_alloc(len);
+    if (copy == NULL)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        stats.frames_skipped++;
+        xSemaphoreGive(mutex);
+        return;
+    }
+    memcpy(copy, buf, len);
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pending_buf = copy;
+    pending_len = len;
+    pending_seq = seq;
+    pending_timestamp = timestamp;
+    xSemaphoreGive(mutex);
+
+    xTaskNotifyGive(task);
+}
+
+transcoder_frame_t *transcoder_acquire(transcoder_variant_handle_t variant, uint32_t last_seq)
+{
+    transcoder_frame_t *frame = NULL;
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (variant->latest != NULL && variant->latest->frame.seq != last_seq)
+    {
+        frame = copy_ref(variant->latest);
+    }
+    else
+    {
+        bool waiting = false;
+        for (int i = 0; i < variant->waiters_count; ++i)
+        {
+            waiting = waiting || variant->waiters[i] == current;
+        }
+        if (!waiting && variant->waiters_count < CONFIG_TRANSCODER_MAX_WAITERS)
+        {
+            variant->waiters[variant->waiters_count++] = current;
+        }
+    }
+    xSemaphoreGive(mutex);
+
+    return frame;
+}
+
+void transcoder_release(transcoder_frame_t *frame)
+{
+    transcoder_copy_t *copy = (transcoder_copy_t *) frame;
+
+    if (atomic_fetch_sub_explicit(&copy->refs, 1, memory_order_acq_rel) == 1)
+    {
+        frame_pool_free((uint8_t *) copy);
+    }
+}
+
+void transcoder_get_stats(transcoder_stats_t *stats_out)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    *stats_out = stats;
+    stats_out->available = available;
+    xSemaphoreGive(mutex);
+}
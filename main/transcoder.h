@@ -0,0 +1,58 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#include "esp_err.h"
+
+typedef struct transcoder_variant *transcoder_variant_handle_t;
+
+// Transcoded frame shared by every viewer of its variant. Sequence number and timestamp are the ones of source frame.
+typedef struct
+{
+    const uint8_t *buf;
+    size_t len;
+    uint32_t seq;
+    int64_t timestamp;
+} transcoder_frame_t;
+
+typedef struct
+{
+    bool available;
+    int variants; // Variants with at least one viewer
+    uint32_t frames_transcoded; // Counted once per variant
+    uint32_t frames_skipped; // Transcoder still busy with previous frame
+    uint32_t frames_failed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint32_t transcode_us; // Per variant, averaged over recent frames
+} transcoder_stats_t;
+
+// Reserves coefficient band and starts transcoder task. Transcoding is disabled, not failed, when band can not be
+// reserved.
+esp_err_t transcoder_init(void);
+
+// Opens variant for viewer, sharing it with viewers that asked for the same scale and quality. Returns
+// ESP_ERR_NOT_SUPPORTED when transcoding is disabled, ESP_ERR_INVALID_ARG for scale other than 1, 2, 4 or 8 or
+// quality above 100, and ESP_ERR_NO_MEM when every variant slot is taken.
+esp_err_t transcoder_open(uint8_t scale, uint8_t quality, transcoder_variant_handle_t *variant);
+
+// Has to be called from task that acquired frames of variant, if any, so it is no longer notified of new ones
+void transcoder_close(transcoder_variant_handle_t variant);
+
+// Hands published frame to transcoder task, unless no variant is open or it is still busy with previous one.
+// Never blocks.
+void transcoder_add_frame(const uint8_t *buf, size_t len, uint32_t seq, int64_t timestamp);
+
+// Gives latest frame of variant newer than last_seq. When there is none yet, calling task is notified once it is
+// transcoded and NULL is returned. Frame has to be released.
+transcoder_frame_t *transcoder_acquire(transcoder_variant_handle_t variant, uint32_t last_seq);
+void transcoder_release(transcoder_frame_t *frame);
+
+void transcoder_get_stats(transcoder_stats_t *stats);
@@ -4,6 +4,7 @@
  */
 
 #include "string.h"
+#include "stdio.h"
 
 #include "esp_log.h"
 #include "esp_err.h"
@@ -11,8 +12,17 @@
 #include "mdns.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+#include "config_cache.h"
+#include "source_list.h"
+#include "control_worker.h"
+#include "metrics.h"
+#include "frame_pool.h"
+#include "playout.h"
+#include "source_sessions.h"
 #include "udps_handler.h"
 
 #define CONFIG_STREAMER_STACK_SIZE 4096
@@ -28,9 +38,41 @@
 
 #define CONFIG_STREAMER_MDNS_SERVER_NAME "espfsp_server"
 
+#define CONFIG_TRANSPORT_MONITOR_STACK_SIZE 4096
+#define CONFIG_TRANSPORT_MONITOR_PRIORITY 4
+
+// In auto mode UDP is dropped for TCP when fewer than given percent of expected frames is completed in every one
+// of consecutive windows
+#define CONFIG_TRANSPORT_AUTO_WINDOW_MS 2000
+#define CONFIG_TRANSPORT_AUTO_BAD_WINDOWS 3
+#define CONFIG_TRANSPORT_AUTO_MIN_COMPLETION 85
+
 static const char *TAG = "STREAMER_HANDLER";
 
 espfsp_client_play_handler_t client_handler = NULL;
+static frame_dispatcher_handle_t stream_dispatcher = NULL;
+
+// Taken for whole init, deinit and transport switch, so they never run over each other
+static SemaphoreHandle_t lifecycle_mutex = NULL;
+// Guards published client and holders of its dispatcher, held only briefly
+static SemaphoreHandle_t client_mutex = NULL;
+static int dispatcher_holders = 0;
+
+static struct esp_ip4_addr server_addr;
+static udps_transport_t transport_mode = UDPS_TRANSPORT_TCP;
+static volatile udps_transport_t current_transport = UDPS_TRANSPORT_TCP;
+static volatile uint32_t fallbacks = 0;
+static volatile int frame_completion = -1;
+
+static SemaphoreHandle_t monitor_done = NULL;
+static TaskHandle_t monitor = NULL;
+static volatile bool monitor_running = false;
+
+static const char *transport_names[] = {
+    [UDPS_TRANSPORT_TCP] = "tcp",
+    [UDPS_TRANSPORT_UDP] = "udp",
+    [UDPS_TRANSPORT_AUTO] = "auto",
+};
 
 static esp_err_t resolve_mdns_host(const char * host_name, struct esp_ip4_addr *addr)
 {
@@ -59,21 +101,48 @@ static esp_err_t resolve_mdns_host(const char * host_name, struct esp_ip4_addr *
 }
 
 
-esp_err_t udps_init(const char *server_ip_addr){
-    struct esp_ip4_addr server_addr;
-    if (strlen(server_ip_addr) == 0)
+static void client_stop(void)
+{
+    // Unpublished first, so handlers started from now on see client as gone
+    xSemaphoreTake(client_mutex, portMAX_DELAY);
+    espfsp_client_play_handler_t client = client_handler;
+    frame_dispatcher_handle_t dispatcher = stream_dispatcher;
+    client_handler = NULL;
+    stream_dispatcher = NULL;
+    xSemaphoreGive(client_mutex);
+
+    // Handlers that got dispatcher before give it back shortly
+    while (true)
     {
-        while (resolve_mdns_host(CONFIG_STREAMER_MDNS_SERVER_NAME, &server_addr) != ESP_OK)
+        xSemaphoreTake(client_mutex, portMAX_DELAY);
+        int holders = dispatcher_holders;
+        xSemaphoreGive(client_mutex);
+
+        if (holders == 0)
         {
-            vTaskDelay(10000 / portTICK_PERIOD_MS);
+            break;
         }
+        vTaskDelay(10 / portTICK_PERIOD_MS);
     }
-    else
+
+    // Sessions of other sources are connected to the same server module
+    source_sessions_close_all();
+    control_worker_deinit();
+    source_list_deinit();
+    if (dispatcher != NULL)
     {
-        server_addr.addr = esp_ip4addr_aton(server_ip_addr);
+        frame_dispatcher_deinit(dispatcher);
+    }
+    if (client != NULL)
+    {
+        espfsp_client_play_deinit(client);
     }
+}
 
-    espfsp_client_play_config_t streamer_config = {
+static void fill_client_config(espfsp_client_play_config_t *config, udps_transport_t data_transport,
+                               uint16_t local_control_port, uint16_t local_data_port)
+{
+    *config = (espfsp_client_play_config_t) {
         .data_task_info = {
             .stack_size = CONFIG_STREAMER_STACK_SIZE,
             .task_prio = CONFIG_STREAMER_PRIORITY,
@@ -83,14 +152,14 @@ esp_err_t udps_init(const char *server_ip_addr){
             .task_prio = CONFIG_STREAMER_PRIORITY,
         },
         .local = {
-            .control_port = CONFIG_STREAMER_PORT_CONTROL,
-            .data_port = CONFIG_STREAMER_PORT_DATA,
+            .control_port = local_control_port,
+            .data_port = local_data_port,
         },
         .remote = {
             .control_port = CONFIG_STREAMER_PORT_CONTROL,
             .data_port = CONFIG_STREAMER_PORT_DATA,
         },
-        .data_transport = ESPFSP_TRANSPORT_TCP,
+        .data_transport = data_transport == UDPS_TRANSPORT_UDP ? ESPFSP_TRANSPORT_UDP : ESPFSP_TRANSPORT_TCP,
         .remote_addr.addr = server_addr.addr,
         .frame_config = {
             .frame_max_len = CONFIG_STREAMER_FRAME_MAX_LENGTH,
@@ -99,18 +168,332 @@ esp_err_t udps_init(const char *server_ip_addr){
             .fb_in_buffer_before_get = CONFIG_STREAMER_FRAMSE_BEFORE_GET,
         },
     };
+}
+
+static esp_err_t client_start(udps_transport_t data_transport)
+{
+    espfsp_client_play_config_t streamer_config;
+    fill_client_config(&streamer_config, data_transport, CONFIG_STREAMER_PORT_CONTROL, CONFIG_STREAMER_PORT_DATA);
 
-    client_handler = espfsp_client_play_init(&streamer_config);
-    if (client_handler == NULL) {
+    espfsp_client_play_handler_t client = espfsp_client_play_init(&streamer_config);
+    if (client == NULL) {
         ESP_LOGE(TAG, "Client play ESPFSP init failed");
         return ESP_FAIL;
     }
 
+    frame_dispatcher_handle_t dispatcher = frame_dispatcher_init(client, true);
+    if (dispatcher == NULL) {
+        ESP_LOGE(TAG, "Frame dispatcher init failed");
+        espfsp_client_play_deinit(client);
+        return ESP_FAIL;
+    }
+
+    if (source_list_init(client) != ESP_OK) {
+        ESP_LOGE(TAG, "Source list init failed");
+        frame_dispatcher_deinit(dispatcher);
+        espfsp_client_play_deinit(client);
+        return ESP_FAIL;
+    }
+
+    if (control_worker_init(client, dispatcher) != ESP_OK) {
+        ESP_LOGE(TAG, "Control worker init failed");
+        source_list_deinit();
+        frame_dispatcher_deinit(dispatcher);
+        espfsp_client_play_deinit(client);
+        return ESP_FAIL;
+    }
+
+    current_transport = data_transport;
+    frame_pool_set_frame_max_len(CONFIG_STREAMER_FRAME_MAX_LENGTH);
+    playout_frame_config_applied(&streamer_config.frame_config, false);
+    frame_completion = -1;
+
+    // Published last, so handlers never see half initialized client
+    xSemaphoreTake(client_mutex, portMAX_DELAY);
+    stream_dispatcher = dispatcher;
+    client_handler = client;
+    xSemaphoreGive(client_mutex);
+
+    ESP_LOGI(TAG, "Client started with %s data transport", transport_names[data_transport]);
+    return ESP_OK;
+}
+
+// Reconnects over TCP and restores source, configuration and stream state of UDP session. Viewers are
+// disconnected, as frame dispatcher is started again for new client.
+static void fall_back_to_tcp(void)
+{
+    control_reconfigure_t restore = {0};
+    uint32_t version;
+
+    restore.has_source = config_cache_get_source(restore.source_name, sizeof(restore.source_name)) == ESP_OK;
+    restore.has_frame = config_cache_get_frame(&restore.frame_config, &version) == ESP_OK;
+    playout_stats_t playout;
+    playout_get_stats(&playout);
+    if (restore.has_frame && playout.adaptive)
+    {
+        restore.frame_config.fb_in_buffer_before_get = PLAYOUT_DEPTH_AUTO;
+    }
+    restore.has_cam = config_cache_get_cam(&restore.cam_config, &version) == ESP_OK;
+    bool restart = control_worker_is_stream_started();
+
+    xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+
+    client_stop();
+    esp_err_t ret = client_start(UDPS_TRANSPORT_TCP);
+    fallbacks++;
+
+    xSemaphoreGive(lifecycle_mutex);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Reconnecting over TCP failed");
+        return;
+    }
+
+    uint32_t id;
+    if (restore.has_source || restore.has_frame || restore.has_cam)
+    {
+        control_cmd_t cmd = { .type = CONTROL_CMD_RECONFIGURE, .reconfigure = restore };
+        control_worker_submit(&cmd, &id);
+    }
+    if (restart)
+    {
+        control_cmd_t cmd = { .type = CONTROL_CMD_START_STREAM };
+        control_worker_submit(&cmd, &id);
+    }
+}
+
+static uint32_t expected_fps(void)
+{
+    espfsp_frame_config_t frame_config;
+    uint32_t version;
+
+    if (config_cache_get_frame(&frame_config, &version) == ESP_OK)
+    {
+        return frame_config.fps;
+    }
+
+    return CONFIG_STREAMER_FPS;
+}
+
+// Frame completion is measured as frames received against frames expected from configured fps. ESPFSP drops
+// frames with lost fragments, so on UDP it falls with packet loss.
+static void transport_monitor_task(void *pvParameters)
+{
+    uint32_t last_frames = metrics_get_frames_received();
+    int bad_windows = 0;
+
+    while (monitor_running)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_TRANSPORT_AUTO_WINDOW_MS));
+        if (!monitor_running)
+        {
+            break;
+        }
+
+        uint32_t frames = metrics_get_frames_received();
+        uint32_t received = frames - last_frames;
+        last_frames = frames;
+
+        if (client_handler == NULL || !control_worker_is_stream_started())
+        {
+            frame_completion = -1;
+            bad_windows = 0;
+            continue;
+        }
+
+        uint32_t expected = expected_fps() * CONFIG_TRANSPORT_AUTO_WINDOW_MS / 1000;
+        frame_completion = expected == 0 || received >= expected ? 100 : (int) (received * 100 / expected);
+
+        if (current_transport != UDPS_TRANSPORT_UDP)
+        {
+            continue;
+        }
+
+        bad_windows = frame_completion < CONFIG_TRANSPORT_AUTO_MIN_COMPLETION ? bad_windows + 1 : 0;
+        if (bad_windows >= CONFIG_TRANSPORT_AUTO_BAD_WINDOWS)
+        {
+            ESP_LOGW(TAG, "Only %d%% of frames completed over UDP, falling back to TCP", frame_completion);
+            bad_windows = 0;
+            fall_back_to_tcp();
+            last_frames = metrics_get_frames_received();
+        }
+    }
+
+    xSemaphoreGive(monitor_done);
+    vTaskDelete(NULL);
+}
+
+static void monitor_stop(void)
+{
+    if (!monitor_running)
+    {
+        return;
+    }
+
+    monitor_running = false;
+    xTaskNotifyGive(monitor);
+    xSemaphoreTake(monitor_done, portMAX_DELAY);
+    monitor = NULL;
+}
+
+esp_err_t udps_init(const char *server_ip_addr, udps_transport_t mode){
+    if (lifecycle_mutex == NULL)
+    {
+        lifecycle_mutex = xSemaphoreCreateMutex();
+        client_mutex = xSemaphoreCreateMutex();
+        monitor_done = xSemaphoreCreateBinary();
+        if (lifecycle_mutex == NULL || client_mutex == NULL || monitor_done == NULL)
+        {
+            ESP_LOGE(TAG, "Semaphores creation failed");
+            return ESP_FAIL;
+        }
+    }
+
+    xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+
+    if (client_handler != NULL)
+    {
+        xSemaphoreGive(lifecycle_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (strlen(server_ip_addr) == 0)
+    {
+        while (resolve_mdns_host(CONFIG_STREAMER_MDNS_SERVER_NAME, &server_addr) != ESP_OK)
+        {
+            vTaskDelay(10000 / portTICK_PERIOD_MS);
+        }
+    }
+    else
+    {
+        server_addr.addr = esp_ip4addr_aton(server_ip_addr);
+    }
+
+    transport_mode = mode;
+    fallbacks = 0;
+
+    // Sources of previous server module are gone
+    config_cache_reset();
+
+    // Auto mode starts on UDP, as it has no head-of-line blocking, and keeps TCP for lossy links
+    esp_err_t ret = client_start(mode == UDPS_TRANSPORT_TCP ? UDPS_TRANSPORT_TCP : UDPS_TRANSPORT_UDP);
+    xSemaphoreGive(lifecycle_mutex);
+
+    if (ret != ESP_OK || mode != UDPS_TRANSPORT_AUTO)
+    {
+        return ret;
+    }
+
+    monitor_running = true;
+    BaseType_t xStatus = xTaskCreate(
+        transport_monitor_task,
+        "transport_monitor",
+        CONFIG_TRANSPORT_MONITOR_STACK_SIZE,
+        NULL,
+        CONFIG_TRANSPORT_MONITOR_PRIORITY,
+        &monitor);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Transport monitor task creation failed");
+        monitor_running = false;
+        udps_deinit();
+        return ESP_FAIL;
+    }
+
     return ESP_OK;
 }
 
 esp_err_t udps_deinit()
 {
-    espfsp_client_play_deinit(client_handler);
+    if (lifecycle_mutex == NULL)
+    {
+        return ESP_OK;
+    }
+
+    // Monitor is stopped first, as it may be switching transport
+    monitor_stop();
+
+    xSemaphoreTake(lifecycle_mutex, portMAX_DELAY);
+    client_stop();
+    xSemaphoreGive(lifecycle_mutex);
+
+    return ESP_OK;
+}
+
+void udps_get_status(udps_status_t *status)
+{
+    memset(status, 0, sizeof(*status));
+
+    status->connected = client_handler != NULL;
+    if (status->connected)
+    {
+        snprintf(status->server_addr, sizeof(status->server_addr), IPSTR, IP2STR(&server_addr));
+    }
+    status->mode = transport_mode;
+    status->transport = current_transport;
+    status->fallbacks = fallbacks;
+    status->frame_completion = frame_completion;
+}
+
+frame_dispatcher_handle_t udps_acquire_dispatcher(void)
+{
+    // Created with lifecycle mutex, before any client is started
+    if (client_mutex == NULL)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(client_mutex, portMAX_DELAY);
+    frame_dispatcher_handle_t dispatcher = stream_dispatcher;
+    if (dispatcher != NULL)
+    {
+        dispatcher_holders++;
+    }
+    xSemaphoreGive(client_mutex);
+
+    return dispatcher;
+}
+
+void udps_release_dispatcher(frame_dispatcher_handle_t dispatcher)
+{
+    if (dispatcher == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(client_mutex, portMAX_DELAY);
+    dispatcher_holders--;
+    xSemaphoreGive(client_mutex);
+}
+
+esp_err_t udps_get_session_config(uint16_t local_control_port, uint16_t local_data_port,
+                                  espfsp_client_play_config_t *config)
+{
+    if (client_handler == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    fill_client_config(config, current_transport, local_control_port, local_data_port);
     return ESP_OK;
 }
+
+const char *udps_transport_name(udps_transport_t transport)
+{
+    return transport_names[transport];
+}
+
+esp_err_t udps_transport_from_name(const char *name, udps_transport_t *transport)
+{
+    for (int i = 0; i < sizeof(transport_names) / sizeof(transport_names[0]); ++i)
+    {
+        if (strcmp(name, transport_names[i]) == 0)
+        {
+            *transport = (udps_transport_t) i;
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
@@ -5,9 +5,48 @@
 
 #pragma once
 
+#include "stdbool.h"
+#include "stdint.h"
+
+#include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+
 typedef int esp_err_t;
 
+typedef enum
+{
+    UDPS_TRANSPORT_TCP,
+    UDPS_TRANSPORT_UDP,
+    UDPS_TRANSPORT_AUTO, // Starts on UDP and falls back to TCP when too many frames are lost
+} udps_transport_t;
+
+typedef struct
+{
+    bool connected;
+    char server_addr[16];
+    udps_transport_t mode;
+    udps_transport_t transport; // TCP or UDP, the one in use
+    uint32_t fallbacks;
+    int frame_completion; // Percent of expected frames received in last window, -1 when not measured
+} udps_status_t;
+
 // server_ip_addr = "" for local server module, then MDNS name should be 'espfsp_server'
 // server_ip_addr = <IP> for remote server module;
-esp_err_t udps_init(const char *server_ip_addr);
+// Returns ESP_ERR_INVALID_STATE when client is already started.
+esp_err_t udps_init(const char *server_ip_addr, udps_transport_t mode);
 esp_err_t udps_deinit();
+
+void udps_get_status(udps_status_t *status);
+
+// Gives dispatcher of main client, or NULL when client is not started. Client is not stopped, e.g. by fallback to
+// TCP, until dispatcher is released, so it has to be held only for the time of a call and never across waits.
+frame_dispatcher_handle_t udps_acquire_dispatcher(void);
+void udps_release_dispatcher(frame_dispatcher_handle_t dispatcher);
+
+// Fills configuration of additional client connected to the same server module over data transport in use, with
+// its own local ports. Returns ESP_ERR_INVALID_STATE when main client is not started.
+esp_err_t udps_get_session_config(uint16_t local_control_port, uint16_t local_data_port,
+                                  espfsp_client_play_config_t *config);
+
+const char *udps_transport_name(udps_transport_t transport);
+esp_err_t udps_transport_from_name(const char *name, udps_transport_t *transport);
@@ -0,0 +1,15 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "stddef.h"
+
+#include "static_assets.h"
+
+// Manifest of files under main/web, generated by web_assets.py during build. Every file has gzip variant and,
+// when brotli was available to build, brotli one.
+extern static_asset_t web_assets[];
+extern const size_t web_assets_count;
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# Home monitoring system
+# Author: Maksymilian Komarnicki
+#
+# Embeds every file under web assets directory into C source with manifest table of static_asset_t, which is served
+# by static_assets module. Text assets are minified first. Each asset is stored gzip compressed and, when brotli is
+# available (Python module or command), brotli compressed too. Run by build from main/CMakeLists.txt, so generated
+# source always matches assets.
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+    ".txt": "text/plain",
+}
+
+HASH_LEN = 16
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};,])\s*", r"\1", text)
+    return re.sub(r":\s+", ":", text).replace(";}", "}").strip()
+
+
+def minify_js(text):
+    """Only drops indentation, blank lines and whole line comments, which is safe without parsing JS. Lines inside
+    multiline template literals are kept as they are."""
+    lines = []
+    in_template = False
+    for line in text.split("\n"):
+        stripped = line if in_template else line.strip()
+        if not in_template and (not stripped or stripped.startswith("//")):
+            continue
+        lines.append(stripped)
+        if len(re.findall(r"(?<!\\)`", line)) % 2:
+            in_template = not in_template
+    return "\n".join(lines)
+
+
+def minify_html(text):
+    text = re.sub(r"<!--(?!\[).*?-->", "", text, flags=re.S)
+    parts = re.split(r"(<(script|style|pre|textarea)\b[^>]*>.*?</\2>)", text, flags=re.S | re.I)
+    result = []
+    # re.split puts whole matched element and tag name after every text part
+    for i in range(0, len(parts), 3):
+        # Whitespace between elements is rendered as single space at most, so runs of it are collapsed
+        result.append(re.sub(r"\s+", " ", parts[i]))
+        if i + 1 < len(parts):
+            element, tag = parts[i + 1], parts[i + 2].lower()
+            open_end = element.index(">") + 1
+            close_start = element.rindex("<")
+            body = element[open_end:close_start]
+            if tag == "script":
+                body = minify_js(body)
+            elif tag == "style":
+                body = minify_css(body)
+            result.append(element[:open_end] + body + element[close_start:])
+    return "".join(result).strip()
+
+
+MINIFIERS = {".html": minify_html, ".css": minify_css, ".js": minify_js}
+
+
+def brotli_compress(data):
+    try:
+        import brotli
+        return brotli.compress(data, quality=11)
+    except ImportError:
+        pass
+    if shutil.which("brotli"):
+        return subprocess.run(["brotli", "-c", "-q", "11", "-"], input=data, stdout=subprocess.PIPE,
+                              check=True).stdout
+    return None
+
+
+def c_bytes(data):
+    return ",\n".join("    " + ", ".join(f"0x{byte:02x}" for byte in data[i:i + 16]) for i in range(0, len(data), 16))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--root", required=True, help="web assets directory")
+    parser.add_argument("--output", required=True, help="generated C source")
+    parser.add_argument("--no-brotli", action="store_true")
+    args = parser.parse_args()
+
+    assets = []
+    for directory, _, files in sorted(os.walk(args.root)):
+        for name in sorted(files):
+            path = os.path.join(directory, name)
+            extension = os.path.splitext(name)[1].lower()
+            if extension not in CONTENT_TYPES:
+                sys.exit(f"{path}: unknown content type")
+            with open(path, "rb") as f:
+                data = f.read()
+            if extension in MINIFIERS:
+                data = MINIFIERS[extension](data.decode("utf-8")).encode("utf-8")
+            url = "/" + os.path.relpath(path, args.root).replace(os.sep, "/")
+            assets.append((url, CONTENT_TYPES[extension], data))
+
+    if not args.no_brotli and brotli_compress(b"") is None:
+        print("web_assets: brotli not available, only gzip variants are embedded", file=sys.stderr)
+        args.no_brotli = True
+
+    arrays = []
+    entries = []
+    for url, content_type, data in assets:
+        content_hash = hashlib.sha256(data).hexdigest()[:HASH_LEN]
+        variants = [("STATIC_ASSET_GZIP", gzip.compress(data, 9, mtime=0))]
+        if not args.no_brotli:
+            variants.append(("STATIC_ASSET_BR", brotli_compress(data)))
+
+        for encoding, encoded in variants:
+            symbol = f"asset_{len(arrays)}"
+            arrays.append(f"// {url}, {encoding}\nstatic const uint8_t {symbol}[] = {{\n{c_bytes(encoded)}\n}};\n")
+            entries.append(
+                f"    {{\n"
+                f"        .path = \"{url}\",\n"
+                f"        .content_type = \"{content_type}\",\n"
+                f"        .encoding = {encoding},\n"
+                f"        .data = {symbol},\n"
+                f"        .len = sizeof({symbol}),\n"
+                f"        .hash = \"{content_hash}\",\n"
+                f"    }},\n")
+        sizes = ", ".join(f"{encoding[13:].lower()} {len(encoded)}" for encoding, encoded in variants)
+        print(f"web_assets: {url} {len(data)} bytes minified, {sizes}")
+
+    source = (
+        "/*\n * Generated by web_assets.py, do not edit\n */\n\n"
+        "#include \"web_assets.h\"\n\n"
+        + "\n".join(arrays)
+        + "\nstatic_asset_t web_assets[] = {\n" + "".join(entries) + "};\n\n"
+        + f"const size_t web_assets_count = {len(entries)};\n")
+
+    with open(args.output, "w") as f:
+        f.write(source)
+
+
+if __name__ == "__main__":
+    main()
@@ -4,6 +4,7 @@
  */
 
 #include "string.h"
+#include "stdlib.h"
 
 #include "esp_log.h"
 #include "esp_err.h"
@@ -11,18 +12,90 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-#include "lwip/ip_addr.h"
+#include "sys/socket.h"
+#include "arpa/inet.h"
+#include "unistd.h"
 #include "esp_timer.h"
 #include "esp_http_server.h"
+#include "cJSON.h"
 
-#include "index_html_gz.h"
 #include "espfsp_client_play.h"
+#include "frame_dispatcher.h"
+#include "config_cache.h"
+#include "source_list.h"
+#include "control_worker.h"
+#include "metrics.h"
 #include "udps_handler.h"
+#include "frame_pool.h"
+#include "playout.h"
+#include "static_assets.h"
+#include "web_assets.h"
+#include "recorder.h"
+#include "playback.h"
+#include "motion.h"
+#include "transcoder.h"
+#include "replay.h"
+#include "source_sessions.h"
+#include "mosaic.h"
+
+// Host build runs as unprivileged process, so it cannot bind port 80. Stream server always listens on next port.
+#ifdef CONFIG_IDF_TARGET_LINUX
+#define CONFIG_WEB_SERVER_PORT 8080
+#else
+#define CONFIG_WEB_SERVER_PORT 80
+#endif
+
+#define CONFIG_REPLAY_DEFAULT_SECONDS 30
+#define CONFIG_REPLAY_MAX_SECONDS 600
+#define CONFIG_REPLAY_MIN_SPEED 0.1f
+#define CONFIG_REPLAY_MAX_SPEED 16.0f
+#define CONFIG_REPLAY_MAX_FPS 30
+
+#define CONFIG_MOSAIC_DEFAULT_SCALE 2
+#define CONFIG_MOSAIC_DEFAULT_FPS 2
+#define CONFIG_MOSAIC_MAX_FPS 10
+
+#define CONFIG_RECORDINGS_DEFAULT_COUNT 100
+#define CONFIG_RECORDINGS_MAX_COUNT 500
+
+#define CONFIG_RECONFIGURE_MAX_BODY_LEN 512
+#define CONFIG_RECONFIGURE_MAX_FPS 60
+#define CONFIG_RECONFIGURE_MAX_FRAME_LEN (1024 * 1024)
+#define CONFIG_RECONFIGURE_MAX_BUFFERED_FBS 32
+#define CONFIG_RECONFIGURE_MAX_JPEG_QUALITY 63
+#define CONFIG_RECONFIGURE_MAX_ENUM 31
 
 static const char *TAG = "WEB_HANDLER";
 
 extern espfsp_client_play_handler_t client_handler;
 
+// Queues command for control worker and answers with its ID, which can be polled on /get_command
+static esp_err_t submit_command(httpd_req_t *req, const control_cmd_t *cmd) {
+    uint32_t id;
+
+    esp_err_t ret = control_worker_submit(cmd, &id);
+    if (ret == ESP_ERR_NO_MEM)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+    if (ret != ESP_OK)
+    {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char json_response[32];
+    snprintf(json_response, sizeof(json_response), "{\"id\": %lu}", (unsigned long) id);
+
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+}
+
 esp_err_t start_stream_handler(httpd_req_t *req) {
     if (client_handler == NULL)
     {
@@ -30,408 +103,1838 @@ esp_err_t start_stream_handler(httpd_req_t *req) {
         return ESP_OK;
     }
 
-    esp_err_t ret = espfsp_client_play_start_stream(client_handler);
-    if (ret == ESP_OK)
+    control_cmd_t cmd = { .type = CONTROL_CMD_START_STREAM };
+    return submit_command(req, &cmd);
+}
+
+esp_err_t stop_stream_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
     {
-        httpd_resp_send(req, "Stream started", HTTPD_RESP_USE_STRLEN);
-        return ret;
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
     }
 
-    httpd_resp_send_500(req);
-    return ESP_OK;
+    control_cmd_t cmd = { .type = CONTROL_CMD_STOP_STREAM };
+    return submit_command(req, &cmd);
 }
 
-esp_err_t stop_stream_handler(httpd_req_t *req) {
+esp_err_t get_command_handler(httpd_req_t *req) {
     if (client_handler == NULL)
     {
         httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
         return ESP_OK;
     }
 
-    esp_err_t ret = espfsp_client_play_stop_stream(client_handler);
-    if (ret == ESP_OK)
+    char query[128];
+    char id[16] = {0};
+    char wait[16] = {0};
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "id", id, sizeof(id));
+            httpd_query_key_value(query, "wait", wait, sizeof(wait));
+        }
+    }
+
+    if (strlen(id) == 0)
     {
-        httpd_resp_send(req, "Stream stopped", HTTPD_RESP_USE_STRLEN);
-        return ret;
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_OK;
     }
 
-    httpd_resp_send_500(req);
-    return ESP_OK;
+    // With 'wait' request is answered by control worker once command is finished, without blocking this server
+    return control_worker_wait_status(req, strtoul(id, NULL, 10), strtoul(wait, NULL, 10));
 }
 
 esp_err_t stream_handler(httpd_req_t *req) {
-    char part_buf[64];
-
-    httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    char query[96];
+    char src[30] = {0};
+    char scale_str[8] = {0};
+    char quality_str[8] = {0};
+    char fps_str[8] = {0};
+    uint32_t scale = 1;
+    uint32_t quality = 0;
+    uint32_t fps = 0;
 
-    while (true) {
-        if (client_handler == NULL)
-        {
-            break;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            if (httpd_query_key_value(query, "scale", scale_str, sizeof(scale_str)) == ESP_OK) {
+                scale = strtoul(scale_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "q", quality_str, sizeof(quality_str)) == ESP_OK) {
+                quality = strtoul(quality_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "fps", fps_str, sizeof(fps_str)) == ESP_OK) {
+                fps = strtoul(fps_str, NULL, 10);
+            }
+            httpd_query_key_value(query, "src", src, sizeof(src));
         }
+    }
 
-        espfsp_fb_t *fb = espfsp_client_play_get_fb(client_handler, 400);
-        if (!fb)
-        {
-            // Delay to feed WD
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            continue;
-        }
+    // Smaller variants are made in DCT domain, which merges whole blocks, so only power of two scales are offered
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "scale");
+        return ESP_OK;
+    }
+    if (strlen(quality_str) > 0 && (quality < 1 || quality > 100))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "q");
+        return ESP_OK;
+    }
+    // Only lowers frame rate for this viewer, frames are still pulled from server module at configured fps
+    if (strlen(fps_str) > 0 && (fps < 1 || fps > CONFIG_RECONFIGURE_MAX_FPS))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "fps");
+        return ESP_OK;
+    }
 
-        size_t hlen = snprintf(part_buf, sizeof(part_buf),
-                               "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %zu\r\n\r\n",
-                               fb->len);
-        if (httpd_resp_send_chunk(req, part_buf, hlen) != ESP_OK) {
-            espfsp_client_play_return_fb(client_handler, fb);
-            ESP_LOGE(TAG, "Send HTTP response header failed");
-            break;
-        }
+    frame_viewer_options_t options = { .scale = scale, .quality = quality, .fps = fps };
 
-        if (httpd_resp_send_chunk(req, (const char *)fb->buf, fb->len) != ESP_OK) {
-            espfsp_client_play_return_fb(client_handler, fb);
-            ESP_LOGE(TAG, "Send HTTP response failed");
-            break;
-        }
+    // Dispatchers are held only until viewer is added, as sender task of viewer is stopped with dispatcher
+    frame_dispatcher_handle_t primary = udps_acquire_dispatcher();
+    if (primary == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
 
-        esp_err_t ret = espfsp_client_play_return_fb(client_handler, fb);
+    // Other sources than selected one are served by sessions of their own
+    frame_dispatcher_handle_t dispatcher = primary;
+    if (strlen(src) > 0)
+    {
+        esp_err_t ret = source_sessions_acquire(src, &dispatcher);
         if (ret != ESP_OK)
         {
-            break;
+            udps_release_dispatcher(primary);
         }
-
-        if (httpd_resp_send_chunk(req, "\r\n", 2) != ESP_OK) {
-            ESP_LOGE(TAG, "Send HTTP Response end failed");
-            break;
+        if (ret == ESP_ERR_NO_MEM)
+        {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_set_hdr(req, "Retry-After", "15");
+            return httpd_resp_sendstr(req, "No room for another source session");
+        }
+        if (ret != ESP_OK)
+        {
+            httpd_resp_send_err(req, ret == ESP_ERR_INVALID_ARG ? HTTPD_400_BAD_REQUEST : HTTPD_403_FORBIDDEN,
+                                ret == ESP_ERR_INVALID_ARG ? "src" : NULL);
+            return ESP_OK;
         }
+    }
 
-        // Delay to feed WD. No more than 100fps will be displayed
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+    // Frames are sent from dispatcher sender task, so this server can accept other viewers meanwhile
+    esp_err_t ret = frame_dispatcher_add_viewer(dispatcher, req, &options);
+    if (strlen(src) > 0)
+    {
+        source_sessions_release(dispatcher);
     }
+    if (ret == ESP_ERR_NOT_SUPPORTED)
+    {
+        // Transcoder is fed by main client only
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, dispatcher != primary ?
+                            "Transcoding is offered for selected source only" : "Transcoding is disabled");
+        ret = ESP_OK;
+    }
+    udps_release_dispatcher(primary);
 
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    return ret;
 }
 
-esp_err_t index_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-    httpd_resp_send(req, (const char *)index_html_gz, index_html_gz_len);
-    return ESP_OK;
+// Answers request that found every sender slot taken. Slots are freed as viewers leave, so it can be retried.
+static esp_err_t send_no_free_slot(httpd_req_t *req, const char *message) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "5");
+    return httpd_resp_sendstr(req, message);
 }
 
-esp_err_t get_src_handler(httpd_req_t *req) {
+// Latest frames of several sources composed into one grid, streamed from mosaic sender task
+esp_err_t mosaic_handler(httpd_req_t *req) {
     if (client_handler == NULL)
     {
         httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
         return ESP_OK;
     }
 
-    char sources_names[5][30];
-    int sources_names_len = 5;
+    char query[192];
+    char src[MOSAIC_MAX_TILES * MOSAIC_SOURCE_NAME_LEN] = {0};
+    char cols_str[8] = {0};
+    char scale_str[8] = {0};
+    char fps_str[8] = {0};
+    uint32_t scale = CONFIG_MOSAIC_DEFAULT_SCALE;
+    uint32_t fps = CONFIG_MOSAIC_DEFAULT_FPS;
+    uint32_t cols = 0;
 
-    esp_err_t ret = espfsp_client_play_get_sources_timeout(client_handler, sources_names, &sources_names_len, 1000);
-    if (ret != ESP_OK)
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "src", src, sizeof(src));
+            if (httpd_query_key_value(query, "cols", cols_str, sizeof(cols_str)) == ESP_OK) {
+                cols = strtoul(cols_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "scale", scale_str, sizeof(scale_str)) == ESP_OK) {
+                scale = strtoul(scale_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "fps", fps_str, sizeof(fps_str)) == ESP_OK) {
+                fps = strtoul(fps_str, NULL, 10);
+            }
+        }
+    }
+
+    // Sources are given as comma separated names
+    char sources[MOSAIC_MAX_TILES][MOSAIC_SOURCE_NAME_LEN] = {0};
+    int count = 0;
+    char *saveptr = NULL;
+    for (char *name = strtok_r(src, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
     {
-        httpd_resp_send(req, NULL, 0);
+        if (count == MOSAIC_MAX_TILES || strlen(name) >= MOSAIC_SOURCE_NAME_LEN)
+        {
+            count = 0;
+            break;
+        }
+        strcpy(sources[count++], name);
+    }
+
+    if (count == 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "src");
+        return ESP_OK;
+    }
+    // Two columns make square grid of four tiles
+    cols = strlen(cols_str) > 0 ? cols : (count == 1 ? 1 : 2);
+    if (cols < 1 || cols > MOSAIC_MAX_TILES)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "cols");
+        return ESP_OK;
+    }
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "scale");
+        return ESP_OK;
+    }
+    if (fps < 1 || fps > CONFIG_MOSAIC_MAX_FPS)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "fps");
         return ESP_OK;
     }
 
-    char json_response[512];
-    char *ptr = json_response;
+    esp_err_t ret = mosaic_add_viewer(req, sources, count, cols, scale, fps);
+    if (ret == ESP_ERR_NOT_SUPPORTED)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Mosaic is disabled");
+        return ESP_OK;
+    }
+    if (ret == ESP_ERR_NO_MEM)
+    {
+        return send_no_free_slot(req, "No free mosaic viewer slot");
+    }
+
+    return ret;
+}
 
-    ptr += sprintf(ptr, "[");
+// Last frames kept in replay ring, streamed from replay sender task alongside live viewers
+esp_err_t replay_handler(httpd_req_t *req) {
+    char query[64];
+    char seconds_str[8] = {0};
+    char speed_str[8] = {0};
+    uint32_t seconds = CONFIG_REPLAY_DEFAULT_SECONDS;
+    float speed = 1.0f;
 
-    for (size_t i = 0; i < sources_names_len; ++i) {
-        ptr += sprintf(ptr, "\"%s\"", sources_names[i]);
-        if (i < sources_names_len - 1) {
-            ptr += sprintf(ptr, ",");
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            if (httpd_query_key_value(query, "seconds", seconds_str, sizeof(seconds_str)) == ESP_OK) {
+                seconds = strtoul(seconds_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "speed", speed_str, sizeof(speed_str)) == ESP_OK) {
+                speed = strtof(speed_str, NULL);
+            }
         }
     }
 
-    sprintf(ptr, "]");
+    if (seconds == 0 || seconds > CONFIG_REPLAY_MAX_SECONDS)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "seconds");
+        return ESP_OK;
+    }
+    if (!(speed >= CONFIG_REPLAY_MIN_SPEED && speed <= CONFIG_REPLAY_MAX_SPEED))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "speed");
+        return ESP_OK;
+    }
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = replay_add_viewer(req, seconds, speed);
+    if (ret == ESP_ERR_NOT_SUPPORTED)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Replay is disabled");
+        return ESP_OK;
+    }
+    if (ret == ESP_ERR_NO_MEM)
+    {
+        return send_no_free_slot(req, "No free replay viewer slot");
+    }
 
-    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+    return ret;
 }
 
-static bool is_valid_ip(const char *ip_addr_str) {
-    ip_addr_t addr;
-    return ipaddr_aton(ip_addr_str, &addr) != 0;
-}
+// Frame rate stored in replay ring, lower one keeps longer history in the same memory
+esp_err_t set_replay_handler(httpd_req_t *req) {
+    char query[32];
+    char max_fps[8] = {0};
 
-esp_err_t set_server_handler(httpd_req_t *req) {
-    if (client_handler != NULL)
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "max_fps", max_fps, sizeof(max_fps));
+        }
+    }
+
+    uint32_t fps = strtoul(max_fps, NULL, 10);
+    if (fps == 0 || fps > CONFIG_REPLAY_MAX_FPS)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "max_fps");
         return ESP_OK;
     }
 
-    char query[128];
-    char server_ip_addr[30];
-    memset(server_ip_addr, 0, sizeof(server_ip_addr));
+    replay_set_max_fps(fps);
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_sendstr(req, "OK");
+}
+
+// Detector state, configuration and kept events newer than 'after'
+esp_err_t motion_handler(httpd_req_t *req) {
+    char query[32];
+    char after_str[12] = {0};
 
     size_t query_len = httpd_req_get_url_query_len(req) + 1;
     if (query_len > 1) {
         if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-            ESP_LOGI("QUERY", "Query string: %s", query);
-
-            if (httpd_query_key_value(query, "name", server_ip_addr, sizeof(server_ip_addr)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'server_ip_addr': %s", server_ip_addr);
-            }
+            httpd_query_key_value(query, "after", after_str, sizeof(after_str));
         }
     }
 
-    if (strlen(server_ip_addr) == 0 || is_valid_ip(server_ip_addr))
-    {
-        esp_err_t ret = udps_init(server_ip_addr);
-        if (ret != ESP_OK)
-        {
-            httpd_resp_send_500(req);
-            return ESP_OK;
-        }
+    motion_stats_t motion;
+    motion_config_t config;
+    motion_get_stats(&motion);
+    motion_get_config(&config);
 
-        httpd_resp_send(req, NULL, 0);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char line[192];
+    char *ptr = line;
+    ptr += sprintf(ptr, "{\"enabled\": %s, \"active\": %s, ", motion.enabled ? "true" : "false",
+                   motion.active ? "true" : "false");
+    ptr += sprintf(ptr, "\"zones\": %lu, \"score\": %.3f, ", (unsigned long) motion.zone_mask,
+                   motion.score_permille / 1000.0);
+    ptr += sprintf(ptr, "\"sensitivity\": %d, \"min_area\": %.3f, \"zone_list\": [", config.sensitivity,
+                   config.min_area_permille / 1000.0);
+    esp_err_t ret = httpd_resp_send_chunk(req, line, ptr - line);
+
+    for (int i = 0; i < config.zones_count && ret == ESP_OK; ++i) {
+        int len = snprintf(line, sizeof(line), "%s[%d, %d, %d, %d]", i > 0 ? ", " : "", config.zones[i].x,
+                           config.zones[i].y, config.zones[i].w, config.zones[i].h);
+        ret = httpd_resp_send_chunk(req, line, len);
     }
-    else
-    {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, "], \"events\": [", HTTPD_RESP_USE_STRLEN);
     }
 
-    return ESP_OK;
+    motion_event_t event;
+    uint32_t after = strtoul(after_str, NULL, 10);
+    bool separator = false;
+    while (ret == ESP_OK && motion_get_events(after, &event, 1) == 1) {
+        int len = separator ? sprintf(line, ", ") : 0;
+        len += motion_format_event(&event, line + len, sizeof(line) - len);
+        ret = httpd_resp_send_chunk(req, line, len);
+        after = event.id;
+        separator = true;
+    }
+
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, "]}", 2);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    return ret;
 }
 
-esp_err_t set_src_handler(httpd_req_t *req) {
-    if (client_handler == NULL)
+// Zones are given as 'x,y,w,h' rectangles in percent of frame, separated by ';', or 'none' for whole frame
+static bool parse_zones(const char *str, motion_config_t *config)
+{
+    config->zones_count = 0;
+    if (strcmp(str, "none") == 0)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
-        return ESP_OK;
+        return true;
     }
 
-    char query[128];
-    char name[30];
+    while (*str != '\0')
+    {
+        unsigned int x, y, w, h;
+        int consumed;
+        if (config->zones_count == MOTION_DETECTOR_MAX_ZONES ||
+            sscanf(str, "%u,%u,%u,%u%n", &x, &y, &w, &h, &consumed) != 4 || x > 100 || y > 100 || w > 100 ||
+            h > 100)
+        {
+            return false;
+        }
+
+        motion_zone_t *zone = &config->zones[config->zones_count++];
+        zone->x = x;
+        zone->y = y;
+        zone->w = w;
+        zone->h = h;
+
+        str += consumed;
+        if (*str == ';')
+        {
+            str++;
+        }
+        else if (*str != '\0')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+esp_err_t set_motion_handler(httpd_req_t *req) {
+    char query[160];
+    char enabled_str[4] = {0};
+    char sensitivity_str[8] = {0};
+    char min_area_str[8] = {0};
+    char zones_str[96] = {0};
 
     size_t query_len = httpd_req_get_url_query_len(req) + 1;
     if (query_len > 1) {
         if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-            ESP_LOGI("QUERY", "Query string: %s", query);
-
-            if (httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'name': %s", name);
-            }
+            httpd_query_key_value(query, "enabled", enabled_str, sizeof(enabled_str));
+            httpd_query_key_value(query, "sensitivity", sensitivity_str, sizeof(sensitivity_str));
+            httpd_query_key_value(query, "min_area", min_area_str, sizeof(min_area_str));
+            httpd_query_key_value(query, "zones", zones_str, sizeof(zones_str));
         }
     }
 
-    esp_err_t ret = espfsp_client_play_set_source(client_handler, name);
-    if (ret != ESP_OK)
+    motion_config_t config;
+    motion_get_config(&config);
+
+    if (strlen(sensitivity_str) > 0)
     {
-        httpd_resp_send_500(req);
+        config.sensitivity = strtoul(sensitivity_str, NULL, 10);
+    }
+    if (strlen(min_area_str) > 0)
+    {
+        // Part of zone, 0-1
+        float min_area = strtof(min_area_str, NULL);
+        config.min_area_permille = min_area >= 0.0f && min_area <= 1.0f ? (uint16_t) (min_area * 1000.0f) : 1001;
+    }
+    if (strlen(zones_str) > 0 && !parse_zones(zones_str, &config))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "zones");
+        return ESP_OK;
+    }
+    if (motion_set_config(&config) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
         return ESP_OK;
     }
 
-    httpd_resp_send(req, NULL, 0);
-    return ESP_OK;
+    if (strlen(enabled_str) > 0)
+    {
+        motion_set_enabled(strcmp(enabled_str, "0") != 0);
+    }
+
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_sendstr(req, "OK");
 }
 
-esp_err_t set_frame_handler(httpd_req_t *req) {
-    if (client_handler == NULL)
+// Motion events as Server-Sent Events, sent from detector task. Reconnecting EventSource passes last event it got
+// in Last-Event-ID, so events kept meanwhile are sent first.
+esp_err_t motion_events_handler(httpd_req_t *req) {
+    char last_event_id[12] = {0};
+    char query[32];
+
+    if (httpd_req_get_hdr_value_str(req, "Last-Event-ID", last_event_id, sizeof(last_event_id)) != ESP_OK) {
+        size_t query_len = httpd_req_get_url_query_len(req) + 1;
+        if (query_len > 1 && httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "last_id", last_event_id, sizeof(last_event_id));
+        }
+    }
+
+    // Without any, only new events are sent
+    motion_event_t newest;
+    uint32_t last_id = strtoul(last_event_id, NULL, 10);
+    if (strlen(last_event_id) == 0) {
+        while (motion_get_events(last_id, &newest, 1) == 1) {
+            last_id = newest.id;
+        }
+    }
+
+    esp_err_t ret = motion_add_subscriber(req, last_id);
+    if (ret == ESP_ERR_NOT_SUPPORTED)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Motion detection is disabled");
         return ESP_OK;
     }
 
-    espfsp_frame_config_t frame_config = {
-        .fps = 1,
-        .frame_max_len = (100 * 1014),
-        .buffered_fbs = 10,
-        .fb_in_buffer_before_get = 0,
-    };
+    return ret;
+}
+
+// Wall clock time given as Unix seconds, possibly fractional, in microseconds
+static bool parse_time(const char *str, int64_t *time_us)
+{
+    char *end;
+    double seconds = strtod(str, &end);
+    if (end == str || *end != '\0' || !(seconds >= 0.0 && seconds < 1e11))
+    {
+        return false;
+    }
+
+    *time_us = (int64_t) (seconds * 1000000.0);
+    return true;
+}
 
-    char query[128];
-    char fps[30];
-    char frame_max_len[30];
-    char buffered_fbs[30];
-    char fb_in_buffer_before_get[30];
+// Segments on storage, page by page as listing opens index of every segment
+esp_err_t recordings_handler(httpd_req_t *req) {
+    char query[64];
+    char first_str[12] = {0};
+    char count_str[8] = {0};
+
+    recorder_stats_t recorder;
+    recorder_get_stats(&recorder);
+    if (!recorder.enabled)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Recording is disabled");
+        return ESP_OK;
+    }
+
+    uint32_t first = recorder.first_segment;
+    uint32_t count = CONFIG_RECORDINGS_DEFAULT_COUNT;
 
     size_t query_len = httpd_req_get_url_query_len(req) + 1;
     if (query_len > 1) {
         if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-            ESP_LOGI("QUERY", "Query string: %s", query);
+            if (httpd_query_key_value(query, "first", first_str, sizeof(first_str)) == ESP_OK) {
+                first = strtoul(first_str, NULL, 10);
+            }
+            if (httpd_query_key_value(query, "count", count_str, sizeof(count_str)) == ESP_OK) {
+                count = strtoul(count_str, NULL, 10);
+            }
+        }
+    }
+
+    if (count == 0 || count > CONFIG_RECORDINGS_MAX_COUNT)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "count");
+        return ESP_OK;
+    }
+    first = first > recorder.first_segment ? first : recorder.first_segment;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char line[192];
+    int len = snprintf(line, sizeof(line), "{\"first_segment\": %lu, \"next_segment\": %lu, \"segments\": [",
+                       (unsigned long) recorder.first_segment, (unsigned long) recorder.next_segment);
+    esp_err_t ret = httpd_resp_send_chunk(req, line, len);
+
+    bool separator = false;
+    for (uint32_t segment = first; segment < recorder.next_segment && segment - first < count && ret == ESP_OK;
+         ++segment)
+    {
+        playback_segment_t info;
+        if (playback_get_segment(segment, &info) != ESP_OK)
+        {
+            continue;
+        }
+
+        len = snprintf(line, sizeof(line),
+                       "%s{\"segment\": %lu, \"start\": %.3f, \"end\": %.3f, \"frames\": %lu, "
+                       "\"data_len\": %lu, \"index_len\": %lu}",
+                       separator ? ", " : "", (unsigned long) segment, info.start_time / 1000000.0,
+                       info.end_time / 1000000.0, (unsigned long) info.frames, (unsigned long) info.data_len,
+                       (unsigned long) info.index_len);
+        ret = httpd_resp_send_chunk(req, line, len);
+        separator = true;
+    }
+
+    if (ret == ESP_OK)
+    {
+        ret = httpd_resp_send_chunk(req, "]}", 2);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    return ret;
+}
+
+// Recorded frames from given time range, read from storage by playback sender task alongside live viewers
+esp_err_t play_handler(httpd_req_t *req) {
+    char query[96];
+    char from_str[24] = {0};
+    char to_str[24] = {0};
+    char speed_str[8] = {0};
+    int64_t from = -1;
+    int64_t to = INT64_MAX;
+    float speed = 1.0f;
 
-            if (httpd_query_key_value(query, "fps", fps, sizeof(fps)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'fps': %s", fps);
-                frame_config.fps = atoi(fps);
-                if (frame_config.fps == 0)
-                {
-                    ESP_LOGE(TAG, "FSP conv failed");
-                    frame_config.fps = 1;
-                }
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            if (httpd_query_key_value(query, "from", from_str, sizeof(from_str)) == ESP_OK &&
+                !parse_time(from_str, &from)) {
+                from = -1;
+            }
+            if (httpd_query_key_value(query, "to", to_str, sizeof(to_str)) == ESP_OK &&
+                !parse_time(to_str, &to)) {
+                to = -1;
             }
+            if (httpd_query_key_value(query, "speed", speed_str, sizeof(speed_str)) == ESP_OK) {
+                speed = strtof(speed_str, NULL);
+            }
+        }
+    }
+
+    if (from < 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from");
+        return ESP_OK;
+    }
+    if (to < from)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "to");
+        return ESP_OK;
+    }
+    if (!(speed >= CONFIG_REPLAY_MIN_SPEED && speed <= CONFIG_REPLAY_MAX_SPEED))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "speed");
+        return ESP_OK;
+    }
+
+    esp_err_t ret = playback_add_viewer(req, from, to, speed);
+    if (ret == ESP_ERR_NOT_SUPPORTED || ret == ESP_ERR_NOT_FOUND)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                            ret == ESP_ERR_NOT_SUPPORTED ? "Recording is disabled" : "No recording");
+        return ESP_OK;
+    }
+    if (ret == ESP_ERR_NO_MEM)
+    {
+        return send_no_free_slot(req, "No free playback session slot");
+    }
+
+    return ret;
+}
+
+// Raw segment data or index file, with Range support so big segments can be fetched in parts or resumed
+esp_err_t recording_handler(httpd_req_t *req) {
+    char query[48];
+    char segment_str[12] = {0};
+    char file_str[8] = {0};
+    char range[48];
 
-            if (httpd_query_key_value(query, "frame_max_len", frame_max_len, sizeof(frame_max_len)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'frame_max_len': %s", frame_max_len);
-                frame_config.frame_max_len = atoi(frame_max_len);
-                if (frame_config.frame_max_len == 0)
-                {
-                    ESP_LOGE(TAG, "frame_max_len conv failed");
-                    frame_config.frame_max_len = 1;
-                }
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            httpd_query_key_value(query, "segment", segment_str, sizeof(segment_str));
+            httpd_query_key_value(query, "file", file_str, sizeof(file_str));
+        }
+    }
+
+    if (strlen(segment_str) == 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "segment");
+        return ESP_OK;
+    }
+    if (strlen(file_str) > 0 && strcmp(file_str, "data") != 0 && strcmp(file_str, "index") != 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "file");
+        return ESP_OK;
+    }
+
+    bool has_range = httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK;
+
+    esp_err_t ret = playback_add_download(req, strtoul(segment_str, NULL, 10), strcmp(file_str, "index") == 0,
+                                          has_range ? range : NULL);
+    if (ret == ESP_ERR_NOT_SUPPORTED || ret == ESP_ERR_NOT_FOUND)
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                            ret == ESP_ERR_NOT_SUPPORTED ? "Recording is disabled" : "No such segment");
+        return ESP_OK;
+    }
+    if (ret == ESP_ERR_NO_MEM)
+    {
+        return send_no_free_slot(req, "No free playback session slot");
+    }
+
+    return ret;
+}
+
+esp_err_t get_src_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    char query[128];
+    char refresh[8];
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            if (httpd_query_key_value(query, "refresh", refresh, sizeof(refresh)) == ESP_OK && strcmp(refresh, "1") == 0) {
+                // Refreshed list is picked up by one of next requests
+                source_list_refresh();
             }
+        }
+    }
 
-            if (httpd_query_key_value(query, "buffered_fbs", buffered_fbs, sizeof(buffered_fbs)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'buffered_fbs': %s", buffered_fbs);
-                frame_config.buffered_fbs = atoi(buffered_fbs);
-                if (frame_config.buffered_fbs == 0)
-                {
-                    ESP_LOGE(TAG, "buffered_fbs conv failed");
-                    frame_config.buffered_fbs = 1;
-                }
+    int64_t age_ms;
+    char *json_response = source_list_get_json(&age_ms);
+    if (json_response == NULL)
+    {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char age[24];
+    snprintf(age, sizeof(age), "%lld", (long long) age_ms);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Access-Control-Expose-Headers", "X-Sources-Age-Ms");
+    httpd_resp_set_hdr(req, "X-Sources-Age-Ms", age);
+
+    esp_err_t ret = httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+    free(json_response);
+    return ret;
+}
+
+static bool is_valid_ip(const char *ip_addr_str) {
+    struct in_addr addr;
+    return inet_pton(AF_INET, ip_addr_str, &addr) == 1;
+}
+
+esp_err_t set_server_handler(httpd_req_t *req) {
+    if (client_handler != NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    char query[128];
+    char server_ip_addr[30];
+    char transport_name[8] = "tcp";
+    memset(server_ip_addr, 0, sizeof(server_ip_addr));
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            ESP_LOGI("QUERY", "Query string: %s", query);
+
+            if (httpd_query_key_value(query, "name", server_ip_addr, sizeof(server_ip_addr)) == ESP_OK) {
+                ESP_LOGI("QUERY", "Value of 'server_ip_addr': %s", server_ip_addr);
             }
+            if (httpd_query_key_value(query, "transport", transport_name, sizeof(transport_name)) == ESP_OK) {
+                ESP_LOGI("QUERY", "Value of 'transport': %s", transport_name);
+            }
+        }
+    }
 
-            if (httpd_query_key_value(query, "fb_in_buffer_before_get", fb_in_buffer_before_get, sizeof(fb_in_buffer_before_get)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'fb_in_buffer_before_get': %s", fb_in_buffer_before_get);
-                frame_config.fb_in_buffer_before_get = atoi(fb_in_buffer_before_get);
+    udps_transport_t transport;
+    if (udps_transport_from_name(transport_name, &transport) != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "transport");
+        return ESP_OK;
+    }
+
+    if (strlen(server_ip_addr) == 0 || is_valid_ip(server_ip_addr))
+    {
+        esp_err_t ret = udps_init(server_ip_addr, transport);
+        if (ret == ESP_ERR_INVALID_STATE)
+        {
+            httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+            return ESP_OK;
+        }
+        if (ret != ESP_OK)
+        {
+            httpd_resp_send_500(req);
+            return ESP_OK;
+        }
+
+        httpd_resp_send(req, NULL, 0);
+    }
+    else
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+    }
+
+    return ESP_OK;
+}
+
+// Sends 304 response and returns true when client already has given version
+static bool send_not_modified(httpd_req_t *req, const char *etag) {
+    char if_none_match[32];
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0)
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", etag);
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_send(req, NULL, 0);
+        return true;
+    }
+
+    return false;
+}
+
+esp_err_t set_src_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    char query[128];
+    char name[30] = {0};
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            ESP_LOGI("QUERY", "Query string: %s", query);
+
+            if (httpd_query_key_value(query, "name", name, sizeof(name)) == ESP_OK) {
+                ESP_LOGI("QUERY", "Value of 'name': %s", name);
             }
         }
     }
 
-    esp_err_t ret = espfsp_client_play_reconfigure_frame(client_handler, &frame_config);
+    control_cmd_t cmd = { .type = CONTROL_CMD_SET_SOURCE };
+    strncpy(cmd.source_name, name, sizeof(cmd.source_name) - 1);
+    return submit_command(req, &cmd);
+}
+
+static void parse_frame_config(const char *query, espfsp_frame_config_t *frame_config) {
+    char fps[30];
+    char frame_max_len[30];
+    char buffered_fbs[30];
+    char fb_in_buffer_before_get[30];
+
+    if (httpd_query_key_value(query, "fps", fps, sizeof(fps)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'fps': %s", fps);
+        frame_config->fps = atoi(fps);
+        if (frame_config->fps == 0)
+        {
+            ESP_LOGE(TAG, "FSP conv failed");
+            frame_config->fps = 1;
+        }
+    }
+
+    if (httpd_query_key_value(query, "frame_max_len", frame_max_len, sizeof(frame_max_len)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'frame_max_len': %s", frame_max_len);
+        frame_config->frame_max_len = atoi(frame_max_len);
+        if (strcmp(frame_max_len, "auto") == 0)
+        {
+            frame_config->frame_max_len = CONTROL_FRAME_MAX_LEN_AUTO;
+        }
+        else if (frame_config->frame_max_len == 0)
+        {
+            ESP_LOGE(TAG, "frame_max_len conv failed");
+            frame_config->frame_max_len = 1;
+        }
+    }
+
+    if (httpd_query_key_value(query, "buffered_fbs", buffered_fbs, sizeof(buffered_fbs)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'buffered_fbs': %s", buffered_fbs);
+        frame_config->buffered_fbs = atoi(buffered_fbs);
+        if (frame_config->buffered_fbs == 0)
+        {
+            ESP_LOGE(TAG, "buffered_fbs conv failed");
+            frame_config->buffered_fbs = 1;
+        }
+    }
+
+    if (httpd_query_key_value(query, "fb_in_buffer_before_get", fb_in_buffer_before_get, sizeof(fb_in_buffer_before_get)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'fb_in_buffer_before_get': %s", fb_in_buffer_before_get);
+        frame_config->fb_in_buffer_before_get = strcmp(fb_in_buffer_before_get, "auto") == 0 ?
+            PLAYOUT_DEPTH_AUTO : atoi(fb_in_buffer_before_get);
+    }
+}
+
+static void set_default_frame_config(espfsp_frame_config_t *frame_config) {
+    frame_config->fps = 1;
+    frame_config->frame_max_len = (100 * 1014);
+    frame_config->buffered_fbs = 10;
+    frame_config->fb_in_buffer_before_get = 0;
+}
+
+esp_err_t set_frame_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    control_cmd_t cmd = { .type = CONTROL_CMD_SET_FRAME };
+    set_default_frame_config(&cmd.frame_config);
+
+    char query[128];
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            ESP_LOGI("QUERY", "Query string: %s", query);
+            parse_frame_config(query, &cmd.frame_config);
+        }
+    }
+
+    return submit_command(req, &cmd);
+}
+
+static void parse_cam_config(const char *query, espfsp_cam_config_t *cam_config) {
+    char cam_jpeg_quality[30];
+    char cam_frame_size[30];
+    char cam_pixel_format[30];
+
+    if (httpd_query_key_value(query, "cam_jpeg_quality", cam_jpeg_quality, sizeof(cam_jpeg_quality)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'cam_jpeg_quality': %s", cam_jpeg_quality);
+        cam_config->cam_jpeg_quality = atoi(cam_jpeg_quality);
+        if (cam_config->cam_jpeg_quality == 0)
+        {
+            ESP_LOGE(TAG, "FSP conv failed");
+            cam_config->cam_jpeg_quality = 1;
+        }
+    }
+
+    if (httpd_query_key_value(query, "cam_frame_size", cam_frame_size, sizeof(cam_frame_size)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'pixel_format': %s", cam_frame_size);
+        cam_config->cam_frame_size = atoi(cam_frame_size);
+    }
+
+    if (httpd_query_key_value(query, "cam_pixel_format", cam_pixel_format, sizeof(cam_pixel_format)) == ESP_OK) {
+        ESP_LOGI("QUERY", "Value of 'cam_pixel_format': %s", cam_pixel_format);
+        cam_config->cam_pixel_format = atoi(cam_pixel_format);
+    }
+}
+
+static void set_default_cam_config(espfsp_cam_config_t *cam_config) {
+    cam_config->cam_fb_count = 2; // Useless now
+    cam_config->cam_grab_mode = ESPFSP_GRAB_LATEST; // Useless now
+    cam_config->cam_jpeg_quality = 30;
+    cam_config->cam_frame_size = ESPFSP_FRAMESIZE_96X96;
+    cam_config->cam_pixel_format = ESPFSP_PIXFORMAT_JPEG;
+}
+
+esp_err_t set_cam_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    control_cmd_t cmd = { .type = CONTROL_CMD_SET_CAM };
+    set_default_cam_config(&cmd.cam_config);
+
+    char query[128];
+
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+            ESP_LOGI("QUERY", "Query string: %s", query);
+            parse_cam_config(query, &cmd.cam_config);
+        }
+    }
+
+    return submit_command(req, &cmd);
+}
+
+// Reads integer field of JSON object, if it is given. Returns false when value is not a number in range.
+static bool read_json_int(const cJSON *object, const char *name, int min, int max, int *value) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (item == NULL)
+    {
+        return true;
+    }
+
+    if (!cJSON_IsNumber(item) || item->valuedouble < min || item->valuedouble > max)
+    {
+        return false;
+    }
+
+    *value = item->valueint;
+    return true;
+}
+
+// Fields missing in JSON keep defaults, the same as for /set_frame and /set_cam. Returns name of invalid field.
+static const char *parse_json_frame_config(const cJSON *object, espfsp_frame_config_t *frame_config) {
+    int fps = frame_config->fps;
+    int frame_max_len = frame_config->frame_max_len;
+    int buffered_fbs = frame_config->buffered_fbs;
+    int fb_in_buffer_before_get = frame_config->fb_in_buffer_before_get;
+
+    if (!read_json_int(object, "fps", 1, CONFIG_RECONFIGURE_MAX_FPS, &fps))
+    {
+        return "fps";
+    }
+    // "auto" lets frame pool choose length from observed frame sizes
+    const cJSON *frame_max_len_item = cJSON_GetObjectItemCaseSensitive(object, "frame_max_len");
+    if (cJSON_IsString(frame_max_len_item) && strcmp(frame_max_len_item->valuestring, "auto") == 0)
+    {
+        frame_max_len = CONTROL_FRAME_MAX_LEN_AUTO;
+    }
+    else if (!read_json_int(object, "frame_max_len", 1, CONFIG_RECONFIGURE_MAX_FRAME_LEN, &frame_max_len))
+    {
+        return "frame_max_len";
+    }
+    if (!read_json_int(object, "buffered_fbs", 1, CONFIG_RECONFIGURE_MAX_BUFFERED_FBS, &buffered_fbs))
+    {
+        return "buffered_fbs";
+    }
+    // "auto" turns on adaptive playout, which chooses both buffered_fbs and fb_in_buffer_before_get
+    const cJSON *depth_item = cJSON_GetObjectItemCaseSensitive(object, "fb_in_buffer_before_get");
+    if (cJSON_IsString(depth_item) && strcmp(depth_item->valuestring, "auto") == 0)
+    {
+        fb_in_buffer_before_get = PLAYOUT_DEPTH_AUTO;
+    }
+    else if (!read_json_int(object, "fb_in_buffer_before_get", 0, buffered_fbs, &fb_in_buffer_before_get))
+    {
+        return "fb_in_buffer_before_get";
+    }
+
+    frame_config->fps = fps;
+    frame_config->frame_max_len = frame_max_len;
+    frame_config->buffered_fbs = buffered_fbs;
+    frame_config->fb_in_buffer_before_get = fb_in_buffer_before_get;
+    return NULL;
+}
+
+static const char *parse_json_cam_config(const cJSON *object, espfsp_cam_config_t *cam_config) {
+    int cam_jpeg_quality = cam_config->cam_jpeg_quality;
+    int cam_frame_size = cam_config->cam_frame_size;
+    int cam_pixel_format = cam_config->cam_pixel_format;
+
+    if (!read_json_int(object, "cam_jpeg_quality", 0, CONFIG_RECONFIGURE_MAX_JPEG_QUALITY, &cam_jpeg_quality))
+    {
+        return "cam_jpeg_quality";
+    }
+    if (!read_json_int(object, "cam_frame_size", 0, CONFIG_RECONFIGURE_MAX_ENUM, &cam_frame_size))
+    {
+        return "cam_frame_size";
+    }
+    if (!read_json_int(object, "cam_pixel_format", 0, CONFIG_RECONFIGURE_MAX_ENUM, &cam_pixel_format))
+    {
+        return "cam_pixel_format";
+    }
+
+    cam_config->cam_jpeg_quality = cam_jpeg_quality;
+    cam_config->cam_frame_size = cam_frame_size;
+    cam_config->cam_pixel_format = cam_pixel_format;
+    return NULL;
+}
+
+// Whole document is validated before anything is queued, so invalid request never leaves source half configured
+static const char *parse_reconfigure(const char *body, size_t body_len, control_reconfigure_t *reconfigure) {
+    const char *invalid = NULL;
+
+    cJSON *root = cJSON_ParseWithLength(body, body_len);
+    if (root == NULL || !cJSON_IsObject(root))
+    {
+        cJSON_Delete(root);
+        return "document";
+    }
+
+    const cJSON *source = cJSON_GetObjectItemCaseSensitive(root, "source");
+    const cJSON *frame = cJSON_GetObjectItemCaseSensitive(root, "frame");
+    const cJSON *cam = cJSON_GetObjectItemCaseSensitive(root, "cam");
+
+    if (source != NULL)
+    {
+        if (!cJSON_IsString(source) || strlen(source->valuestring) == 0 ||
+            strlen(source->valuestring) >= sizeof(reconfigure->source_name))
+        {
+            invalid = "source";
+            goto out;
+        }
+
+        strcpy(reconfigure->source_name, source->valuestring);
+        reconfigure->has_source = true;
+    }
+
+    if (frame != NULL)
+    {
+        if (!cJSON_IsObject(frame))
+        {
+            invalid = "frame";
+            goto out;
+        }
+
+        set_default_frame_config(&reconfigure->frame_config);
+        invalid = parse_json_frame_config(frame, &reconfigure->frame_config);
+        if (invalid != NULL)
+        {
+            goto out;
+        }
+        reconfigure->has_frame = true;
+    }
+
+    if (cam != NULL)
+    {
+        if (!cJSON_IsObject(cam))
+        {
+            invalid = "cam";
+            goto out;
+        }
+
+        set_default_cam_config(&reconfigure->cam_config);
+        invalid = parse_json_cam_config(cam, &reconfigure->cam_config);
+        if (invalid != NULL)
+        {
+            goto out;
+        }
+        reconfigure->has_cam = true;
+    }
+
+    if (!reconfigure->has_source && !reconfigure->has_frame && !reconfigure->has_cam)
+    {
+        invalid = "document";
+    }
+
+out:
+    cJSON_Delete(root);
+    return invalid;
+}
+
+esp_err_t reconfigure_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    char body[CONFIG_RECONFIGURE_MAX_BODY_LEN];
+    size_t body_len = 0;
+
+    if (req->content_len == 0 || req->content_len > sizeof(body))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Body missing or too long");
+        return ESP_OK;
+    }
+
+    while (body_len < req->content_len)
+    {
+        int len = httpd_req_recv(req, body + body_len, req->content_len - body_len);
+        if (len == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            return ESP_FAIL;
+        }
+        body_len += len;
+    }
+
+    control_cmd_t cmd = { .type = CONTROL_CMD_RECONFIGURE };
+    memset(&cmd.reconfigure, 0, sizeof(cmd.reconfigure));
+
+    const char *invalid = parse_reconfigure(body, body_len, &cmd.reconfigure);
+    if (invalid != NULL)
+    {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Invalid %s", invalid);
+        ESP_LOGE(TAG, "Reconfigure rejected: %s", msg);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+        return ESP_OK;
+    }
+
+    return submit_command(req, &cmd);
+}
+
+// Configuration is not cached yet, e.g. previous read after source change failed. It is read by control worker,
+// so this server never waits for ESPFSP, and client is asked to retry.
+static esp_err_t send_config_missing(httpd_req_t *req)
+{
+    char source[30];
+    if (config_cache_get_source(source, sizeof(source)) != ESP_OK)
+    {
+        // No source selected yet, so there is nothing to read
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    control_cmd_t cmd = { .type = CONTROL_CMD_FETCH_CONFIG };
+    uint32_t id;
+    control_worker_submit(&cmd, &id);
+
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_sendstr(req, "Configuration is being read");
+}
+
+esp_err_t get_frame_config_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    espfsp_frame_config_t frame_config;
+    uint32_t version;
+
+    if (config_cache_get_frame(&frame_config, &version) != ESP_OK)
+    {
+        return send_config_missing(req);
+    }
+
+    playout_stats_t playout;
+    playout_get_stats(&playout);
+
+    // Playout measurements change once per window, so they are part of version
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"f%lu-%lu\"", (unsigned long) version, (unsigned long) playout.window);
+    if (send_not_modified(req, etag))
+    {
+        return ESP_OK;
+    }
+
+    char json_response[512];
+    char *ptr = json_response;
+
+    ptr += sprintf(ptr, "{");
+
+    ptr += sprintf(ptr, "\"fps\": %d,", frame_config.fps);
+    ptr += sprintf(ptr, "\"frame_max_len\": %ld,", frame_config.frame_max_len);
+    ptr += sprintf(ptr, "\"buffered_fbs\": %d,", frame_config.buffered_fbs);
+    ptr += sprintf(ptr, "\"fb_in_buffer_before_get\": %d,", frame_config.fb_in_buffer_before_get);
+    ptr += sprintf(ptr, "\"playout\": \"%s\",", playout.adaptive ? "adaptive" : "fixed");
+    ptr += sprintf(ptr, "\"jitter_ms\": %.1f,", playout.jitter_us / 1000.0);
+    ptr += sprintf(ptr, "\"stall_rate\": %.3f", playout.stall_permille / 1000.0);
+
+    sprintf(ptr, "}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+
+    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t get_cam_config_handler(httpd_req_t *req) {
+    if (client_handler == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    espfsp_cam_config_t cam_config;
+    uint32_t version;
+
+    if (config_cache_get_cam(&cam_config, &version) != ESP_OK)
+    {
+        return send_config_missing(req);
+    }
+
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"c%lu\"", (unsigned long) version);
+    if (send_not_modified(req, etag))
+    {
+        return ESP_OK;
+    }
+
+    char json_response[512];
+    char *ptr = json_response;
+
+    ptr += sprintf(ptr, "{");
+
+    ptr += sprintf(ptr, "\"cam_jpeg_quality\": %d,", cam_config.cam_jpeg_quality);
+    ptr += sprintf(ptr, "\"cam_frame_size\": %d,", cam_config.cam_frame_size);
+    ptr += sprintf(ptr, "\"cam_pixel_format\": %d", cam_config.cam_pixel_format);
+
+    sprintf(ptr, "}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+
+    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t get_stream_clients_handler(httpd_req_t *req) {
+    frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+    if (dispatcher == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    frame_viewer_stats_t stats[8];
+    int stats_len = frame_dispatcher_get_viewers_stats(dispatcher, stats, 8);
+    udps_release_dispatcher(dispatcher);
+
+    char json_response[1536];
+    size_t len = 0;
+
+    len += snprintf(json_response + len, sizeof(json_response) - len, "[");
+
+    for (int i = 0; i < stats_len && len < sizeof(json_response); ++i) {
+        len += snprintf(json_response + len, sizeof(json_response) - len,
+                        "%s{\"addr\": \"%s\", \"frames_sent\": %lu, \"frames_dropped\": %lu, \"frames_decimated\": %lu, "
+                        "\"bytes_sent\": %llu, \"throughput\": %lu, \"queue_depth\": %lu, \"copying\": %s, "
+                        "\"scale\": %u, \"quality\": %u, \"fps\": %u}",
+                        i > 0 ? "," : "", stats[i].addr,
+                        (unsigned long) stats[i].frames_sent, (unsigned long) stats[i].frames_dropped,
+                        (unsigned long) stats[i].frames_decimated,
+                        (unsigned long long) stats[i].bytes_sent, (unsigned long) stats[i].throughput,
+                        (unsigned long) stats[i].queue_depth, stats[i].copying ? "true" : "false",
+                        stats[i].scale, stats[i].quality, stats[i].fps);
+    }
+
+    if (len < sizeof(json_response)) {
+        len += snprintf(json_response + len, sizeof(json_response) - len, "]");
+    }
+    if (len >= sizeof(json_response)) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    return httpd_resp_send(req, json_response, len);
+}
+
+esp_err_t get_status_handler(httpd_req_t *req) {
+    udps_status_t status;
+    udps_get_status(&status);
+
+    char json_response[320];
+    snprintf(json_response, sizeof(json_response),
+             "{\"connected\": %s, \"server\": \"%s\", \"transport_mode\": \"%s\", \"transport\": \"%s\", "
+             "\"stream_started\": %s, \"frame_completion\": %d, \"fallbacks\": %lu, "
+             "\"frame_max_len_recommended\": %lu}",
+             status.connected ? "true" : "false", status.server_addr,
+             udps_transport_name(status.mode), udps_transport_name(status.transport),
+             status.connected && control_worker_is_stream_started() ? "true" : "false",
+             status.frame_completion, (unsigned long) status.fallbacks,
+             (unsigned long) frame_pool_recommended_max_len());
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+}
+
+// Latest frame from cached copy, so stills for dashboards do not take frames away from stream viewers
+esp_err_t snapshot_handler(httpd_req_t *req) {
+    frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+    if (dispatcher == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
+        return ESP_OK;
+    }
+
+    // Snapshot stays valid after dispatcher is released, so client is never held while sending
+    frame_snapshot_t *snapshot;
+    esp_err_t ret = frame_dispatcher_get_snapshot(dispatcher, &snapshot);
+    udps_release_dispatcher(dispatcher);
+    if (ret == ESP_ERR_NOT_FOUND)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "No frame received yet");
+    }
+    if (ret != ESP_OK)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return ESP_OK;
+    }
+
+    // Reception time changes only when new frame arrives. Sequence is not used, as it starts over with every
+    // dispatcher and old tag could match frame of new one.
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"s%lld\"", (long long) snapshot->timestamp);
+
+    char timestamp[24];
+    char age[24];
+    snprintf(timestamp, sizeof(timestamp), "%lld", (long long) snapshot->timestamp);
+    snprintf(age, sizeof(age), "%lld", (long long) ((esp_timer_get_time() - snapshot->timestamp) / 1000));
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "X-Timestamp", timestamp);
+    httpd_resp_set_hdr(req, "X-Frame-Age-Ms", age);
+
+    if (send_not_modified(req, etag))
+    {
+        frame_dispatcher_release_snapshot(snapshot);
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    ret = httpd_resp_send(req, (const char *) snapshot->buf, snapshot->len);
+
+    frame_dispatcher_release_snapshot(snapshot);
+    return ret;
+}
+
+// Global metrics are followed by per-viewer ones, labelled with viewer address while it is connected
+esp_err_t metrics_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    esp_err_t ret = metrics_send_chunks(req);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    frame_viewer_stats_t stats[8];
+    int stats_len = 0;
+    frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+    if (dispatcher != NULL)
+    {
+        stats_len = frame_dispatcher_get_viewers_stats(dispatcher, stats, 8);
+        udps_release_dispatcher(dispatcher);
+    }
+
+    udps_status_t status;
+    udps_get_status(&status);
+
+    char line[1024];
+    int len = snprintf(line, sizeof(line),
+                       "# HELP accessor_data_transport ESPFSP data transport in use\n"
+                       "# TYPE accessor_data_transport gauge\n"
+                       "accessor_data_transport{transport=\"tcp\",mode=\"%s\"} %d\n"
+                       "accessor_data_transport{transport=\"udp\",mode=\"%s\"} %d\n"
+                       "# HELP accessor_transport_fallbacks_total Switches from UDP to TCP in auto transport mode\n"
+                       "# TYPE accessor_transport_fallbacks_total counter\n"
+                       "accessor_transport_fallbacks_total %lu\n",
+                       udps_transport_name(status.mode), status.connected && status.transport == UDPS_TRANSPORT_TCP,
+                       udps_transport_name(status.mode), status.connected && status.transport == UDPS_TRANSPORT_UDP,
+                       (unsigned long) status.fallbacks);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    frame_pool_stats_t pool;
+    frame_pool_get_stats(&pool);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_frame_pool_bytes gauge\n"
+                   "accessor_frame_pool_bytes %lu\n"
+                   "# TYPE accessor_frame_pool_used_bytes gauge\n"
+                   "accessor_frame_pool_used_bytes %lu\n"
+                   "# HELP accessor_frame_pool_fallback_allocs_total Frame copies allocated from heap instead of pool\n"
+                   "# TYPE accessor_frame_pool_fallback_allocs_total counter\n"
+                   "accessor_frame_pool_fallback_allocs_total %lu\n"
+                   "# TYPE accessor_frame_len_bytes gauge\n"
+                   "accessor_frame_len_bytes{stat=\"p50\"} %lu\n"
+                   "accessor_frame_len_bytes{stat=\"p99\"} %lu\n"
+                   "accessor_frame_len_bytes{stat=\"max\"} %lu\n"
+                   "# TYPE accessor_frame_max_len_bytes gauge\n"
+                   "accessor_frame_max_len_bytes{kind=\"configured\"} %lu\n"
+                   "accessor_frame_max_len_bytes{kind=\"recommended\"} %lu\n",
+                   (unsigned long) pool.pool_len, (unsigned long) pool.used_len,
+                   (unsigned long) pool.fallback_allocs, (unsigned long) pool.frame_len_p50,
+                   (unsigned long) pool.frame_len_p99, (unsigned long) pool.frame_len_max,
+                   (unsigned long) pool.frame_max_len, (unsigned long) pool.recommended_max_len);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    replay_stats_t replay;
+    replay_get_stats(&replay);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_replay_buffer_bytes gauge\n"
+                   "accessor_replay_buffer_bytes %lu\n"
+                   "# TYPE accessor_replay_used_bytes gauge\n"
+                   "accessor_replay_used_bytes %lu\n"
+                   "# TYPE accessor_replay_frames gauge\n"
+                   "accessor_replay_frames %lu\n"
+                   "# HELP accessor_replay_depth_seconds Time covered by frames kept for replay\n"
+                   "# TYPE accessor_replay_depth_seconds gauge\n"
+                   "accessor_replay_depth_seconds %.1f\n"
+                   "# TYPE accessor_replay_max_fps gauge\n"
+                   "accessor_replay_max_fps %lu\n"
+                   "# TYPE accessor_replay_frames_evicted_total counter\n"
+                   "accessor_replay_frames_evicted_total %lu\n"
+                   "# TYPE accessor_replay_viewers gauge\n"
+                   "accessor_replay_viewers %d\n",
+                   (unsigned long) replay.buffer_len, (unsigned long) replay.used_len,
+                   (unsigned long) replay.frames, replay.depth_ms / 1000.0, (unsigned long) replay.max_fps,
+                   (unsigned long) replay.frames_evicted, replay.viewers);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    recorder_stats_t recorder;
+    recorder_get_stats(&recorder);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_recorder_enabled gauge\n"
+                   "accessor_recorder_enabled %d\n"
+                   "# TYPE accessor_recorder_frames_total counter\n"
+                   "accessor_recorder_frames_total %lu\n"
+                   "# HELP accessor_recorder_frames_dropped_total Frames not recorded as writer did not keep up\n"
+                   "# TYPE accessor_recorder_frames_dropped_total counter\n"
+                   "accessor_recorder_frames_dropped_total %lu\n"
+                   "# TYPE accessor_recorder_bytes_written_total counter\n"
+                   "accessor_recorder_bytes_written_total %llu\n"
+                   "# TYPE accessor_recorder_segments gauge\n"
+                   "accessor_recorder_segments %lu\n"
+                   "# TYPE accessor_recorder_segments_deleted_total counter\n"
+                   "accessor_recorder_segments_deleted_total %lu\n"
+                   "# TYPE accessor_recorder_write_errors_total counter\n"
+                   "accessor_recorder_write_errors_total %lu\n"
+                   "# TYPE accessor_recorder_free_bytes gauge\n"
+                   "accessor_recorder_free_bytes %llu\n",
+                   recorder.enabled, (unsigned long) recorder.frames_recorded,
+                   (unsigned long) recorder.frames_dropped, (unsigned long long) recorder.bytes_written,
+                   (unsigned long) (recorder.next_segment - recorder.first_segment),
+                   (unsigned long) recorder.segments_deleted, (unsigned long) recorder.write_errors,
+                   (unsigned long long) recorder.free_bytes);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    len = snprintf(line, sizeof(line),
+                   "# HELP accessor_recorder_clock_valid Wall clock is set, frames are not recorded before\n"
+                   "# TYPE accessor_recorder_clock_valid gauge\n"
+                   "accessor_recorder_clock_valid %d\n",
+                   recorder.clock_valid);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    playback_stats_t playback;
+    playback_get_stats(&playback);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_playback_sessions gauge\n"
+                   "accessor_playback_sessions %d\n"
+                   "# TYPE accessor_playback_sessions_total counter\n"
+                   "accessor_playback_sessions_total %lu\n"
+                   "# TYPE accessor_playback_frames_sent_total counter\n"
+                   "accessor_playback_frames_sent_total %lu\n"
+                   "# TYPE accessor_playback_bytes_sent_total counter\n"
+                   "accessor_playback_bytes_sent_total %llu\n",
+                   playback.sessions, (unsigned long) playback.sessions_started,
+                   (unsigned long) playback.frames_sent, (unsigned long long) playback.bytes_sent);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    motion_stats_t motion;
+    motion_get_stats(&motion);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_motion_active gauge\n"
+                   "accessor_motion_active %d\n"
+                   "# TYPE accessor_motion_score gauge\n"
+                   "accessor_motion_score %.3f\n"
+                   "# TYPE accessor_motion_frames_analyzed_total counter\n"
+                   "accessor_motion_frames_analyzed_total %lu\n"
+                   "# HELP accessor_motion_frames_skipped_total Frames not analyzed as detector was busy\n"
+                   "# TYPE accessor_motion_frames_skipped_total counter\n"
+                   "accessor_motion_frames_skipped_total %lu\n"
+                   "# TYPE accessor_motion_frames_unsupported_total counter\n"
+                   "accessor_motion_frames_unsupported_total %lu\n"
+                   "# HELP accessor_motion_frame_seconds Time of DC decode and model update of one frame\n"
+                   "# TYPE accessor_motion_frame_seconds gauge\n"
+                   "accessor_motion_frame_seconds{stage=\"decode\"} %.6f\n"
+                   "accessor_motion_frame_seconds{stage=\"model\"} %.6f\n"
+                   "# TYPE accessor_motion_events_total counter\n"
+                   "accessor_motion_events_total %lu\n"
+                   "# TYPE accessor_motion_subscribers gauge\n"
+                   "accessor_motion_subscribers %d\n",
+                   motion.active, motion.score_permille / 1000.0, (unsigned long) motion.frames_analyzed,
+                   (unsigned long) motion.frames_skipped, (unsigned long) motion.frames_unsupported,
+                   motion.decode_us / 1e6, motion.model_us / 1e6, (unsigned long) motion.events,
+                   motion.subscribers);
+    ret = httpd_resp_send_chunk(req, line, len);
     if (ret != ESP_OK)
     {
-        httpd_resp_send_500(req);
-        return ESP_OK;
+        return ret;
     }
 
-    httpd_resp_send(req, NULL, 0);
-    return ESP_OK;
-}
-
-esp_err_t set_cam_handler(httpd_req_t *req) {
-    if (client_handler == NULL)
+    transcoder_stats_t transcoder;
+    transcoder_get_stats(&transcoder);
+
+    len = snprintf(line, sizeof(line),
+                   "# HELP accessor_transcoder_variants Stream variants currently transcoded for viewers\n"
+                   "# TYPE accessor_transcoder_variants gauge\n"
+                   "accessor_transcoder_variants %d\n"
+                   "# TYPE accessor_transcoder_frames_total counter\n"
+                   "accessor_transcoder_frames_total{result=\"ok\"} %lu\n"
+                   "accessor_transcoder_frames_total{result=\"skipped\"} %lu\n"
+                   "accessor_transcoder_frames_total{result=\"failed\"} %lu\n"
+                   "# TYPE accessor_transcoder_bytes_total counter\n"
+                   "accessor_transcoder_bytes_total{direction=\"in\"} %llu\n"
+                   "accessor_transcoder_bytes_total{direction=\"out\"} %llu\n"
+                   "# HELP accessor_transcoder_frame_seconds Time of transcoding one frame to one variant\n"
+                   "# TYPE accessor_transcoder_frame_seconds gauge\n"
+                   "accessor_transcoder_frame_seconds %.6f\n",
+                   transcoder.variants, (unsigned long) transcoder.frames_transcoded,
+                   (unsigned long) transcoder.frames_skipped, (unsigned long) transcoder.frames_failed,
+                   (unsigned long long) transcoder.bytes_in, (unsigned long long) transcoder.bytes_out,
+                   transcoder.transcode_us / 1e6);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
-        return ESP_OK;
+        return ret;
     }
 
-    espfsp_cam_config_t cam_config = {
-        .cam_fb_count = 2, // Useless now
-        .cam_grab_mode = ESPFSP_GRAB_LATEST, // Useless now
-        .cam_jpeg_quality = 30,
-        .cam_frame_size = ESPFSP_FRAMESIZE_96X96,
-        .cam_pixel_format = ESPFSP_PIXFORMAT_JPEG,
-    };
-
-    char query[128];
-    char cam_jpeg_quality[30];
-    char cam_frame_size[30];
-    char cam_pixel_format[30];
-
-    size_t query_len = httpd_req_get_url_query_len(req) + 1;
-    if (query_len > 1) {
-        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-            ESP_LOGI("QUERY", "Query string: %s", query);
-
-            if (httpd_query_key_value(query, "cam_jpeg_quality", cam_jpeg_quality, sizeof(cam_jpeg_quality)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'cam_jpeg_quality': %s", cam_jpeg_quality);
-                cam_config.cam_jpeg_quality = atoi(cam_jpeg_quality);
-                if (cam_config.cam_jpeg_quality == 0)
-                {
-                    ESP_LOGE(TAG, "FSP conv failed");
-                    cam_config.cam_jpeg_quality = 1;
-                }
-            }
+    source_sessions_stats_t sessions;
+    source_sessions_get_stats(&sessions);
+
+    len = snprintf(line, sizeof(line),
+                   "# HELP accessor_source_sessions Sessions of sources other than selected one\n"
+                   "# TYPE accessor_source_sessions gauge\n"
+                   "accessor_source_sessions{state=\"open\"} %d\n"
+                   "accessor_source_sessions{state=\"streaming\"} %d\n"
+                   "# TYPE accessor_source_sessions_viewers gauge\n"
+                   "accessor_source_sessions_viewers %d\n"
+                   "# HELP accessor_source_sessions_psram_bytes ESPFSP frame buffers of sessions against budget\n"
+                   "# TYPE accessor_source_sessions_psram_bytes gauge\n"
+                   "accessor_source_sessions_psram_bytes{kind=\"used\"} %lu\n"
+                   "accessor_source_sessions_psram_bytes{kind=\"budget\"} %lu\n"
+                   "# TYPE accessor_source_sessions_total counter\n"
+                   "accessor_source_sessions_total{result=\"opened\"} %lu\n"
+                   "accessor_source_sessions_total{result=\"rejected\"} %lu\n"
+                   "accessor_source_sessions_total{result=\"start_failed\"} %lu\n",
+                   sessions.sessions, sessions.streaming, sessions.viewers, (unsigned long) sessions.psram_used,
+                   (unsigned long) sessions.psram_budget, (unsigned long) sessions.sessions_opened,
+                   (unsigned long) sessions.sessions_rejected, (unsigned long) sessions.start_failures);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
 
-            if (httpd_query_key_value(query, "cam_frame_size", cam_frame_size, sizeof(cam_frame_size)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'pixel_format': %s", cam_frame_size);
-                cam_config.cam_frame_size = atoi(cam_frame_size);
-            }
+    mosaic_stats_t mosaic;
+    mosaic_get_stats(&mosaic);
+
+    len = snprintf(line, sizeof(line),
+                   "# TYPE accessor_mosaic_viewers gauge\n"
+                   "accessor_mosaic_viewers %d\n"
+                   "# TYPE accessor_mosaic_frames_total counter\n"
+                   "accessor_mosaic_frames_total{result=\"ok\"} %lu\n"
+                   "accessor_mosaic_frames_total{result=\"failed\"} %lu\n"
+                   "# TYPE accessor_mosaic_tiles_total counter\n"
+                   "accessor_mosaic_tiles_total{result=\"transcoded\"} %lu\n"
+                   "accessor_mosaic_tiles_total{result=\"cached\"} %lu\n"
+                   "# HELP accessor_mosaic_frame_seconds Time of composing one mosaic with its tiles\n"
+                   "# TYPE accessor_mosaic_frame_seconds gauge\n"
+                   "accessor_mosaic_frame_seconds %.6f\n",
+                   mosaic.viewers, (unsigned long) mosaic.frames_composed, (unsigned long) mosaic.frames_failed,
+                   (unsigned long) mosaic.tiles_transcoded, (unsigned long) mosaic.tiles_cached,
+                   mosaic.compose_us / 1e6);
+    ret = httpd_resp_send_chunk(req, line, len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
 
-            if (httpd_query_key_value(query, "cam_pixel_format", cam_pixel_format, sizeof(cam_pixel_format)) == ESP_OK) {
-                ESP_LOGI("QUERY", "Value of 'cam_pixel_format': %s", cam_pixel_format);
-                cam_config.cam_pixel_format = atoi(cam_pixel_format);
-            }
-        }
+    static const char *viewer_metrics =
+        "# TYPE accessor_viewer_frames_sent_total counter\n"
+        "# TYPE accessor_viewer_frames_dropped_total counter\n"
+        "# TYPE accessor_viewer_bytes_sent_total counter\n"
+        "# TYPE accessor_viewer_throughput_bytes gauge\n";
+
+    ret = httpd_resp_send_chunk(req, viewer_metrics, HTTPD_RESP_USE_STRLEN);
+
+    for (int i = 0; i < stats_len && ret == ESP_OK; ++i) {
+        len = snprintf(line, sizeof(line),
+                       "accessor_viewer_frames_sent_total{addr=\"%s\"} %lu\n"
+                       "accessor_viewer_frames_dropped_total{addr=\"%s\"} %lu\n"
+                       "accessor_viewer_bytes_sent_total{addr=\"%s\"} %llu\n"
+                       "accessor_viewer_throughput_bytes{addr=\"%s\"} %lu\n",
+                       stats[i].addr, (unsigned long) stats[i].frames_sent,
+                       stats[i].addr, (unsigned long) stats[i].frames_dropped,
+                       stats[i].addr, (unsigned long long) stats[i].bytes_sent,
+                       stats[i].addr, (unsigned long) stats[i].throughput);
+        ret = httpd_resp_send_chunk(req, line, len);
     }
 
-    esp_err_t ret = espfsp_client_play_reconfigure_cam(client_handler, &cam_config);
     if (ret != ESP_OK)
     {
-        httpd_resp_send_500(req);
-        return ESP_OK;
+        return ret;
     }
 
-    httpd_resp_send(req, NULL, 0);
-    return ESP_OK;
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
-esp_err_t get_frame_config_handler(httpd_req_t *req) {
-    if (client_handler == NULL)
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+// Fills command from text message. Returns name of recognized command, NULL otherwise.
+static const char *parse_ws_command(const char *command, control_cmd_t *cmd) {
+    const char *query = strchr(command, '?');
+    query = query != NULL ? query + 1 : "";
+
+    if (strcmp(command, "start") == 0)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
-        return ESP_OK;
+        cmd->type = CONTROL_CMD_START_STREAM;
+        return "start";
     }
 
-    espfsp_frame_config_t frame_config;
+    if (strcmp(command, "stop") == 0)
+    {
+        cmd->type = CONTROL_CMD_STOP_STREAM;
+        return "stop";
+    }
 
-    esp_err_t ret = espfsp_client_play_get_frame(client_handler, &frame_config, 2000);
-    if (ret != ESP_OK)
+    if (strncmp(command, "set_frame?", strlen("set_frame?")) == 0)
     {
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
+        cmd->type = CONTROL_CMD_SET_FRAME;
+        set_default_frame_config(&cmd->frame_config);
+        parse_frame_config(query, &cmd->frame_config);
+        return "set_frame";
     }
 
-    char json_response[512];
-    char *ptr = json_response;
+    if (strncmp(command, "set_cam?", strlen("set_cam?")) == 0)
+    {
+        cmd->type = CONTROL_CMD_SET_CAM;
+        set_default_cam_config(&cmd->cam_config);
+        parse_cam_config(query, &cmd->cam_config);
+        return "set_cam";
+    }
 
-    ptr += sprintf(ptr, "{");
+    return NULL;
+}
 
-    ptr += sprintf(ptr, "\"fps\": %d,", frame_config.fps);
-    ptr += sprintf(ptr, "\"frame_max_len\": %ld,", frame_config.frame_max_len);
-    ptr += sprintf(ptr, "\"buffered_fbs\": %d,", frame_config.buffered_fbs);
-    ptr += sprintf(ptr, "\"fb_in_buffer_before_get\": %d", frame_config.fb_in_buffer_before_get);
+esp_err_t ws_stream_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET)
+    {
+        // Handshake is done. From now on frames are pushed by dispatcher sender task.
+        frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+        if (dispatcher == NULL)
+        {
+            return ESP_FAIL;
+        }
+        esp_err_t ret = frame_dispatcher_add_ws_viewer(dispatcher, req->handle, httpd_req_to_sockfd(req));
+        udps_release_dispatcher(dispatcher);
+        return ret;
+    }
 
-    sprintf(ptr, "}");
+    char command[128];
+    httpd_ws_frame_t ws_frame;
+    memset(&ws_frame, 0, sizeof(ws_frame));
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_frame, 0);
+    if (ret != ESP_OK || ws_frame.len >= sizeof(command))
+    {
+        ESP_LOGE(TAG, "WebSocket frame receive failed");
+        return ESP_FAIL;
+    }
 
-    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
-}
+    ws_frame.payload = (uint8_t *) command;
+    ret = httpd_ws_recv_frame(req, &ws_frame, sizeof(command) - 1);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "WebSocket frame receive failed");
+        return ret;
+    }
+    command[ws_frame.len] = '\0';
 
-esp_err_t get_cam_config_handler(httpd_req_t *req) {
-    if (client_handler == NULL)
+    if (ws_frame.type != HTTPD_WS_TYPE_TEXT)
     {
-        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, NULL);
         return ESP_OK;
     }
 
-    espfsp_cam_config_t cam_config;
+    ESP_LOGI(TAG, "WebSocket command: %s", command);
 
-    esp_err_t ret = espfsp_client_play_get_cam(client_handler, &cam_config, 2000);
-    if (ret != ESP_OK)
+    char reply[64];
+    control_cmd_t cmd;
+    uint32_t id = 0;
+
+    // Command is run by control worker, its result can be polled on /get_command
+    const char *name = parse_ws_command(command, &cmd);
+    if (name != NULL && control_worker_submit(&cmd, &id) != ESP_OK)
     {
-        httpd_resp_send(req, NULL, 0);
-        return ESP_OK;
+        id = 0;
     }
 
-    char json_response[512];
-    char *ptr = json_response;
+    snprintf(reply, sizeof(reply), "{\"cmd\": \"%s\", \"id\": %lu}",
+             name != NULL ? name : "unknown", (unsigned long) id);
 
-    ptr += sprintf(ptr, "{");
+    // Viewer of dispatcher replaced by fallback to TCP is gone, like its connection
+    frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+    if (dispatcher == NULL)
+    {
+        return ESP_FAIL;
+    }
+    ret = frame_dispatcher_ws_queue_text(dispatcher, httpd_req_to_sockfd(req), reply);
+    udps_release_dispatcher(dispatcher);
 
-    ptr += sprintf(ptr, "\"cam_jpeg_quality\": %d,", cam_config.cam_jpeg_quality);
-    ptr += sprintf(ptr, "\"cam_frame_size\": %d,", cam_config.cam_frame_size);
-    ptr += sprintf(ptr, "\"cam_pixel_format\": %d", cam_config.cam_pixel_format);
+    return ret;
+}
+#endif
 
-    sprintf(ptr, "}");
+httpd_uri_t replay_uri = {
+    .uri = "/replay",
+    .method = HTTP_GET,
+    .handler = replay_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+httpd_uri_t set_replay_uri = {
+    .uri = "/set_replay",
+    .method = HTTP_GET,
+    .handler = set_replay_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
 
-    return httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
-}
+httpd_uri_t mosaic_uri = {
+    .uri = "/mosaic",
+    .method = HTTP_GET,
+    .handler = mosaic_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
 
 httpd_uri_t stream_uri = {
     .uri = "/stream",
@@ -440,24 +1943,23 @@ httpd_uri_t stream_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
 };
 
-httpd_uri_t index_uri = {
-    .uri = "/index",
-    .method = HTTP_GET,
-    .handler = index_handler,
-    .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
-    ,
+httpd_uri_t ws_stream_uri = {
+    .uri = "/ws",
+    .method = HTTP_GET,
+    .handler = ws_stream_handler,
+    .user_ctx = NULL,
     .is_websocket = true,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
-#endif
 };
+#endif
 
 httpd_uri_t start_stream_uri = {
     .uri = "/start_stream",
@@ -466,7 +1968,7 @@ httpd_uri_t start_stream_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -479,7 +1981,7 @@ httpd_uri_t stop_stream_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -492,7 +1994,7 @@ httpd_uri_t get_src_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -505,7 +2007,7 @@ httpd_uri_t set_server_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -518,7 +2020,7 @@ httpd_uri_t set_src_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -531,7 +2033,7 @@ httpd_uri_t set_frame_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -544,7 +2046,7 @@ httpd_uri_t set_cam_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -557,7 +2059,7 @@ httpd_uri_t get_frame_config_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -570,7 +2072,163 @@ httpd_uri_t get_cam_config_uri = {
     .user_ctx = NULL
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     ,
-    .is_websocket = true,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t get_stream_clients_uri = {
+    .uri = "/get_stream_clients",
+    .method = HTTP_GET,
+    .handler = get_stream_clients_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t metrics_uri = {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = metrics_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t recordings_uri = {
+    .uri = "/recordings",
+    .method = HTTP_GET,
+    .handler = recordings_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t play_uri = {
+    .uri = "/play",
+    .method = HTTP_GET,
+    .handler = play_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t recording_uri = {
+    .uri = "/recording",
+    .method = HTTP_GET,
+    .handler = recording_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t motion_uri = {
+    .uri = "/motion",
+    .method = HTTP_GET,
+    .handler = motion_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t set_motion_uri = {
+    .uri = "/set_motion",
+    .method = HTTP_GET,
+    .handler = set_motion_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t motion_events_uri = {
+    .uri = "/motion_events",
+    .method = HTTP_GET,
+    .handler = motion_events_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t snapshot_uri = {
+    .uri = "/snapshot",
+    .method = HTTP_GET,
+    .handler = snapshot_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t get_status_uri = {
+    .uri = "/get_status",
+    .method = HTTP_GET,
+    .handler = get_status_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t reconfigure_uri = {
+    .uri = "/reconfigure",
+    .method = HTTP_POST,
+    .handler = reconfigure_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = NULL
+#endif
+};
+
+httpd_uri_t get_command_uri = {
+    .uri = "/get_command",
+    .method = HTTP_GET,
+    .handler = get_command_handler,
+    .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ,
+    .is_websocket = false,
     .handle_ws_control_frames = false,
     .supported_subprotocol = NULL
 #endif
@@ -581,7 +2239,8 @@ httpd_handle_t start_webserver(void)
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
-    config.max_uri_handlers = 10;
+    config.server_port = CONFIG_WEB_SERVER_PORT;
+    config.max_uri_handlers = 21;
     config.lru_purge_enable = true;
     // config.keep_alive_enable = true;
     // config.keep_alive_idle = 10;
@@ -593,7 +2252,8 @@ httpd_handle_t start_webserver(void)
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &start_stream_uri);
         httpd_register_uri_handler(server, &stop_stream_uri);
-        httpd_register_uri_handler(server, &index_uri);
+        static_assets_register(server, "/", web_assets, web_assets_count, "/index.html");
+        static_assets_register(server, "/index", web_assets, web_assets_count, "/index.html");
         httpd_register_uri_handler(server, &get_src_uri);
         httpd_register_uri_handler(server, &set_src_uri);
         httpd_register_uri_handler(server, &set_frame_uri);
@@ -601,6 +2261,16 @@ httpd_handle_t start_webserver(void)
         httpd_register_uri_handler(server, &set_server_uri);
         httpd_register_uri_handler(server, &get_frame_config_uri);
         httpd_register_uri_handler(server, &get_cam_config_uri);
+        httpd_register_uri_handler(server, &get_stream_clients_uri);
+        httpd_register_uri_handler(server, &get_command_uri);
+        httpd_register_uri_handler(server, &reconfigure_uri);
+        httpd_register_uri_handler(server, &metrics_uri);
+        httpd_register_uri_handler(server, &get_status_uri);
+        httpd_register_uri_handler(server, &snapshot_uri);
+        httpd_register_uri_handler(server, &set_replay_uri);
+        httpd_register_uri_handler(server, &recordings_uri);
+        httpd_register_uri_handler(server, &motion_uri);
+        httpd_register_uri_handler(server, &set_motion_uri);
         return server;
     }
 
@@ -608,6 +2278,23 @@ httpd_handle_t start_webserver(void)
     return NULL;
 }
 
+static void stream_server_close_fn(httpd_handle_t hd, int sockfd)
+{
+    // Sender tasks write to sockets on their own, so they have to let go before socket is closed
+    frame_dispatcher_handle_t dispatcher = udps_acquire_dispatcher();
+    if (dispatcher != NULL)
+    {
+        frame_dispatcher_close_socket(dispatcher, sockfd);
+        udps_release_dispatcher(dispatcher);
+    }
+    source_sessions_close_socket(sockfd);
+    replay_close_socket(sockfd);
+    playback_close_socket(sockfd);
+    motion_close_socket(sockfd);
+    mosaic_close_socket(sockfd);
+    close(sockfd);
+}
+
 httpd_handle_t start_stream_server(void)
 {
     httpd_handle_t server = NULL;
@@ -619,13 +2306,22 @@ httpd_handle_t start_stream_server(void)
     config.keep_alive_interval = 5;
     config.keep_alive_count = 3;
 
-    config.server_port += 1;
+    config.server_port = CONFIG_WEB_SERVER_PORT + 1;
     config.ctrl_port += 1;
+    config.close_fn = stream_server_close_fn;
 
     ESP_LOGI(TAG, "Starting stream server on port: '%d'", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &stream_uri);
+        httpd_register_uri_handler(server, &replay_uri);
+        httpd_register_uri_handler(server, &play_uri);
+        httpd_register_uri_handler(server, &recording_uri);
+        httpd_register_uri_handler(server, &motion_events_uri);
+        httpd_register_uri_handler(server, &mosaic_uri);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        httpd_register_uri_handler(server, &ws_stream_uri);
+#endif
         return server;
     }
 
@@ -1,47 +0,0 @@
-const uint8_t wifi_config_index_html_gz[] = {
-    0x1f, 0x8b, 0x08, 0x08, 0x56, 0x73, 0x8d, 0x67, 0x00, 0x03, 0x77, 0x69, 0x66, 0x69, 0x5f, 0x63,
-    0x6f, 0x6e, 0x66, 0x69, 0x67, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x00, 0x85, 0x55, 0x5b, 0x6f, 0xda,
-    0x30, 0x14, 0x7e, 0xef, 0xaf, 0xf0, 0x52, 0x4d, 0x6a, 0x25, 0x32, 0x92, 0xc2, 0xb8, 0x64, 0x01,
-    0x69, 0xa2, 0xad, 0xb4, 0xa7, 0x22, 0x51, 0x69, 0x9a, 0xa6, 0x3e, 0x38, 0xb6, 0x93, 0x78, 0x75,
-    0xec, 0xc8, 0x76, 0x0a, 0x74, 0xda, 0x7f, 0x9f, 0x73, 0x21, 0x21, 0x21, 0x14, 0x0b, 0x84, 0xed,
-    0x73, 0x7c, 0xce, 0x77, 0xbe, 0x73, 0xc1, 0xff, 0x74, 0xff, 0xb4, 0x7a, 0xfe, 0xb5, 0x7e, 0x00,
-    0xb1, 0x4e, 0xd8, 0xf2, 0xca, 0x3f, 0xfc, 0x10, 0x88, 0x97, 0x57, 0xc0, 0x2c, 0x5f, 0x53, 0xcd,
-    0xc8, 0xf2, 0x27, 0x7d, 0xa4, 0x60, 0x43, 0x74, 0x96, 0xfa, 0xc3, 0xf2, 0xa6, 0x94, 0x2a, 0xbd,
-    0x3f, 0xec, 0xf3, 0x15, 0x08, 0xbc, 0x07, 0x7f, 0xeb, 0x63, 0xbe, 0x42, 0xc1, 0xb5, 0x1d, 0xc2,
-    0x84, 0xb2, 0xbd, 0x07, 0xbe, 0x4b, 0x0a, 0xd9, 0x00, 0x28, 0xc8, 0x95, 0xad, 0x88, 0xa4, 0xe1,
-    0xb7, 0x96, 0x6e, 0x00, 0xd1, 0x6b, 0x24, 0x45, 0xc6, 0xb1, 0x07, 0xae, 0xc3, 0x51, 0x38, 0x0e,
-    0x27, 0x6d, 0x05, 0x24, 0x98, 0x90, 0x46, 0x36, 0x1a, 0x8d, 0xda, 0x82, 0x04, 0xca, 0x88, 0x72,
-    0x0f, 0x38, 0xed, 0x6b, 0x4c, 0x55, 0xca, 0xa0, 0x71, 0x1c, 0x32, 0xb2, 0x6b, 0x8b, 0x20, 0xa3,
-    0x11, 0xb7, 0xa9, 0x26, 0x89, 0xf2, 0x00, 0x22, 0x5c, 0x13, 0xd9, 0x56, 0xf8, 0x93, 0x29, 0x4d,
-    0xc3, 0xbd, 0x8d, 0x4c, 0x00, 0x46, 0xdc, 0xaf, 0x14, 0x13, 0x1a, 0xc5, 0x46, 0xe6, 0x3a, 0xce,
-    0x5b, 0xdc, 0x88, 0xfe, 0xd5, 0xbb, 0x50, 0xc8, 0xa4, 0xc3, 0xc8, 0x71, 0x94, 0xdb, 0xd8, 0x20,
-    0x68, 0x9b, 0x4c, 0x21, 0xc6, 0x94, 0x47, 0x1e, 0xb8, 0x73, 0xd2, 0x0e, 0xe6, 0x40, 0x48, 0x4c,
-    0xa4, 0x2d, 0x21, 0xa6, 0x99, 0x41, 0x3d, 0x3b, 0x95, 0xef, 0x6c, 0x15, 0x43, 0x2c, 0xb6, 0x86,
-    0x09, 0x30, 0x4e, 0x77, 0x60, 0x62, 0xbe, 0x32, 0x0a, 0xe0, 0x8d, 0x33, 0x00, 0xd5, 0xe7, 0x8b,
-    0x7b, 0xdb, 0x7e, 0xb5, 0xa5, 0x58, 0xc7, 0x1e, 0x18, 0x39, 0x27, 0xfe, 0x34, 0xd9, 0x69, 0xbb,
-    0x20, 0xea, 0x34, 0xfa, 0x26, 0xc4, 0xd8, 0xed, 0x4b, 0xb9, 0xa2, 0xef, 0xa4, 0x2f, 0x86, 0x32,
-    0x53, 0x76, 0x20, 0xb4, 0x16, 0x49, 0x9f, 0xc2, 0x21, 0xc7, 0xf3, 0xd9, 0xcc, 0x45, 0x93, 0x3e,
-    0x87, 0x0c, 0x06, 0x84, 0x75, 0x7c, 0xd6, 0x99, 0x0e, 0x98, 0x40, 0xaf, 0x1f, 0xba, 0xfc, 0xda,
-    0xf5, 0x78, 0x84, 0xd7, 0x1d, 0x9f, 0x83, 0xd3, 0x2a, 0xb9, 0x06, 0x0b, 0xe5, 0x69, 0xa6, 0x7f,
-    0xeb, 0x7d, 0x4a, 0x16, 0x56, 0x4e, 0x97, 0xf5, 0x32, 0xe8, 0x95, 0xa5, 0x50, 0xa9, 0xad, 0x49,
-    0x9f, 0xf5, 0xd2, 0x01, 0x5e, 0xb1, 0x8f, 0x20, 0x43, 0x37, 0xa6, 0x8a, 0x3e, 0x03, 0xbb, 0xe0,
-    0xe4, 0xf6, 0x4c, 0x51, 0xb8, 0x97, 0x08, 0x75, 0x4f, 0xc2, 0x2b, 0xab, 0xc6, 0x48, 0x4c, 0x2d,
-    0x28, 0xc1, 0x28, 0x06, 0xd7, 0x18, 0xe3, 0x0f, 0x2b, 0xeb, 0x84, 0x85, 0xa2, 0xb2, 0xe8, 0x7b,
-    0x01, 0xa1, 0xd2, 0x35, 0x57, 0x97, 0x08, 0x51, 0x59, 0x90, 0x50, 0x7d, 0x12, 0x72, 0x2b, 0x98,
-    0x9e, 0x0a, 0x38, 0xce, 0xc7, 0xe4, 0x4c, 0x3e, 0x7a, 0x1a, 0xa7, 0xe9, 0x2b, 0xfb, 0x90, 0xb4,
-    0xd9, 0x7c, 0x1e, 0x84, 0x6e, 0x3f, 0x1d, 0x5c, 0xf0, 0xae, 0x81, 0x0b, 0xed, 0x85, 0x32, 0xa9,
-    0x72, 0xb3, 0xa9, 0xa0, 0xe7, 0x7a, 0xa1, 0x2f, 0x7a, 0x2f, 0x16, 0x6f, 0x44, 0x9e, 0x1d, 0x02,
-    0x35, 0xd8, 0xa9, 0x33, 0x45, 0x68, 0xda, 0xb5, 0xea, 0x0f, 0xab, 0x19, 0xeb, 0x0f, 0xcb, 0xa9,
-    0xec, 0xe7, 0x43, 0xb6, 0x1a, 0xbf, 0xc5, 0x74, 0x49, 0x88, 0x8e, 0x05, 0x5e, 0x58, 0xeb, 0xa7,
-    0xcd, 0xb3, 0x05, 0x20, 0xd2, 0x54, 0xf0, 0x85, 0x35, 0x34, 0x73, 0x8b, 0x13, 0xa4, 0xad, 0x66,
-    0x3a, 0xfb, 0xb1, 0xbb, 0x7c, 0xd8, 0xac, 0x47, 0x77, 0xa0, 0x18, 0xe7, 0x2b, 0xc1, 0x43, 0x1a,
-    0x65, 0x12, 0xe6, 0x0f, 0x8c, 0x75, 0xf7, 0x48, 0xb3, 0x6c, 0x31, 0x63, 0xde, 0x84, 0xa1, 0x28,
-    0xb6, 0x96, 0x9b, 0xcd, 0x8f, 0x7b, 0xcf, 0x1f, 0x16, 0xf7, 0x47, 0x7a, 0x45, 0xbc, 0xe0, 0xa8,
-    0xfc, 0x01, 0xc5, 0xd5, 0x13, 0xc0, 0x61, 0x42, 0x0e, 0x7b, 0xd3, 0x9b, 0x88, 0xc4, 0x82, 0x19,
-    0x7e, 0x17, 0xd6, 0x43, 0xce, 0x5e, 0x89, 0x21, 0x37, 0x6b, 0xf5, 0xfb, 0xad, 0x3b, 0x66, 0xb9,
-    0xae, 0x76, 0x17, 0xfc, 0xd7, 0x0f, 0x0a, 0x0c, 0xcd, 0xa9, 0xc4, 0xd1, 0x9c, 0xcf, 0x61, 0x59,
-    0xd7, 0x0e, 0xfb, 0xed, 0x57, 0xf9, 0x04, 0x6f, 0x90, 0x65, 0xe6, 0xb8, 0x6a, 0xf1, 0xeb, 0x0f,
-    0xf3, 0x5c, 0xe4, 0x59, 0x2a, 0xd3, 0x63, 0xf8, 0x2c, 0xfe, 0x4a, 0xff, 0x03, 0x79, 0xd7, 0xd7,
-    0xcc, 0x62, 0x07, 0x00, 0x00
-};
-const size_t wifi_config_index_html_gz_len = 693;
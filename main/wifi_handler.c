@@ -10,7 +10,8 @@
 #include "esp_event.h"
 
 #include "wifi_handler.h"
-#include "wifi_config_index_html_gz.h"
+#include "static_assets.h"
+#include "web_assets.h"
 
 #define EXAMPLE_ESP_MAXIMUM_RETRY 10
 
@@ -126,13 +127,6 @@ static void load_wifi_credentials(char *ssid, char *password) {
     nvs_close(nvs);
 }
 
-esp_err_t handle_root_get(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
-    httpd_resp_send(req, (const char *)wifi_config_index_html_gz, wifi_config_index_html_gz_len);
-    return ESP_OK;
-}
-
 esp_err_t handle_connect_post(httpd_req_t *req) {
     char buf[128];
     int len = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -159,12 +153,6 @@ static httpd_handle_t start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
     if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t root_get = {
-            .uri = "/",
-            .method = HTTP_GET,
-            .handler = handle_root_get,
-            .user_ctx = NULL
-        };
         httpd_uri_t connect_post = {
             .uri = "/connect",
             .method = HTTP_POST,
@@ -172,7 +160,7 @@ static httpd_handle_t start_webserver(void) {
             .user_ctx = NULL
         };
 
-        httpd_register_uri_handler(server, &root_get);
+        static_assets_register(server, "/", web_assets, web_assets_count, "/wifi_config.html");
         httpd_register_uri_handler(server, &connect_post);
     }
     return server;
@@ -0,0 +1,662 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+// Mock of ESPFSP client play for host build. Instead of talking to server module it replays JPEG frames from
+// directory at configured rate. Every frame gets COM segment with wall clock time it was produced at, so benchmarks
+// can measure latency through accessor. Behaviour is set with environment variables:
+//
+//   ESPFSP_MOCK_FRAMES_DIR       directory with *.jpg frames replayed in name order, built-in 16x16 frame if not set
+//   ESPFSP_MOCK_FPS              frame rate, overrides fps of frame configuration
+//   ESPFSP_MOCK_FRAME_LEN        frames shorter than this are padded with COM segments to this length
+//   ESPFSP_MOCK_SOURCES          number of sources reported by server, 2 by default
+//   ESPFSP_MOCK_CONTROL_DELAY_MS time every control call takes, imitating round trip to server module
+//   ESPFSP_MOCK_NET              connect to server emulator (bench/espfsp_server_emulator.py) at configured address
+//                                and ports instead of replaying frames locally, see mock_net.c. Value "tcp" or "udp"
+//                                forces data transport, any other value keeps the configured one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "mock_internal.h"
+
+#define CONFIG_MOCK_COM_MAX_LEN 65533
+#define CONFIG_MOCK_TIMESTAMP_LEN 64
+#define CONFIG_MOCK_CONTROL_TIMEOUT 2000
+
+static const char *TAG = "ESPFSP_MOCK";
+
+// 16x16 baseline JPEG used when no frames directory is given
+static const uint8_t builtin_frame[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x10, 0x0b, 0x0c, 0x0e, 0x0c, 0x0a, 0x10, 0x0e, 0x0d, 0x0e, 0x12,
+    0x11, 0x10, 0x13, 0x18, 0x28, 0x1a, 0x18, 0x16, 0x16, 0x18, 0x31, 0x23,
+    0x25, 0x1d, 0x28, 0x3a, 0x33, 0x3d, 0x3c, 0x39, 0x33, 0x38, 0x37, 0x40,
+    0x48, 0x5c, 0x4e, 0x40, 0x44, 0x57, 0x45, 0x37, 0x38, 0x50, 0x6d, 0x51,
+    0x57, 0x5f, 0x62, 0x67, 0x68, 0x67, 0x3e, 0x4d, 0x71, 0x79, 0x70, 0x64,
+    0x78, 0x5c, 0x65, 0x67, 0x63, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x11, 0x12,
+    0x12, 0x18, 0x15, 0x18, 0x2f, 0x1a, 0x1a, 0x2f, 0x63, 0x42, 0x38, 0x42,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63, 0x63,
+    0x63, 0x63, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x10, 0x03,
+    0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x15, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x06, 0xff, 0xc4, 0x00, 0x17,
+    0x10, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x21, 0x31, 0xff, 0xc4, 0x00,
+    0x15, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xc4, 0x00, 0x19,
+    0x11, 0x00, 0x02, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x05, 0x21, 0x31, 0xff,
+    0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f,
+    0x00, 0x9f, 0x38, 0x72, 0xa2, 0x67, 0x0e, 0x54, 0x48, 0xe1, 0xca, 0x89,
+    0x9c, 0x39, 0x52, 0xa5, 0x6c, 0x57, 0xbd, 0xcd, 0x3f, 0xff, 0xd9,
+};
+
+static uint32_t env_uint(const char *name, uint32_t default_value)
+{
+    const char *value = getenv(name);
+    return value != NULL ? strtoul(value, NULL, 10) : default_value;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char **) a, *(const char **) b);
+}
+
+static esp_err_t read_file(const char *path, mock_frame_t *frame)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    frame->buf = len > 4 ? (uint8_t *) malloc(len) : NULL;
+    frame->len = frame->buf != NULL ? fread(frame->buf, 1, len, file) : 0;
+    fclose(file);
+
+    // Only complete JPEG files can be replayed, as COM segments are inserted right after SOI marker
+    if (frame->buf == NULL || frame->len != len || frame->buf[0] != 0xff || frame->buf[1] != 0xd8)
+    {
+        free(frame->buf);
+        frame->buf = NULL;
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static void load_frames(espfsp_client_play_handler_t handler)
+{
+    const char *dir_path = getenv("ESPFSP_MOCK_FRAMES_DIR");
+    DIR *dir = dir_path != NULL ? opendir(dir_path) : NULL;
+
+    if (dir != NULL)
+    {
+        char *names[CONFIG_MOCK_MAX_FRAMES];
+        int names_len = 0;
+
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL && names_len < CONFIG_MOCK_MAX_FRAMES)
+        {
+            const char *ext = strrchr(entry->d_name, '.');
+            if (ext != NULL && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0))
+            {
+                names[names_len++] = strdup(entry->d_name);
+            }
+        }
+        closedir(dir);
+
+        qsort(names, names_len, sizeof(char *), compare_names);
+
+        for (int i = 0; i < names_len; ++i)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]);
+
+            if (read_file(path, &handler->frames[handler->frames_len]) == ESP_OK)
+            {
+                handler->frames_len++;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Skipping %s, it is not JPEG file", path);
+            }
+            free(names[i]);
+        }
+    }
+
+    if (handler->frames_len == 0)
+    {
+        if (dir_path != NULL)
+        {
+            ESP_LOGW(TAG, "No frames in %s, replaying built-in frame", dir_path);
+        }
+
+        handler->frames[0].buf = (uint8_t *) builtin_frame;
+        handler->frames[0].len = sizeof(builtin_frame);
+        handler->frames_len = 1;
+    }
+
+    ESP_LOGI(TAG, "Replaying %d frames", handler->frames_len);
+}
+
+static void control_delay(espfsp_client_play_handler_t handler)
+{
+    if (handler->control_delay_ms > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(handler->control_delay_ms));
+    }
+}
+
+static size_t put_com(uint8_t *buf, const uint8_t *payload, size_t payload_len)
+{
+    buf[0] = 0xff;
+    buf[1] = 0xfe;
+    buf[2] = (payload_len + 2) >> 8;
+    buf[3] = (payload_len + 2) & 0xff;
+    if (payload != NULL)
+    {
+        memcpy(buf + 4, payload, payload_len);
+    }
+    else
+    {
+        memset(buf + 4, 0, payload_len);
+    }
+
+    return payload_len + 4;
+}
+
+// Builds frame as SOI, timestamp COM, padding COM segments and rest of recorded frame. Returns 0 if it does not fit.
+static size_t build_frame(espfsp_client_play_handler_t handler, const mock_frame_t *frame, uint32_t seq,
+                          uint8_t *buf, size_t buf_len)
+{
+    char timestamp[CONFIG_MOCK_TIMESTAMP_LEN];
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    int timestamp_len = snprintf(timestamp, sizeof(timestamp), "espfsp-mock ts=%lld seq=%lu",
+                                 (long long) now.tv_sec * 1000000 + now.tv_usec, (unsigned long) seq);
+
+    size_t len = 2 + 4 + timestamp_len + (frame->len - 2);
+    size_t padding = handler->pad_len > len ? handler->pad_len - len : 0;
+    if (len + padding > buf_len)
+    {
+        return 0;
+    }
+
+    size_t pos = 0;
+    buf[pos++] = 0xff;
+    buf[pos++] = 0xd8;
+    pos += put_com(buf + pos, (const uint8_t *) timestamp, timestamp_len);
+
+    // Each COM segment costs 4 bytes of header, so padding shorter than that is skipped
+    while (padding >= 4)
+    {
+        size_t payload_len = padding - 4 > CONFIG_MOCK_COM_MAX_LEN ? CONFIG_MOCK_COM_MAX_LEN : padding - 4;
+        pos += put_com(buf + pos, NULL, payload_len);
+        padding -= payload_len + 4;
+    }
+
+    memcpy(buf + pos, frame->buf + 2, frame->len - 2);
+    return pos + frame->len - 2;
+}
+
+// Buffers count and size follow frame configuration. Buffer is only resized while producer owns it, so buffers
+// held by accessor are never touched.
+mock_fb_t *mock_acquire_fb(espfsp_client_play_handler_t handler)
+{
+    mock_fb_t *mock_fb = NULL;
+
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    int fbs_len = handler->frame_config.buffered_fbs;
+    fbs_len = fbs_len < 1 ? 1 : (fbs_len > CONFIG_MOCK_MAX_FBS ? CONFIG_MOCK_MAX_FBS : fbs_len);
+    size_t frame_max_len = handler->frame_config.frame_max_len;
+
+    for (int i = 0; i < fbs_len; ++i)
+    {
+        if (handler->fbs[i].state == MOCK_FB_FREE)
+        {
+            mock_fb = &handler->fbs[i];
+            mock_fb->state = MOCK_FB_FILLING;
+            break;
+        }
+    }
+    xSemaphoreGive(handler->mutex);
+
+    if (mock_fb != NULL && mock_fb->capacity != frame_max_len)
+    {
+        uint8_t *buf = (uint8_t *) realloc(mock_fb->fb.buf, frame_max_len);
+        if (buf == NULL)
+        {
+            mock_commit_fb(handler, mock_fb, 0);
+            return NULL;
+        }
+        mock_fb->fb.buf = buf;
+        mock_fb->capacity = frame_max_len;
+    }
+
+    return mock_fb;
+}
+
+void mock_commit_fb(espfsp_client_play_handler_t handler, mock_fb_t *mock_fb, size_t len)
+{
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    if (len > 0)
+    {
+        mock_fb->fb.len = len;
+        mock_fb->seq = ++handler->seq;
+        mock_fb->state = MOCK_FB_READY;
+    }
+    else
+    {
+        mock_fb->state = MOCK_FB_FREE;
+    }
+    xSemaphoreGive(handler->mutex);
+
+    if (len > 0)
+    {
+        xSemaphoreGive(handler->ready);
+    }
+}
+
+static void produce_frame(espfsp_client_play_handler_t handler)
+{
+    // Like real client, frames arriving when all buffers are in use are lost
+    mock_fb_t *mock_fb = mock_acquire_fb(handler);
+    if (mock_fb == NULL)
+    {
+        return;
+    }
+
+    const mock_frame_t *frame = &handler->frames[handler->next_frame];
+    handler->next_frame = (handler->next_frame + 1) % handler->frames_len;
+
+    size_t len = build_frame(handler, frame, handler->seq + 1, mock_fb->fb.buf, mock_fb->capacity);
+    if (len == 0)
+    {
+        ESP_LOGW(TAG, "Frame does not fit in %lu bytes", (unsigned long) mock_fb->capacity);
+    }
+
+    mock_commit_fb(handler, mock_fb, len);
+}
+
+static void producer_task(void *pvParameters)
+{
+    espfsp_client_play_handler_t handler = (espfsp_client_play_handler_t) pvParameters;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (handler->running)
+    {
+        uint16_t fps = handler->fps_override > 0 ? handler->fps_override : handler->frame_config.fps;
+        TickType_t period = pdMS_TO_TICKS(1000 / (fps > 0 ? fps : 1));
+
+        vTaskDelayUntil(&last_wake, period > 0 ? period : 1);
+
+        if (handler->streaming)
+        {
+            produce_frame(handler);
+        }
+    }
+
+    xSemaphoreGive(handler->task_done);
+    vTaskDelete(NULL);
+}
+
+espfsp_client_play_handler_t espfsp_client_play_init(const espfsp_client_play_config_t *config)
+{
+    espfsp_client_play_handler_t handler =
+        (espfsp_client_play_handler_t) calloc(1, sizeof(struct espfsp_client_play));
+    if (handler == NULL)
+    {
+        return NULL;
+    }
+
+    handler->frame_config = config->frame_config;
+    handler->cam_config = (espfsp_cam_config_t) {
+        .cam_fb_count = 2,
+        .cam_grab_mode = ESPFSP_GRAB_LATEST,
+        .cam_jpeg_quality = 30,
+        .cam_frame_size = ESPFSP_FRAMESIZE_96X96,
+        .cam_pixel_format = ESPFSP_PIXFORMAT_JPEG,
+    };
+
+    handler->fps_override = env_uint("ESPFSP_MOCK_FPS", 0);
+    handler->pad_len = env_uint("ESPFSP_MOCK_FRAME_LEN", 0);
+    handler->control_delay_ms = env_uint("ESPFSP_MOCK_CONTROL_DELAY_MS", 0);
+    handler->sources_len = env_uint("ESPFSP_MOCK_SOURCES", 2);
+    if (handler->sources_len > CONFIG_MOCK_MAX_SOURCES)
+    {
+        handler->sources_len = CONFIG_MOCK_MAX_SOURCES;
+    }
+
+    handler->mutex = xSemaphoreCreateMutex();
+    handler->ready = xSemaphoreCreateCounting(CONFIG_MOCK_MAX_FBS, 0);
+    handler->task_done = xSemaphoreCreateBinary();
+    if (handler->mutex == NULL || handler->ready == NULL || handler->task_done == NULL)
+    {
+        ESP_LOGE(TAG, "Mock init failed");
+        espfsp_client_play_deinit(handler);
+        return NULL;
+    }
+
+    // Emulator sends frames of its own sources, so local frames are not loaded then
+    if (getenv("ESPFSP_MOCK_NET") != NULL)
+    {
+        handler->net = true;
+        if (mock_net_init(handler, config) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Connecting to server emulator failed");
+            espfsp_client_play_deinit(handler);
+            return NULL;
+        }
+        return handler;
+    }
+
+    load_frames(handler);
+
+    handler->running = true;
+    BaseType_t xStatus = xTaskCreate(
+        producer_task,
+        "espfsp_mock",
+        config->data_task_info.stack_size,
+        handler,
+        config->data_task_info.task_prio,
+        &handler->task);
+    if (xStatus != pdPASS)
+    {
+        ESP_LOGE(TAG, "Producer task creation failed");
+        handler->running = false;
+        espfsp_client_play_deinit(handler);
+        return NULL;
+    }
+
+    return handler;
+}
+
+esp_err_t espfsp_client_play_deinit(espfsp_client_play_handler_t handler)
+{
+    if (handler->net)
+    {
+        mock_net_deinit(handler);
+    }
+    else if (handler->running)
+    {
+        handler->running = false;
+        xSemaphoreTake(handler->task_done, portMAX_DELAY);
+    }
+
+    for (int i = 0; i < CONFIG_MOCK_MAX_FBS; ++i)
+    {
+        free(handler->fbs[i].fb.buf);
+    }
+
+    for (int i = 0; i < handler->frames_len; ++i)
+    {
+        if (handler->frames[i].buf != builtin_frame)
+        {
+            free(handler->frames[i].buf);
+        }
+    }
+
+    if (handler->mutex != NULL)
+    {
+        vSemaphoreDelete(handler->mutex);
+    }
+    if (handler->ready != NULL)
+    {
+        vSemaphoreDelete(handler->ready);
+    }
+    if (handler->task_done != NULL)
+    {
+        vSemaphoreDelete(handler->task_done);
+    }
+
+    free(handler);
+    return ESP_OK;
+}
+
+espfsp_fb_t *espfsp_client_play_get_fb(espfsp_client_play_handler_t handler, uint32_t timeout_ms)
+{
+    // Real client returns at once when stream is not started
+    if (!handler->streaming)
+    {
+        return NULL;
+    }
+
+    // Getting frame from empty buffer is a stall. Buffer is then filled with fb_in_buffer_before_get frames again
+    // before next one is handed out, the same as at stream start.
+    if (uxSemaphoreGetCount(handler->ready) == 0)
+    {
+        handler->prebuffering = true;
+    }
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    while (handler->prebuffering && uxSemaphoreGetCount(handler->ready) < handler->frame_config.fb_in_buffer_before_get)
+    {
+        if (xTaskGetTickCount() >= deadline || !handler->streaming)
+        {
+            return NULL;
+        }
+        vTaskDelay(1);
+    }
+    handler->prebuffering = false;
+
+    TickType_t now = xTaskGetTickCount();
+    if (xSemaphoreTake(handler->ready, deadline > now ? deadline - now : 0) != pdTRUE)
+    {
+        return NULL;
+    }
+
+    mock_fb_t *oldest = NULL;
+
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOCK_MAX_FBS; ++i)
+    {
+        if (handler->fbs[i].state == MOCK_FB_READY && (oldest == NULL || handler->fbs[i].seq < oldest->seq))
+        {
+            oldest = &handler->fbs[i];
+        }
+    }
+    if (oldest != NULL)
+    {
+        oldest->state = MOCK_FB_TAKEN;
+    }
+    xSemaphoreGive(handler->mutex);
+
+    return oldest != NULL ? &oldest->fb : NULL;
+}
+
+esp_err_t espfsp_client_play_return_fb(espfsp_client_play_handler_t handler, espfsp_fb_t *fb)
+{
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOCK_MAX_FBS; ++i)
+    {
+        if (&handler->fbs[i].fb == fb)
+        {
+            handler->fbs[i].state = MOCK_FB_FREE;
+        }
+    }
+    xSemaphoreGive(handler->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_start_stream(espfsp_client_play_handler_t handler)
+{
+    control_delay(handler);
+
+    if (handler->net && mock_net_request(handler, "START", NULL, 0, CONFIG_MOCK_CONTROL_TIMEOUT) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    handler->prebuffering = true;
+    handler->streaming = true;
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_stop_stream(espfsp_client_play_handler_t handler)
+{
+    control_delay(handler);
+
+    if (handler->net && mock_net_request(handler, "STOP", NULL, 0, CONFIG_MOCK_CONTROL_TIMEOUT) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    handler->streaming = false;
+
+    // Frames not taken yet are dropped, like buffered data of closed session
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MOCK_MAX_FBS; ++i)
+    {
+        if (handler->fbs[i].state == MOCK_FB_READY)
+        {
+            handler->fbs[i].state = MOCK_FB_FREE;
+            xSemaphoreTake(handler->ready, 0);
+        }
+    }
+    xSemaphoreGive(handler->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_get_sources_timeout(
+    espfsp_client_play_handler_t handler, char (*names)[30], int *names_len, uint32_t timeout_ms)
+{
+    control_delay(handler);
+
+    if (handler->net)
+    {
+        char reply[CONFIG_MOCK_MAX_SOURCES * CONFIG_MOCK_SOURCE_NAME_LEN];
+        if (mock_net_request(handler, "SOURCES", reply, sizeof(reply), timeout_ms) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+
+        int len = 0;
+        char *save = NULL;
+        for (char *name = strtok_r(reply, " ", &save); name != NULL && len < *names_len;
+             name = strtok_r(NULL, " ", &save))
+        {
+            snprintf(names[len++], CONFIG_MOCK_SOURCE_NAME_LEN, "%s", name);
+        }
+
+        *names_len = len;
+        return ESP_OK;
+    }
+
+    int len = handler->sources_len < *names_len ? handler->sources_len : *names_len;
+    for (int i = 0; i < len; ++i)
+    {
+        snprintf(names[i], CONFIG_MOCK_SOURCE_NAME_LEN, "mock_cam_%d", i);
+    }
+
+    *names_len = len;
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_set_source(espfsp_client_play_handler_t handler, const char *name)
+{
+    control_delay(handler);
+
+    if (handler->net)
+    {
+        char request[8 + CONFIG_MOCK_SOURCE_NAME_LEN];
+        snprintf(request, sizeof(request), "SOURCE %s", name);
+        return mock_net_request(handler, request, NULL, 0, CONFIG_MOCK_CONTROL_TIMEOUT);
+    }
+
+    int source;
+    if (sscanf(name, "mock_cam_%d", &source) != 1 || source < 0 || source >= handler->sources_len)
+    {
+        return ESP_FAIL;
+    }
+
+    handler->source = source;
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_reconfigure_frame(espfsp_client_play_handler_t handler, espfsp_frame_config_t *config)
+{
+    control_delay(handler);
+
+    if (handler->net)
+    {
+        char request[64];
+        snprintf(request, sizeof(request), "FRAME %u %lu %u %u", config->fps, (unsigned long) config->frame_max_len,
+                 config->buffered_fbs, config->fb_in_buffer_before_get);
+        if (mock_net_request(handler, request, NULL, 0, CONFIG_MOCK_CONTROL_TIMEOUT) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+    }
+
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    handler->frame_config = *config;
+    xSemaphoreGive(handler->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_reconfigure_cam(espfsp_client_play_handler_t handler, espfsp_cam_config_t *config)
+{
+    control_delay(handler);
+
+    if (handler->net)
+    {
+        char request[64];
+        snprintf(request, sizeof(request), "CAM %d %d %d",
+                 config->cam_jpeg_quality, config->cam_frame_size, config->cam_pixel_format);
+        if (mock_net_request(handler, request, NULL, 0, CONFIG_MOCK_CONTROL_TIMEOUT) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+    }
+
+    handler->cam_config = *config;
+    return ESP_OK;
+}
+
+// Configurations set through this client are the ones server module uses, so they are answered locally
+esp_err_t espfsp_client_play_get_frame(
+    espfsp_client_play_handler_t handler, espfsp_frame_config_t *config, uint32_t timeout_ms)
+{
+    control_delay(handler);
+
+    xSemaphoreTake(handler->mutex, portMAX_DELAY);
+    *config = handler->frame_config;
+    xSemaphoreGive(handler->mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t espfsp_client_play_get_cam(
+    espfsp_client_play_handler_t handler, espfsp_cam_config_t *config, uint32_t timeout_ms)
+{
+    control_delay(handler);
+    *config = handler->cam_config;
+    return ESP_OK;
+}
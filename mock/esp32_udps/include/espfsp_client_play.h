@@ -0,0 +1,125 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_netif_ip_addr.h"
+
+// Subset of ESPFSP client play API used by accessor. Types mirror the real component, so accessor sources
+// build against either of them.
+
+typedef enum
+{
+    ESPFSP_TRANSPORT_TCP,
+    ESPFSP_TRANSPORT_UDP,
+} espfsp_data_transport_t;
+
+typedef enum
+{
+    ESPFSP_GRAB_WHEN_EMPTY,
+    ESPFSP_GRAB_LATEST,
+} espfsp_grab_mode_t;
+
+typedef enum
+{
+    ESPFSP_FRAMESIZE_96X96,
+    ESPFSP_FRAMESIZE_QQVGA,
+    ESPFSP_FRAMESIZE_QCIF,
+    ESPFSP_FRAMESIZE_HQVGA,
+    ESPFSP_FRAMESIZE_240X240,
+    ESPFSP_FRAMESIZE_QVGA,
+    ESPFSP_FRAMESIZE_CIF,
+    ESPFSP_FRAMESIZE_HVGA,
+    ESPFSP_FRAMESIZE_VGA,
+    ESPFSP_FRAMESIZE_SVGA,
+    ESPFSP_FRAMESIZE_XGA,
+    ESPFSP_FRAMESIZE_HD,
+    ESPFSP_FRAMESIZE_SXGA,
+    ESPFSP_FRAMESIZE_UXGA,
+} espfsp_framesize_t;
+
+typedef enum
+{
+    ESPFSP_PIXFORMAT_RGB565,
+    ESPFSP_PIXFORMAT_YUV422,
+    ESPFSP_PIXFORMAT_YUV420,
+    ESPFSP_PIXFORMAT_GRAYSCALE,
+    ESPFSP_PIXFORMAT_JPEG,
+} espfsp_pixformat_t;
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+    size_t width;
+    size_t height;
+} espfsp_fb_t;
+
+typedef struct
+{
+    uint16_t fps;
+    uint32_t frame_max_len;
+    uint16_t buffered_fbs;
+    uint16_t fb_in_buffer_before_get;
+} espfsp_frame_config_t;
+
+typedef struct
+{
+    int cam_fb_count;
+    espfsp_grab_mode_t cam_grab_mode;
+    int cam_jpeg_quality;
+    espfsp_framesize_t cam_frame_size;
+    espfsp_pixformat_t cam_pixel_format;
+} espfsp_cam_config_t;
+
+typedef struct
+{
+    uint32_t stack_size;
+    uint32_t task_prio;
+} espfsp_task_info_t;
+
+typedef struct
+{
+    uint16_t control_port;
+    uint16_t data_port;
+} espfsp_ports_t;
+
+typedef struct
+{
+    espfsp_task_info_t data_task_info;
+    espfsp_task_info_t session_and_control_task_info;
+    espfsp_ports_t local;
+    espfsp_ports_t remote;
+    espfsp_data_transport_t data_transport;
+    esp_ip4_addr_t remote_addr;
+    espfsp_frame_config_t frame_config;
+} espfsp_client_play_config_t;
+
+typedef struct espfsp_client_play *espfsp_client_play_handler_t;
+
+espfsp_client_play_handler_t espfsp_client_play_init(const espfsp_client_play_config_t *config);
+esp_err_t espfsp_client_play_deinit(espfsp_client_play_handler_t handler);
+
+espfsp_fb_t *espfsp_client_play_get_fb(espfsp_client_play_handler_t handler, uint32_t timeout_ms);
+esp_err_t espfsp_client_play_return_fb(espfsp_client_play_handler_t handler, espfsp_fb_t *fb);
+
+esp_err_t espfsp_client_play_start_stream(espfsp_client_play_handler_t handler);
+esp_err_t espfsp_client_play_stop_stream(espfsp_client_play_handler_t handler);
+
+esp_err_t espfsp_client_play_get_sources_timeout(
+    espfsp_client_play_handler_t handler, char (*names)[30], int *names_len, uint32_t timeout_ms);
+esp_err_t espfsp_client_play_set_source(espfsp_client_play_handler_t handler, const char *name);
+
+esp_err_t espfsp_client_play_reconfigure_frame(espfsp_client_play_handler_t handler, espfsp_frame_config_t *config);
+esp_err_t espfsp_client_play_reconfigure_cam(espfsp_client_play_handler_t handler, espfsp_cam_config_t *config);
+
+esp_err_t espfsp_client_play_get_frame(
+    espfsp_client_play_handler_t handler, espfsp_frame_config_t *config, uint32_t timeout_ms);
+esp_err_t espfsp_client_play_get_cam(
+    espfsp_client_play_handler_t handler, espfsp_cam_config_t *config, uint32_t timeout_ms);
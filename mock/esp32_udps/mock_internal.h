@@ -0,0 +1,92 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+
+#define CONFIG_MOCK_MAX_FBS 16
+#define CONFIG_MOCK_MAX_FRAMES 1024
+#define CONFIG_MOCK_MAX_SOURCES 64
+#define CONFIG_MOCK_SOURCE_NAME_LEN 30
+
+typedef enum
+{
+    MOCK_FB_FREE,
+    MOCK_FB_FILLING,
+    MOCK_FB_READY,
+    MOCK_FB_TAKEN,
+} mock_fb_state_t;
+
+typedef struct
+{
+    espfsp_fb_t fb;
+    size_t capacity;
+    mock_fb_state_t state;
+    uint32_t seq;
+} mock_fb_t;
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t len;
+} mock_frame_t;
+
+struct espfsp_client_play
+{
+    espfsp_frame_config_t frame_config;
+    espfsp_cam_config_t cam_config;
+
+    SemaphoreHandle_t mutex;
+    SemaphoreHandle_t ready;
+    SemaphoreHandle_t task_done;
+    TaskHandle_t task;
+    volatile bool running;
+    volatile bool streaming;
+    bool prebuffering;
+
+    mock_fb_t fbs[CONFIG_MOCK_MAX_FBS];
+    uint32_t seq;
+
+    // Local replay
+    mock_frame_t frames[CONFIG_MOCK_MAX_FRAMES];
+    int frames_len;
+    int next_frame;
+
+    int sources_len;
+    int source;
+
+    uint16_t fps_override;
+    size_t pad_len;
+    uint32_t control_delay_ms;
+
+    // Connection to server emulator, used instead of local replay when ESPFSP_MOCK_NET is set
+    bool net;
+    espfsp_data_transport_t transport;
+    uint32_t remote_addr;
+    espfsp_ports_t local_ports;
+    espfsp_ports_t remote_ports;
+    SemaphoreHandle_t control_mutex;
+    int control_fd;
+    int data_fd;
+};
+
+// Takes free buffer for new frame, resized to current frame_max_len. Returns NULL if all buffers are in use.
+mock_fb_t *mock_acquire_fb(espfsp_client_play_handler_t handler);
+
+// Hands filled buffer out to get_fb. Buffer with len 0 is released without being handed out.
+void mock_commit_fb(espfsp_client_play_handler_t handler, mock_fb_t *mock_fb, size_t len);
+
+// Connects to server emulator and starts data task of configured transport
+esp_err_t mock_net_init(espfsp_client_play_handler_t handler, const espfsp_client_play_config_t *config);
+void mock_net_deinit(espfsp_client_play_handler_t handler);
+
+// Sends one line request on control connection and reads reply line. Returns ESP_FAIL if server answered ERR.
+esp_err_t mock_net_request(espfsp_client_play_handler_t handler, const char *request, char *reply, size_t reply_len,
+                           uint32_t timeout_ms);
@@ -0,0 +1,434 @@
+/*
+ * Home monitoring system
+ * Author: Maksymilian Komarnicki
+ */
+
+// Connection of mock client to server emulator. Real ESPFSP wire format is not reproduced, emulator and mock use
+// simple format of their own, which is enough to put real sockets, delays and losses between server and accessor.
+//
+// Control: TCP connection to remote control port, one text line per request and per reply ("OK [payload]" or
+// "ERR"). First request is "HELLO tcp" or "HELLO udp <local data port>".
+//
+// Data over TCP: connection to remote data port, every frame is sent as
+//   u32 seq | u64 timestamp us | u32 len | JPEG
+// Data over UDP: emulator sends to local data port, every frame is split into datagrams of
+//   u32 seq | u16 fragment index | u16 fragments count | u32 frame len | up to 1400 bytes of JPEG
+// Frame with lost fragment is dropped when fragment of newer frame arrives. All numbers are big endian.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "espfsp_client_play.h"
+#include "mock_internal.h"
+
+#define CONFIG_MOCK_NET_TCP_HEADER_LEN 16
+#define CONFIG_MOCK_NET_UDP_HEADER_LEN 12
+#define CONFIG_MOCK_NET_UDP_PAYLOAD_LEN 1400
+#define CONFIG_MOCK_NET_MAX_FRAGMENTS 1024
+#define CONFIG_MOCK_NET_RECV_TIMEOUT 500
+#define CONFIG_MOCK_NET_LINE_LEN 2048
+
+static const char *TAG = "ESPFSP_MOCK_NET";
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+static uint16_t get_u16(const uint8_t *buf)
+{
+    return ((uint16_t) buf[0] << 8) | buf[1];
+}
+
+static void set_timeout(int fd, int option, uint32_t timeout_ms)
+{
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+}
+
+static int connect_tcp(uint32_t addr, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_in remote = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = addr,
+    };
+
+    if (connect(fd, (struct sockaddr *) &remote, sizeof(remote)) != 0)
+    {
+        ESP_LOGE(TAG, "Connecting to port %u failed: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Returns false on error or timeout. Timeout is only reported before first byte, later ones are waited through.
+static bool recv_all(espfsp_client_play_handler_t handler, int fd, uint8_t *buf, size_t len)
+{
+    size_t received = 0;
+
+    while (received < len && handler->running)
+    {
+        ssize_t ret = recv(fd, buf + received, len - received, 0);
+        if (ret > 0)
+        {
+            received += ret;
+        }
+        else if (ret == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            return false;
+        }
+        else if (received == 0)
+        {
+            return false;
+        }
+    }
+
+    return received == len;
+}
+
+static void tcp_data_task(void *pvParameters)
+{
+    espfsp_client_play_handler_t handler = (espfsp_client_play_handler_t) pvParameters;
+    uint8_t header[CONFIG_MOCK_NET_TCP_HEADER_LEN];
+    uint8_t discard[CONFIG_MOCK_NET_UDP_PAYLOAD_LEN];
+
+    while (handler->running)
+    {
+        if (!recv_all(handler, handler->data_fd, header, sizeof(header)))
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                continue;
+            }
+            ESP_LOGE(TAG, "Data connection lost");
+            break;
+        }
+
+        size_t len = get_u32(header + 12);
+
+        // Frame that has no free or big enough buffer is read out of stream and lost
+        mock_fb_t *mock_fb = mock_acquire_fb(handler);
+        if (mock_fb != NULL && mock_fb->capacity >= len)
+        {
+            bool ok = recv_all(handler, handler->data_fd, mock_fb->fb.buf, len);
+            mock_commit_fb(handler, mock_fb, ok && handler->streaming ? len : 0);
+            continue;
+        }
+
+        if (mock_fb != NULL)
+        {
+            mock_commit_fb(handler, mock_fb, 0);
+        }
+
+        while (len > 0 && handler->running)
+        {
+            size_t chunk = len < sizeof(discard) ? len : sizeof(discard);
+            if (!recv_all(handler, handler->data_fd, discard, chunk))
+            {
+                break;
+            }
+            len -= chunk;
+        }
+    }
+
+    xSemaphoreGive(handler->task_done);
+    vTaskDelete(NULL);
+}
+
+typedef struct
+{
+    mock_fb_t *mock_fb;
+    uint32_t seq;
+    uint32_t len;
+    uint16_t fragments;
+    uint16_t received;
+    uint8_t received_map[CONFIG_MOCK_NET_MAX_FRAGMENTS / 8];
+} udp_frame_t;
+
+static void udp_drop_frame(espfsp_client_play_handler_t handler, udp_frame_t *frame)
+{
+    if (frame->mock_fb != NULL)
+    {
+        mock_commit_fb(handler, frame->mock_fb, 0);
+        frame->mock_fb = NULL;
+    }
+}
+
+static void udp_data_task(void *pvParameters)
+{
+    espfsp_client_play_handler_t handler = (espfsp_client_play_handler_t) pvParameters;
+    uint8_t datagram[CONFIG_MOCK_NET_UDP_HEADER_LEN + CONFIG_MOCK_NET_UDP_PAYLOAD_LEN];
+    udp_frame_t frame = { 0 };
+
+    while (handler->running)
+    {
+        ssize_t ret = recv(handler->data_fd, datagram, sizeof(datagram), 0);
+        if (ret < CONFIG_MOCK_NET_UDP_HEADER_LEN)
+        {
+            continue;
+        }
+
+        uint32_t seq = get_u32(datagram);
+        uint16_t index = get_u16(datagram + 4);
+        uint16_t fragments = get_u16(datagram + 6);
+        uint32_t len = get_u32(datagram + 8);
+        size_t payload_len = ret - CONFIG_MOCK_NET_UDP_HEADER_LEN;
+
+        if (fragments == 0 || fragments > CONFIG_MOCK_NET_MAX_FRAGMENTS || index >= fragments)
+        {
+            continue;
+        }
+
+        // Fragments of older frame arriving late are of no use
+        if (frame.seq != 0 && seq < frame.seq)
+        {
+            continue;
+        }
+
+        if (seq != frame.seq)
+        {
+            udp_drop_frame(handler, &frame);
+
+            frame.seq = seq;
+            frame.len = len;
+            frame.fragments = fragments;
+            frame.received = 0;
+            memset(frame.received_map, 0, sizeof(frame.received_map));
+
+            frame.mock_fb = mock_acquire_fb(handler);
+            if (frame.mock_fb != NULL && frame.mock_fb->capacity < len)
+            {
+                udp_drop_frame(handler, &frame);
+            }
+        }
+
+        size_t offset = (size_t) index * CONFIG_MOCK_NET_UDP_PAYLOAD_LEN;
+        if (frame.mock_fb == NULL || offset + payload_len > frame.len ||
+            (frame.received_map[index / 8] & (1 << (index % 8))))
+        {
+            continue;
+        }
+
+        memcpy(frame.mock_fb->fb.buf + offset, datagram + CONFIG_MOCK_NET_UDP_HEADER_LEN, payload_len);
+        frame.received_map[index / 8] |= 1 << (index % 8);
+        frame.received++;
+
+        if (frame.received == frame.fragments)
+        {
+            mock_commit_fb(handler, frame.mock_fb, handler->streaming ? frame.len : 0);
+            frame.mock_fb = NULL;
+        }
+    }
+
+    udp_drop_frame(handler, &frame);
+
+    xSemaphoreGive(handler->task_done);
+    vTaskDelete(NULL);
+}
+
+static int bind_udp(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // Bigger receive buffer keeps bursts of fragments from being lost in kernel instead of emulated network
+    int rcvbuf = 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    if (bind(fd, (struct sockaddr *) &local, sizeof(local)) != 0)
+    {
+        ESP_LOGE(TAG, "Binding UDP port %u failed: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+esp_err_t mock_net_request(espfsp_client_play_handler_t handler, const char *request, char *reply, size_t reply_len,
+                           uint32_t timeout_ms)
+{
+    char line[CONFIG_MOCK_NET_LINE_LEN];
+    esp_err_t ret = ESP_FAIL;
+
+    xSemaphoreTake(handler->control_mutex, portMAX_DELAY);
+
+    int len = snprintf(line, sizeof(line), "%s\n", request);
+    if (send(handler->control_fd, line, len, 0) != len)
+    {
+        ESP_LOGE(TAG, "Sending '%s' failed", request);
+        goto out;
+    }
+
+    set_timeout(handler->control_fd, SO_RCVTIMEO, timeout_ms);
+
+    // Replies are short, so they are read byte by byte up to new line instead of being buffered
+    size_t pos = 0;
+    while (pos < sizeof(line) - 1)
+    {
+        if (recv(handler->control_fd, line + pos, 1, 0) != 1)
+        {
+            ESP_LOGE(TAG, "No reply to '%s'", request);
+            goto out;
+        }
+        if (line[pos] == '\n')
+        {
+            break;
+        }
+        pos++;
+    }
+    line[pos] = '\0';
+
+    if (strncmp(line, "OK", 2) == 0)
+    {
+        if (reply != NULL)
+        {
+            snprintf(reply, reply_len, "%s", line[2] == ' ' ? line + 3 : "");
+        }
+        ret = ESP_OK;
+    }
+
+out:
+    xSemaphoreGive(handler->control_mutex);
+    return ret;
+}
+
+esp_err_t mock_net_init(espfsp_client_play_handler_t handler, const espfsp_client_play_config_t *config)
+{
+    // Transport of data connection can be forced, as accessor itself always asks for the same one
+    const char *transport = getenv("ESPFSP_MOCK_NET");
+    if (strcmp(transport, "udp") == 0)
+    {
+        handler->transport = ESPFSP_TRANSPORT_UDP;
+    }
+    else if (strcmp(transport, "tcp") == 0)
+    {
+        handler->transport = ESPFSP_TRANSPORT_TCP;
+    }
+    else
+    {
+        handler->transport = config->data_transport;
+    }
+    handler->remote_addr = config->remote_addr.addr;
+    handler->local_ports = config->local;
+    handler->remote_ports = config->remote;
+    handler->control_fd = -1;
+    handler->data_fd = -1;
+
+    handler->control_mutex = xSemaphoreCreateMutex();
+    if (handler->control_mutex == NULL)
+    {
+        return ESP_FAIL;
+    }
+
+    handler->control_fd = connect_tcp(handler->remote_addr, handler->remote_ports.control_port);
+    if (handler->control_fd < 0)
+    {
+        return ESP_FAIL;
+    }
+
+    char hello[32];
+    if (handler->transport == ESPFSP_TRANSPORT_UDP)
+    {
+        handler->data_fd = bind_udp(handler->local_ports.data_port);
+        snprintf(hello, sizeof(hello), "HELLO udp %u", handler->local_ports.data_port);
+    }
+    else
+    {
+        snprintf(hello, sizeof(hello), "HELLO tcp");
+    }
+
+    if (mock_net_request(handler, hello, NULL, 0, CONFIG_MOCK_NET_RECV_TIMEOUT * 4) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    if (handler->transport == ESPFSP_TRANSPORT_TCP)
+    {
+        handler->data_fd = connect_tcp(handler->remote_addr, handler->remote_ports.data_port);
+    }
+    if (handler->data_fd < 0)
+    {
+        return ESP_FAIL;
+    }
+
+    // Data task checks running flag between receives, so deinit does not have to close socket under it
+    set_timeout(handler->data_fd, SO_RCVTIMEO, CONFIG_MOCK_NET_RECV_TIMEOUT);
+
+    handler->running = true;
+    BaseType_t xStatus = xTaskCreate(
+        handler->transport == ESPFSP_TRANSPORT_UDP ? udp_data_task : tcp_data_task,
+        "espfsp_mock_net",
+        config->data_task_info.stack_size,
+        handler,
+        config->data_task_info.task_prio,
+        &handler->task);
+    if (xStatus != pdPASS)
+    {
+        handler->running = false;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Connected to server emulator over %s", handler->transport == ESPFSP_TRANSPORT_UDP ? "UDP" : "TCP");
+    return ESP_OK;
+}
+
+void mock_net_deinit(espfsp_client_play_handler_t handler)
+{
+    if (handler->running)
+    {
+        handler->running = false;
+        xSemaphoreTake(handler->task_done, portMAX_DELAY);
+    }
+
+    if (handler->control_fd >= 0)
+    {
+        close(handler->control_fd);
+    }
+    if (handler->data_fd >= 0)
+    {
+        close(handler->data_fd);
+    }
+    if (handler->control_mutex != NULL)
+    {
+        vSemaphoreDelete(handler->control_mutex);
+    }
+}